@@ -1,13 +1,36 @@
 #include "glfuncs.h"
 
 #include "utils/util.h"
+#include "utils/mapped_file.h"
 #include "texture-formats/tgareader.h"
 #include "texture-formats/pngreader.h"
 #include "texture-formats/bmpreader.h"
+#include "texture-formats/ddsreader.h"
+#include "texture-formats/ktxreader.h"
+#include "texture-formats/pixel_convert.h"
 
 #include <iostream>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
 #include <boost\filesystem.hpp>
 
+// Bumped when the encoder output changes, so older compressed caches are rebuilt.
+#define TEXTURE_CACHE_VERSION 1
+// Pixel buffer objects the uploads rotate through.
+#define TEXTURE_PIXEL_BUFFERS 4
+// Texture units whose bindings texture_bind remembers.
+#define TEXTURE_TRACKED_UNITS 16
+
+static int pixel_buffers_enabled = 0;
+static GLuint pixel_buffers[TEXTURE_PIXEL_BUFFERS];
+static int next_pixel_buffer = 0;
+
+static GLuint bound_textures[TEXTURE_TRACKED_UNITS];
+static int bound_known[TEXTURE_TRACKED_UNITS];
+static int active_unit = -1;
+static unsigned long bind_calls = 0, binds_skipped = 0;
+
 
 //Crea un buffer per OpenGL
 GLuint make_buffer(
@@ -23,59 +46,436 @@ GLuint make_buffer(
 	return buffer;
 }
 
-void *read_texture(const char *filename, int *width, int *height, GLuint &format)
+//Tutti i lettori scrivono pixel RGBA8, il formato in cui le texture vengono caricate, dove dice destination
+static void *read_texture(const char *filename, int *width, int *height, pixel_destination destination, void *context)
 {
 	std::string extension = boost::filesystem::extension(filename);
 
 	if (extension == ".png")
+		return read_png_to(filename, (unsigned *) width, (unsigned *) height, destination, context);
+
+	if (extension == ".tga")
+		return read_tga_to(filename, width, height, destination, context);
+
+	if (extension == ".bmp")
+		return read_bmp_to(filename, width, height, destination, context);
+
+	return NULL;
+}
+
+//Il prossimo buffer dell'anello, creato al primo uso
+static GLuint next_ring_buffer()
+{
+	GLuint buffer = pixel_buffers[next_pixel_buffer];
+	if (buffer == 0)
 	{
-		format = GL_RGBA;
-		return read_png(filename, (unsigned *) width, (unsigned *) height);
+		glGenBuffers(1, &buffer);
+		pixel_buffers[next_pixel_buffer] = buffer;
 	}
+	next_pixel_buffer = (next_pixel_buffer + 1) % TEXTURE_PIXEL_BUFFERS;
+	return buffer;
+}
 
-	if (extension == ".tga")
+//Dove decode_texture scrive i pixel di un file png, tga o bmp
+typedef struct {
+	const mipmap_settings *mipmaps;
+	int pixel_buffer; //nel prossimo buffer dell'anello, solo sul thread di OpenGL
+	GLuint buffer;    //il buffer mappato da allocate_texture_pixels, 0 se i pixel sono nell'heap
+} texture_destination;
+
+//Riserva anche lo spazio della catena di mipmap, che viene costruita subito dopo il livello 0
+static void *allocate_texture_pixels(int width, int height, void *context)
+{
+	texture_destination *destination = (texture_destination *) context;
+	const mipmap_settings *mipmaps = destination->mipmaps;
+	bool chain = mipmaps != NULL && mipmaps->filter != MIPMAP_NONE;
+	size_t bytes = chain ? mipmap_chain_bytes(width, height) : (size_t) width * height * 4;
+	if (!destination->pixel_buffer)
+		return malloc(bytes);
+
+	GLuint buffer = next_ring_buffer();
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+	//dati nuovi: il driver pu continuare a leggere quelli vecchi da un'altra allocazione
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+	//le mipmap e la premoltiplicazione rileggono i pixel, e la memoria mappata in sola scrittura
+	// spesso lentissima da leggere
+	bool read_back = chain || (mipmaps != NULL && mipmaps->premultiply);
+	void *mapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, read_back ? GL_READ_WRITE : GL_WRITE_ONLY);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (mapped == NULL)
+		return malloc(bytes);
+	destination->buffer = buffer;
+	return mapped;
+}
+
+void release_texture_pixels(texture_image *image)
+{
+	free(image->pixels);
+	image->pixels = NULL;
+}
+
+void texture_set_pixel_buffers(int enabled)
+{
+	pixel_buffers_enabled = enabled;
+}
+
+int texture_pixel_buffers_enabled()
+{
+	return pixel_buffers_enabled;
+}
+
+//Byte di un livello dei pixel di un'immagine decodificata
+static size_t texture_level_bytes(const texture_image *image, int level)
+{
+	int level_width = mipmap_level_size(image->width, level), level_height = mipmap_level_size(image->height, level);
+	if (image->compression != BCN_NONE)
+		return bcn_level_bytes(image->compression, level_width, level_height);
+	return (size_t) level_width * level_height * 4;
+}
+
+//Calcola la catena di mipmap completa nello spazio riservato dopo il livello 0
+static void build_mipmaps(texture_image *image, const mipmap_settings *mipmaps, int threads)
+{
+	mipmap_build_chain((unsigned char *) image->pixels, image->width, image->height, mipmaps, threads);
+	image->level_count = mipmap_level_count(image->width, image->height);
+}
+
+int texture_compression_supported(bcn_format format)
+{
+	switch (format)
 	{
-		format = GL_BGR;
-		return read_tga(filename, width, height);
+	case BCN_BC1:
+	case BCN_BC2:
+	case BCN_BC3:
+		return GLEW_EXT_texture_compression_s3tc;
+	case BCN_BC7:
+		return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+	default:
+		return 1;
 	}
+}
 
-	if (extension == ".bmp")
+static GLenum compressed_internal_format(bcn_format format)
+{
+	switch (format)
 	{
-		format = GL_BGR;
-		return read_bmp(filename, width, height);
+	case BCN_BC1: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	case BCN_BC2: return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+	case BCN_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	default: return GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
 	}
+}
 
-	return NULL;
+std::string texture_compressed_cache_path(const std::string &filename, const mipmap_settings *mipmaps)
+{
+	//ogni combinazione di formato e mipmap ha il suo file, cos due usi diversi della stessa immagine non si sovrascrivono
+	static const char *filters[] = { "none", "box", "kaiser" };
+	std::string path = filename + "." + bcn_format_name(mipmaps->compression) + "-" + filters[mipmaps->filter];
+	if (mipmaps->filter != MIPMAP_NONE && mipmaps->gamma)
+		path += "-linear";
+	if (mipmaps->premultiply)
+		path += "-pm";
+	return path + ".dds";
+}
+
+//Legge un file dds o ktx, gi compresso e con le sue mipmap
+static int read_compressed_texture(const char *filename, const std::string &extension, texture_image *image)
+{
+	bcn_image compressed;
+	if (!(extension == ".dds" ? read_dds(filename, &compressed, NULL) : read_ktx(filename, &compressed)))
+		return 0;
+	image->pixels = compressed.data;
+	image->width = compressed.width;
+	image->height = compressed.height;
+	image->level_count = compressed.level_count;
+	image->compression = compressed.format;
+	return 1;
+}
+
+//Dimensione e data del sorgente e impostazioni che una cache compressa deve avere per essere valida
+static int texture_cache_stamp(const char *filename, const mipmap_settings *mipmaps, dds_stamp *stamp)
+{
+	if (!file_stat(filename, &stamp->source_size, &stamp->source_mtime))
+		return 0;
+	stamp->settings = mipmaps->filter | (mipmaps->filter != MIPMAP_NONE && mipmaps->gamma ? 0x10 : 0) |
+		(mipmaps->premultiply ? 0x20 : 0) | (mipmaps->compression << 8) | (TEXTURE_CACHE_VERSION << 16);
+	return 1;
+}
+
+//Carica la copia compressa di un'immagine se  stata scritta con le stesse impostazioni dal file attuale
+static int read_texture_cache(const char *filename, const mipmap_settings *mipmaps, texture_image *image)
+{
+	dds_stamp expected, stamp;
+	std::string path = texture_compressed_cache_path(filename, mipmaps);
+	//un file mancante  il caso normale e non va segnalato come errore
+	if (!texture_cache_stamp(filename, mipmaps, &expected) || !file_stat(path.c_str(), NULL, NULL))
+		return 0;
+
+	bcn_image compressed;
+	if (!read_dds(path.c_str(), &compressed, &stamp))
+		return 0;
+	if (stamp.source_size != expected.source_size || stamp.source_mtime != expected.source_mtime ||
+		stamp.settings != expected.settings || compressed.format != mipmaps->compression)
+	{
+		free(compressed.data);
+		return 0;
+	}
+	image->pixels = compressed.data;
+	image->width = compressed.width;
+	image->height = compressed.height;
+	image->level_count = compressed.level_count;
+	image->compression = compressed.format;
+	return 1;
+}
+
+//Comprime i livelli RGBA dell'immagine nel formato richiesto e ne scrive la copia in cache
+static void compress_texture(const char *filename, texture_image *image, const mipmap_settings *mipmaps, int threads)
+{
+	bcn_image compressed;
+	compressed.format = mipmaps->compression;
+	compressed.width = image->width;
+	compressed.height = image->height;
+	compressed.level_count = image->level_count;
+	compressed.data = (unsigned char *) malloc(bcn_image_bytes(compressed.format, image->width, image->height, image->level_count));
+	bcn_encode_chain((const unsigned char *) image->pixels, image->width, image->height, image->level_count,
+		compressed.format, compressed.data, threads);
+
+	release_texture_pixels(image);
+	image->pixels = compressed.data;
+	image->compression = compressed.format;
+
+	dds_stamp stamp;
+	if (texture_cache_stamp(filename, mipmaps, &stamp))
+		write_dds(texture_compressed_cache_path(filename, mipmaps).c_str(), &compressed, &stamp);
+}
+
+//Legge i pixel di una texture e ne calcola le mipmap; usa OpenGL solo per scriverli in un buffer di pixel
+static int decode_texture_to(const char *filename, texture_image *image, const mipmap_settings *mipmaps, int threads,
+	texture_destination *destination)
+{
+	std::string extension = boost::filesystem::extension(filename);
+	image->level_count = 1;
+	image->first_level = 0;
+	image->compression = BCN_NONE;
+
+	if (extension == ".dds" || extension == ".ktx")
+		return read_compressed_texture(filename, extension, image);
+
+	bool compress = mipmaps != NULL && mipmaps->compression != BCN_NONE;
+	if (compress && read_texture_cache(filename, mipmaps, image))
+		return 1;
+
+	image->format = GL_RGBA;
+	image->pixels = read_texture(filename, &image->width, &image->height, allocate_texture_pixels, destination);
+	if (image->pixels == NULL)
+		return 0;
+	//prima delle mipmap, cos che il filtro non sporchi i bordi trasparenti
+	if (mipmaps != NULL && mipmaps->premultiply)
+		pixels_premultiply((unsigned char *) image->pixels, (size_t) image->width * image->height);
+	if (mipmaps != NULL && mipmaps->filter != MIPMAP_NONE)
+		build_mipmaps(image, mipmaps, threads);
+	if (compress)
+		compress_texture(filename, image, mipmaps, threads);
+	return 1;
+}
+
+int decode_texture(const char *filename, texture_image *image, const mipmap_settings *mipmaps, int threads)
+{
+	texture_destination destination = { mipmaps, 0, 0 };
+	return decode_texture_to(filename, image, mipmaps, threads, &destination);
+}
+
+//Tiene solo i livelli da first_level in poi, copiandoli in un blocco nuovo
+void drop_texture_levels(texture_image *image, int first_level)
+{
+	if (first_level <= image->first_level || first_level >= image->level_count)
+		return;
+	size_t offset = 0, bytes = 0;
+	for (int level = image->first_level; level < image->level_count; level++)
+		(level < first_level ? offset : bytes) += texture_level_bytes(image, level);
+
+	void *pixels = malloc(bytes);
+	if (pixels == NULL)
+		return;
+	memcpy(pixels, (const unsigned char *) image->pixels + offset, bytes);
+	free(image->pixels);
+	image->pixels = pixels;
+	image->first_level = first_level;
+}
+
+size_t texture_level_memory(int width, int height, bcn_format compression, int level)
+{
+	int level_width = mipmap_level_size(width, level), level_height = mipmap_level_size(height, level);
+	if (compression != BCN_NONE)
+		return bcn_level_bytes(compression, level_width, level_height);
+	return (size_t) level_width * level_height * 4;
+}
+
+//Carica i livelli [first_level, end_level) dell'immagine nella texture legata; ritorna la memoria che occupano.
+//Con un buffer di pixel legato i pixel dell'immagine sono un offset al suo interno
+static size_t upload_levels(const texture_image *image, int first_level, int end_level)
+{
+	size_t offset = 0;
+	for (int level = image->first_level; level < first_level; level++)
+		offset += texture_level_bytes(image, level);
+
+	//Le righe dei livelli piccoli non sono allineate a 4 byte
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	size_t bytes = 0;
+	const unsigned char *level_pixels = (const unsigned char *) image->pixels + offset;
+	for (int level = first_level; level < end_level; level++)
+	{
+		int level_width = mipmap_level_size(image->width, level), level_height = mipmap_level_size(image->height, level);
+		if (image->compression != BCN_NONE)
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, compressed_internal_format(image->compression),
+				level_width, level_height, 0, (GLsizei) texture_level_bytes(image, level), level_pixels);
+		else
+			glTexImage2D(
+				GL_TEXTURE_2D, level,       /* target, level of detail */
+				GL_RGBA8,                   /* internal format, the same layout as the pixels */
+				level_width, level_height, 0, /* width, height, border */
+				image->format, GL_UNSIGNED_BYTE, /* external format, type */
+				level_pixels                /* pixels */
+				);
+		level_pixels += texture_level_bytes(image, level);
+		bytes += texture_level_memory(image->width, image->height, image->compression, level);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	return bytes;
 }
 
 //Crea una texure per OpenGL
-GLuint make_texture(const char *filename)
+GLuint upload_texture(texture_image *image, size_t *texture_bytes)
 {
-	GLuint texture;
-	int width, height;
-	GLuint format;
-	void *pixels = read_texture(filename, &width, &height, format);
+	return upload_texture_from_level(image, 0, texture_bytes);
+}
 
+GLuint upload_texture_from_level(texture_image *image, int first_level, size_t *texture_bytes)
+{
+	GLuint texture;
+	//i livelli scartati da drop_texture_levels non si possono caricare
+	if (first_level < image->first_level)
+		first_level = image->first_level;
 
-	if (!pixels)
+	if (!texture_compression_supported(image->compression))
+	{
+		fprintf(stderr, "The driver does not support %s compressed textures\n", bcn_format_name(image->compression));
+		release_texture_pixels(image);
 		return 0;
+	}
 
 	glGenTextures(1, &texture);
 	glBindTexture(GL_TEXTURE_2D, texture);
+	texture_forget_bindings(); //legata sull'unit attiva, qualunque sia
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, image->level_count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, first_level);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,  image->level_count - 1);
+
+	size_t bytes = upload_levels(image, first_level, image->level_count);
+
+	release_texture_pixels(image);
+	if (texture_bytes != NULL)
+		*texture_bytes = bytes;
+	return texture;
+}
+
+size_t texture_load_levels(GLuint texture, const texture_image *image, int first_level, int end_level)
+{
+	glBindTexture(GL_TEXTURE_2D, texture);
+	texture_forget_bindings();
+	size_t bytes = upload_levels(image, first_level, end_level);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, first_level);
+	return bytes;
+}
 
-	glTexImage2D(
-		GL_TEXTURE_2D, 0,           /* target, level of detail */
-		GL_RGB8,                    /* internal format */
-		width, height, 0,           /* width, height, border */
-		format, GL_UNSIGNED_BYTE,   /* external format, type */
-		pixels                      /* pixels */
-		);
-	free(pixels);
+void texture_unload_levels(GLuint texture, int first_level, int end_level)
+{
+	glBindTexture(GL_TEXTURE_2D, texture);
+	texture_forget_bindings();
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, end_level);
+	//un livello vuoto fuori da [base, max] non rende la texture incompleta e ne libera la memoria
+	for (int level = first_level; level < end_level; level++)
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+}
+
+void texture_bind(int unit, GLuint texture)
+{
+	if (unit < TEXTURE_TRACKED_UNITS && bound_known[unit] && bound_textures[unit] == texture)
+	{
+		binds_skipped++;
+		return;
+	}
+	if (unit != active_unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		active_unit = unit;
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
+	bind_calls++;
+	if (unit < TEXTURE_TRACKED_UNITS)
+	{
+		bound_textures[unit] = texture;
+		bound_known[unit] = 1;
+	}
+}
+
+void texture_forget_bindings()
+{
+	memset(bound_known, 0, sizeof(bound_known));
+	active_unit = -1;
+}
+
+unsigned long texture_bind_calls()
+{
+	return bind_calls;
+}
+
+unsigned long texture_binds_skipped()
+{
+	return binds_skipped;
+}
+
+void texture_reset_bind_counts()
+{
+	bind_calls = binds_skipped = 0;
+}
+
+//I pixel di un'immagine non compressa vengono decodificati nel prossimo buffer dell'anello, gi mappato:
+//glTexImage2D ritorna subito e il driver li trasferisce mentre si prepara la texture successiva,
+//senza che passino per una copia nell'heap
+GLuint make_texture(const char *filename, const mipmap_settings *mipmaps, size_t *texture_bytes)
+{
+	texture_image image;
+	texture_destination destination = { mipmaps, pixel_buffers_enabled && (mipmaps == NULL || mipmaps->compression == BCN_NONE), 0 };
+	if (!decode_texture_to(filename, &image, mipmaps, 0, &destination))
+	{
+		if (destination.buffer != 0)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, destination.buffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+		return 0;
+	}
+	if (destination.buffer == 0)
+		return upload_texture(&image, texture_bytes);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, destination.buffer);
+	if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+	{
+		//il contenuto del buffer  andato perso (ad esempio per un cambio di modalit video)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (!decode_texture(filename, &image, mipmaps, 0))
+			return 0;
+		return upload_texture(&image, texture_bytes);
+	}
+	image.pixels = NULL; //da qui in poi gli indirizzi sono offset nel buffer
+	GLuint texture = upload_texture(&image, texture_bytes);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 	return texture;
 }
 void show_info_log(
@@ -7,7 +7,10 @@
 #include <Gl\glut.h>
 #endif
 
+#include <string>
+
 #include "utils/util.h"
+#include "texture-formats/mipmap.h"
 
 typedef struct {
 	GLuint vertex_buffer, element_buffer;
@@ -28,7 +31,82 @@ GLuint make_buffer(
 	GLsizei buffer_size
 	);
 
-GLuint make_texture(const char *filename);
+// Pixels of an image file, ready for glTexImage2D. With more than one level the
+// pixels hold the whole mip chain, 4 channels per pixel, level after level.
+// A compressed image holds the BCn blocks of its levels instead (see bcn.h),
+// ready for glCompressedTexImage2D, and format is unused. Pixels are malloc'd
+// and uncompressed ones are always GL_RGBA, so the driver never converts them.
+// The pixels start at first_level, 0 unless drop_texture_levels freed the larger levels;
+// width, height and level_count always describe the whole chain.
+typedef struct {
+	void *pixels;
+	int width, height;
+	GLuint format;
+	int level_count;
+	int first_level;
+	bcn_format compression;
+} texture_image;
+
+// Frees the pixels of a decoded image.
+void release_texture_pixels(texture_image *image);
+
+// Frees the levels of a decoded image before first_level, keeping the smaller ones.
+void drop_texture_levels(texture_image *image, int first_level);
+
+// Whether make_texture decodes into the ring of pixel buffer objects (--no-pbo turns it off).
+void texture_set_pixel_buffers(int enabled);
+int texture_pixel_buffers_enabled();
+
+// Whether the driver samples the format; valid once glewInit has run.
+int texture_compression_supported(bcn_format format);
+
+// Path of the compressed copy of an image baked on load with the given settings,
+// one file per format and mip settings (wood.png -> wood.png.bc3-box.dds).
+std::string texture_compressed_cache_path(const std::string &filename, const mipmap_settings *mipmaps);
+
+// Decodes a png, tga or bmp file to RGBA, premultiplies its alpha if mipmaps asks for it and,
+// unless mipmaps is NULL or its filter is MIPMAP_NONE, builds its mip chain on up to `threads`
+// threads (<= 0 for all cores). dds and ktx files are loaded compressed with the levels they
+// contain. When mipmaps asks for a compression the image is read from its compressed cache or,
+// if that is missing or stale, encoded and written to it. It does not touch OpenGL, so it can
+// run on any thread. Returns 0 on failure.
+int decode_texture(const char *filename, texture_image *image, const mipmap_settings *mipmaps, int threads);
+
+// Creates the texture from a decoded image and releases its pixels; images with a mip chain
+// are sampled trilinearly. The driver reads the pixels from where they are, without a copy
+// of its own into a pixel buffer.
+// texture_bytes, if not NULL, receives the memory used by the texture.
+// Returns 0 for a compressed image whose format the driver does not support.
+GLuint upload_texture(texture_image *image, size_t *texture_bytes);
+
+// Like upload_texture, but only the levels from first_level on are uploaded and sampled
+// (GL_TEXTURE_BASE_LEVEL): the streamed textures start from their small levels.
+GLuint upload_texture_from_level(texture_image *image, int first_level, size_t *texture_bytes);
+
+// Uploads levels [first_level, end_level) of a decoded image into an existing texture and
+// samples it from first_level; returns the memory they take. The pixels are not released.
+size_t texture_load_levels(GLuint texture, const texture_image *image, int first_level, int end_level);
+
+// Samples a texture from end_level and frees levels [first_level, end_level).
+void texture_unload_levels(GLuint texture, int first_level, int end_level);
+
+// Video memory of a level of a texture, as counted by the functions above.
+size_t texture_level_memory(int width, int height, bcn_format compression, int level);
+
+// Binds a 2D texture on a unit unless it is already bound there, so objects sharing a
+// texture or an atlas page do not rebind it. Bindings made any other way (uploads,
+// deleted textures, the post-processing pass) must be followed by texture_forget_bindings.
+void texture_bind(int unit, GLuint texture);
+void texture_forget_bindings();
+// glBindTexture calls issued and avoided by texture_bind since the last reset.
+unsigned long texture_bind_calls();
+unsigned long texture_binds_skipped();
+void texture_reset_bind_counts();
+
+// decode_texture and upload_texture in one go, on the OpenGL thread. With pixel buffers an
+// uncompressed png, tga or bmp is decoded straight into the next buffer of the ring, mapped
+// first, from where the driver transfers it while the caller moves on.
+GLuint make_texture(const char *filename, const mipmap_settings *mipmaps, size_t *texture_bytes);
 
 void show_info_log(
     GLuint object,
@@ -11,6 +11,18 @@
 
 #include "scene\Scene.h"
 #include "scene\scene_parser.h"
+#include "objloader\obj_mapped_parser.h"
+#include "mesh\index_buffer.h"
+#include "mesh\vcache.h"
+#include "mesh\vertex_format.h"
+#include "mesh\meshlet.h"
+#include "mesh\mesh_codec.h"
+#include "scene\Geometry.h"
+#include "scene\TextureCache.h"
+#include "scene\TextureAtlas.h"
+#include "scene\TextureStreamer.h"
+#include "utils\timer.h"
+#include "utils\benchmark.h"
 
 using namespace std;
 
@@ -37,7 +49,8 @@ GLushort fbo_elements[] = { 0, 1, 2, 3 };
 GLuint fbo, fbo_texture, rbo_depth;
 GLuint vbo_fbo_vertices, vbo_fbo_st, fbo_elements_buf;
 
-static void render(void)
+//Disegna la scena nel framebuffer fuori schermo dal punto di vista della camera attiva
+static void render_scene(void)
 {
 	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 	scn->getActiveCamera().cameraMove();
@@ -57,6 +70,11 @@ static void render(void)
 		);
 	scn->previsitLights();
 	scn->render();
+}
+
+static void render(void)
+{
+	render_scene();
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glLoadIdentity();
 	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
@@ -117,6 +135,57 @@ static void reshape(int width, int height)
 	glBindRenderbuffer(GL_RENDERBUFFER, 0);
 }
 
+//Contatori della residenza delle texture (--texture-budget)
+static void print_texture_streaming(void)
+{
+	printf("Texture streaming: %d KB resident (peak %d KB, budget %d KB), %d requests, %d levels loaded, %d evicted, latency %.1f ms average, %.1f ms max\n",
+		(int) (TextureStreamer::getResidentBytes() / 1024), (int) (TextureStreamer::getPeakBytes() / 1024),
+		(int) (TextureStreamer::getBudget() / 1024), TextureStreamer::getRequests(), TextureStreamer::getLevelsLoaded(),
+		TextureStreamer::getLevelsEvicted(), TextureStreamer::getAverageLatency() * 1000.0, TextureStreamer::getMaxLatency() * 1000.0);
+}
+
+//Confronta il costo su cpu del rendering della scena con e senza vertex array object
+static int benchmark_render(int frames)
+{
+	bool vertexArrays = mesh_vertex_arrays_enabled() != 0;
+	if (!vertexArrays)
+		cout << "Vertex array objects not available or disabled, only the pointer path is measured" << endl;
+
+	for (int mode = 0; mode < (vertexArrays ? 2 : 1); mode++)
+	{
+		mesh_set_vertex_arrays(mode == 1);
+
+		//Un frame di riscaldamento, poi si misura solo l'invio dei comandi
+		render_scene();
+		glFinish();
+		Geometry::resetGlCalls();
+		texture_reset_bind_counts();
+
+		double elapsed = 0.0;
+		for (int f = 0; f < frames; f++)
+		{
+			double start = timer_seconds();
+			render_scene();
+			elapsed += timer_seconds() - start;
+			glFinish();
+		}
+
+		unsigned long renders = Geometry::getRenderCount();
+		printf("%s: %lu objects per frame, %.1f geometry GL calls per object, %lu clusters culled per frame, %.3f ms CPU per frame\n",
+			mode == 1 ? "vertex array objects" : "per-draw pointers",
+			renders / frames, renders > 0 ? (double) Geometry::getGlCalls() / renders : 0.0,
+			Geometry::getCulledMeshlets() / frames, elapsed * 1000.0 / frames);
+		printf("  %.1f texture binds per frame, %.1f avoided because the texture was already bound\n",
+			(double) texture_bind_calls() / frames, (double) texture_binds_skipped() / frames);
+	}
+
+	if (TextureStreamer::isEnabled())
+		print_texture_streaming();
+
+	mesh_set_vertex_arrays(vertexArrays);
+	return 1;
+}
+
 //-------------------------------------------------------------------------------------
 //-- Keyboard -------------------------------------------------------------------------
 //-------------------------------------------------------------------------------------
@@ -261,6 +330,16 @@ bool init_framebuffer()
 int main(int argc, char* argv[])
 {
 	int width, height;
+	int benchmarkIterations;
+	int benchmarkFrames;
+	int objThreads;
+	int textureThreads;
+	int atlasPageSize;
+	int atlasMaxTexture;
+	int textureBudget;
+	int textureStreamThreads;
+	string mipmapFilter;
+	string textureCompression;
 	unsigned int glutOptions = GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH;
 	string scenefile;
 
@@ -271,6 +350,31 @@ int main(int argc, char* argv[])
 		( "width", po::value<int>(&width)->default_value(500), "window width")
 		( "height", po::value<int>(&height)->default_value(500), "windows height")
 		( "scene", po::value<string>(), "file to render")
+		( "obj-threads", po::value<int>(&objThreads)->default_value(0), "threads used to parse big OBJ files (0 = all cores)")
+		( "index16", "use only 16-bit indices, splitting big meshes (for targets without 32-bit index support)")
+		( "optimize-meshes", "reorder mesh triangles and vertices for the vertex cache and overdraw")
+		( "texture-threads", po::value<int>(&textureThreads)->default_value(0), "threads used to decode the scene textures (0 = all cores)")
+		( "mipmap-filter", po::value<string>(&mipmapFilter)->default_value("box"), "filter of the texture mipmaps: none, box or kaiser (scenes can override it per texture)")
+		( "mipmap-gamma", "filter the texture mipmaps in linear light instead of on the sRGB values")
+		( "texture-compression", po::value<string>(&textureCompression)->default_value("none"), "compress the textures on load, caching them next to the images: none, bc1, bc3 or bc7 (scenes can override it per texture)")
+		( "bake-textures", po::value<string>(), "write the compressed copies of every texture in a scene and exit")
+		( "texture-content-hash", "share textures between files with identical contents, not only between uses of the same file")
+		( "texture-atlas", "pack the small textures of meshes with texcoords in [0, 1] into atlas pages, so objects draw without rebinding textures")
+		( "atlas-page-size", po::value<int>(&atlasPageSize)->default_value(2048), "width and height of an atlas page, a power of two")
+		( "atlas-max-texture", po::value<int>(&atlasMaxTexture)->default_value(256), "largest texture side packed into the atlases")
+		( "texture-budget", po::value<int>(&textureBudget)->default_value(0), "video memory in MB for the textures: they load their small mipmaps first and stream the larger ones as they grow on screen (0 = load them whole)")
+		( "texture-stream-threads", po::value<int>(&textureStreamThreads)->default_value(2), "threads decoding the streamed texture mipmaps")
+		( "compress-meshes", "write the vertices and indices of the .amesh caches compressed")
+		( "bake-meshes", po::value<string>(), "write the .amesh caches of every geometry in a scene and exit")
+		( "benchmark-obj", po::value<string>(), "measure the OBJ parsers throughput on a file and exit")
+		( "benchmark-codec", po::value<string>(), "compare the compressed mesh size and decode speed with the OBJ and raw binary and exit")
+		( "benchmark-iterations", po::value<int>(&benchmarkIterations)->default_value(3), "repetitions for the benchmarks")
+		( "benchmark-pixels", po::value<int>(), "measure the texture pixel conversions on an image of the given megapixels and exit")
+		( "benchmark-render", "render the scene without and with vertex array objects, print the GL calls and CPU time per frame and exit")
+		( "benchmark-frames", po::value<int>(&benchmarkFrames)->default_value(200), "frames rendered by --benchmark-render")
+		( "no-vao", "set the vertex pointers on every draw instead of using vertex array objects")
+		( "no-pbo", "decode textures into memory of their own instead of straight into pixel buffer objects")
+		( "no-cluster-culling", "draw whole meshes instead of culling their clusters against the frustum and by normal cone")
 		;
 	po::positional_options_description pos;
 	pos.add("scene", 1);
@@ -286,6 +390,81 @@ int main(int argc, char* argv[])
 		return EXIT_FAILURE;
 	}
 
+	obj_set_parser_threads(objThreads);
+	mesh_set_index32_supported(vm.count("index16") == 0);
+	mesh_set_optimization(vm.count("optimize-meshes") != 0);
+	mesh_set_compression(vm.count("compress-meshes") != 0);
+	TextureCache::setContentHash(vm.count("texture-content-hash") != 0);
+	TextureCache::setDecodeThreads(textureThreads);
+
+	atlas_settings atlas;
+	atlas_default_settings(&atlas);
+	atlas.page_size = atlasPageSize;
+	atlas.max_texture = atlasMaxTexture;
+	//ogni texture deve stare in una pagina insieme al suo bordo
+	if (atlasPageSize < 64 || (atlasPageSize & (atlasPageSize - 1)) != 0 || atlasMaxTexture < 1 ||
+		atlasMaxTexture + 2 * atlas_gutter(&atlas) > atlasPageSize)
+	{
+		cout << "The atlas page size must be a power of two of at least 64, larger than the largest packed texture and its gutter" << endl;
+		return EXIT_FAILURE;
+	}
+	TextureAtlas::setEnabled(vm.count("texture-atlas") != 0);
+	if (textureBudget < 0 || textureStreamThreads < 1)
+	{
+		cout << "The texture budget cannot be negative and at least one stream thread is needed" << endl;
+		return EXIT_FAILURE;
+	}
+	TextureStreamer::setBudget((size_t) textureBudget * 1024 * 1024);
+	TextureStreamer::setThreads(textureStreamThreads);
+
+	mipmap_settings mipmaps;
+	mipmap_default_settings(&mipmaps);
+	mipmaps.gamma = vm.count("mipmap-gamma") != 0;
+	if (mipmapFilter == "none")
+		mipmaps.filter = MIPMAP_NONE;
+	else if (mipmapFilter == "box")
+		mipmaps.filter = MIPMAP_BOX;
+	else if (mipmapFilter == "kaiser")
+		mipmaps.filter = MIPMAP_KAISER;
+	else
+	{
+		cout << "Unknown mipmap filter " << mipmapFilter << endl;
+		return EXIT_FAILURE;
+	}
+	mipmaps.compression = bcn_format_from_name(textureCompression.c_str());
+	if (mipmaps.compression == BCN_NONE && textureCompression != "none")
+	{
+		cout << "Unknown texture compression " << textureCompression << endl;
+		return EXIT_FAILURE;
+	}
+	mipmap_set_default_settings(&mipmaps);
+	mesh_set_cluster_culling(vm.count("no-cluster-culling") == 0);
+
+	if (vm.count("bake-meshes"))
+	{
+		return Scene::bakeMeshCaches(vm["bake-meshes"].as<string>()) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if (vm.count("bake-textures"))
+	{
+		return Scene::bakeTextureCaches(vm["bake-textures"].as<string>(), textureThreads) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if (vm.count("benchmark-obj"))
+	{
+		return benchmark_obj_parser(vm["benchmark-obj"].as<string>().c_str(), benchmarkIterations) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if (vm.count("benchmark-codec"))
+	{
+		return benchmark_mesh_codec(vm["benchmark-codec"].as<string>().c_str(), benchmarkIterations) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if (vm.count("benchmark-pixels"))
+	{
+		return benchmark_pixel_conversion(vm["benchmark-pixels"].as<int>(), benchmarkIterations) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	if (vm.count("height")) 
 	{
 		height = vm["height"].as<int>();
@@ -332,6 +511,19 @@ int main(int argc, char* argv[])
 		cout << "OpenGL 2.0 not available, check if the current driver supports it." << endl;
 		return EXIT_FAILURE;
 	}
+	mesh_set_vertex_arrays((GLEW_VERSION_3_0 || GLEW_ARB_vertex_array_object) && vm.count("no-vao") == 0);
+	texture_set_pixel_buffers((GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object) && vm.count("no-pbo") == 0);
+	if (!texture_compression_supported(mipmaps.compression))
+	{
+		cout << "The driver does not support " << textureCompression << " textures, they are uploaded uncompressed" << endl;
+		mipmaps.compression = BCN_NONE;
+		mipmap_set_default_settings(&mipmaps);
+	}
+	GLint maxTextureSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	while (atlas.page_size > maxTextureSize && atlas.page_size / 2 >= atlas.max_texture + 2 * atlas_gutter(&atlas))
+		atlas.page_size /= 2;
+	TextureAtlas::setSettings(atlas);
 
 	//Vediamo se il caricamento  effettivamente riuscito
 #ifndef _DEBUG
@@ -347,12 +539,22 @@ int main(int argc, char* argv[])
 		return EXIT_FAILURE;
 	}
 #endif
+	if (TextureStreamer::isEnabled())
+		print_texture_streaming();
 	glEnable(GL_TEXTURE_2D);
 	if(!init_framebuffer())
 	{
 		return EXIT_FAILURE;
 	}
 
+	if (vm.count("benchmark-render"))
+	{
+		reshape(width, height);
+		benchmark_render(benchmarkFrames > 0 ? benchmarkFrames : 1);
+		delete scn;
+		return EXIT_SUCCESS;
+	}
+
 	//Render loop principale
 	glutMainLoop();
 
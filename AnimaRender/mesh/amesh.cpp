@@ -0,0 +1,365 @@
+#include "amesh.h"
+#include "vcache.h"
+#include "mesh_codec.h"
+#include "../utils/parallel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define AMESH_MAGIC "AMSH"
+#define AMESH_ALIGNMENT 16
+
+// How the vertex and index sections are stored.
+#define AMESH_CODEC_RAW 0
+#define AMESH_CODEC_MESH 1
+
+typedef struct
+{
+	char magic[4];
+	unsigned int version;
+	long long source_size;
+	long long source_mtime;
+
+	unsigned int flags;
+	unsigned int vertex_count;
+	unsigned int index_count;
+	unsigned int index_type;
+	unsigned int part_count;
+	unsigned int lod_count;
+	unsigned int meshlet_count;
+	unsigned int material_count;
+	unsigned int codec;
+
+	//settings the mesh was built with
+	int lod_levels;
+	float lod_ratio;
+	float crease_angle;
+	int meshlet_triangles;
+	vertex_format format;
+
+	//where the attributes are inside an interleaved vertex and, with the compact format, how to decode them
+	vertex_layout layout;
+	int unit_texcoords;
+	unsigned int normal_type;
+	vertex_decode decode;
+	vertex_error error;
+
+	float center[3];
+	float radius;
+
+	//byte offsets from the start of the file, 0 for a missing section
+	unsigned long long vertices;
+	unsigned long long elements;
+	unsigned long long parts;
+	unsigned long long lods;
+	unsigned long long meshlets;
+	unsigned long long materials;
+
+	//encoded lengths of the sections above with AMESH_CODEC_MESH
+	unsigned long long vertices_size;
+	unsigned long long elements_size;
+} amesh_header;
+
+static int amesh_source_stat(const std::string &source_filename, long long *size, long long *mtime)
+{
+	return file_stat(source_filename.c_str(), size, mtime);
+}
+
+static size_t amesh_index_size(GLenum index_type)
+{
+	return index_type == GL_UNSIGNED_INT ? sizeof(GLuint) : sizeof(GLushort);
+}
+
+// The codec deltas the vertices word by word: floats whole, quantized attributes 16 bits at a time.
+static int amesh_vertex_word_size(const vertex_format &format)
+{
+	return format.compact ? sizeof(GLushort) : sizeof(float);
+}
+
+// Whether the vertices of a cache are in the layout the format asks for now.
+static bool amesh_format_matches(const amesh_header &header, const vertex_format &format)
+{
+	vertex_layout expected;
+	vertex_layout_make(&format, header.layout.normal_offset >= 0, header.layout.texcoord_offset >= 0, &expected);
+	if (header.layout.stride != expected.stride || header.layout.position_offset != expected.position_offset ||
+		header.layout.normal_offset != expected.normal_offset || header.layout.texcoord_offset != expected.texcoord_offset)
+		return false;
+	return header.format.compact == format.compact && (!format.compact ||
+		(header.format.position_bits == format.position_bits && header.format.normal_bits == format.normal_bits &&
+		header.format.texcoord_bits == format.texcoord_bits));
+}
+
+static unsigned long long amesh_align(unsigned long long offset)
+{
+	return (offset + AMESH_ALIGNMENT - 1) & ~(unsigned long long) (AMESH_ALIGNMENT - 1);
+}
+
+// Checks that [offset, offset + length) lies inside the mapped file.
+static const void *amesh_section(const mapped_file *file, unsigned long long offset, unsigned long long length)
+{
+	if (offset == 0 || offset > file->size || length > file->size - offset)
+		return NULL;
+	return file->data + offset;
+}
+
+std::string amesh_cache_path(const std::string &source_filename)
+{
+	return source_filename + ".amesh";
+}
+
+unsigned int amesh_current_flags()
+{
+	return mesh_optimization_enabled() ? AMESH_FLAG_OPTIMIZED : 0;
+}
+
+void mesh_default_settings(mesh_settings *settings)
+{
+	lod_default_settings(&settings->lod);
+	settings->crease_angle = 180.0f;
+	settings->meshlet_triangles = 128;
+	vertex_format_default(&settings->format);
+	settings->stream = 0;
+}
+
+// A section encoded with mesh_codec and where it is decoded to.
+typedef struct
+{
+	unsigned long long offset;
+	unsigned long long size;
+	size_t count;
+	int components;
+	int word_size;
+	unsigned char *target;
+} amesh_encoded_section;
+
+// Decodes the vertex and index sections of a compressed cache into one
+// allocation, one section per thread, and points the mesh at it.
+static int amesh_decode(amesh_file *cache, const amesh_header &header)
+{
+	amesh_data *mesh = &cache->mesh;
+	int word_size = amesh_vertex_word_size(header.format);
+	size_t index_size = amesh_index_size(header.index_type);
+	amesh_encoded_section sections[2] = {
+		{ header.vertices, header.vertices_size, header.vertex_count, header.layout.stride / word_size, word_size, NULL },
+		{ header.elements, header.elements_size, header.index_count, 1, (int) index_size, NULL }
+	};
+
+	size_t total = 0;
+	for (int s = 0; s < 2; s++)
+		if (sections[s].offset != 0)
+			total += sections[s].count * sections[s].components * sections[s].word_size;
+	cache->decoded = (unsigned char *) malloc(total > 0 ? total : 1);
+	if (cache->decoded == NULL)
+		return 0;
+
+	unsigned char *target = cache->decoded;
+	for (int s = 0; s < 2; s++)
+		if (sections[s].offset != 0)
+		{
+			sections[s].target = target;
+			target += sections[s].count * sections[s].components * sections[s].word_size;
+		}
+
+	int decoded[2] = { 1, 1 };
+	parallel_for(2, 0, [&](int s) {
+		const amesh_encoded_section &section = sections[s];
+		if (section.offset == 0)
+			return;
+		const unsigned char *data = (const unsigned char *) amesh_section(&cache->file, section.offset, section.size);
+		decoded[s] = data != NULL &&
+			codec_decode_words(data, (size_t) section.size, section.count, section.components, section.word_size, section.target);
+	});
+	if (!decoded[0] || !decoded[1])
+		return 0;
+
+	mesh->vertices = sections[0].target;
+	mesh->elements = sections[1].target;
+	return 1;
+}
+
+int amesh_open(amesh_file *cache, const std::string &source_filename, const mesh_settings &settings)
+{
+	amesh_header header;
+	long long size, mtime;
+
+	memset(cache, 0, sizeof(*cache));
+	if (!amesh_source_stat(source_filename, &size, &mtime))
+		return 0;
+
+	//stat first: a missing cache is the normal case and must not be reported as an error
+	std::string cache_filename = amesh_cache_path(source_filename);
+	if (!file_stat(cache_filename.c_str(), NULL, NULL) || !map_file(&cache->file, cache_filename.c_str()))
+		return 0;
+
+	const mapped_file *file = &cache->file;
+	if (file->size < sizeof(header))
+	{
+		amesh_close(cache);
+		return 0;
+	}
+	memcpy(&header, file->data, sizeof(header));
+
+	if (memcmp(header.magic, AMESH_MAGIC, 4) != 0 || header.version != AMESH_VERSION ||
+		(header.codec != AMESH_CODEC_RAW && header.codec != AMESH_CODEC_MESH) ||
+		header.source_size != size || header.source_mtime != mtime || header.flags != amesh_current_flags() ||
+		header.lod_levels != settings.lod.levels || (settings.lod.levels > 1 && header.lod_ratio != settings.lod.ratio) ||
+		header.crease_angle != settings.crease_angle || header.meshlet_triangles != settings.meshlet_triangles ||
+		!amesh_format_matches(header, settings.format) ||
+		(header.index_type == GL_UNSIGNED_INT && !mesh_index32_supported()))
+	{
+		amesh_close(cache);
+		return 0;
+	}
+
+	amesh_data *mesh = &cache->mesh;
+	mesh->flags = header.flags;
+	mesh->vertex_count = header.vertex_count;
+	mesh->index_count = header.index_count;
+	mesh->index_type = header.index_type;
+	mesh->part_count = header.part_count;
+	mesh->vertices = amesh_section(file, header.vertices, header.vertex_count * (unsigned long long) header.layout.stride);
+	mesh->layout = header.layout;
+	mesh->unit_texcoords = header.unit_texcoords;
+	mesh->normal_type = header.normal_type;
+	mesh->decode = header.decode;
+	mesh->error = header.error;
+	mesh->elements = amesh_section(file, header.elements, header.index_count * (unsigned long long) amesh_index_size(header.index_type));
+	mesh->parts = (const mesh_part *) amesh_section(file, header.parts, header.part_count * (unsigned long long) sizeof(mesh_part));
+	mesh->lod_count = header.lod_count;
+	mesh->lods = (const lod_level *) amesh_section(file, header.lods, header.lod_count * (unsigned long long) sizeof(lod_level));
+	mesh->meshlet_count = header.meshlet_count;
+	mesh->meshlets = (const meshlet *) amesh_section(file, header.meshlets, header.meshlet_count * (unsigned long long) sizeof(meshlet));
+	mesh->material_count = header.material_count;
+	mesh->materials = (const mesh_material *) amesh_section(file, header.materials, header.material_count * (unsigned long long) sizeof(mesh_material));
+	memcpy(mesh->center, header.center, sizeof(mesh->center));
+	mesh->radius = header.radius;
+
+	if (header.codec == AMESH_CODEC_MESH && !amesh_decode(cache, header))
+	{
+		amesh_close(cache);
+		return 0;
+	}
+
+	if (mesh->vertices == NULL || mesh->elements == NULL || mesh->parts == NULL || mesh->lods == NULL ||
+		(header.meshlets != 0 && mesh->meshlets == NULL) || (header.materials != 0 && mesh->materials == NULL))
+	{
+		amesh_close(cache);
+		return 0;
+	}
+
+	return 1;
+}
+
+void amesh_close(amesh_file *cache)
+{
+	unmap_file(&cache->file);
+	free(cache->decoded);
+	memset(cache, 0, sizeof(*cache));
+}
+
+static int amesh_write_section(FILE *f, unsigned long long *offset, unsigned long long *section, const void *data, size_t length)
+{
+	static const char padding[AMESH_ALIGNMENT] = { 0 };
+	unsigned long long aligned = amesh_align(*offset);
+
+	if (data == NULL)
+	{
+		*section = 0;
+		return 1;
+	}
+
+	if (fwrite(padding, 1, (size_t) (aligned - *offset), f) != aligned - *offset ||
+		fwrite(data, 1, length, f) != length)
+		return 0;
+
+	*section = aligned;
+	*offset = aligned + length;
+	return 1;
+}
+
+// Writes a vertex or index section, encoded when the cache is compressed;
+// *encoded_size receives the length of the encoded data.
+static int amesh_write_stream(FILE *f, unsigned long long *offset, unsigned long long *section, unsigned long long *encoded_size,
+	const void *data, size_t count, int components, int word_size, unsigned int codec)
+{
+	if (codec == AMESH_CODEC_RAW || data == NULL)
+		return amesh_write_section(f, offset, section, data, count * components * word_size);
+
+	std::vector<unsigned char> encoded;
+	codec_encode_words(data, count, components, word_size, encoded);
+	*encoded_size = encoded.size();
+	return amesh_write_section(f, offset, section, &encoded[0], encoded.size());
+}
+
+int amesh_write(const std::string &source_filename, const amesh_data *mesh, const mesh_settings &settings)
+{
+	amesh_header header;
+	unsigned long long offset = sizeof(header);
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, AMESH_MAGIC, 4);
+	header.version = AMESH_VERSION;
+	if (!amesh_source_stat(source_filename, &header.source_size, &header.source_mtime))
+		return 0;
+	header.flags = mesh->flags;
+	header.vertex_count = mesh->vertex_count;
+	header.index_count = mesh->index_count;
+	header.index_type = mesh->index_type;
+	header.part_count = mesh->part_count;
+	header.lod_count = mesh->lod_count;
+	header.lod_levels = settings.lod.levels;
+	header.lod_ratio = settings.lod.ratio;
+	header.crease_angle = settings.crease_angle;
+	header.meshlet_triangles = settings.meshlet_triangles;
+	header.format = settings.format;
+	header.layout = mesh->layout;
+	header.unit_texcoords = mesh->unit_texcoords;
+	header.normal_type = mesh->normal_type;
+	header.decode = mesh->decode;
+	header.error = mesh->error;
+	header.meshlet_count = mesh->meshlet_count;
+	header.material_count = mesh->material_count;
+	header.codec = mesh_compression_enabled() ? AMESH_CODEC_MESH : AMESH_CODEC_RAW;
+	int word_size = amesh_vertex_word_size(settings.format);
+	memcpy(header.center, mesh->center, sizeof(header.center));
+	header.radius = mesh->radius;
+
+	//Written to a temporary file and renamed, so a reader never maps a half-written cache
+	std::string cache_filename = amesh_cache_path(source_filename);
+	std::string temp_filename = cache_filename + ".tmp";
+	FILE *f = fopen(temp_filename.c_str(), "wb");
+	if (f == NULL)
+	{
+		fprintf(stderr, "Unable to write mesh cache %s\n", cache_filename.c_str());
+		return 0;
+	}
+
+	int ok = fwrite(&header, sizeof(header), 1, f) == 1
+		&& amesh_write_stream(f, &offset, &header.vertices, &header.vertices_size, mesh->vertices, mesh->vertex_count,
+			mesh->layout.stride / word_size, word_size, header.codec)
+		&& amesh_write_stream(f, &offset, &header.elements, &header.elements_size, mesh->elements, mesh->index_count, 1,
+			(int) amesh_index_size(mesh->index_type), header.codec)
+		&& amesh_write_section(f, &offset, &header.parts, mesh->parts, mesh->part_count * sizeof(mesh_part))
+		&& amesh_write_section(f, &offset, &header.lods, mesh->lods, mesh->lod_count * sizeof(lod_level))
+		&& amesh_write_section(f, &offset, &header.meshlets, mesh->meshlet_count > 0 ? mesh->meshlets : NULL, mesh->meshlet_count * sizeof(meshlet))
+		&& amesh_write_section(f, &offset, &header.materials, mesh->material_count > 0 ? mesh->materials : NULL, mesh->material_count * sizeof(mesh_material))
+		&& fseek(f, 0, SEEK_SET) == 0
+		&& fwrite(&header, sizeof(header), 1, f) == 1;
+
+	if (fclose(f) != 0)
+		ok = 0;
+
+	if (ok)
+	{
+		remove(cache_filename.c_str());
+		ok = rename(temp_filename.c_str(), cache_filename.c_str()) == 0;
+	}
+	if (!ok)
+	{
+		remove(temp_filename.c_str());
+		fprintf(stderr, "Unable to write mesh cache %s\n", cache_filename.c_str());
+	}
+	return ok;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <GL/glew.h>
+
+#include "index_buffer.h"
+#include "lod.h"
+#include "vertex_format.h"
+#include "meshlet.h"
+#include "material.h"
+#include "../utils/mapped_file.h"
+
+/*
+ * .amesh: precompiled mesh cache written next to the source OBJ
+ * (model.obj -> model.obj.amesh). It stores the vertices interleaved as
+ * they are uploaded (see vertex_layout), already quantized with their
+ * decode constants for the compact format, the 16 or 32-bit index buffer with
+ * its draw parts, levels of detail, meshlets and MTL materials,
+ * so a load is a single mmap whose pointers go straight to glBufferData.
+ * With mesh compression enabled the vertex and index sections are written
+ * with mesh_codec and decoded on load; both kinds of cache are read.
+ * The header records the size and mtime of the source file and the
+ * settings the mesh was built with, vertex format and layout included; a
+ * cache that does not match them, or was written by another format
+ * version, is stale.
+ */
+
+#define AMESH_VERSION 9
+
+// The geometry went through the vertex cache / overdraw optimization stage.
+#define AMESH_FLAG_OPTIMIZED 1
+
+// Per-object settings a mesh is built with; a cache only matches the same lod,
+// crease angle, cluster size and vertex format. Streaming only changes how a mesh
+// without a cache is loaded.
+typedef struct
+{
+	lod_settings lod;
+	float crease_angle; // used when normals are generated, see generate_normals
+	int meshlet_triangles; // cluster size for culling, 0 disables it
+	vertex_format format;
+	int stream; // load progressively when there is no cache, see mesh_stream.h
+} mesh_settings;
+
+void mesh_default_settings(mesh_settings *settings);
+
+// A mesh ready to be uploaded. The vertices are interleaved in layout, whose
+// normal and texcoord offsets are -1 when the mesh has none.
+typedef struct
+{
+	unsigned int flags;
+	GLuint vertex_count;
+	GLuint index_count;
+	GLenum index_type;
+	GLuint part_count;
+	const void *vertices;
+	vertex_layout layout;
+	int unit_texcoords; // every texcoord inside [0, 1], so its textures may go in an atlas
+	// With the compact format: how the normals are stored, the constants that
+	// dequantize the vertices and the error the quantization introduced.
+	GLenum normal_type;
+	vertex_decode decode;
+	vertex_error error;
+	const void *elements;
+	const mesh_part *parts;
+	GLuint lod_count;
+	const lod_level *lods;
+	GLuint meshlet_count;
+	const meshlet *meshlets;
+	GLuint material_count;
+	const mesh_material *materials;
+	float center[3];
+	float radius;
+} amesh_data;
+
+typedef struct
+{
+	mapped_file file;
+	amesh_data mesh;
+	unsigned char *decoded; // vertices and indices of a compressed cache, NULL otherwise
+} amesh_file;
+
+std::string amesh_cache_path(const std::string &source_filename);
+
+// The flags a mesh built now with the current settings would have.
+unsigned int amesh_current_flags();
+
+// Maps the cache of source_filename. Returns 0 if it is missing, stale or
+// built with flags other than amesh_current_flags() or other settings.
+int amesh_open(amesh_file *cache, const std::string &source_filename, const mesh_settings &settings);
+// Unmaps a cache opened by amesh_open; the mesh pointers become invalid.
+void amesh_close(amesh_file *cache);
+
+// Writes (or replaces) the cache of source_filename. Returns 0 on failure.
+int amesh_write(const std::string &source_filename, const amesh_data *mesh, const mesh_settings &settings);
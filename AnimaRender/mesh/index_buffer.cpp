@@ -0,0 +1,62 @@
+#include "index_buffer.h"
+
+static bool index32_supported = true;
+
+void mesh_set_index32_supported(bool supported)
+{
+	index32_supported = supported;
+}
+
+bool mesh_index32_supported()
+{
+	return index32_supported;
+}
+
+void split_mesh(const std::vector<GLuint> &elements, size_t vertex_count, size_t max_vertices,
+	std::vector<GLuint> &vertex_remap, std::vector<GLushort> &local_elements, std::vector<mesh_part> &parts)
+{
+	//local_index is valid for a vertex only while owner equals the current part
+	std::vector<GLuint> local_index(vertex_count);
+	std::vector<int> owner(vertex_count, -1);
+	mesh_part part = { 0, 0, 0, 0, 0, -1 };
+
+	vertex_remap.clear();
+	local_elements.clear();
+	local_elements.reserve(elements.size());
+	parts.clear();
+
+	for (size_t t = 0; t + 2 < elements.size(); t += 3)
+	{
+		int current = (int) parts.size();
+		size_t needed = 0;
+		for (int k = 0; k < 3; k++)
+			if (owner[elements[t + k]] != current)
+				needed++;
+
+		//The triangle does not fit: close the part and start a new one
+		if (vertex_remap.size() - part.first_vertex + needed > max_vertices)
+		{
+			parts.push_back(part);
+			part.first_vertex = (GLuint) vertex_remap.size();
+			part.first_index = (GLuint) local_elements.size();
+			part.index_count = 0;
+			current++;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint vertex = elements[t + k];
+			if (owner[vertex] != current)
+			{
+				owner[vertex] = current;
+				local_index[vertex] = (GLuint) vertex_remap.size() - part.first_vertex;
+				vertex_remap.push_back(vertex);
+			}
+			local_elements.push_back((GLushort) local_index[vertex]);
+		}
+		part.index_count += 3;
+	}
+
+	if (part.index_count > 0)
+		parts.push_back(part);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+#include <GL/glew.h>
+
+// Vertices addressable by a GL_UNSIGNED_SHORT index buffer.
+#define MESH_MAX_SHORT_VERTICES 65536
+
+// A range of the index buffer drawn with one glDrawElements call.
+// Its indices are relative to first_vertex. When the part was clustered its
+// triangles are covered, in order, by meshlet_count meshlets (see meshlet.h).
+typedef struct
+{
+	GLuint first_vertex;
+	GLuint first_index;
+	GLsizei index_count;
+	GLuint first_meshlet;
+	GLuint meshlet_count;
+	int material; // index in the mesh materials, -1 for none (see material.h)
+} mesh_part;
+
+// Whether GL_UNSIGNED_INT indices may be used. When they may not, big
+// meshes are split into parts of at most MESH_MAX_SHORT_VERTICES vertices.
+void mesh_set_index32_supported(bool supported);
+bool mesh_index32_supported();
+
+/*
+ * Splits an indexed triangle list into consecutive parts that reference at
+ * most max_vertices vertices each. Vertices used by more than one part are
+ * duplicated: vertex_remap receives, for every output vertex, the input
+ * vertex it copies, and local_elements the part-relative indices.
+ */
+void split_mesh(const std::vector<GLuint> &elements, size_t vertex_count, size_t max_vertices,
+	std::vector<GLuint> &vertex_remap, std::vector<GLushort> &local_elements, std::vector<mesh_part> &parts);
+
+// Reorders a vertex attribute array according to a remap from split_mesh.
+template <typename T>
+void remap_vertices(std::vector<T> &attribute, const std::vector<GLuint> &vertex_remap)
+{
+	if (attribute.empty())
+		return;
+
+	std::vector<T> remapped(vertex_remap.size());
+	for (size_t i = 0; i < vertex_remap.size(); i++)
+		remapped[i] = attribute[vertex_remap[i]];
+	attribute.swap(remapped);
+}
@@ -0,0 +1,51 @@
+#include "lod.h"
+#include "simplify.h"
+
+#include <math.h>
+
+void lod_default_settings(lod_settings *settings)
+{
+	settings->levels = 1;
+	settings->ratio = 0.5f;
+	settings->pixel_error = 1.0f;
+}
+
+void build_lod_chain(std::vector<GLuint> &elements, const std::vector<glm::vec3> &vertices,
+	const lod_settings &settings, std::vector<lod_range> &ranges)
+{
+	lod_range base = { 0, (GLuint) elements.size(), 0.0f };
+	ranges.clear();
+	ranges.push_back(base);
+
+	std::vector<GLuint> level(elements);
+	std::vector<GLuint> simplified;
+	float error = 0.0f;
+
+	for (int l = 1; l < settings.levels; l++)
+	{
+		size_t target = (size_t) (level.size() / 3 * settings.ratio) * 3;
+		error += simplify_mesh(level, vertices, target, simplified);
+
+		//Locked borders and seams can stop the simplifier: a level that is not coarser is useless
+		if (simplified.empty() || simplified.size() >= level.size() * 0.95)
+			break;
+
+		lod_range range = { (GLuint) elements.size(), (GLuint) simplified.size(), error };
+		ranges.push_back(range);
+		elements.insert(elements.end(), simplified.begin(), simplified.end());
+		level.swap(simplified);
+	}
+}
+
+int select_lod(const lod_level *levels, int level_count, float distance, float fov_y, int viewport_height, float pixel_error)
+{
+	//Pixels covered by one object space unit at that distance
+	float pixels_per_unit = viewport_height / (2.0f * tanf(fov_y * 0.5f) * distance);
+	int selected = 0;
+
+	for (int l = 1; l < level_count; l++)
+		if (levels[l].error * pixels_per_unit <= pixel_error)
+			selected = l;
+
+	return selected;
+}
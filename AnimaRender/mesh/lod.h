@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Level of detail chain requested for an object (the `lod` scene keyword).
+typedef struct
+{
+	int levels;        // 1 disables the chain
+	float ratio;       // triangles kept by each level relative to the previous one
+	float pixel_error; // largest error on screen, in pixels, accepted when picking a level
+} lod_settings;
+
+// A range of the element array holding one level, finest first.
+typedef struct
+{
+	GLuint first_index;
+	GLuint index_count;
+	float error;
+} lod_range;
+
+// A level after the element array has been turned into draw parts.
+typedef struct
+{
+	float error;
+	GLuint first_part;
+	GLuint part_count;
+} lod_level;
+
+void lod_default_settings(lod_settings *settings);
+
+/*
+ * Simplifies the triangle list in elements (level 0) into settings.levels
+ * levels and appends them after it. ranges receives one entry per level;
+ * levels that could not be simplified further are dropped. Errors are in
+ * object space and grow monotonically.
+ */
+void build_lod_chain(std::vector<GLuint> &elements, const std::vector<glm::vec3> &vertices,
+	const lod_settings &settings, std::vector<lod_range> &ranges);
+
+/*
+ * Picks the coarsest level whose error, projected at distance with the given
+ * vertical field of view (radians) on a viewport_height pixels tall viewport,
+ * stays under pixel_error.
+ */
+int select_lod(const lod_level *levels, int level_count, float distance, float fov_y, int viewport_height, float pixel_error);
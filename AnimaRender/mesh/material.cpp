@@ -0,0 +1,98 @@
+#include "material.h"
+#include "../glfuncs.h"
+
+#include <string.h>
+#include <algorithm>
+
+void material_from_obj(const obj_material *source, mesh_material *material)
+{
+	memset(material, 0, sizeof(*material));
+	strncpy(material->name, source->name, MESH_MATERIAL_NAME_SIZE - 1);
+	strncpy(material->texture_filename, source->texture_filename, MESH_MATERIAL_PATH_SIZE - 1);
+	for (int k = 0; k < 3; k++)
+	{
+		material->ambient[k] = (float) source->amb[k];
+		material->diffuse[k] = (float) source->diff[k];
+		material->specular[k] = (float) source->spec[k];
+	}
+	material->ambient[3] = material->specular[3] = 1.0f;
+	material->diffuse[3] = (float) source->trans;
+	material->shininess = (float) std::min(std::max(source->shiny, 0.0), 128.0);
+}
+
+void sort_by_material(std::vector<GLuint> &elements, const int *triangle_materials, std::vector<material_range> &ranges)
+{
+	int triangle_count = (int) (elements.size() / 3);
+	int material_count = 0;
+
+	ranges.clear();
+	if (triangle_count == 0)
+		return;
+
+	for (int t = 0; t < triangle_count; t++)
+		material_count = triangle_materials[t] + 1 > material_count ? triangle_materials[t] + 1 : material_count;
+
+	// Counting sort on material + 1, so faces without a material come first
+	std::vector<GLuint> offsets(material_count + 2, 0);
+	for (int t = 0; t < triangle_count; t++)
+		offsets[triangle_materials[t] + 2]++;
+	for (int m = 0; m <= material_count; m++)
+		offsets[m + 1] += offsets[m];
+
+	std::vector<GLuint> sorted(elements.size());
+	std::vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+	for (int t = 0; t < triangle_count; t++)
+	{
+		GLuint to = fill[triangle_materials[t] + 1]++ * 3;
+		sorted[to] = elements[t * 3];
+		sorted[to + 1] = elements[t * 3 + 1];
+		sorted[to + 2] = elements[t * 3 + 2];
+	}
+	elements.swap(sorted);
+
+	for (int m = 0; m <= material_count; m++)
+	{
+		if (offsets[m + 1] == offsets[m])
+			continue;
+		material_range range = { offsets[m] * 3, (offsets[m + 1] - offsets[m]) * 3, 0, m - 1, 0.0f };
+		ranges.push_back(range);
+	}
+}
+
+void material_get_uniforms(GLuint program, material_uniforms *uniforms)
+{
+	uniforms->texture = glGetUniformLocation(program, "materialTexture");
+	uniforms->textured = glGetUniformLocation(program, "materialTextured");
+}
+
+void material_bind(const mesh_material *material, GLuint texture, const material_uniforms *uniforms)
+{
+	glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, material->ambient);
+	glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, material->diffuse);
+	glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, material->specular);
+	glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, material->shininess);
+
+	if (texture != 0)
+	{
+		// Parts of the same material in a row keep the texture bound
+		texture_bind(MESH_MATERIAL_TEXTURE_UNIT, texture);
+		if (uniforms->texture >= 0)
+			glUniform1i(uniforms->texture, MESH_MATERIAL_TEXTURE_UNIT);
+	}
+	if (uniforms->textured >= 0)
+		glUniform1i(uniforms->textured, texture != 0 ? 1 : 0);
+}
+
+void material_reset(const material_uniforms *uniforms)
+{
+	static const float ambient[4] = { 0.2f, 0.2f, 0.2f, 1.0f };
+	static const float diffuse[4] = { 0.8f, 0.8f, 0.8f, 1.0f };
+	static const float specular[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, ambient);
+	glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, diffuse);
+	glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, specular);
+	glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, 0.0f);
+	if (uniforms->textured >= 0)
+		glUniform1i(uniforms->textured, 0);
+}
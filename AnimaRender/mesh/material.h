@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <GL/glew.h>
+#include "../objloader/obj_parser.h"
+
+/*
+ * MTL materials of an OBJ. The triangles of every material are grouped into
+ * their own draw parts, sorted by material, so an object binds each material
+ * once per frame however its faces were interleaved in the file.
+ *
+ * Binding a material sets the fixed function material (gl_FrontMaterial in
+ * the shaders) from Ka/Kd/Ks/Ns/d and, when it has a map_Kd (or map_Ka),
+ * binds the texture on MESH_MATERIAL_TEXTURE_UNIT. Shaders that want the map
+ * declare
+ *   uniform sampler2D materialTexture; uniform int materialTextured;
+ */
+
+// The scene textures use units 0..7.
+#define MESH_MATERIAL_TEXTURE_UNIT 8
+
+#define MESH_MATERIAL_NAME_SIZE 256
+#define MESH_MATERIAL_PATH_SIZE 512
+
+// A material as stored in the .amesh cache.
+typedef struct
+{
+	char name[MESH_MATERIAL_NAME_SIZE];
+	char texture_filename[MESH_MATERIAL_PATH_SIZE]; // empty without a map
+	float ambient[4];
+	float diffuse[4];  // alpha is the dissolve (d)
+	float specular[4];
+	float shininess;   // Ns clamped to the 0..128 of GL_SHININESS
+} mesh_material;
+
+// A range of the element array drawn with one material at one level of detail.
+typedef struct
+{
+	GLuint first_index;
+	GLuint index_count;
+	int level;
+	int material; // -1 for faces before any usemtl
+	float error;
+} material_range;
+
+typedef struct
+{
+	GLint texture;
+	GLint textured;
+} material_uniforms;
+
+// Copies a material parsed from an mtl file.
+void material_from_obj(const obj_material *source, mesh_material *material);
+
+/*
+ * Stably reorders the triangles of elements by triangle_materials (one
+ * entry per triangle, -1 allowed) and fills ranges with one level 0 range
+ * per material actually used, in material order.
+ */
+void sort_by_material(std::vector<GLuint> &elements, const int *triangle_materials, std::vector<material_range> &ranges);
+
+void material_get_uniforms(GLuint program, material_uniforms *uniforms);
+
+// texture is 0 when the material has no map or it is not drawn textured.
+void material_bind(const mesh_material *material, GLuint texture, const material_uniforms *uniforms);
+
+// Back to the OpenGL default material, so objects without materials are not
+// drawn with the last one bound.
+void material_reset(const material_uniforms *uniforms);
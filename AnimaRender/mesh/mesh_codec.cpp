@@ -0,0 +1,397 @@
+#include "mesh_codec.h"
+
+#include <string.h>
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define CODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+#define CODEC_MODE_STORED 0
+#define CODEC_MODE_LZ 1
+
+#define CODEC_LZ_MIN_MATCH 4
+#define CODEC_LZ_WINDOW 65535
+#define CODEC_LZ_HASH_BITS 16
+
+static bool compression_enabled = false;
+
+void mesh_set_compression(bool enabled)
+{
+	compression_enabled = enabled;
+}
+
+bool mesh_compression_enabled()
+{
+	return compression_enabled;
+}
+
+static unsigned int codec_read32(const unsigned char *p)
+{
+	unsigned int value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static size_t codec_hash(unsigned int value)
+{
+	return (value * 2654435761u) >> (32 - CODEC_LZ_HASH_BITS);
+}
+
+static void codec_lz_length(std::vector<unsigned char> &out, size_t length)
+{
+	for (; length >= 255; length -= 255)
+		out.push_back(255);
+	out.push_back((unsigned char) length);
+}
+
+// One sequence: a token with the literal count and match length (4 bits
+// each, 15 means more bytes follow), the literals, then a 16-bit offset and
+// the rest of the match length. The last sequence has literals only.
+static void codec_lz_sequence(std::vector<unsigned char> &out, const unsigned char *literals, size_t literal_count,
+	size_t offset, size_t match_length)
+{
+	size_t match_code = match_length >= CODEC_LZ_MIN_MATCH ? match_length - CODEC_LZ_MIN_MATCH : 0;
+
+	out.push_back((unsigned char) ((std::min(literal_count, (size_t) 15) << 4) | std::min(match_code, (size_t) 15)));
+	if (literal_count >= 15)
+		codec_lz_length(out, literal_count - 15);
+	out.insert(out.end(), literals, literals + literal_count);
+
+	if (match_length == 0)
+		return;
+	out.push_back((unsigned char) (offset & 255));
+	out.push_back((unsigned char) (offset >> 8));
+	if (match_code >= 15)
+		codec_lz_length(out, match_code - 15);
+}
+
+void codec_lz_compress(const unsigned char *in, size_t size, std::vector<unsigned char> &out)
+{
+	std::vector<unsigned int> table(1 << CODEC_LZ_HASH_BITS, 0); // last position + 1 of every hash
+	size_t anchor = 0, i = 0, misses = 0;
+
+	while (i + CODEC_LZ_MIN_MATCH <= size)
+	{
+		unsigned int value = codec_read32(in + i);
+		size_t h = codec_hash(value);
+		size_t candidate = table[h];
+		table[h] = (unsigned int) (i + 1);
+
+		if (candidate == 0 || i + 1 - candidate > CODEC_LZ_WINDOW || codec_read32(in + candidate - 1) != value)
+		{
+			//incompressible data is skipped faster and faster
+			i += 1 + (misses++ >> 6);
+			continue;
+		}
+		candidate--;
+		misses = 0;
+
+		size_t length = CODEC_LZ_MIN_MATCH;
+		while (i + length < size && in[candidate + length] == in[i + length])
+			length++;
+		while (i > anchor && candidate > 0 && in[i - 1] == in[candidate - 1])
+		{
+			i--;
+			candidate--;
+			length++;
+		}
+
+		codec_lz_sequence(out, in + anchor, i - anchor, i - candidate, length);
+		i += length;
+		anchor = i;
+	}
+
+	codec_lz_sequence(out, in + anchor, size - anchor, 0, 0);
+}
+
+static int codec_lz_read_length(const unsigned char **p, const unsigned char *end, size_t *length)
+{
+	unsigned char byte;
+	do
+	{
+		if (*p >= end)
+			return 0;
+		byte = *(*p)++;
+		*length += byte;
+	} while (byte == 255);
+	return 1;
+}
+
+int codec_lz_decompress(const unsigned char *in, size_t size, unsigned char *out, size_t out_size)
+{
+	const unsigned char *ip = in, *in_end = in + size;
+	unsigned char *op = out, *out_end = out + out_size;
+
+	while (ip < in_end)
+	{
+		unsigned char token = *ip++;
+
+		size_t literal_count = token >> 4;
+		if (literal_count == 15 && !codec_lz_read_length(&ip, in_end, &literal_count))
+			return 0;
+		if (literal_count > (size_t) (in_end - ip) || literal_count > (size_t) (out_end - op))
+			return 0;
+		//short runs are copied with one fixed-size move when both buffers have room past them
+		if (literal_count <= 16 && in_end - ip >= 16 && out_end - op >= 16)
+			memcpy(op, ip, 16);
+		else
+			memcpy(op, ip, literal_count);
+		op += literal_count;
+		ip += literal_count;
+		if (ip == in_end)
+			break;
+
+		if (in_end - ip < 2)
+			return 0;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		size_t length = token & 15;
+		if (length == 15 && !codec_lz_read_length(&ip, in_end, &length))
+			return 0;
+		length += CODEC_LZ_MIN_MATCH;
+		if (offset == 0 || offset > (size_t) (op - out) || length > (size_t) (out_end - op))
+			return 0;
+
+		//overlapping copies repeat the last offset bytes
+		const unsigned char *match = op - offset;
+		if (offset >= 16 && length <= 16 && out_end - op >= 16)
+			memcpy(op, match, 16);
+		else if (offset >= length)
+			memcpy(op, match, length);
+		else if (offset == 1)
+			memset(op, *match, length);
+		else if (offset >= 8 && (size_t) (out_end - op) >= length + 8)
+		{
+			for (size_t k = 0; k < length; k += 8)
+				memcpy(op + k, match + k, 8);
+		}
+		else
+		{
+			for (size_t k = 0; k < length; k++)
+				op[k] = match[k];
+		}
+		op += length;
+	}
+
+	return op == out_end;
+}
+
+static unsigned int codec_previous(const unsigned char *bytes, size_t i, int components, int word_size)
+{
+	if (i < (size_t) components)
+		return 0;
+	if (word_size == 4)
+		return codec_read32(bytes + (i - components) * 4);
+	unsigned short value;
+	memcpy(&value, bytes + (i - components) * 2, sizeof(value));
+	return value;
+}
+
+void codec_encode_words(const void *words, size_t count, int components, int word_size, std::vector<unsigned char> &out)
+{
+	const unsigned char *bytes = (const unsigned char *) words;
+	size_t n = count * components;
+	std::vector<unsigned char> planes(n * word_size);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		size_t block = i - i % CODEC_BLOCK_WORDS;
+		size_t block_words = std::min(n - block, (size_t) CODEC_BLOCK_WORDS);
+		unsigned char *block_planes = &planes[block * word_size];
+
+		unsigned int zigzag;
+		if (word_size == 4)
+		{
+			unsigned int delta = codec_read32(bytes + i * 4) - codec_previous(bytes, i, components, word_size);
+			zigzag = (delta << 1) ^ (0u - (delta >> 31));
+		}
+		else
+		{
+			unsigned short value;
+			memcpy(&value, bytes + i * 2, sizeof(value));
+			unsigned int delta = (value - codec_previous(bytes, i, components, word_size)) & 0xffff;
+			zigzag = ((delta << 1) ^ (0u - (delta >> 15))) & 0xffff;
+		}
+		for (int b = 0; b < word_size; b++)
+			block_planes[b * block_words + i - block] = (unsigned char) (zigzag >> (8 * b));
+	}
+
+	std::vector<unsigned char> compressed;
+	if (!planes.empty())
+		codec_lz_compress(&planes[0], planes.size(), compressed);
+
+	if (compressed.size() < planes.size())
+	{
+		out.push_back(CODEC_MODE_LZ);
+		out.insert(out.end(), compressed.begin(), compressed.end());
+	}
+	else
+	{
+		out.push_back(CODEC_MODE_STORED);
+		out.insert(out.end(), planes.begin(), planes.end());
+	}
+}
+
+// Turns the deltas of [begin, end) back into values. The running sums stay
+// in registers: reading back the word just stored would chain every word
+// to the previous one through store forwarding.
+template <typename T, int C>
+static void codec_prefix_sum(T *out, size_t begin, size_t end)
+{
+	T sum[C];
+	for (int k = 0; k < C; k++)
+		sum[k] = begin + k >= C ? out[begin + k - C] : 0;
+
+	size_t i = begin;
+	for (; i + C <= end; i += C)
+		for (int k = 0; k < C; k++)
+		{
+			sum[k] = (T) (sum[k] + out[i + k]);
+			out[i + k] = sum[k];
+		}
+	for (int k = 0; i + k < end; k++)
+		out[i + k] = (T) (sum[k] + out[i + k]);
+}
+
+#ifdef CODEC_SSE2
+// Index streams: an in-register scan of four words at a time.
+template <>
+void codec_prefix_sum<unsigned int, 1>(unsigned int *out, size_t begin, size_t end)
+{
+	__m128i carry = _mm_set1_epi32(begin > 0 ? out[begin - 1] : 0);
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *) (out + i));
+		x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+		x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+		x = _mm_add_epi32(x, carry);
+		_mm_storeu_si128((__m128i *) (out + i), x);
+		carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+	for (; i < end; i++)
+		out[i] += i > 0 ? out[i - 1] : 0;
+}
+#endif
+
+template <typename T>
+static void codec_prefix_sum(T *out, size_t begin, size_t end, int components)
+{
+	switch (components)
+	{
+	case 1: codec_prefix_sum<T, 1>(out, begin, end); break;
+	case 2: codec_prefix_sum<T, 2>(out, begin, end); break;
+	case 3: codec_prefix_sum<T, 3>(out, begin, end); break;
+	case 4: codec_prefix_sum<T, 4>(out, begin, end); break;
+	default:
+		for (size_t i = std::max(begin, (size_t) components); i < end; i++)
+			out[i] = (T) (out[i] + out[i - components]);
+	}
+}
+
+// Interleaves the four planes of a block into zigzag decoded words.
+static void codec_unplane32(const unsigned char *planes, size_t block_words, unsigned int *out)
+{
+	const unsigned char *p0 = planes, *p1 = p0 + block_words, *p2 = p1 + block_words, *p3 = p2 + block_words;
+	size_t i = 0;
+
+#ifdef CODEC_SSE2
+	const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi32(1);
+	for (; i + 16 <= block_words; i += 16)
+	{
+		__m128i b0 = _mm_loadu_si128((const __m128i *) (p0 + i));
+		__m128i b1 = _mm_loadu_si128((const __m128i *) (p1 + i));
+		__m128i b2 = _mm_loadu_si128((const __m128i *) (p2 + i));
+		__m128i b3 = _mm_loadu_si128((const __m128i *) (p3 + i));
+		__m128i low01 = _mm_unpacklo_epi8(b0, b1), high01 = _mm_unpackhi_epi8(b0, b1);
+		__m128i low23 = _mm_unpacklo_epi8(b2, b3), high23 = _mm_unpackhi_epi8(b2, b3);
+		__m128i w[4];
+		w[0] = _mm_unpacklo_epi16(low01, low23);
+		w[1] = _mm_unpackhi_epi16(low01, low23);
+		w[2] = _mm_unpacklo_epi16(high01, high23);
+		w[3] = _mm_unpackhi_epi16(high01, high23);
+		for (int k = 0; k < 4; k++)
+		{
+			__m128i sign = _mm_sub_epi32(zero, _mm_and_si128(w[k], one));
+			_mm_storeu_si128((__m128i *) (out + i + 4 * k), _mm_xor_si128(_mm_srli_epi32(w[k], 1), sign));
+		}
+	}
+#endif
+	for (; i < block_words; i++)
+	{
+		unsigned int zigzag = p0[i] | (p1[i] << 8) | (p2[i] << 16) | ((unsigned int) p3[i] << 24);
+		out[i] = (zigzag >> 1) ^ (0u - (zigzag & 1));
+	}
+}
+
+static void codec_unplane16(const unsigned char *planes, size_t block_words, unsigned short *out)
+{
+	const unsigned char *p0 = planes, *p1 = p0 + block_words;
+	size_t i = 0;
+
+#ifdef CODEC_SSE2
+	const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi16(1);
+	for (; i + 16 <= block_words; i += 16)
+	{
+		__m128i b0 = _mm_loadu_si128((const __m128i *) (p0 + i));
+		__m128i b1 = _mm_loadu_si128((const __m128i *) (p1 + i));
+		__m128i w[2];
+		w[0] = _mm_unpacklo_epi8(b0, b1);
+		w[1] = _mm_unpackhi_epi8(b0, b1);
+		for (int k = 0; k < 2; k++)
+		{
+			__m128i sign = _mm_sub_epi16(zero, _mm_and_si128(w[k], one));
+			_mm_storeu_si128((__m128i *) (out + i + 8 * k), _mm_xor_si128(_mm_srli_epi16(w[k], 1), sign));
+		}
+	}
+#endif
+	for (; i < block_words; i++)
+	{
+		unsigned int zigzag = p0[i] | (p1[i] << 8);
+		out[i] = (unsigned short) ((zigzag >> 1) ^ (0u - (zigzag & 1)));
+	}
+}
+
+int codec_decode_words(const unsigned char *data, size_t size, size_t count, int components, int word_size, void *words)
+{
+	size_t n = count * components;
+	size_t plane_size = n * word_size;
+	unsigned char *bytes = (unsigned char *) words;
+
+	if (size < 1 || (word_size != 2 && word_size != 4))
+		return 0;
+	if (data[0] == CODEC_MODE_STORED)
+	{
+		if (size - 1 != plane_size)
+			return 0;
+		memcpy(bytes, data + 1, plane_size);
+	}
+	else if (data[0] == CODEC_MODE_LZ)
+	{
+		if (plane_size == 0 || !codec_lz_decompress(data + 1, size - 1, bytes, plane_size))
+			return 0;
+	}
+	else
+		return 0;
+
+	//every block of planes is copied aside and rewritten as words over itself
+	unsigned char planes[CODEC_BLOCK_WORDS * 4];
+	for (size_t block = 0; block < n; block += CODEC_BLOCK_WORDS)
+	{
+		size_t block_words = std::min(n - block, (size_t) CODEC_BLOCK_WORDS);
+		memcpy(planes, bytes + block * word_size, block_words * word_size);
+		if (word_size == 4)
+		{
+			codec_unplane32(planes, block_words, (unsigned int *) words + block);
+			codec_prefix_sum((unsigned int *) words, block, block + block_words, components);
+		}
+		else
+		{
+			codec_unplane16(planes, block_words, (unsigned short *) words + block);
+			codec_prefix_sum((unsigned short *) words, block, block + block_words, components);
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+
+/*
+ * Lossless compression of vertex attributes and index buffers, used for
+ * the .amesh sections when mesh compression is enabled.
+ *
+ * A stream is an array of count items of `components` words, each word
+ * 2 or 4 bytes (floats are coded by their bit pattern). Encoding:
+ *   1. every word becomes the difference from the same component of the
+ *      previous item, zigzag mapped so small negative steps stay small
+ *      (indices after the vertex cache optimization, neighbouring vertices);
+ *   2. every block of CODEC_BLOCK_WORDS words is split into byte planes,
+ *      all its low bytes first, so the mostly zero or repeated high bytes
+ *      form long runs; a block of planes is as big as the words it holds;
+ *   3. the planes go through a byte-oriented LZ77 stage (LZ4-like
+ *      sequences, 64K window) that the decoder expands with wide copies.
+ * Decoding expands the LZ stage straight into the output, then for every
+ * block interleaves the planes in place and undoes the zigzag (with SSE2
+ * when available) and the deltas while the block is in cache.
+ */
+
+#define CODEC_BLOCK_WORDS 4096
+
+// Whether meshes are written to the .amesh cache compressed (--compress-meshes).
+void mesh_set_compression(bool enabled);
+bool mesh_compression_enabled();
+
+// Appends the encoded stream to out.
+void codec_encode_words(const void *words, size_t count, int components, int word_size, std::vector<unsigned char> &out);
+
+// Decodes a stream produced by codec_encode_words with the same count, components
+// and word_size into words. Returns 0 if the data is corrupt.
+int codec_decode_words(const unsigned char *data, size_t size, size_t count, int components, int word_size, void *words);
+
+// The LZ stage on its own. Decompression returns 0 unless it produces exactly out_size bytes.
+void codec_lz_compress(const unsigned char *in, size_t size, std::vector<unsigned char> &out);
+int codec_lz_decompress(const unsigned char *in, size_t size, unsigned char *out, size_t out_size);
@@ -0,0 +1,194 @@
+#include "mesh_stream.h"
+#include "weld.h"
+#include "normals.h"
+
+#include <stdio.h>
+#include <unordered_map>
+
+void mesh_stream_layout(vertex_layout *layout)
+{
+	vertex_format format;
+	vertex_format_default(&format);
+	vertex_layout_make(&format, 1, 1, layout);
+}
+
+// Smooth normals of one batch, computed on its own positions so the cost
+// does not depend on the size of the file; corners get their normal_index
+// into normals. Borders between batches are not averaged.
+static void mesh_stream_batch_normals(const obj_stream_reader *reader, std::vector<obj_index_triple> &corners,
+	float crease_angle, std::vector<glm::vec3> &normals)
+{
+	std::unordered_map<int, int> local_index;
+	std::vector<float> positions;
+	std::vector<obj_index_triple> local(corners);
+
+	for (size_t c = 0; c < local.size(); c++)
+	{
+		std::unordered_map<int, int>::iterator it = local_index.find(local[c].vertex_index);
+		if (it == local_index.end())
+		{
+			const float *p = obj_stream_item(&reader->positions, local[c].vertex_index);
+			it = local_index.insert(std::make_pair(local[c].vertex_index, (int) positions.size() / 3)).first;
+			positions.insert(positions.end(), p, p + 3);
+		}
+		local[c].vertex_index = it->second;
+	}
+
+	generate_normals(&positions[0], (int) positions.size() / 3, &local[0], (int) local.size(), crease_angle, normals);
+	for (size_t c = 0; c < corners.size(); c++)
+		corners[c].normal_index = local[c].normal_index;
+}
+
+static void mesh_stream_build_batch(mesh_stream *stream, std::vector<obj_index_triple> &corners, int material, mesh_stream_batch *batch)
+{
+	const obj_stream_reader *reader = &stream->reader;
+	int position_count = obj_stream_count(&reader->positions);
+	int texture_count = obj_stream_count(&reader->texcoords);
+	int normal_count = obj_stream_count(&reader->normals);
+
+	//faces pointing outside the vertices read so far collapse to the first one
+	bool complete_normals = true;
+	for (size_t c = 0; c < corners.size(); c++)
+	{
+		obj_index_triple &corner = corners[c];
+		if (corner.vertex_index < 0 || corner.vertex_index >= position_count)
+			corner.vertex_index = 0;
+		if (corner.texture_index >= texture_count)
+			corner.texture_index = -1;
+		if (corner.normal_index < 0 || corner.normal_index >= normal_count)
+			complete_normals = false;
+	}
+
+	std::vector<glm::vec3> generated;
+	if (!complete_normals)
+		mesh_stream_batch_normals(reader, corners, stream->crease_angle, generated);
+
+	std::vector<int> remap;
+	std::vector<obj_index_triple> unique;
+	int vertex_count = weld_corners(&corners[0], (int) corners.size(), remap, unique);
+
+	std::vector<float> positions(vertex_count * 3), vertex_normals(vertex_count * 3), texcoords(vertex_count * 2, 0.0f);
+	for (int v = 0; v < vertex_count; v++)
+	{
+		const obj_index_triple &corner = unique[v];
+		const float *position = obj_stream_item(&reader->positions, corner.vertex_index);
+		const float *normal = complete_normals ? obj_stream_item(&reader->normals, corner.normal_index) : &generated[corner.normal_index].x;
+		for (int k = 0; k < 3; k++)
+		{
+			positions[v * 3 + k] = position[k];
+			vertex_normals[v * 3 + k] = normal[k];
+		}
+		if (corner.texture_index >= 0)
+		{
+			const float *texcoord = obj_stream_item(&reader->texcoords, corner.texture_index);
+			texcoords[v * 2] = texcoord[0];
+			texcoords[v * 2 + 1] = texcoord[1];
+		}
+	}
+
+	interleave_vertices(&stream->layout, &positions[0], &vertex_normals[0], &texcoords[0], NULL, vertex_count, batch->vertices);
+	batch->elements.assign(remap.begin(), remap.end());
+	batch->vertex_count = vertex_count;
+	batch->material = material;
+}
+
+static void mesh_stream_run(mesh_stream *stream)
+{
+	std::vector<obj_index_triple> corners;
+	int material;
+
+	while (true)
+	{
+		corners.clear();
+		int triangles = obj_stream_read(&stream->reader, corners, MESH_STREAM_BATCH_TRIANGLES, &material);
+		if (triangles == 0)
+			break;
+		if (obj_stream_count(&stream->reader.positions) == 0)
+			continue;
+
+		mesh_stream_batch *batch = new mesh_stream_batch;
+		mesh_stream_build_batch(stream, corners, material, batch);
+
+		std::unique_lock<std::mutex> lock(stream->mutex);
+		for (int m = (int) stream->materials.size(); m < stream->reader.material_list.item_count; m++)
+		{
+			mesh_material converted;
+			material_from_obj((const obj_material*) stream->reader.material_list.items[m], &converted);
+			stream->materials.push_back(converted);
+		}
+		stream->space.wait(lock, [stream]() { return stream->stop || stream->batches.size() < MESH_STREAM_QUEUE_BATCHES; });
+		if (stream->stop)
+		{
+			delete batch;
+			break;
+		}
+		stream->batches.push_back(batch);
+		stream->bytes_read = obj_stream_position(&stream->reader);
+	}
+
+	std::lock_guard<std::mutex> lock(stream->mutex);
+	stream->finished = 1;
+}
+
+int mesh_stream_open(mesh_stream *stream, const char *filename, float crease_angle)
+{
+	if (!obj_stream_open(&stream->reader, filename))
+		return 0;
+
+	stream->crease_angle = crease_angle;
+	mesh_stream_layout(&stream->layout);
+	stream->bytes_read = 0;
+	stream->finished = 0;
+	stream->stop = 0;
+	stream->worker = std::thread(mesh_stream_run, stream);
+	return 1;
+}
+
+void mesh_stream_close(mesh_stream *stream)
+{
+	{
+		std::lock_guard<std::mutex> lock(stream->mutex);
+		stream->stop = 1;
+	}
+	stream->space.notify_all();
+	if (stream->worker.joinable())
+		stream->worker.join();
+
+	for (size_t b = 0; b < stream->batches.size(); b++)
+		delete stream->batches[b];
+	stream->batches.clear();
+	obj_stream_close(&stream->reader);
+}
+
+mesh_stream_batch *mesh_stream_pop(mesh_stream *stream)
+{
+	mesh_stream_batch *batch = NULL;
+	{
+		std::lock_guard<std::mutex> lock(stream->mutex);
+		if (stream->batches.empty())
+			return NULL;
+		batch = stream->batches.front();
+		stream->batches.pop_front();
+	}
+	stream->space.notify_one();
+	return batch;
+}
+
+void mesh_stream_materials(mesh_stream *stream, std::vector<mesh_material> &materials)
+{
+	std::lock_guard<std::mutex> lock(stream->mutex);
+	if (stream->materials.size() > materials.size())
+		materials.insert(materials.end(), stream->materials.begin() + materials.size(), stream->materials.end());
+}
+
+int mesh_stream_done(mesh_stream *stream)
+{
+	std::lock_guard<std::mutex> lock(stream->mutex);
+	return stream->finished && stream->batches.empty();
+}
+
+long long mesh_stream_bytes_read(mesh_stream *stream)
+{
+	std::lock_guard<std::mutex> lock(stream->mutex);
+	return stream->bytes_read;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <GL/glew.h>
+
+#include "../objloader/obj_stream_reader.h"
+#include "index_buffer.h"
+#include "vertex_format.h"
+#include "material.h"
+
+/*
+ * Progressive loading of big OBJ files (the `stream` scene keyword). A
+ * worker thread reads the file with obj_stream_reader and turns every batch
+ * of faces into welded, interleaved float vertices (position, normal,
+ * texcoord, see mesh_stream_layout) and indices relative to the batch. The
+ * renderer pops the finished batches and appends them to its buffers a few
+ * at a time, drawing whatever has arrived so far.
+ *
+ * At most MESH_STREAM_QUEUE_BATCHES batches wait to be uploaded: when the
+ * renderer falls behind the reader stops, so the memory in flight stays
+ * bounded whatever the size of the file. The vertices the faces refer to
+ * are read out of mapped scratch files past the last OBJ_STREAM_SPILL_ITEMS
+ * (see obj_stream_reader.h). Normals missing from the file are generated per
+ * batch, texcoords missing from it are zero.
+ */
+
+// Batches never exceed what GL_UNSIGNED_SHORT indices can address.
+#define MESH_STREAM_BATCH_TRIANGLES (MESH_MAX_SHORT_VERTICES / 3)
+#define MESH_STREAM_QUEUE_BATCHES 16
+
+// The renderer appends batches to buffers of this size, adding a new pair
+// when the last one is full, and spends at most this long per frame on it.
+#define MESH_STREAM_SEGMENT_VERTICES (1 << 20)
+#define MESH_STREAM_SEGMENT_INDICES (3 << 20)
+#define MESH_STREAM_UPLOAD_SECONDS 0.004
+
+typedef struct
+{
+	std::vector<unsigned char> vertices; // interleaved with mesh_stream_layout
+	std::vector<GLuint> elements;        // relative to the first vertex of the batch
+	GLuint vertex_count;
+	int material;                        // index in the stream materials, -1 for none
+} mesh_stream_batch;
+
+typedef struct
+{
+	obj_stream_reader reader;
+	float crease_angle;
+	vertex_layout layout;
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable space;
+	std::deque<mesh_stream_batch*> batches;
+	std::vector<mesh_material> materials; // grows as mtllib lines are read
+	long long bytes_read;
+	int finished;
+	int stop;
+} mesh_stream;
+
+// The float layout with normals and texcoords used by every batch.
+void mesh_stream_layout(vertex_layout *layout);
+
+// Starts reading filename in the background. Returns 0 if it cannot be opened.
+int mesh_stream_open(mesh_stream *stream, const char *filename, float crease_angle);
+
+// Stops the worker and frees the batches that were not popped.
+void mesh_stream_close(mesh_stream *stream);
+
+// Takes the oldest finished batch without waiting; the caller deletes it. NULL if none is ready.
+mesh_stream_batch *mesh_stream_pop(mesh_stream *stream);
+
+// Copies the materials read so far past the ones already in materials.
+void mesh_stream_materials(mesh_stream *stream, std::vector<mesh_material> &materials);
+
+// The whole file has been read and every batch popped.
+int mesh_stream_done(mesh_stream *stream);
+
+long long mesh_stream_bytes_read(mesh_stream *stream);
@@ -0,0 +1,227 @@
+#include "meshlet.h"
+
+#include <math.h>
+#include <algorithm>
+
+// Triangles whose normal is further than this from the cluster's average
+// normal are left to a later cluster, so that cones stay narrow enough to cull.
+#define MESHLET_CONE_LIMIT 0.5f
+
+static int cluster_culling = 1;
+
+void mesh_set_cluster_culling(int enabled)
+{
+	cluster_culling = enabled;
+}
+
+int mesh_cluster_culling_enabled()
+{
+	return cluster_culling;
+}
+
+static void compute_bounds(const std::vector<GLuint> &indices, const std::vector<int> &triangles,
+	const std::vector<glm::vec3> &vertices, const std::vector<glm::vec3> &face_normals, GLuint base_vertex, meshlet *cluster)
+{
+	glm::vec3 minimum = vertices[base_vertex + indices[triangles[0] * 3]];
+	glm::vec3 maximum = minimum;
+	glm::vec3 normal_sum(0.0f);
+
+	for (size_t t = 0; t < triangles.size(); t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			const glm::vec3 &v = vertices[base_vertex + indices[triangles[t] * 3 + k]];
+			minimum = glm::min(minimum, v);
+			maximum = glm::max(maximum, v);
+		}
+		normal_sum += face_normals[triangles[t]];
+	}
+
+	glm::vec3 center = (minimum + maximum) * 0.5f;
+	float radius = 0.0f;
+	for (size_t t = 0; t < triangles.size(); t++)
+		for (int k = 0; k < 3; k++)
+			radius = std::max(radius, glm::length(vertices[base_vertex + indices[triangles[t] * 3 + k]] - center));
+
+	float normal_length = glm::length(normal_sum);
+	glm::vec3 axis = normal_length > 0.0f ? normal_sum / normal_length : glm::vec3(0.0f, 0.0f, 1.0f);
+	float min_dot = normal_length > 0.0f ? 1.0f : -1.0f;
+	for (size_t t = 0; t < triangles.size(); t++)
+		if (face_normals[triangles[t]] != glm::vec3(0.0f))
+			min_dot = std::min(min_dot, glm::dot(face_normals[triangles[t]], axis));
+
+	cluster->center[0] = center.x;
+	cluster->center[1] = center.y;
+	cluster->center[2] = center.z;
+	cluster->radius = radius;
+	cluster->cone_axis[0] = axis.x;
+	cluster->cone_axis[1] = axis.y;
+	cluster->cone_axis[2] = axis.z;
+	// A spread of 90 degrees or more contains opposite normals: never backfacing as a whole
+	cluster->cone_cutoff = min_dot <= 0.0f ? 2.0f : sqrtf(1.0f - min_dot * min_dot);
+}
+
+void build_meshlets(std::vector<GLuint> &indices, const std::vector<glm::vec3> &vertices, GLuint base_vertex,
+	GLuint first_index, int max_triangles, std::vector<meshlet> &meshlets)
+{
+	int triangle_count = (int) (indices.size() / 3);
+	if (triangle_count == 0)
+		return;
+
+	// Unit face normals; degenerate triangles get a zero normal and fit in any cone
+	std::vector<glm::vec3> face_normals(triangle_count);
+	GLuint vertex_count = 0;
+	for (int t = 0; t < triangle_count; t++)
+	{
+		const glm::vec3 &a = vertices[base_vertex + indices[t * 3]];
+		const glm::vec3 &b = vertices[base_vertex + indices[t * 3 + 1]];
+		const glm::vec3 &c = vertices[base_vertex + indices[t * 3 + 2]];
+		glm::vec3 n = glm::cross(b - a, c - a);
+		float length = glm::length(n);
+		face_normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+		for (int k = 0; k < 3; k++)
+			vertex_count = std::max(vertex_count, indices[t * 3 + k] + 1);
+	}
+
+	// Triangles around each vertex, as offsets into one array
+	std::vector<int> adjacency_offsets(vertex_count + 1, 0);
+	std::vector<int> adjacency(indices.size());
+	for (size_t i = 0; i < indices.size(); i++)
+		adjacency_offsets[indices[i] + 1]++;
+	for (GLuint v = 0; v < vertex_count; v++)
+		adjacency_offsets[v + 1] += adjacency_offsets[v];
+	std::vector<int> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+		adjacency[fill[indices[i]]++] = (int) (i / 3);
+
+	std::vector<char> assigned(triangle_count, 0);
+	std::vector<char> queued(triangle_count, 0);
+	std::vector<GLuint> reordered;
+	std::vector<int> cluster_triangles, frontier;
+	reordered.reserve(indices.size());
+	int seed = 0;
+
+	while (true)
+	{
+		while (seed < triangle_count && assigned[seed])
+			seed++;
+		if (seed == triangle_count)
+			break;
+
+		cluster_triangles.clear();
+		frontier.clear();
+		frontier.push_back(seed);
+		queued[seed] = 1;
+		glm::vec3 normal_sum(0.0f);
+
+		// Breadth first across shared vertices keeps the cluster compact
+		for (size_t f = 0; f < frontier.size() && (int) cluster_triangles.size() < max_triangles; f++)
+		{
+			int t = frontier[f];
+			glm::vec3 average = glm::length(normal_sum) > 0.0f ? glm::normalize(normal_sum) : face_normals[t];
+			if (!cluster_triangles.empty() && face_normals[t] != glm::vec3(0.0f) &&
+				glm::dot(face_normals[t], average) < MESHLET_CONE_LIMIT)
+				continue;
+
+			assigned[t] = 1;
+			cluster_triangles.push_back(t);
+			normal_sum += face_normals[t];
+
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint v = indices[t * 3 + k];
+				for (int a = adjacency_offsets[v]; a < adjacency_offsets[v + 1]; a++)
+				{
+					int neighbour = adjacency[a];
+					if (!assigned[neighbour] && !queued[neighbour])
+					{
+						queued[neighbour] = 1;
+						frontier.push_back(neighbour);
+					}
+				}
+			}
+		}
+		for (size_t f = 0; f < frontier.size(); f++)
+			queued[frontier[f]] = 0;
+
+		std::sort(cluster_triangles.begin(), cluster_triangles.end());
+
+		meshlet cluster;
+		compute_bounds(indices, cluster_triangles, vertices, face_normals, base_vertex, &cluster);
+		cluster.first_index = first_index + (GLuint) reordered.size();
+		cluster.index_count = (GLuint) cluster_triangles.size() * 3;
+		meshlets.push_back(cluster);
+
+		for (size_t t = 0; t < cluster_triangles.size(); t++)
+			for (int k = 0; k < 3; k++)
+				reordered.push_back(indices[cluster_triangles[t] * 3 + k]);
+	}
+
+	indices.swap(reordered);
+}
+
+static void normalize_plane(float plane[4])
+{
+	float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+	if (length > 0.0f)
+		for (int i = 0; i < 4; i++)
+			plane[i] /= length;
+}
+
+void meshlet_view_make(const float modelview[16], const float projection[16], meshlet_view *view)
+{
+	// Planes of the clip matrix, Gribb and Hartmann: row 3 plus or minus rows 0, 1, 2
+	float clip[16];
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 4; r++)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < 4; k++)
+				sum += projection[k * 4 + r] * modelview[c * 4 + k];
+			clip[c * 4 + r] = sum;
+		}
+
+	for (int p = 0; p < 6; p++)
+	{
+		int row = p / 2;
+		float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+		for (int c = 0; c < 4; c++)
+			view->planes[p][c] = clip[c * 4 + 3] + sign * clip[c * 4 + row];
+		normalize_plane(view->planes[p]);
+	}
+
+	// The camera is the origin of eye space brought back by the inverse modelview
+	glm::mat4 m(1.0f);
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 4; r++)
+			m[c][r] = modelview[c * 4 + r];
+	glm::vec4 eye = glm::inverse(m) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	view->eye[0] = eye.x / eye.w;
+	view->eye[1] = eye.y / eye.w;
+	view->eye[2] = eye.z / eye.w;
+}
+
+int meshlet_visible(const meshlet *cluster, const meshlet_view *view)
+{
+	const float *c = cluster->center;
+
+	for (int p = 0; p < 6; p++)
+	{
+		const float *plane = view->planes[p];
+		if (plane[0] * c[0] + plane[1] * c[1] + plane[2] * c[2] + plane[3] < -cluster->radius)
+			return 0;
+	}
+
+	// Every triangle faces away when the direction from the camera stays within
+	// 90 degrees minus the normals spread from the cone axis, for every point of the sphere
+	if (cluster->cone_cutoff <= 1.0f)
+	{
+		float d[3] = { c[0] - view->eye[0], c[1] - view->eye[1], c[2] - view->eye[2] };
+		float distance = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		float along = d[0] * cluster->cone_axis[0] + d[1] * cluster->cone_axis[1] + d[2] * cluster->cone_axis[2];
+		if (along >= cluster->cone_cutoff * distance + cluster->radius)
+			return 0;
+	}
+
+	return 1;
+}
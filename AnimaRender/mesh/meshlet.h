@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/*
+ * Meshlets: clusters of nearby triangles stored as consecutive ranges of the
+ * index buffer, each with a bounding sphere and a cone bounding its face
+ * normals. Every frame the clusters outside the view frustum or facing away
+ * from the camera are skipped and the surviving ranges of a part are drawn
+ * with a single glMultiDrawElements.
+ */
+
+// Meshes with fewer triangles than this many clusters are not clustered.
+#define MESHLET_MIN_CLUSTERS 8
+
+typedef struct
+{
+	float center[3];
+	float radius;
+	float cone_axis[3];
+	float cone_cutoff; // sine of the normals spread around cone_axis; above 1 the cluster is never backface culled
+	GLuint first_index;
+	GLuint index_count;
+} meshlet;
+
+// Frustum planes (pointing inside) and camera position in object space.
+typedef struct
+{
+	float planes[6][4];
+	float eye[3];
+} meshlet_view;
+
+// Whether clusters are culled at all; the scene can be rendered with the
+// plain per-part draws for comparison.
+void mesh_set_cluster_culling(int enabled);
+int mesh_cluster_culling_enabled();
+
+/*
+ * Reorders the triangles of indices into clusters of at most max_triangles,
+ * grown across shared vertices from the first unassigned triangle, and
+ * appends them to meshlets. Triangles keep their relative order inside a
+ * cluster so the vertex cache order survives. Indices address
+ * vertices[base_vertex + index]; first_index is the position of indices[0]
+ * in the whole index buffer.
+ */
+void build_meshlets(std::vector<GLuint> &indices, const std::vector<glm::vec3> &vertices, GLuint base_vertex,
+	GLuint first_index, int max_triangles, std::vector<meshlet> &meshlets);
+
+// Extracts the view from the column-major OpenGL modelview and projection matrices.
+void meshlet_view_make(const float modelview[16], const float projection[16], meshlet_view *view);
+
+int meshlet_visible(const meshlet *cluster, const meshlet_view *view);
@@ -0,0 +1,192 @@
+#include "normals.h"
+#include "../utils/parallel.h"
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define NORMALS_SSE2
+#include <emmintrin.h>
+#endif
+
+#define NORMALS_BLOCK_SIZE 4096
+
+// Unit face normal and the weight of each of its corners.
+static void face_weights(const float *p0, const float *p1, const float *p2, float cx, float cy, float cz,
+	glm::vec3 &face_normal, float *corner_weights)
+{
+	float length = sqrtf(cx * cx + cy * cy + cz * cz);
+	if (length == 0.0f)
+	{
+		face_normal = glm::vec3(0.0f);
+		corner_weights[0] = corner_weights[1] = corner_weights[2] = 0.0f;
+		return;
+	}
+	face_normal = glm::vec3(cx, cy, cz) / length;
+
+	const float *p[3] = { p0, p1, p2 };
+	for (int k = 0; k < 3; k++)
+	{
+		const float *a = p[k], *b = p[(k + 1) % 3], *c = p[(k + 2) % 3];
+		glm::vec3 e1(b[0] - a[0], b[1] - a[1], b[2] - a[2]);
+		glm::vec3 e2(c[0] - a[0], c[1] - a[1], c[2] - a[2]);
+		float l1 = glm::length(e1), l2 = glm::length(e2);
+		float cosine = (l1 > 0.0f && l2 > 0.0f) ? glm::dot(e1, e2) / (l1 * l2) : 1.0f;
+		cosine = cosine < -1.0f ? -1.0f : (cosine > 1.0f ? 1.0f : cosine);
+		//|cross| is twice the area; the constant factor does not matter
+		corner_weights[k] = length * acosf(cosine);
+	}
+}
+
+static void face_normals_block(const float *positions, const obj_index_triple *corners, int first, int last,
+	std::vector<glm::vec3> &face_normals, std::vector<float> &corner_weights)
+{
+	int t = first;
+
+#ifdef NORMALS_SSE2
+	//Four faces at a time: gather the edges in structure of arrays form and cross them together
+	for (; t + 4 <= last; t += 4)
+	{
+		float e1[3][4], e2[3][4];
+		for (int i = 0; i < 4; i++)
+		{
+			const float *p0 = &positions[3 * corners[3 * (t + i)].vertex_index];
+			const float *p1 = &positions[3 * corners[3 * (t + i) + 1].vertex_index];
+			const float *p2 = &positions[3 * corners[3 * (t + i) + 2].vertex_index];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				e1[axis][i] = p1[axis] - p0[axis];
+				e2[axis][i] = p2[axis] - p0[axis];
+			}
+		}
+
+		__m128 ax = _mm_loadu_ps(e1[0]), ay = _mm_loadu_ps(e1[1]), az = _mm_loadu_ps(e1[2]);
+		__m128 bx = _mm_loadu_ps(e2[0]), by = _mm_loadu_ps(e2[1]), bz = _mm_loadu_ps(e2[2]);
+		float cross[3][4];
+		_mm_storeu_ps(cross[0], _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by)));
+		_mm_storeu_ps(cross[1], _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz)));
+		_mm_storeu_ps(cross[2], _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx)));
+
+		for (int i = 0; i < 4; i++)
+		{
+			const obj_index_triple *triangle = &corners[3 * (t + i)];
+			face_weights(&positions[3 * triangle[0].vertex_index], &positions[3 * triangle[1].vertex_index], &positions[3 * triangle[2].vertex_index],
+				cross[0][i], cross[1][i], cross[2][i], face_normals[t + i], &corner_weights[3 * (t + i)]);
+		}
+	}
+#endif
+
+	for (; t < last; t++)
+	{
+		const obj_index_triple *triangle = &corners[3 * t];
+		const float *p0 = &positions[3 * triangle[0].vertex_index];
+		const float *p1 = &positions[3 * triangle[1].vertex_index];
+		const float *p2 = &positions[3 * triangle[2].vertex_index];
+		glm::vec3 n = glm::cross(glm::vec3(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]), glm::vec3(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]));
+		face_weights(p0, p1, p2, n.x, n.y, n.z, face_normals[t], &corner_weights[3 * t]);
+	}
+}
+
+void generate_normals(const float *positions, int position_count, obj_index_triple *corners, int corner_count,
+	float crease_angle, std::vector<glm::vec3> &normals)
+{
+	int triangle_count = corner_count / 3;
+	normals.clear();
+	if (position_count <= 0)
+		return;
+
+	//Corners pointing outside the positions collapse to the first one, as in mesh_stream
+	for (int c = 0; c < triangle_count * 3; c++)
+		if (corners[c].vertex_index < 0 || corners[c].vertex_index >= position_count)
+			corners[c].vertex_index = 0;
+
+	int blocks = (triangle_count + NORMALS_BLOCK_SIZE - 1) / NORMALS_BLOCK_SIZE;
+	std::vector<glm::vec3> face_normals(triangle_count);
+	std::vector<float> corner_weights(triangle_count * 3);
+
+	parallel_for(blocks, 0, [&](int b) {
+		int first = b * NORMALS_BLOCK_SIZE;
+		int last = first + NORMALS_BLOCK_SIZE < triangle_count ? first + NORMALS_BLOCK_SIZE : triangle_count;
+		face_normals_block(positions, corners, first, last, face_normals, corner_weights);
+	});
+
+	//Corners grouped by position
+	std::vector<int> offsets(position_count + 1, 0);
+	for (int c = 0; c < triangle_count * 3; c++)
+		offsets[corners[c].vertex_index + 1]++;
+	for (int p = 0; p < position_count; p++)
+		offsets[p + 1] += offsets[p];
+	std::vector<int> position_corners(triangle_count * 3);
+	std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+	for (int c = 0; c < triangle_count * 3; c++)
+		position_corners[fill[corners[c].vertex_index]++] = c;
+
+	//Each corner averages the faces around its position within the crease angle
+	bool smooth = crease_angle >= 180.0f;
+	float crease_cosine = cosf(crease_angle * 3.14159265f / 180.0f);
+	std::vector<glm::vec3> corner_normals(triangle_count * 3);
+	int position_blocks = (position_count + NORMALS_BLOCK_SIZE - 1) / NORMALS_BLOCK_SIZE;
+
+	parallel_for(position_blocks, 0, [&](int b) {
+		int last = (b + 1) * NORMALS_BLOCK_SIZE < position_count ? (b + 1) * NORMALS_BLOCK_SIZE : position_count;
+		for (int p = b * NORMALS_BLOCK_SIZE; p < last; p++)
+		{
+			//Without creases every corner of the position gets the same sum
+			if (smooth)
+			{
+				glm::vec3 sum(0.0f);
+				for (int j = offsets[p]; j < offsets[p + 1]; j++)
+					sum += face_normals[position_corners[j] / 3] * corner_weights[position_corners[j]];
+				float length = glm::length(sum);
+				for (int i = offsets[p]; i < offsets[p + 1]; i++)
+					corner_normals[position_corners[i]] = length > 0.0f ? sum / length : face_normals[position_corners[i] / 3];
+				continue;
+			}
+
+			for (int i = offsets[p]; i < offsets[p + 1]; i++)
+			{
+				const glm::vec3 &face = face_normals[position_corners[i] / 3];
+				glm::vec3 sum(0.0f);
+				for (int j = offsets[p]; j < offsets[p + 1]; j++)
+				{
+					int other = position_corners[j];
+					if (glm::dot(face, face_normals[other / 3]) >= crease_cosine)
+						sum += face_normals[other / 3] * corner_weights[other];
+				}
+				float length = glm::length(sum);
+				corner_normals[position_corners[i]] = length > 0.0f ? sum / length : face;
+			}
+		}
+	});
+
+	//Corners of a position that ended up with the same normal share it: sorting them by normal
+	//puts the equal ones next to each other, then the normals are added in order of first use
+	std::vector<int> order;
+	std::vector<std::pair<int, int> > firsts;
+	for (int p = 0; p < position_count; p++)
+	{
+		order.assign(position_corners.begin() + offsets[p], position_corners.begin() + offsets[p + 1]);
+		std::sort(order.begin(), order.end(), [&](int a, int b) {
+			const glm::vec3 &na = corner_normals[a], &nb = corner_normals[b];
+			if (na.x != nb.x) return na.x < nb.x;
+			if (na.y != nb.y) return na.y < nb.y;
+			if (na.z != nb.z) return na.z < nb.z;
+			return a < b;
+		});
+
+		//for every run of equal normals its first corner, and the position of the run in order
+		firsts.clear();
+		for (size_t i = 0; i < order.size(); i++)
+			if (i == 0 || corner_normals[order[i]] != corner_normals[order[i - 1]])
+				firsts.push_back(std::make_pair(order[i], (int) i));
+		std::sort(firsts.begin(), firsts.end());
+
+		for (size_t r = 0; r < firsts.size(); r++)
+		{
+			int n = (int) normals.size();
+			normals.push_back(corner_normals[firsts[r].first]);
+			for (size_t i = firsts[r].second; i < order.size() && corner_normals[order[i]] == normals[n]; i++)
+				corners[order[i]].normal_index = n;
+		}
+	}
+}
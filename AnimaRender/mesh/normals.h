@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "../objloader/obj_parser.h"
+
+/*
+ * Smooth normals for a triangle list that has none. Every face contributes
+ * to the normal of its corners with its area times the corner angle.
+ * Faces meeting at a position are only averaged when their normals are
+ * less than crease_angle degrees apart (180 averages everything), so hard
+ * edges stay sharp.
+ * normals receives the distinct normals and the normal_index of every
+ * corner is rewritten to point into it. Corners whose vertex_index is
+ * outside the positions are moved to the first position. Faces are processed in parallel
+ * and their cross products are computed four at a time with SSE2.
+ */
+void generate_normals(const float *positions, int position_count, obj_index_triple *corners, int corner_count,
+	float crease_angle, std::vector<glm::vec3> &normals);
@@ -0,0 +1,272 @@
+#include "simplify.h"
+
+#include <math.h>
+#include <algorithm>
+
+// Symmetric 4x4 matrix of the area weighted sum of squared distances from a
+// set of planes; w is the total weight, so error / w is a mean squared distance.
+typedef struct
+{
+	double a2, ab, ac, ad;
+	double b2, bc, bd;
+	double c2, cd;
+	double d2;
+	double w;
+} simplify_quadric;
+
+typedef struct
+{
+	double cost;
+	GLuint from;
+	GLuint to;
+} simplify_collapse;
+
+static bool simplify_collapse_less(const simplify_collapse &a, const simplify_collapse &b)
+{
+	return a.cost < b.cost;
+}
+
+static void quadric_add_plane(simplify_quadric &q, double a, double b, double c, double d, double w)
+{
+	q.a2 += w * a * a; q.ab += w * a * b; q.ac += w * a * c; q.ad += w * a * d;
+	q.b2 += w * b * b; q.bc += w * b * c; q.bd += w * b * d;
+	q.c2 += w * c * c; q.cd += w * c * d;
+	q.d2 += w * d * d;
+	q.w += w;
+}
+
+static void quadric_add(simplify_quadric &q, const simplify_quadric &o)
+{
+	q.a2 += o.a2; q.ab += o.ab; q.ac += o.ac; q.ad += o.ad;
+	q.b2 += o.b2; q.bc += o.bc; q.bd += o.bd;
+	q.c2 += o.c2; q.cd += o.cd;
+	q.d2 += o.d2;
+	q.w += o.w;
+}
+
+static double quadric_error(const simplify_quadric &q, const glm::vec3 &p)
+{
+	double x = p.x, y = p.y, z = p.z;
+	double error = q.a2 * x * x + 2 * q.ab * x * y + 2 * q.ac * x * z + 2 * q.ad * x
+		+ q.b2 * y * y + 2 * q.bc * y * z + 2 * q.bd * y
+		+ q.c2 * z * z + 2 * q.cd * z
+		+ q.d2;
+	return error > 0.0 && q.w > 0.0 ? error / q.w : 0.0;
+}
+
+static bool position_less(const glm::vec3 &a, const glm::vec3 &b)
+{
+	if (a.x != b.x) return a.x < b.x;
+	if (a.y != b.y) return a.y < b.y;
+	return a.z < b.z;
+}
+
+typedef struct
+{
+	const std::vector<glm::vec3> *vertices;
+	bool operator()(GLuint a, GLuint b) const
+	{
+		return position_less((*vertices)[a], (*vertices)[b]);
+	}
+} simplify_vertex_order;
+
+// Marks the vertices that share their position with another one (seams)
+// and the ones on edges used by a single triangle (borders).
+static void simplify_find_locked(const std::vector<GLuint> &elements, const std::vector<glm::vec3> &vertices, std::vector<bool> &locked)
+{
+	size_t vertex_count = vertices.size();
+	std::vector<GLuint> position_id(vertex_count);
+	std::vector<GLuint> order(vertex_count);
+	for (size_t v = 0; v < vertex_count; v++)
+		order[v] = (GLuint) v;
+
+	simplify_vertex_order compare = { &vertices };
+	std::sort(order.begin(), order.end(), compare);
+
+	locked.assign(vertex_count, false);
+	for (size_t i = 0; i < vertex_count; )
+	{
+		size_t j = i + 1;
+		while (j < vertex_count && vertices[order[j]] == vertices[order[i]])
+			j++;
+		for (size_t k = i; k < j; k++)
+		{
+			position_id[order[k]] = order[i];
+			if (j - i > 1)
+				locked[order[k]] = true;
+		}
+		i = j;
+	}
+
+	//Undirected edges between positions, sorted so that equal edges are adjacent
+	std::vector<unsigned long long> edges;
+	edges.reserve(elements.size());
+	for (size_t t = 0; t + 2 < elements.size(); t += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned long long a = position_id[elements[t + k]];
+			unsigned long long b = position_id[elements[t + (k + 1) % 3]];
+			edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	for (size_t i = 0; i < edges.size(); )
+	{
+		size_t j = i + 1;
+		while (j < edges.size() && edges[j] == edges[i])
+			j++;
+		if (j - i == 1)
+		{
+			//Seam vertices are locked already, so locking the position ids is enough
+			locked[(GLuint) (edges[i] >> 32)] = true;
+			locked[(GLuint) (edges[i] & 0xffffffffu)] = true;
+		}
+		i = j;
+	}
+}
+
+// Whether moving vertex from onto to would flip one of the triangles around from.
+static bool simplify_flips(const std::vector<GLuint> &indices, const std::vector<glm::vec3> &vertices,
+	const std::vector<size_t> &offsets, const std::vector<size_t> &adjacency, GLuint from, GLuint to)
+{
+	for (size_t a = offsets[from]; a < offsets[from + 1]; a++)
+	{
+		const GLuint *triangle = &indices[3 * adjacency[a]];
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+			continue; //this one collapses
+
+		glm::vec3 p[3], q[3];
+		for (int k = 0; k < 3; k++)
+		{
+			p[k] = vertices[triangle[k]];
+			q[k] = triangle[k] == from ? vertices[to] : p[k];
+		}
+		glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+		glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+		if (glm::dot(before, after) <= 0.0f)
+			return true;
+	}
+	return false;
+}
+
+float simplify_mesh(const std::vector<GLuint> &elements, const std::vector<glm::vec3> &vertices,
+	size_t target_index_count, std::vector<GLuint> &destination)
+{
+	size_t vertex_count = vertices.size();
+	double max_cost = 0.0;
+
+	destination = elements;
+	if (destination.size() <= target_index_count)
+		return 0.0f;
+
+	std::vector<bool> locked;
+	simplify_find_locked(destination, vertices, locked);
+
+	simplify_quadric zero = simplify_quadric();
+	std::vector<simplify_quadric> quadrics(vertex_count, zero);
+	for (size_t t = 0; t + 2 < destination.size(); t += 3)
+	{
+		const glm::vec3 &p0 = vertices[destination[t]];
+		glm::vec3 normal = glm::cross(vertices[destination[t + 1]] - p0, vertices[destination[t + 2]] - p0);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;
+		normal /= length;
+		double d = -glm::dot(normal, p0);
+		for (int k = 0; k < 3; k++)
+			quadric_add_plane(quadrics[destination[t + k]], normal.x, normal.y, normal.z, d, length * 0.5);
+	}
+
+	std::vector<GLuint> remap(vertex_count);
+	std::vector<bool> touched(vertex_count);
+	std::vector<size_t> offsets(vertex_count + 1);
+	std::vector<size_t> adjacency;
+	std::vector<simplify_collapse> candidates;
+
+	//Each pass collapses a set of independent edges, cheapest first
+	while (destination.size() > target_index_count)
+	{
+		size_t triangle_count = destination.size() / 3;
+
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (size_t i = 0; i < destination.size(); i++)
+			offsets[destination[i] + 1]++;
+		for (size_t v = 0; v < vertex_count; v++)
+			offsets[v + 1] += offsets[v];
+		adjacency.resize(destination.size());
+		std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < destination.size(); i++)
+			adjacency[fill[destination[i]]++] = i / 3;
+
+		candidates.clear();
+		for (size_t t = 0; t < triangle_count; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint from = destination[3 * t + k];
+				GLuint to = destination[3 * t + (k + 1) % 3];
+				for (int direction = 0; direction < 2; direction++)
+				{
+					if (!locked[from])
+					{
+						simplify_quadric q = quadrics[from];
+						quadric_add(q, quadrics[to]);
+						simplify_collapse collapse = { quadric_error(q, vertices[to]), from, to };
+						candidates.push_back(collapse);
+					}
+					std::swap(from, to);
+				}
+			}
+		}
+		std::sort(candidates.begin(), candidates.end(), simplify_collapse_less);
+
+		//A collapse removes two triangles on a closed surface
+		size_t budget = (triangle_count - target_index_count / 3) / 2 + 1;
+		size_t collapses = 0;
+		for (size_t v = 0; v < vertex_count; v++)
+		{
+			remap[v] = (GLuint) v;
+			touched[v] = false;
+		}
+
+		for (size_t c = 0; c < candidates.size() && collapses < budget; c++)
+		{
+			const simplify_collapse &collapse = candidates[c];
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+			if (simplify_flips(destination, vertices, offsets, adjacency, collapse.from, collapse.to))
+				continue;
+
+			remap[collapse.from] = collapse.to;
+			quadric_add(quadrics[collapse.to], quadrics[collapse.from]);
+			max_cost = std::max(max_cost, collapse.cost);
+			collapses++;
+
+			//Freeze the whole one-ring so that the flip test stays valid for this pass
+			for (size_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++)
+				for (int k = 0; k < 3; k++)
+					touched[destination[3 * adjacency[a] + k]] = true;
+		}
+
+		if (collapses == 0)
+			break;
+
+		size_t write = 0;
+		for (size_t t = 0; t < triangle_count; t++)
+		{
+			GLuint a = remap[destination[3 * t]];
+			GLuint b = remap[destination[3 * t + 1]];
+			GLuint c = remap[destination[3 * t + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			destination[write++] = a;
+			destination[write++] = b;
+			destination[write++] = c;
+		}
+		destination.resize(write);
+	}
+
+	return (float) sqrt(max_cost);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/*
+ * Quadric error edge collapse simplifier (Garland & Heckbert).
+ * Vertices are only ever collapsed onto other existing vertices, so the
+ * result indexes the same vertex array as the input and every level of
+ * detail can share one vertex buffer.
+ * Vertices on open borders and on attribute seams (same position, different
+ * normal or texcoord) are never moved, which keeps the mesh watertight and
+ * its texture mapping intact.
+ * Returns the geometric error of the result: the largest RMS distance of a
+ * collapsed vertex from its original planes, in object space.
+ */
+float simplify_mesh(const std::vector<GLuint> &elements, const std::vector<glm::vec3> &vertices,
+	size_t target_index_count, std::vector<GLuint> &destination);
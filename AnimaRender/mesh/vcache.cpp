@@ -0,0 +1,311 @@
+#include "vcache.h"
+
+#include <math.h>
+#include <algorithm>
+
+static bool optimization_enabled = false;
+
+void mesh_set_optimization(bool enabled)
+{
+	optimization_enabled = enabled;
+}
+
+bool mesh_optimization_enabled()
+{
+	return optimization_enabled;
+}
+
+// Simulates the FIFO cache and returns the number of transformed vertices.
+// If restarts is not NULL it receives the triangles whose three vertices all missed.
+static size_t simulate_fifo(const std::vector<GLuint> &elements, size_t vertex_count, std::vector<size_t> *restarts)
+{
+	//A vertex is in the cache while its insertion stamp is within the last MESH_STATS_CACHE_SIZE insertions
+	std::vector<size_t> stamp(vertex_count, 0);
+	size_t time = MESH_STATS_CACHE_SIZE + 1;
+	size_t misses = 0;
+
+	for (size_t t = 0; t + 2 < elements.size(); t += 3)
+	{
+		int triangle_misses = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint vertex = elements[t + k];
+			if (time - stamp[vertex] > MESH_STATS_CACHE_SIZE)
+			{
+				stamp[vertex] = time++;
+				triangle_misses++;
+			}
+		}
+		misses += triangle_misses;
+		if (restarts != NULL && triangle_misses == 3)
+			restarts->push_back(t / 3);
+	}
+	return misses;
+}
+
+float mesh_acmr(const std::vector<GLuint> &elements, size_t vertex_count)
+{
+	size_t triangles = elements.size() / 3;
+	return triangles == 0 ? 0.0f : (float) simulate_fifo(elements, vertex_count, NULL) / triangles;
+}
+
+float mesh_atvr(const std::vector<GLuint> &elements, size_t vertex_count)
+{
+	std::vector<bool> used(vertex_count, false);
+	size_t used_count = 0;
+	for (size_t i = 0; i < elements.size(); i++)
+	{
+		if (!used[elements[i]])
+		{
+			used[elements[i]] = true;
+			used_count++;
+		}
+	}
+	return used_count == 0 ? 0.0f : (float) simulate_fifo(elements, vertex_count, NULL) / used_count;
+}
+
+// Forsyth's scoring: LRU cache of FORSYTH_CACHE_SIZE entries.
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_MAX_VALENCE 32
+static const float forsyth_cache_decay_power = 1.5f;
+static const float forsyth_last_triangle_score = 0.75f;
+static const float forsyth_valence_boost_scale = 2.0f;
+static const float forsyth_valence_boost_power = 0.5f;
+
+static float forsyth_cache_scores[FORSYTH_CACHE_SIZE];
+static float forsyth_valence_scores[FORSYTH_MAX_VALENCE + 1];
+static bool forsyth_tables_ready = false;
+
+static void forsyth_init_tables()
+{
+	if (forsyth_tables_ready)
+		return;
+
+	for (int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+	{
+		//The three vertices of the last triangle get a fixed score so that strips are not favoured
+		if (i < 3)
+			forsyth_cache_scores[i] = forsyth_last_triangle_score;
+		else
+			forsyth_cache_scores[i] = powf(1.0f - (float) (i - 3) / (FORSYTH_CACHE_SIZE - 3), forsyth_cache_decay_power);
+	}
+	forsyth_valence_scores[0] = 0.0f;
+	for (int i = 1; i <= FORSYTH_MAX_VALENCE; i++)
+		forsyth_valence_scores[i] = forsyth_valence_boost_scale * powf((float) i, -forsyth_valence_boost_power);
+
+	forsyth_tables_ready = true;
+}
+
+static float forsyth_vertex_score(int cache_position, unsigned int remaining)
+{
+	//A vertex with no triangles left is useless in the cache
+	if (remaining == 0)
+		return -1.0f;
+
+	float score = cache_position < 0 ? 0.0f : forsyth_cache_scores[cache_position];
+	return score + forsyth_valence_scores[std::min(remaining, (unsigned int) FORSYTH_MAX_VALENCE)];
+}
+
+void optimize_vertex_cache(std::vector<GLuint> &elements, size_t vertex_count)
+{
+	size_t triangle_count = elements.size() / 3;
+	if (triangle_count == 0)
+		return;
+
+	forsyth_init_tables();
+
+	//Vertex -> triangle adjacency in compressed rows
+	std::vector<unsigned int> remaining(vertex_count, 0);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+		remaining[elements[i]]++;
+
+	std::vector<size_t> offsets(vertex_count + 1, 0);
+	for (size_t v = 0; v < vertex_count; v++)
+		offsets[v + 1] = offsets[v] + remaining[v];
+
+	std::vector<size_t> adjacency(triangle_count * 3);
+	std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+		adjacency[fill[elements[i]]++] = i / 3;
+
+	std::vector<int> cache_position(vertex_count, -1);
+	std::vector<float> vertex_scores(vertex_count);
+	for (size_t v = 0; v < vertex_count; v++)
+		vertex_scores[v] = forsyth_vertex_score(-1, remaining[v]);
+
+	std::vector<float> triangle_scores(triangle_count);
+	std::vector<bool> emitted(triangle_count, false);
+	for (size_t t = 0; t < triangle_count; t++)
+		triangle_scores[t] = vertex_scores[elements[3 * t]] + vertex_scores[elements[3 * t + 1]] + vertex_scores[elements[3 * t + 2]];
+
+	std::vector<GLuint> output;
+	output.reserve(triangle_count * 3);
+
+	//The LRU cache, with room for the three vertices pushed by a new triangle
+	GLuint cache[FORSYTH_CACHE_SIZE + 3];
+	GLuint next_cache[FORSYTH_CACHE_SIZE + 3];
+	int cache_count = 0;
+
+	size_t best = 0;
+	size_t scan_cursor = 0;
+
+	for (size_t emitted_count = 0; emitted_count < triangle_count; emitted_count++)
+	{
+		const GLuint *triangle = &elements[3 * best];
+		output.push_back(triangle[0]);
+		output.push_back(triangle[1]);
+		output.push_back(triangle[2]);
+		emitted[best] = true;
+
+		//Remove the triangle from the adjacency of its vertices
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint vertex = triangle[k];
+			size_t *begin = &adjacency[offsets[vertex]];
+			size_t *end = begin + remaining[vertex];
+			*std::find(begin, end, best) = *(end - 1);
+			remaining[vertex]--;
+		}
+
+		//New cache: the triangle's vertices first, then the old contents without duplicates
+		int next_count = 0;
+		for (int k = 0; k < 3; k++)
+			next_cache[next_count++] = triangle[k];
+		for (int i = 0; i < cache_count; i++)
+		{
+			GLuint vertex = cache[i];
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+				next_cache[next_count++] = vertex;
+		}
+
+		//Rescore the vertices that moved or fell out of the cache, and their triangles
+		float best_score = -1e30f;
+		bool found = false;
+		for (int i = 0; i < next_count; i++)
+		{
+			GLuint vertex = next_cache[i];
+			int position = i < FORSYTH_CACHE_SIZE ? i : -1;
+			cache_position[vertex] = position;
+
+			float score = forsyth_vertex_score(position, remaining[vertex]);
+			float delta = score - vertex_scores[vertex];
+			vertex_scores[vertex] = score;
+
+			for (unsigned int a = 0; a < remaining[vertex]; a++)
+			{
+				size_t t = adjacency[offsets[vertex] + a];
+				triangle_scores[t] += delta;
+				if (triangle_scores[t] > best_score)
+				{
+					best_score = triangle_scores[t];
+					best = t;
+					found = true;
+				}
+			}
+		}
+
+		cache_count = std::min(next_count, FORSYTH_CACHE_SIZE);
+		std::copy(next_cache, next_cache + cache_count, cache);
+
+		//Nothing left around the cache: continue with the first triangle not yet emitted
+		if (!found)
+		{
+			while (scan_cursor < triangle_count && emitted[scan_cursor])
+				scan_cursor++;
+			best = scan_cursor;
+		}
+	}
+
+	elements.swap(output);
+}
+
+typedef struct
+{
+	size_t first_triangle;
+	size_t triangle_count;
+	float sort_key;
+} overdraw_cluster;
+
+static bool overdraw_cluster_less(const overdraw_cluster &a, const overdraw_cluster &b)
+{
+	return a.sort_key > b.sort_key;
+}
+
+void optimize_overdraw(std::vector<GLuint> &elements, const std::vector<glm::vec3> &vertices)
+{
+	size_t triangle_count = elements.size() / 3;
+	if (triangle_count == 0)
+		return;
+
+	glm::vec3 mesh_centroid(0.0f);
+	for (size_t i = 0; i < elements.size(); i++)
+		mesh_centroid += vertices[elements[i]];
+	mesh_centroid /= (float) elements.size();
+
+	std::vector<size_t> restarts;
+	simulate_fifo(elements, vertices.size(), &restarts);
+	restarts.push_back(triangle_count);
+
+	//Each cluster gets the area weighted centroid and normal of its triangles;
+	//clusters whose normal points away from the mesh center come first
+	std::vector<overdraw_cluster> clusters;
+	size_t first = 0;
+	for (size_t r = 0; r < restarts.size(); r++)
+	{
+		if (restarts[r] <= first)
+			continue;
+
+		overdraw_cluster cluster = { first, restarts[r] - first, 0.0f };
+		glm::vec3 centroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t t = first; t < restarts[r]; t++)
+		{
+			const glm::vec3 &a = vertices[elements[3 * t]];
+			const glm::vec3 &b = vertices[elements[3 * t + 1]];
+			const glm::vec3 &c = vertices[elements[3 * t + 2]];
+			glm::vec3 n = glm::cross(b - a, c - a);
+			float triangle_area = glm::length(n);
+			centroid += (a + b + c) * (triangle_area / 3.0f);
+			normal += n;
+			area += triangle_area;
+		}
+		if (area > 0.0f)
+		{
+			centroid /= area;
+			float normal_length = glm::length(normal);
+			if (normal_length > 0.0f)
+				cluster.sort_key = glm::dot(centroid - mesh_centroid, normal / normal_length);
+		}
+		clusters.push_back(cluster);
+		first = restarts[r];
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), overdraw_cluster_less);
+
+	std::vector<GLuint> output;
+	output.reserve(elements.size());
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		std::vector<GLuint>::const_iterator begin = elements.begin() + 3 * clusters[c].first_triangle;
+		output.insert(output.end(), begin, begin + 3 * clusters[c].triangle_count);
+	}
+	elements.swap(output);
+}
+
+void optimize_vertex_fetch(std::vector<GLuint> &elements, size_t vertex_count, std::vector<GLuint> &vertex_remap)
+{
+	const GLuint unused = ~0u;
+	std::vector<GLuint> new_index(vertex_count, unused);
+
+	vertex_remap.clear();
+	for (size_t i = 0; i < elements.size(); i++)
+	{
+		GLuint vertex = elements[i];
+		if (new_index[vertex] == unused)
+		{
+			new_index[vertex] = (GLuint) vertex_remap.size();
+			vertex_remap.push_back(vertex);
+		}
+		elements[i] = new_index[vertex];
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/*
+ * Triangle and vertex reordering for indexed triangle lists.
+ * The usual pipeline is optimize_vertex_cache, optimize_overdraw and then
+ * optimize_vertex_fetch, whose remap is applied to every vertex attribute
+ * with remap_vertices (index_buffer.h).
+ */
+
+// Post-transform cache simulated by the statistics: a 16 entry FIFO.
+#define MESH_STATS_CACHE_SIZE 16
+
+// Whether Object runs the optimization stage on the geometry it builds.
+void mesh_set_optimization(bool enabled);
+bool mesh_optimization_enabled();
+
+// Average cache miss ratio: transformed vertices per triangle (0.5 - 3).
+float mesh_acmr(const std::vector<GLuint> &elements, size_t vertex_count);
+// Average transform to vertex ratio: transformed vertices per vertex (>= 1).
+float mesh_atvr(const std::vector<GLuint> &elements, size_t vertex_count);
+
+// Reorders the triangles for the post-transform cache (Forsyth's linear-speed algorithm).
+void optimize_vertex_cache(std::vector<GLuint> &elements, size_t vertex_count);
+
+/*
+ * Splits an already cache-optimized list into clusters at the points where
+ * the cache restarts, then sorts the clusters so that the ones facing out
+ * of the mesh are drawn first and occlude the rest.
+ */
+void optimize_overdraw(std::vector<GLuint> &elements, const std::vector<glm::vec3> &vertices);
+
+// Renumbers the vertices in order of first use. vertex_remap receives, for every new vertex, the old one it copies.
+void optimize_vertex_fetch(std::vector<GLuint> &elements, size_t vertex_count, std::vector<GLuint> &vertex_remap);
@@ -0,0 +1,370 @@
+#include "vertex_format.h"
+#include "../glfuncs.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *vertex_decode_compact_source =
+	"uniform vec3 animaPositionOffset;\n"
+	"uniform vec3 animaPositionScale;\n"
+	"uniform vec2 animaTexcoordOffset;\n"
+	"uniform vec2 animaTexcoordScale;\n"
+	"uniform float animaNormalScale;\n"
+	"attribute vec4 animaPackedPosition;\n"
+	"attribute vec2 animaPackedNormal;\n"
+	"attribute vec2 animaPackedTexcoord;\n"
+	"vec4 animaVertex()\n"
+	"{\n"
+	"	return vec4(animaPositionOffset + animaPackedPosition.xyz * animaPositionScale, 1.0);\n"
+	"}\n"
+	"vec3 animaNormal()\n"
+	"{\n"
+	"	vec2 e = clamp(animaPackedNormal * animaNormalScale, -1.0, 1.0);\n"
+	"	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+	"	if (n.z < 0.0)\n"
+	"		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+	"	return normalize(n);\n"
+	"}\n"
+	"vec4 animaMultiTexCoord0()\n"
+	"{\n"
+	"	return vec4(animaTexcoordOffset + animaPackedTexcoord * animaTexcoordScale, 0.0, 1.0);\n"
+	"}\n";
+
+static const char *vertex_decode_float_source =
+	"uniform vec2 animaTexcoordOffset;\n"
+	"uniform vec2 animaTexcoordScale;\n"
+	"vec4 animaVertex()\n"
+	"{\n"
+	"	return gl_Vertex;\n"
+	"}\n"
+	"vec3 animaNormal()\n"
+	"{\n"
+	"	return gl_Normal;\n"
+	"}\n"
+	"vec4 animaMultiTexCoord0()\n"
+	"{\n"
+	"	return vec4(animaTexcoordOffset + gl_MultiTexCoord0.xy * animaTexcoordScale, gl_MultiTexCoord0.zw);\n"
+	"}\n";
+
+static int vertex_arrays = 0;
+
+void mesh_set_vertex_arrays(int enabled)
+{
+	vertex_arrays = enabled;
+}
+
+int mesh_vertex_arrays_enabled()
+{
+	return vertex_arrays;
+}
+
+void vertex_format_default(vertex_format *format)
+{
+	format->compact = 0;
+	format->position_bits = 16;
+	format->normal_bits = 8;
+	format->texcoord_bits = 16;
+}
+
+int vertex_format_normal_size(const vertex_format *format)
+{
+	return format->normal_bits > 8 ? 2 * sizeof(GLshort) : 2 * sizeof(GLbyte);
+}
+
+void vertex_layout_make(const vertex_format *format, int has_normals, int has_texcoords, vertex_layout *layout)
+{
+	int offset = 0;
+
+	layout->position_offset = offset;
+	offset += format->compact ? 4 * sizeof(GLushort) : 3 * sizeof(float);
+
+	// The compact texcoords go before the normals so that 4-byte values stay aligned
+	if (format->compact)
+	{
+		layout->texcoord_offset = has_texcoords ? offset : -1;
+		offset += has_texcoords ? 2 * sizeof(GLushort) : 0;
+		layout->normal_offset = has_normals ? offset : -1;
+		offset += has_normals ? vertex_format_normal_size(format) : 0;
+	}
+	else
+	{
+		layout->normal_offset = has_normals ? offset : -1;
+		offset += has_normals ? 3 * sizeof(float) : 0;
+		layout->texcoord_offset = has_texcoords ? offset : -1;
+		offset += has_texcoords ? 2 * sizeof(float) : 0;
+	}
+
+	layout->stride = (offset + 3) & ~3;
+}
+
+int vertex_format_size(const vertex_format *format, int has_normals, int has_texcoords)
+{
+	vertex_layout layout;
+	vertex_layout_make(format, has_normals, has_texcoords, &layout);
+	return layout.stride;
+}
+
+void interleave_vertices(const vertex_layout *layout, const float *positions, const float *normals,
+	const float *texcoords, const compact_vertices *compact, int vertex_count, std::vector<unsigned char> &out)
+{
+	out.assign((size_t) vertex_count * layout->stride, 0);
+
+	for (int i = 0; i < vertex_count; i++)
+	{
+		unsigned char *vertex = &out[(size_t) i * layout->stride];
+
+		if (compact != NULL)
+		{
+			int normal_size = compact->normal_type == GL_SHORT ? 2 * sizeof(GLshort) : 2 * sizeof(GLbyte);
+			memcpy(vertex + layout->position_offset, &compact->positions[i * 4], 4 * sizeof(GLushort));
+			if (layout->texcoord_offset >= 0)
+				memcpy(vertex + layout->texcoord_offset, &compact->texcoords[i * 2], 2 * sizeof(GLushort));
+			if (layout->normal_offset >= 0)
+				memcpy(vertex + layout->normal_offset, &compact->normals[i * normal_size], normal_size);
+		}
+		else
+		{
+			memcpy(vertex + layout->position_offset, positions + i * 3, 3 * sizeof(float));
+			if (layout->normal_offset >= 0)
+				memcpy(vertex + layout->normal_offset, normals + i * 3, 3 * sizeof(float));
+			if (layout->texcoord_offset >= 0)
+				memcpy(vertex + layout->texcoord_offset, texcoords + i * 2, 2 * sizeof(float));
+		}
+	}
+}
+
+static float sign_not_zero(float value)
+{
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+void oct_encode(const float normal[3], float encoded[2])
+{
+	float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+	if (length == 0.0f)
+	{
+		encoded[0] = encoded[1] = 0.0f;
+		return;
+	}
+
+	float x = normal[0] / length;
+	float y = normal[1] / length;
+	if (normal[2] < 0.0f)
+	{
+		float folded_x = (1.0f - fabsf(y)) * sign_not_zero(x);
+		float folded_y = (1.0f - fabsf(x)) * sign_not_zero(y);
+		x = folded_x;
+		y = folded_y;
+	}
+	encoded[0] = x;
+	encoded[1] = y;
+}
+
+void oct_decode(const float encoded[2], float normal[3])
+{
+	float x = encoded[0], y = encoded[1];
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	if (z < 0.0f)
+	{
+		float unfolded_x = (1.0f - fabsf(y)) * sign_not_zero(x);
+		float unfolded_y = (1.0f - fabsf(x)) * sign_not_zero(y);
+		x = unfolded_x;
+		y = unfolded_y;
+	}
+
+	float length = sqrtf(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
+
+static int quantize(float value, float offset, float inverse_scale, int max_value)
+{
+	int q = (int) floorf((value - offset) * inverse_scale + 0.5f);
+	return q < 0 ? 0 : (q > max_value ? max_value : q);
+}
+
+// Bounding box of count vectors of the given size; scale maps [0, max_value] onto it.
+static void quantization_range(const float *values, int count, int size, int bits, float *offset, float *scale)
+{
+	int max_value = (1 << bits) - 1;
+
+	for (int c = 0; c < size; c++)
+	{
+		float minimum = count > 0 ? values[c] : 0.0f;
+		float maximum = minimum;
+		for (int i = 1; i < count; i++)
+		{
+			float v = values[i * size + c];
+			minimum = v < minimum ? v : minimum;
+			maximum = v > maximum ? v : maximum;
+		}
+		offset[c] = minimum;
+		scale[c] = (maximum - minimum) / max_value;
+	}
+}
+
+// The error is measured on the decoded value, exactly as the shader computes it.
+static float quantize_attribute(const float *values, int count, int size, int bits, const float *offset,
+	const float *scale, GLushort *out, int out_stride)
+{
+	int max_value = (1 << bits) - 1;
+	float error = 0.0f;
+
+	for (int i = 0; i < count; i++)
+	{
+		float distance = 0.0f;
+		for (int c = 0; c < size; c++)
+		{
+			float inverse_scale = scale[c] > 0.0f ? 1.0f / scale[c] : 0.0f;
+			int q = quantize(values[i * size + c], offset[c], inverse_scale, max_value);
+			float d = offset[c] + q * scale[c] - values[i * size + c];
+			out[i * out_stride + c] = (GLushort) q;
+			distance += d * d;
+		}
+		distance = sqrtf(distance);
+		error = distance > error ? distance : error;
+	}
+	return error;
+}
+
+void quantize_vertices(const vertex_format *format, const float *positions, const float *normals,
+	const float *texcoords, int vertex_count, compact_vertices *out)
+{
+	memset(&out->decode, 0, sizeof(out->decode));
+	memset(&out->error, 0, sizeof(out->error));
+
+	out->positions.assign(vertex_count * 4, 0);
+	quantization_range(positions, vertex_count, 3, format->position_bits,
+		out->decode.position_offset, out->decode.position_scale);
+	out->error.position = quantize_attribute(positions, vertex_count, 3, format->position_bits,
+		out->decode.position_offset, out->decode.position_scale, &out->positions[0], 4);
+
+	out->texcoords.clear();
+	if (texcoords != NULL)
+	{
+		out->texcoords.resize(vertex_count * 2);
+		quantization_range(texcoords, vertex_count, 2, format->texcoord_bits,
+			out->decode.texcoord_offset, out->decode.texcoord_scale);
+		out->error.texcoord = quantize_attribute(texcoords, vertex_count, 2, format->texcoord_bits,
+			out->decode.texcoord_offset, out->decode.texcoord_scale, &out->texcoords[0], 2);
+	}
+
+	// 127 and 32767 keep the encoding symmetric around zero
+	int normal_max = format->normal_bits > 8 ? 32767 : 127;
+	out->normal_type = format->normal_bits > 8 ? GL_SHORT : GL_BYTE;
+	out->decode.normal_scale = 1.0f / normal_max;
+	out->normals.clear();
+	if (normals != NULL)
+	{
+		out->normals.resize(vertex_count * vertex_format_normal_size(format));
+		GLbyte *bytes = (GLbyte *) &out->normals[0];
+		GLshort *shorts = (GLshort *) &out->normals[0];
+		float max_angle = 0.0f;
+
+		for (int i = 0; i < vertex_count; i++)
+		{
+			const float *n = &normals[i * 3];
+			float encoded[2], decoded[3];
+			int q[2];
+
+			oct_encode(n, encoded);
+			for (int c = 0; c < 2; c++)
+			{
+				q[c] = (int) floorf(encoded[c] * normal_max + 0.5f);
+				encoded[c] = q[c] * out->decode.normal_scale;
+				if (out->normal_type == GL_SHORT)
+					shorts[i * 2 + c] = (GLshort) q[c];
+				else
+					bytes[i * 2 + c] = (GLbyte) q[c];
+			}
+
+			float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (length == 0.0f)
+				continue;
+			oct_decode(encoded, decoded);
+			float cosine = (n[0] * decoded[0] + n[1] * decoded[1] + n[2] * decoded[2]) / length;
+			cosine = cosine > 1.0f ? 1.0f : (cosine < -1.0f ? -1.0f : cosine);
+			float angle = acosf(cosine);
+			max_angle = angle > max_angle ? angle : max_angle;
+		}
+		out->error.normal = max_angle * 180.0f / 3.14159265f;
+	}
+}
+
+GLuint vertex_decode_make_program(GLuint vertex_shader, GLuint fragment_shader, int compact)
+{
+	const GLchar *source = compact ? vertex_decode_compact_source : vertex_decode_float_source;
+	GLint shader_ok, program_ok;
+
+	GLuint library = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(library, 1, &source, NULL);
+	glCompileShader(library);
+	glGetShaderiv(library, GL_COMPILE_STATUS, &shader_ok);
+	if (!shader_ok)
+	{
+		fprintf(stderr, "Failed to compile the vertex decode library:\n");
+		show_info_log(library, glGetShaderiv, glGetShaderInfoLog);
+		glDeleteShader(library);
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertex_shader);
+	glAttachShader(program, library);
+	glAttachShader(program, fragment_shader);
+	if (compact)
+	{
+		glBindAttribLocation(program, VERTEX_POSITION_ATTRIBUTE, "animaPackedPosition");
+		glBindAttribLocation(program, VERTEX_NORMAL_ATTRIBUTE, "animaPackedNormal");
+		glBindAttribLocation(program, VERTEX_TEXCOORD_ATTRIBUTE, "animaPackedTexcoord");
+	}
+	glLinkProgram(program);
+	// The program keeps the library alive until it is deleted
+	glDeleteShader(library);
+
+	glGetProgramiv(program, GL_LINK_STATUS, &program_ok);
+	if (!program_ok)
+	{
+		fprintf(stderr, "Failed to link shader program:\n");
+		show_info_log(program, glGetProgramiv, glGetProgramInfoLog);
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	if (compact && glGetAttribLocation(program, "animaPackedPosition") == -1)
+		fprintf(stderr, "Warning: compact vertex format, but the vertex shader does not call animaVertex()\n");
+	return program;
+}
+
+void vertex_decode_get_uniforms(GLuint program, vertex_decode_uniforms *uniforms)
+{
+	uniforms->position_offset = glGetUniformLocation(program, "animaPositionOffset");
+	uniforms->position_scale = glGetUniformLocation(program, "animaPositionScale");
+	uniforms->texcoord_offset = glGetUniformLocation(program, "animaTexcoordOffset");
+	uniforms->texcoord_scale = glGetUniformLocation(program, "animaTexcoordScale");
+	uniforms->normal_scale = glGetUniformLocation(program, "animaNormalScale");
+}
+
+void vertex_decode_set_uniforms(const vertex_decode_uniforms *uniforms, const vertex_decode *decode, const texcoord_transform *atlas)
+{
+	float texcoord_offset[2] = { 0.0f, 0.0f }, texcoord_scale[2] = { 1.0f, 1.0f };
+	if (decode != NULL)
+	{
+		glUniform3fv(uniforms->position_offset, 1, decode->position_offset);
+		glUniform3fv(uniforms->position_scale, 1, decode->position_scale);
+		glUniform1f(uniforms->normal_scale, decode->normal_scale);
+		memcpy(texcoord_offset, decode->texcoord_offset, sizeof(texcoord_offset));
+		memcpy(texcoord_scale, decode->texcoord_scale, sizeof(texcoord_scale));
+	}
+	// The atlas placement applies after the dequantization: t' = offset + t * scale
+	if (atlas != NULL)
+		for (int i = 0; i < 2; i++)
+		{
+			texcoord_offset[i] = atlas->offset[i] + texcoord_offset[i] * atlas->scale[i];
+			texcoord_scale[i] *= atlas->scale[i];
+		}
+	glUniform2fv(uniforms->texcoord_offset, 1, texcoord_offset);
+	glUniform2fv(uniforms->texcoord_scale, 1, texcoord_scale);
+}
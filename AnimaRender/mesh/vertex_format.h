@@ -0,0 +1,134 @@
+#pragma once
+
+#include <vector>
+#include <GL/glew.h>
+
+/*
+ * Compact vertex format. Instead of float vec3 positions, vec3 normals and
+ * vec2 texcoords (32 bytes per vertex) a mesh can be uploaded as:
+ *   positions  4 x 16-bit, quantized against the mesh bounding box (w is padding)
+ *   texcoords  2 x 16-bit, quantized against the texcoord bounding box
+ *   normals    2 x 8 or 2 x 16-bit octahedral encoding
+ * i.e. 16 bytes per vertex once padded. The attributes are generic vertex
+ * attributes decoded by a small GLSL library linked into every object
+ * program (see vertex_decode_make_program); vertex shaders call
+ *   vec4 animaVertex(); vec3 animaNormal(); vec4 animaMultiTexCoord0();
+ * in place of gl_Vertex, gl_Normal and gl_MultiTexCoord0. With the float
+ * format the same functions simply return the conventional attributes,
+ * except for the texcoords of objects drawn from an atlas page, which
+ * animaMultiTexCoord0 moves into the page with either format.
+ *
+ * Either way a vertex is stored interleaved in a single buffer, see
+ * vertex_layout.
+ */
+
+// Generic attribute locations. The position must be 0, it provokes the vertex
+// when the conventional vertex array is disabled; 6 and 7 alias no
+// conventional attribute.
+#define VERTEX_POSITION_ATTRIBUTE 0
+#define VERTEX_NORMAL_ATTRIBUTE 6
+#define VERTEX_TEXCOORD_ATTRIBUTE 7
+
+// Per-object format (the `vertexformat` scene keyword).
+typedef struct
+{
+	int compact;       // 0 keeps the float attributes
+	int position_bits; // 1..16, stored in 16 bits
+	int normal_bits;   // 8 or 16 per octahedral component
+	int texcoord_bits; // 1..16, stored in 16 bits
+} vertex_format;
+
+// Dequantization constants, set as uniforms before drawing.
+typedef struct
+{
+	float position_offset[3];
+	float position_scale[3];
+	float texcoord_offset[2];
+	float texcoord_scale[2];
+	float normal_scale;
+} vertex_decode;
+
+// Largest error introduced by the quantization.
+typedef struct
+{
+	float position;  // object units
+	float normal;    // degrees
+	float texcoord;  // texcoord units
+} vertex_error;
+
+typedef struct
+{
+	std::vector<GLushort> positions;   // 4 per vertex
+	std::vector<unsigned char> normals; // 2 GLbyte or 2 GLshort per vertex, see normal_type
+	GLenum normal_type;
+	std::vector<GLushort> texcoords;   // 2 per vertex
+	vertex_decode decode;
+	vertex_error error;
+} compact_vertices;
+
+// Offsets of the attributes inside an interleaved vertex; -1 if absent.
+typedef struct
+{
+	int stride; // multiple of 4
+	int position_offset;
+	int normal_offset;
+	int texcoord_offset;
+} vertex_layout;
+
+// Placement of the textures of an object in an atlas page (see texture-formats/atlas.h).
+typedef struct
+{
+	float offset[2];
+	float scale[2];
+} texcoord_transform;
+
+typedef struct
+{
+	GLint position_offset;
+	GLint position_scale;
+	GLint texcoord_offset;
+	GLint texcoord_scale;
+	GLint normal_scale;
+} vertex_decode_uniforms;
+
+void vertex_format_default(vertex_format *format);
+
+void vertex_layout_make(const vertex_format *format, int has_normals, int has_texcoords, vertex_layout *layout);
+
+// Bytes per vertex of the uploaded attributes.
+int vertex_format_size(const vertex_format *format, int has_normals, int has_texcoords);
+int vertex_format_normal_size(const vertex_format *format);
+
+/*
+ * Writes vertex_count vertices with the given layout into out. The source
+ * is either the float attributes (compact NULL) or the quantized ones
+ * produced by quantize_vertices.
+ */
+void interleave_vertices(const vertex_layout *layout, const float *positions, const float *normals,
+	const float *texcoords, const compact_vertices *compact, int vertex_count, std::vector<unsigned char> &out);
+
+// Vertex array objects record the attribute setup of a mesh once (GL 3.0 or
+// ARB_vertex_array_object); without them the pointers are set on every draw.
+void mesh_set_vertex_arrays(int enabled);
+int mesh_vertex_arrays_enabled();
+
+/*
+ * Quantizes the float attributes (normals and texcoords may be NULL) and
+ * measures the error of the decoded values against the originals.
+ */
+void quantize_vertices(const vertex_format *format, const float *positions, const float *normals,
+	const float *texcoords, int vertex_count, compact_vertices *out);
+
+// Octahedral mapping of a unit vector to [-1, 1]^2 and back.
+void oct_encode(const float normal[3], float encoded[2]);
+void oct_decode(const float encoded[2], float normal[3]);
+
+/*
+ * Links vertex_shader and fragment_shader together with the decode library
+ * for the compact or the float format, binding the generic attribute
+ * locations above. Returns 0 on failure.
+ */
+GLuint vertex_decode_make_program(GLuint vertex_shader, GLuint fragment_shader, int compact);
+void vertex_decode_get_uniforms(GLuint program, vertex_decode_uniforms *uniforms);
+// decode is NULL for the float format, atlas for textures not in an atlas.
+void vertex_decode_set_uniforms(const vertex_decode_uniforms *uniforms, const vertex_decode *decode, const texcoord_transform *atlas);
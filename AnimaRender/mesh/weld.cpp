@@ -0,0 +1,50 @@
+#include "weld.h"
+
+#include <stddef.h>
+
+// Open addressing table of vertex indices, -1 marks an empty slot.
+static const int WELD_EMPTY = -1;
+
+static unsigned int weld_hash(const obj_index_triple &corner)
+{
+	unsigned int h = (unsigned int) corner.vertex_index * 0x9e3779b1u;
+	h ^= (unsigned int) corner.texture_index * 0x85ebca77u;
+	h ^= (unsigned int) corner.normal_index * 0xc2b2ae3du;
+	return h ^ (h >> 16);
+}
+
+static bool weld_equal(const obj_index_triple &a, const obj_index_triple &b)
+{
+	return a.vertex_index == b.vertex_index && a.texture_index == b.texture_index && a.normal_index == b.normal_index;
+}
+
+int weld_corners(const obj_index_triple *corners, int corner_count, std::vector<int> &remap, std::vector<obj_index_triple> &unique)
+{
+	//Keep the load factor under 50%
+	size_t table_size = 16;
+	while (table_size < (size_t) corner_count * 2)
+		table_size *= 2;
+	std::vector<int> table(table_size, WELD_EMPTY);
+	size_t mask = table_size - 1;
+
+	remap.resize(corner_count);
+	unique.clear();
+
+	for (int i = 0; i < corner_count; i++)
+	{
+		const obj_index_triple &corner = corners[i];
+		size_t slot = weld_hash(corner) & mask;
+
+		while (table[slot] != WELD_EMPTY && !weld_equal(unique[table[slot]], corner))
+			slot = (slot + 1) & mask;
+
+		if (table[slot] == WELD_EMPTY)
+		{
+			table[slot] = (int) unique.size();
+			unique.push_back(corner);
+		}
+		remap[i] = table[slot];
+	}
+
+	return (int) unique.size();
+}
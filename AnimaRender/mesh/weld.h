@@ -0,0 +1,13 @@
+#pragma once
+
+#include <vector>
+#include "../objloader/obj_parser.h"
+
+/*
+ * Collapses triangle corners that reference the same (position, texcoord,
+ * normal) triple into a single vertex.
+ * remap receives, for every corner, the index of its welded vertex; unique
+ * receives the distinct triples in order of first use. Returns the number
+ * of welded vertices.
+ */
+int weld_corners(const obj_index_triple *corners, int corner_count, std::vector<int> &remap, std::vector<obj_index_triple> &unique);
@@ -9,6 +9,45 @@ char list_is_full(list *listo)
 	return(listo->item_count == listo->current_max_size);
 }
 
+// FNV-1a
+unsigned int list_hash_name(const char *name)
+{
+	unsigned int hash = 2166136261u;
+	
+	for(; *name != '\0'; name++)
+		hash = (hash ^ (unsigned char)*name) * 16777619u;
+	return hash;
+}
+
+void list_drop_name_index(list *listo)
+{
+	free(listo->name_slots);
+	listo->name_slots = NULL;
+	listo->name_slot_count = 0;
+}
+
+// slots hold item index + 1, 0 is empty; the table is kept at most half full
+void list_build_name_index(list *listo)
+{
+	int i, slot;
+	
+	listo->name_slot_count = 16;
+	while(listo->name_slot_count < listo->item_count * 2)
+		listo->name_slot_count *= 2;
+	listo->name_slots = (int*) calloc(listo->name_slot_count, sizeof(int));
+	
+	for(i=0; i < listo->item_count; i++)
+	{
+		if(listo->names[i] == NULL)
+			continue;
+		
+		slot = list_hash_name(listo->names[i]) & (listo->name_slot_count - 1);
+		while(listo->name_slots[slot] != 0)
+			slot = (slot + 1) & (listo->name_slot_count - 1);
+		listo->name_slots[slot] = i + 1;
+	}
+}
+
 void list_grow(list *old_listo)
 {
 	int i;
@@ -24,6 +63,8 @@ void list_grow(list *old_listo)
 	//copy new structure to old list
 	old_listo->names = new_listo.names;
 	old_listo->items = new_listo.items;
+	old_listo->name_slots = new_listo.name_slots;
+	old_listo->name_slot_count = new_listo.name_slot_count;
 	old_listo->item_count = new_listo.item_count;
 	old_listo->current_max_size = new_listo.current_max_size;
 	old_listo->growable = new_listo.growable;
@@ -37,6 +78,8 @@ void list_make(list *listo, int start_size, char growable)
 	listo->item_count = 0;
 	listo->current_max_size = start_size;
 	listo->growable = growable;
+	listo->name_slots = NULL;
+	listo->name_slot_count = 0;
 }
 
 int list_add_item(list *listo, void *item, char *name)
@@ -57,9 +100,10 @@ int list_add_item(list *listo, void *item, char *name)
 	{
 		name_length = strlen(name);
 		new_name = (char*) malloc(sizeof(char) * name_length + 1);
-		strncpy(new_name, name, name_length);
+		memcpy(new_name, name, name_length + 1);
 		listo->names[listo->item_count] = new_name;
 	}
+	list_drop_name_index(listo);
 
 	listo->items[listo->item_count] = item;
 	listo->item_count++;
@@ -101,28 +145,30 @@ void* list_get_item(list *listo, void *item_to_find)
 
 void* list_get_name(list *listo, char *name_to_find)
 {
-	int i = 0;
-
-	for(i=0; i < listo->item_count; i++)
-	{
-		if(strncmp(listo->names[i], name_to_find, strlen(name_to_find)) == 0)
-			return listo->items[i];
-	}
+	int i = list_find(listo, name_to_find);
 	
-	return NULL;
+	return i >= 0 ? listo->items[i] : NULL;
 }
 
+// exact match through the name hash; with duplicate names the first item wins
 int list_find(list *listo, char *name_to_find)
 {
-	int i = 0;
+	int slot, found = -1;
 
-	for(i=0; i < listo->item_count; i++)
+	if(name_to_find == NULL)
+		return -1;
+	if(listo->name_slots == NULL)
+		list_build_name_index(listo);
+	
+	slot = list_hash_name(name_to_find) & (listo->name_slot_count - 1);
+	for(; listo->name_slots[slot] != 0; slot = (slot + 1) & (listo->name_slot_count - 1))
 	{
-		if(strncmp(listo->names[i], name_to_find, strlen(name_to_find)) == 0)
-			return i;
+		int i = listo->name_slots[slot] - 1;
+		if(strcmp(listo->names[i], name_to_find) == 0 && (found < 0 || i < found))
+			found = i;
 	}
 	
-	return -1;
+	return found;
 }
 
 void list_delete_item(list *listo, void *item)
@@ -173,6 +219,7 @@ void list_delete_index(list *listo, int indx)
 	}
 	
 	listo->item_count--;
+	list_drop_name_index(listo);
 	
 	return;
 }
@@ -188,6 +235,7 @@ void list_delete_all(list *listo)
 void list_free(list *listo)
 {
 	list_delete_all(listo);
+	list_drop_name_index(listo);
 	free(listo->names);
 	free(listo->items);
 }
@@ -9,6 +9,11 @@ typedef struct
 
 	void **items;
 	char **names;	
+
+	// open addressing hash of names -> item index, built on the first
+	// lookup after a change (see list_find)
+	int *name_slots;
+	int name_slot_count;
 } list;
 
 void list_make(list *listo, int size, char growable);
@@ -8,11 +8,11 @@ int objLoader::load(const char *filename)
 	no_error = parse_obj_scene(&data, filename);
 	if(no_error)
 	{
-		this->vertexCount = data.vertex_count;
-		this->normalCount = data.vertex_normal_count;
-		this->textureCount = data.vertex_texture_count;
+		this->vertexCount = data.mesh.position_count;
+		this->normalCount = data.mesh.normal_count;
+		this->textureCount = data.mesh.texcoord_count;
 
-		this->faceCount = data.face_count;
+		this->triangleCount = data.mesh.triangle_count;
 		this->sphereCount = data.sphere_count;
 		this->planeCount = data.plane_count;
 
@@ -22,11 +22,12 @@ int objLoader::load(const char *filename)
 
 		this->materialCount = data.material_count;
 
-		this->vertexList = data.vertex_list;
-		this->normalList = data.vertex_normal_list;
-		this->textureList = data.vertex_texture_list;
+		this->positions = data.mesh.positions;
+		this->normals = data.mesh.normals;
+		this->texcoords = data.mesh.texcoords;
+		this->triangles = data.mesh.triangles;
+		this->triangleMaterials = data.mesh.triangle_materials;
 
-		this->faceList = data.face_list;
 		this->sphereList = data.sphere_list;
 		this->planeList = data.plane_list;
 
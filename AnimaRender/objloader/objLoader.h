@@ -3,10 +3,15 @@
 
 #include "obj_parser.h"
 
+#include <string.h>
+
 class objLoader
 {
 public:
-	objLoader() {}
+	objLoader()
+	{
+		memset(&data, 0, sizeof(data));
+	}
 	~objLoader()
 	{
 		delete_obj_data(&data);
@@ -14,11 +19,13 @@ public:
 
 	int load(const char *filename);
 
-	obj_vector **vertexList;
-	obj_vector **normalList;
-	obj_vector **textureList;
-	
-	obj_face **faceList;
+	//flat geometry, see obj_mesh_arrays
+	float *positions;
+	float *normals;
+	float *texcoords;
+	obj_index_triple *triangles;
+	int *triangleMaterials;
+
 	obj_sphere **sphereList;
 	obj_plane **planeList;
 	
@@ -32,7 +39,7 @@ public:
 	int normalCount;
 	int textureCount;
 
-	int faceCount;
+	int triangleCount;
 	int sphereCount;
 	int planeCount;
 
@@ -0,0 +1,100 @@
+#include "obj_arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define OBJ_ARENA_ALIGNMENT 16
+
+static size_t obj_arena_align(size_t size)
+{
+	return (size + OBJ_ARENA_ALIGNMENT - 1) & ~(size_t)(OBJ_ARENA_ALIGNMENT - 1);
+}
+
+void obj_arena_init(obj_arena *arena, size_t block_size)
+{
+	arena->head = NULL;
+	arena->block_size = block_size;
+}
+
+void *obj_arena_alloc(obj_arena *arena, size_t bytes)
+{
+	obj_arena_block *block = arena->head;
+	size_t header = obj_arena_align(sizeof(obj_arena_block));
+
+	bytes = obj_arena_align(bytes);
+	if (block == NULL || block->used + bytes > block->size)
+	{
+		size_t size = bytes > arena->block_size ? bytes : arena->block_size;
+		block = (obj_arena_block*) malloc(header + size);
+		if (block == NULL)
+			return NULL;
+		block->next = arena->head;
+		block->size = size;
+		block->used = 0;
+		arena->head = block;
+	}
+
+	void *memory = (char*) block + header + block->used;
+	block->used += bytes;
+	return memory;
+}
+
+void obj_arena_free(obj_arena *arena)
+{
+	obj_arena_block *block = arena->head;
+	while (block != NULL)
+	{
+		obj_arena_block *next = block->next;
+		free(block);
+		block = next;
+	}
+	arena->head = NULL;
+}
+
+static char *obj_segment_data(obj_stream_segment *segment)
+{
+	return (char*) segment + obj_arena_align(sizeof(obj_stream_segment));
+}
+
+void obj_stream_init(obj_stream *stream, obj_arena *arena, size_t element_size, int segment_capacity)
+{
+	stream->arena = arena;
+	stream->element_size = element_size;
+	stream->segment_capacity = segment_capacity;
+	stream->count = 0;
+	stream->head = NULL;
+	stream->tail = NULL;
+}
+
+void *obj_stream_push(obj_stream *stream)
+{
+	obj_stream_segment *segment = stream->tail;
+
+	if (segment == NULL || segment->count == stream->segment_capacity)
+	{
+		segment = (obj_stream_segment*) obj_arena_alloc(stream->arena,
+			obj_arena_align(sizeof(obj_stream_segment)) + stream->element_size * stream->segment_capacity);
+		segment->next = NULL;
+		segment->count = 0;
+		if (stream->tail != NULL)
+			stream->tail->next = segment;
+		else
+			stream->head = segment;
+		stream->tail = segment;
+	}
+
+	stream->count++;
+	return obj_segment_data(segment) + stream->element_size * segment->count++;
+}
+
+// Copies every element, in push order, to a contiguous destination
+void obj_stream_copy(const obj_stream *stream, void *destination)
+{
+	char *out = (char*) destination;
+	for (obj_stream_segment *segment = stream->head; segment != NULL; segment = segment->next)
+	{
+		size_t bytes = stream->element_size * segment->count;
+		memcpy(out, obj_segment_data(segment), bytes);
+		out += bytes;
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef OBJ_ARENA_H
+#define OBJ_ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Bump allocator: memory is carved out of big blocks and released all at once.
+ */
+typedef struct obj_arena_block
+{
+	struct obj_arena_block *next;
+	size_t size;
+	size_t used;
+} obj_arena_block;
+
+typedef struct
+{
+	obj_arena_block *head;
+	size_t block_size;
+} obj_arena;
+
+void obj_arena_init(obj_arena *arena, size_t block_size);
+void *obj_arena_alloc(obj_arena *arena, size_t bytes);
+void obj_arena_free(obj_arena *arena);
+
+/*
+ * Append-only array of fixed-size elements stored as a chain of arena
+ * segments. Elements never move once pushed, so pointers into the stream
+ * stay valid until the arena is released.
+ */
+typedef struct obj_stream_segment
+{
+	struct obj_stream_segment *next;
+	int count;
+} obj_stream_segment;
+
+typedef struct
+{
+	obj_arena *arena;
+	size_t element_size;
+	int segment_capacity;
+	int count;
+	obj_stream_segment *head;
+	obj_stream_segment *tail;
+} obj_stream;
+
+void obj_stream_init(obj_stream *stream, obj_arena *arena, size_t element_size, int segment_capacity);
+void *obj_stream_push(obj_stream *stream);
+void obj_stream_copy(const obj_stream *stream, void *destination);
+
+#endif
@@ -0,0 +1,380 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include "obj_mapped_parser.h"
+#include "obj_tokenizer.h"
+#include "obj_arena.h"
+#include "obj_triangulate.h"
+#include "../utils/mapped_file.h"
+#include "../utils/parallel.h"
+
+#define OBJ_MIN_CHUNK_SIZE (1 << 20)
+#define OBJ_CHUNKS_PER_THREAD 4
+#define OBJ_ARENA_BLOCK_SIZE (1 << 20)
+#define OBJ_STREAM_SEGMENT 4096
+
+/*
+ * Memory-mapped replacement for obj_parse_obj_file().
+ * The hot statements (v, vn, vt, f) are scanned in place straight into
+ * arena-backed streams of floats and index triples; every other statement
+ * is copied to a line buffer and handed to obj_parse_line(), so the result
+ * is the same as with the stdio parser followed by obj_build_mesh_arrays().
+ *
+ * The file is cut into line-aligned chunks that are parsed concurrently
+ * and then stitched together in file order (see obj_merge_chunks).
+ *
+ * Faces may have any number of corners. Triangles go straight to the
+ * triangle stream; bigger polygons keep their corners in the arena and
+ * reserve their n - 2 triangles, which are filled by obj_triangulate once
+ * the merge has made every position they reference available.
+ */
+
+static int obj_parser_threads = 0;
+
+enum obj_fixup_kind
+{
+	OBJ_FIXUP_VERTEX,
+	OBJ_FIXUP_TEXTURE,
+	OBJ_FIXUP_NORMAL
+};
+
+// A relative (negative) index resolved against chunk-local counts;
+// the chunk's v/vt/vn base has to be added once the chunks are merged.
+typedef struct
+{
+	int *index;
+	int kind;
+} obj_index_fixup;
+
+// A statement that depends on parser state (materials, cameras, lights...)
+// and is therefore replayed serially, in file order, during the merge.
+typedef struct
+{
+	const char *begin;
+	const char *end;
+	int line_number;
+	int vertex_count;
+	int texture_count;
+	int normal_count;
+	int triangle_count;
+} obj_deferred_line;
+
+// A face of four or more corners waiting to be triangulated.
+typedef struct
+{
+	obj_index_triple *corners;
+	int corner_count;
+	int first_triangle;
+} obj_polygon;
+
+typedef struct
+{
+	const char *begin;
+	const char *end;
+	int line_count;
+
+	obj_arena arena;
+	obj_stream positions;
+	obj_stream normals;
+	obj_stream texcoords;
+	obj_stream triangles;
+
+	std::vector<obj_index_fixup> fixups;
+	std::vector<obj_deferred_line> deferred;
+	std::vector<obj_polygon> polygons;
+} obj_chunk;
+
+void obj_set_parser_threads(int threads)
+{
+	obj_parser_threads = threads;
+}
+
+int obj_get_parser_threads()
+{
+	return obj_parser_threads > 0 ? obj_parser_threads : hardware_threads();
+}
+
+static void obj_scan_floats(const char *p, const char *end, float *out, int count)
+{
+	double value;
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		p = obj_skip_space(p, end);
+		if (p == end)
+			out[i] = 0.0f;
+		else
+		{
+			p = obj_parse_double(p, end, &value);
+			out[i] = (float) value;
+		}
+	}
+}
+
+static void obj_convert_face_index(int *index, int current_max, int kind, std::vector<obj_index_fixup> &fixups)
+{
+	if (*index < 0)
+	{
+		obj_index_fixup fixup = { index, kind };
+		fixups.push_back(fixup);
+	}
+	*index = obj_convert_to_list_index(current_max, *index);
+}
+
+// Parses one v/vt/vn corner and resolves its indices into out
+static const char *obj_scan_corner(obj_chunk *chunk, const char *p, const char *end, obj_index_triple *out)
+{
+	out->texture_index = 0;
+	out->normal_index = 0;
+
+	p = obj_parse_int(p, end, &out->vertex_index);
+	if (p < end && *p == '/')
+	{
+		p++;
+		if (p < end && *p != '/')
+			p = obj_parse_int(p, end, &out->texture_index);
+		if (p < end && *p == '/')
+			p = obj_parse_int(p + 1, end, &out->normal_index);
+	}
+
+	obj_convert_face_index(&out->vertex_index, chunk->positions.count, OBJ_FIXUP_VERTEX, chunk->fixups);
+	obj_convert_face_index(&out->texture_index, chunk->texcoords.count, OBJ_FIXUP_TEXTURE, chunk->fixups);
+	obj_convert_face_index(&out->normal_index, chunk->normals.count, OBJ_FIXUP_NORMAL, chunk->fixups);
+	return obj_skip_token(p, end);
+}
+
+static void obj_scan_face(obj_chunk *chunk, const char *p, const char *end)
+{
+	const char *q;
+	int corner_count = 0;
+	int i;
+
+	for (q = obj_skip_space(p, end); q < end; q = obj_skip_space(obj_skip_token(q, end), end))
+		corner_count++;
+	if (corner_count < 3)
+		return;
+
+	if (corner_count == 3)
+	{
+		obj_index_triple *triangle = (obj_index_triple*) obj_stream_push(&chunk->triangles);
+		for (i = 0; i < 3; i++)
+			p = obj_scan_corner(chunk, obj_skip_space(p, end), end, &triangle[i]);
+		return;
+	}
+
+	obj_polygon polygon;
+	polygon.corners = (obj_index_triple*) obj_arena_alloc(&chunk->arena, sizeof(obj_index_triple) * corner_count);
+	polygon.corner_count = corner_count;
+	polygon.first_triangle = chunk->triangles.count;
+	for (i = 0; i < corner_count; i++)
+		p = obj_scan_corner(chunk, obj_skip_space(p, end), end, &polygon.corners[i]);
+
+	for (i = 0; i < corner_count - 2; i++)
+		obj_stream_push(&chunk->triangles);
+	chunk->polygons.push_back(polygon);
+}
+
+static void obj_parse_chunk(obj_chunk *chunk)
+{
+	const char *p = chunk->begin;
+	const char *end = chunk->end;
+
+	obj_arena_init(&chunk->arena, OBJ_ARENA_BLOCK_SIZE);
+	obj_stream_init(&chunk->positions, &chunk->arena, sizeof(float) * 3, OBJ_STREAM_SEGMENT);
+	obj_stream_init(&chunk->normals, &chunk->arena, sizeof(float) * 3, OBJ_STREAM_SEGMENT);
+	obj_stream_init(&chunk->texcoords, &chunk->arena, sizeof(float) * 2, OBJ_STREAM_SEGMENT);
+	obj_stream_init(&chunk->triangles, &chunk->arena, sizeof(obj_index_triple) * 3, OBJ_STREAM_SEGMENT);
+	chunk->line_count = 0;
+
+	while (p < end)
+	{
+		const char *eol = obj_find_eol(p, end);
+		const char *token = obj_skip_space(p, eol);
+		const char *token_end = obj_skip_token(token, eol);
+		size_t token_length = token_end - token;
+		chunk->line_count++;
+
+		if (token_length == 0 || token[0] == '#')
+			;
+		else if (token[0] == 'v' && token_length == 1) //process vertex
+			obj_scan_floats(token_end, eol, (float*) obj_stream_push(&chunk->positions), 3);
+		else if (token[0] == 'v' && token_length == 2 && token[1] == 'n') //process vertex normal
+			obj_scan_floats(token_end, eol, (float*) obj_stream_push(&chunk->normals), 3);
+		else if (token[0] == 'v' && token_length == 2 && token[1] == 't') //process vertex texture
+			obj_scan_floats(token_end, eol, (float*) obj_stream_push(&chunk->texcoords), 2);
+		else if (token[0] == 'f' && token_length == 1) //process face
+			obj_scan_face(chunk, token_end, eol);
+		else if (token_length == 1 && (token[0] == 'o' || token[0] == 's' || token[0] == 'g'))
+			;
+		else
+		{
+			obj_deferred_line line;
+			line.begin = p;
+			line.end = eol;
+			line.line_number = chunk->line_count;
+			line.vertex_count = chunk->positions.count;
+			line.texture_count = chunk->texcoords.count;
+			line.normal_count = chunk->normals.count;
+			line.triangle_count = chunk->triangles.count;
+			chunk->deferred.push_back(line);
+		}
+
+		p = eol + 1;
+	}
+}
+
+static void obj_set_materials(int *materials, int from, int to, int material)
+{
+	for (int i = from; i < to; i++)
+		materials[i] = material;
+}
+
+/*
+ * Stitches the chunks in file order into the mesh arrays. Absolute indices
+ * are already global; relative ones were resolved against the chunk-local
+ * counts and only need the chunk base. Deferred statements are replayed
+ * with the v/vt/vn counts they had at that line, so obj_parse_line() sees
+ * exactly the state the serial parser would have.
+ */
+static void obj_merge_chunks(obj_growable_scene_data *growable_data, std::vector<obj_chunk> &chunks)
+{
+	std::vector<char> current_line;
+	obj_triangulator triangulator;
+	int current_material = -1;
+	int line_base = 0;
+	int triangle_base = 0;
+	int positions = 0, normals = 0, texcoords = 0, triangles = 0;
+	size_t c, i;
+
+	for (c = 0; c < chunks.size(); c++)
+	{
+		positions += chunks[c].positions.count;
+		normals += chunks[c].normals.count;
+		texcoords += chunks[c].texcoords.count;
+		triangles += chunks[c].triangles.count;
+	}
+
+	obj_mesh_arrays *mesh = &growable_data->mesh;
+	obj_mesh_arrays_allocate(mesh, positions, normals, texcoords, triangles);
+	obj_triangulator_init(&triangulator);
+
+	for (c = 0; c < chunks.size(); c++)
+	{
+		obj_chunk &chunk = chunks[c];
+		int vertex_base = growable_data->vertex_count;
+		int texture_base = growable_data->vertex_texture_count;
+		int normal_base = growable_data->vertex_normal_count;
+		int triangle_cursor = triangle_base;
+
+		for (i = 0; i < chunk.fixups.size(); i++)
+		{
+			obj_index_fixup &fixup = chunk.fixups[i];
+			if (fixup.kind == OBJ_FIXUP_VERTEX)
+				*fixup.index += vertex_base;
+			else if (fixup.kind == OBJ_FIXUP_TEXTURE)
+				*fixup.index += texture_base;
+			else
+				*fixup.index += normal_base;
+		}
+
+		obj_stream_copy(&chunk.positions, mesh->positions + 3 * vertex_base);
+		obj_stream_copy(&chunk.normals, mesh->normals + 3 * normal_base);
+		obj_stream_copy(&chunk.texcoords, mesh->texcoords + 2 * texture_base);
+		obj_stream_copy(&chunk.triangles, mesh->triangles + 3 * triangle_base);
+
+		//faces reference positions of this chunk or of the ones before, all copied by now
+		for (i = 0; i < chunk.polygons.size(); i++)
+		{
+			obj_polygon &polygon = chunk.polygons[i];
+			obj_triangulate(&triangulator, mesh->positions, vertex_base + chunk.positions.count,
+				polygon.corners, polygon.corner_count, mesh->triangles + 3 * (triangle_base + polygon.first_triangle));
+		}
+
+		for (i = 0; i < chunk.deferred.size(); i++)
+		{
+			obj_deferred_line &line = chunk.deferred[i];
+			size_t length = line.end - line.begin;
+
+			obj_set_materials(mesh->triangle_materials, triangle_cursor, triangle_base + line.triangle_count, current_material);
+			triangle_cursor = triangle_base + line.triangle_count;
+
+			current_line.resize(length + 1);
+			memcpy(&current_line[0], line.begin, length);
+			current_line[length] = '\0';
+
+			growable_data->vertex_count = vertex_base + line.vertex_count;
+			growable_data->vertex_texture_count = texture_base + line.texture_count;
+			growable_data->vertex_normal_count = normal_base + line.normal_count;
+			obj_parse_line(growable_data, &current_line[0], line_base + line.line_number, &current_material);
+		}
+
+		obj_set_materials(mesh->triangle_materials, triangle_cursor, triangle_base + chunk.triangles.count, current_material);
+
+		growable_data->vertex_count = vertex_base + chunk.positions.count;
+		growable_data->vertex_texture_count = texture_base + chunk.texcoords.count;
+		growable_data->vertex_normal_count = normal_base + chunk.normals.count;
+		triangle_base += chunk.triangles.count;
+		line_base += chunk.line_count;
+
+		obj_arena_free(&chunk.arena);
+	}
+
+	obj_triangulator_free(&triangulator);
+}
+
+int obj_parse_obj_buffer(obj_growable_scene_data *growable_data, const char *begin, const char *end, int threads)
+{
+	size_t size = end - begin;
+	size_t chunk_count = (size_t) threads * OBJ_CHUNKS_PER_THREAD;
+
+	if (size / OBJ_MIN_CHUNK_SIZE < chunk_count)
+		chunk_count = size / OBJ_MIN_CHUNK_SIZE;
+	if (chunk_count < 1)
+		chunk_count = 1;
+
+	//line-aligned chunk boundaries
+	std::vector<obj_chunk> chunks(chunk_count);
+	const char *chunk_begin = begin;
+	for (size_t c = 0; c < chunk_count; c++)
+	{
+		const char *chunk_end = end;
+		if (c + 1 < chunk_count)
+		{
+			chunk_end = obj_find_eol(begin + size / chunk_count * (c + 1), end);
+			if (chunk_end < end)
+				chunk_end++;
+			if (chunk_end < chunk_begin)
+				chunk_end = chunk_begin;
+		}
+		chunks[c].begin = chunk_begin;
+		chunks[c].end = chunk_end;
+		chunk_begin = chunk_end;
+	}
+
+	parallel_for((int) chunk_count, threads, [&](int c) {
+		obj_parse_chunk(&chunks[c]);
+	});
+
+	obj_merge_chunks(growable_data, chunks);
+	return 1;
+}
+
+int obj_parse_mapped_obj_file(obj_growable_scene_data *growable_data, const char *filename)
+{
+	mapped_file file;
+	int result;
+
+	strncpy(growable_data->scene_filename, filename, OBJ_FILENAME_LENGTH - 1);
+	if (!map_file(&file, filename))
+	{
+		fprintf(stderr, "Error reading file: %s\n", filename);
+		return 0;
+	}
+
+	result = obj_parse_obj_buffer(growable_data, file.data, file.data + file.size, obj_get_parser_threads());
+
+	unmap_file(&file);
+	return result;
+}
@@ -0,0 +1,13 @@
+#ifndef OBJ_MAPPED_PARSER_H
+#define OBJ_MAPPED_PARSER_H
+
+#include "obj_parser.h"
+
+int obj_parse_mapped_obj_file(obj_growable_scene_data *growable_data, const char *filename);
+int obj_parse_obj_buffer(obj_growable_scene_data *growable_data, const char *begin, const char *end, int threads);
+
+// Worker threads used for big files; 0 (the default) uses every core.
+void obj_set_parser_threads(int threads);
+int obj_get_parser_threads();
+
+#endif
@@ -4,6 +4,8 @@
 #include "obj_parser.h"
 #include "list.h"
 #include "string_extra.h"
+#include "obj_mapped_parser.h"
+#include "obj_triangulate.h"
 
 #define WHITESPACE " \t\n\r"
 
@@ -24,6 +26,31 @@ int obj_convert_to_list_index(int current_max, int index)
 	return index - 1;  //normal counting index
 }
 
+// Paths inside an obj or mtl are relative to the directory of that file
+void obj_resolve_path(char *out, const char *base_filename, const char *filename)
+{
+	const char *slash = strrchr(base_filename, '/');
+	const char *backslash = strrchr(base_filename, '\\');
+	int directory_length;
+	
+	if(backslash > slash)
+		slash = backslash;
+	
+	if(slash == NULL || filename[0] == '/' || filename[0] == '\\' || (filename[0] != '\0' && filename[1] == ':'))
+	{
+		strncpy(out, filename, OBJ_FILENAME_LENGTH - 1);
+		out[OBJ_FILENAME_LENGTH - 1] = '\0';
+		return;
+	}
+	
+	directory_length = (int)(slash - base_filename) + 1;
+	if(directory_length >= OBJ_FILENAME_LENGTH)
+		directory_length = OBJ_FILENAME_LENGTH - 1;
+	memcpy(out, base_filename, directory_length);
+	strncpy(out + directory_length, filename, OBJ_FILENAME_LENGTH - 1 - directory_length);
+	out[OBJ_FILENAME_LENGTH - 1] = '\0';
+}
+
 void obj_convert_to_list_index_v(int current_max, int *indices)
 {
 	for(int i=0; i<MAX_VERTEX_COUNT; i++)
@@ -49,39 +76,50 @@ void obj_set_material_defaults(obj_material *mtl)
 	mtl->texture_filename[0] = '\0';
 }
 
-int obj_parse_vertex_index(int *vertex_index, int *texture_index, int *normal_index)
+// v, v/vt, v//vn or v/vt/vn
+void obj_parse_corner(char *token, obj_index_triple *corner)
 {
 	char *temp_str;
+
+	corner->texture_index = 0;
+	corner->normal_index = 0;
+	corner->vertex_index = atoi( token );
+	
+	if(contains(token, "//"))  //normal only
+	{
+		temp_str = strchr(token, '/');
+		temp_str++;
+		corner->normal_index = atoi( ++temp_str );
+	}
+	else if(contains(token, "/"))
+	{
+		temp_str = strchr(token, '/');
+		corner->texture_index = atoi( ++temp_str );
+
+		if(contains(temp_str, "/"))
+		{
+			temp_str = strchr(temp_str, '/');
+			corner->normal_index = atoi( ++temp_str );
+		}
+	}
+}
+
+// reads at most max_count corners, the rest of the line is ignored
+int obj_parse_vertex_index(int *vertex_index, int *texture_index, int *normal_index, int max_count)
+{
 	char *token;
 	int vertex_count = 0;
+	obj_index_triple corner;
 
 	
-	while( (token = strtok(NULL, WHITESPACE)) != NULL)
+	while( vertex_count < max_count && (token = strtok(NULL, WHITESPACE)) != NULL)
 	{
+		obj_parse_corner(token, &corner);
+		vertex_index[vertex_count] = corner.vertex_index;
 		if(texture_index != NULL)
-			texture_index[vertex_count] = 0;
+			texture_index[vertex_count] = corner.texture_index;
 		if(normal_index != NULL)
-		normal_index[vertex_count] = 0;
-
-		vertex_index[vertex_count] = atoi( token );
-		
-		if(contains(token, "//"))  //normal only
-		{
-			temp_str = strchr(token, '/');
-			temp_str++;
-			normal_index[vertex_count] = atoi( ++temp_str );
-		}
-		else if(contains(token, "/"))
-		{
-			temp_str = strchr(token, '/');
-			texture_index[vertex_count] = atoi( ++temp_str );
-
-			if(contains(temp_str, "/"))
-			{
-				temp_str = strchr(temp_str, '/');
-				normal_index[vertex_count] = atoi( ++temp_str );
-			}
-		}
+			normal_index[vertex_count] = corner.normal_index;
 		
 		vertex_count++;
 	}
@@ -91,14 +129,34 @@ int obj_parse_vertex_index(int *vertex_index, int *texture_index, int *normal_in
 
 obj_face* obj_parse_face(obj_growable_scene_data *scene)
 {
-	int vertex_count;
-	obj_face *face = (obj_face*)malloc(sizeof(obj_face));
-	
-	vertex_count = obj_parse_vertex_index(face->vertex_index, face->texture_index, face->normal_index);
-	obj_convert_to_list_index_v(scene->vertex_list.item_count, face->vertex_index);
-	obj_convert_to_list_index_v(scene->vertex_texture_list.item_count, face->texture_index);
-	obj_convert_to_list_index_v(scene->vertex_normal_list.item_count, face->normal_index);
+	// the corners are counted first, so the face is a single allocation whatever its size
+	char *corners = strtok(NULL, "\n\r");
+	char *token;
+	int vertex_count = 0;
+	char *p;
+	obj_face *face;
+
+	for(p = corners; p != NULL && *p != '\0'; )
+	{
+		p += strspn(p, " \t");
+		if(*p == '\0')
+			break;
+		p += strcspn(p, " \t");
+		vertex_count++;
+	}
+
+	face = (obj_face*)malloc(sizeof(obj_face) + sizeof(obj_index_triple) * (vertex_count > 1 ? vertex_count - 1 : 0));
 	face->vertex_count = vertex_count;
+	
+	vertex_count = 0;
+	for(token = corners != NULL ? strtok(corners, " \t") : NULL; token != NULL; token = strtok(NULL, " \t"))
+	{
+		obj_index_triple *corner = &face->corners[vertex_count++];
+		obj_parse_corner(token, corner);
+		corner->vertex_index = obj_convert_to_list_index(scene->vertex_count, corner->vertex_index);
+		corner->texture_index = obj_convert_to_list_index(scene->vertex_texture_count, corner->texture_index);
+		corner->normal_index = obj_convert_to_list_index(scene->vertex_normal_count, corner->normal_index);
+	}
 
 	return face;
 }
@@ -108,11 +166,11 @@ obj_sphere* obj_parse_sphere(obj_growable_scene_data *scene)
 	int temp_indices[MAX_VERTEX_COUNT];
 
 	obj_sphere *obj = (obj_sphere*)malloc(sizeof(obj_sphere));
-	obj_parse_vertex_index(temp_indices, obj->texture_index, NULL);
-	obj_convert_to_list_index_v(scene->vertex_texture_list.item_count, obj->texture_index);
-	obj->pos_index = obj_convert_to_list_index(scene->vertex_list.item_count, temp_indices[0]);
-	obj->up_normal_index = obj_convert_to_list_index(scene->vertex_normal_list.item_count, temp_indices[1]);
-	obj->equator_normal_index = obj_convert_to_list_index(scene->vertex_normal_list.item_count, temp_indices[2]);
+	obj_parse_vertex_index(temp_indices, obj->texture_index, NULL, MAX_VERTEX_COUNT);
+	obj_convert_to_list_index_v(scene->vertex_texture_count, obj->texture_index);
+	obj->pos_index = obj_convert_to_list_index(scene->vertex_count, temp_indices[0]);
+	obj->up_normal_index = obj_convert_to_list_index(scene->vertex_normal_count, temp_indices[1]);
+	obj->equator_normal_index = obj_convert_to_list_index(scene->vertex_normal_count, temp_indices[2]);
 
 	return obj;
 }
@@ -122,11 +180,11 @@ obj_plane* obj_parse_plane(obj_growable_scene_data *scene)
 	int temp_indices[MAX_VERTEX_COUNT];
 
 	obj_plane *obj = (obj_plane*)malloc(sizeof(obj_plane));
-	obj_parse_vertex_index(temp_indices, obj->texture_index, NULL);
-	obj_convert_to_list_index_v(scene->vertex_texture_list.item_count, obj->texture_index);
-	obj->pos_index = obj_convert_to_list_index(scene->vertex_list.item_count, temp_indices[0]);
-	obj->normal_index = obj_convert_to_list_index(scene->vertex_normal_list.item_count, temp_indices[1]);
-	obj->rotation_normal_index = obj_convert_to_list_index(scene->vertex_normal_list.item_count, temp_indices[2]);
+	obj_parse_vertex_index(temp_indices, obj->texture_index, NULL, MAX_VERTEX_COUNT);
+	obj_convert_to_list_index_v(scene->vertex_texture_count, obj->texture_index);
+	obj->pos_index = obj_convert_to_list_index(scene->vertex_count, temp_indices[0]);
+	obj->normal_index = obj_convert_to_list_index(scene->vertex_normal_count, temp_indices[1]);
+	obj->rotation_normal_index = obj_convert_to_list_index(scene->vertex_normal_count, temp_indices[2]);
 
 	return obj;
 }
@@ -134,15 +192,15 @@ obj_plane* obj_parse_plane(obj_growable_scene_data *scene)
 obj_light_point* obj_parse_light_point(obj_growable_scene_data *scene)
 {
 	obj_light_point *o= (obj_light_point*)malloc(sizeof(obj_light_point));
-	o->pos_index = obj_convert_to_list_index(scene->vertex_list.item_count, atoi( strtok(NULL, WHITESPACE)) );
+	o->pos_index = obj_convert_to_list_index(scene->vertex_count, atoi( strtok(NULL, WHITESPACE)) );
 	return o;
 }
 
 obj_light_quad* obj_parse_light_quad(obj_growable_scene_data *scene)
 {
 	obj_light_quad *o = (obj_light_quad*)malloc(sizeof(obj_light_quad));
-	obj_parse_vertex_index(o->vertex_index, NULL, NULL);
-	obj_convert_to_list_index_v(scene->vertex_list.item_count, o->vertex_index);
+	obj_parse_vertex_index(o->vertex_index, NULL, NULL, MAX_VERTEX_COUNT);
+	obj_convert_to_list_index_v(scene->vertex_count, o->vertex_index);
 
 	return o;
 }
@@ -152,9 +210,9 @@ obj_light_disc* obj_parse_light_disc(obj_growable_scene_data *scene)
 	int temp_indices[MAX_VERTEX_COUNT];
 
 	obj_light_disc *obj = (obj_light_disc*)malloc(sizeof(obj_light_disc));
-	obj_parse_vertex_index(temp_indices, NULL, NULL);
-	obj->pos_index = obj_convert_to_list_index(scene->vertex_list.item_count, temp_indices[0]);
-	obj->normal_index = obj_convert_to_list_index(scene->vertex_normal_list.item_count, temp_indices[1]);
+	obj_parse_vertex_index(temp_indices, NULL, NULL, MAX_VERTEX_COUNT);
+	obj->pos_index = obj_convert_to_list_index(scene->vertex_count, temp_indices[0]);
+	obj->normal_index = obj_convert_to_list_index(scene->vertex_normal_count, temp_indices[1]);
 
 	return obj;
 }
@@ -175,13 +233,13 @@ obj_vector* obj_parse_vector()
 void obj_parse_camera(obj_growable_scene_data *scene, obj_camera *camera)
 {
 	int indices[3];
-	obj_parse_vertex_index(indices, NULL, NULL);
-	camera->camera_pos_index = obj_convert_to_list_index(scene->vertex_list.item_count, indices[0]);
-	camera->camera_look_point_index = obj_convert_to_list_index(scene->vertex_list.item_count, indices[1]);
-	camera->camera_up_norm_index = obj_convert_to_list_index(scene->vertex_normal_list.item_count, indices[2]);
+	obj_parse_vertex_index(indices, NULL, NULL, 3);
+	camera->camera_pos_index = obj_convert_to_list_index(scene->vertex_count, indices[0]);
+	camera->camera_look_point_index = obj_convert_to_list_index(scene->vertex_count, indices[1]);
+	camera->camera_up_norm_index = obj_convert_to_list_index(scene->vertex_normal_count, indices[2]);
 }
 
-int obj_parse_mtl_file(char *filename, list *material_list)
+int obj_parse_mtl_file(const char *filename, list *material_list)
 {
 	int line_number = 0;
 	char *current_token;
@@ -197,8 +255,6 @@ int obj_parse_mtl_file(char *filename, list *material_list)
 		fprintf(stderr, "Error reading file: %s\n", filename);
 		return 0;
 	}
-		
-	list_make(material_list, 10, 1);
 
 	while( fgets(current_line, OBJ_LINE_SIZE, mtl_file_stream) )
 	{
@@ -217,8 +273,9 @@ int obj_parse_mtl_file(char *filename, list *material_list)
 			current_mtl = (obj_material*) malloc(sizeof(obj_material));
 			obj_set_material_defaults(current_mtl);
 			
-			// get the name
-			strncpy(current_mtl->name, strtok(NULL, " \t"), MATERIAL_NAME_SIZE);
+			// get the name, usemtl looks it up exactly
+			strncpy(current_mtl->name, strtok(NULL, WHITESPACE), MATERIAL_NAME_SIZE - 1);
+			current_mtl->name[MATERIAL_NAME_SIZE - 1] = '\0';
 			list_add_item(material_list, current_mtl, current_mtl->name);
 		}
 		
@@ -274,10 +331,12 @@ int obj_parse_mtl_file(char *filename, list *material_list)
 		else if( strequal(current_token, "illum") && material_open)
 		{
 		}
-		// texture map
-		else if( strequal(current_token, "map_Ka") && material_open)
+		// texture map, relative to the mtl file; the diffuse map wins over the ambient one
+		else if( (strequal(current_token, "map_Kd") || strequal(current_token, "map_Ka")) && material_open)
 		{
-			strncpy(current_mtl->texture_filename, strtok(NULL, " \t"), OBJ_FILENAME_LENGTH);
+			char *map_filename = strtok(NULL, WHITESPACE);
+			if( map_filename != NULL && (strequal(current_token, "map_Kd") || current_mtl->texture_filename[0] == '\0'))
+				obj_resolve_path(current_mtl->texture_filename, filename, map_filename);
 		}
 		else
 		{
@@ -293,14 +352,146 @@ int obj_parse_mtl_file(char *filename, list *material_list)
 
 }
 
+void obj_parse_line(obj_growable_scene_data *growable_data, char *current_line, int line_number, int *current_material)
+{
+	char *current_token = strtok( current_line, " \t\n\r");
+	
+	//skip comments
+	if( current_token == NULL || current_token[0] == '#')
+		return;
+
+	//parse objects
+	else if( strequal(current_token, "v") ) //process vertex
+	{
+		list_add_item(&growable_data->vertex_list,  obj_parse_vector(), NULL);
+		growable_data->vertex_count++;
+	}
+	
+	else if( strequal(current_token, "vn") ) //process vertex normal
+	{
+		list_add_item(&growable_data->vertex_normal_list,  obj_parse_vector(), NULL);
+		growable_data->vertex_normal_count++;
+	}
+	
+	else if( strequal(current_token, "vt") ) //process vertex texture
+	{
+		list_add_item(&growable_data->vertex_texture_list,  obj_parse_vector(), NULL);
+		growable_data->vertex_texture_count++;
+	}
+	
+	else if( strequal(current_token, "f") ) //process face
+	{
+		obj_face *face = obj_parse_face(growable_data);
+		face->material_index = *current_material;
+		list_add_item(&growable_data->face_list, face, NULL);
+	}
+	
+	else if( strequal(current_token, "sp") ) //process sphere
+	{
+		obj_sphere *sphr = obj_parse_sphere(growable_data);
+		sphr->material_index = *current_material;
+		list_add_item(&growable_data->sphere_list, sphr, NULL);
+	}
+	
+	else if( strequal(current_token, "pl") ) //process plane
+	{
+		obj_plane *pl = obj_parse_plane(growable_data);
+		pl->material_index = *current_material;
+		list_add_item(&growable_data->plane_list, pl, NULL);
+	}
+	
+	else if( strequal(current_token, "p") ) //process point
+	{
+		//make a small sphere to represent the point?
+	}
+	
+	else if( strequal(current_token, "lp") ) //light point source
+	{
+		obj_light_point *o = obj_parse_light_point(growable_data);
+		o->material_index = *current_material;
+		list_add_item(&growable_data->light_point_list, o, NULL);
+	}
+	
+	else if( strequal(current_token, "ld") ) //process light disc
+	{
+		obj_light_disc *o = obj_parse_light_disc(growable_data);
+		o->material_index = *current_material;
+		list_add_item(&growable_data->light_disc_list, o, NULL);
+	}
+	
+	else if( strequal(current_token, "lq") ) //process light quad
+	{
+		obj_light_quad *o = obj_parse_light_quad(growable_data);
+		o->material_index = *current_material;
+		list_add_item(&growable_data->light_quad_list, o, NULL);
+	}
+	
+	else if( strequal(current_token, "c") ) //camera
+	{
+		growable_data->camera = (obj_camera*) malloc(sizeof(obj_camera));
+		obj_parse_camera(growable_data, growable_data->camera);
+	}
+	
+	else if( strequal(current_token, "usemtl") ) // usemtl
+	{
+		*current_material = list_find(&growable_data->material_list, strtok(NULL, WHITESPACE));
+	}
+	
+	else if( strequal(current_token, "mtllib") ) // mtllib
+	{
+		obj_resolve_path(growable_data->material_filename, growable_data->scene_filename, strtok(NULL, WHITESPACE));
+		obj_parse_mtl_file(growable_data->material_filename, &growable_data->material_list);
+	}
+	
+	else if( strequal(current_token, "o") ) //object name
+	{ }
+	else if( strequal(current_token, "s") ) //smoothing
+	{ }
+	else if( strequal(current_token, "g") ) // group
+	{ }		
+
+	else
+	{
+		printf("Unknown command '%s' in scene code at line %i: \"%s\".\n",
+				current_token, line_number, current_line);
+	}
+}
+
+// Reads a whole line however long it is; the buffer grows as needed and is reused
+char *obj_read_line(FILE *stream, char **buffer, int *size)
+{
+	int length = 0;
+
+	if(*buffer == NULL)
+	{
+		*size = OBJ_LINE_SIZE;
+		*buffer = (char*) malloc(*size);
+	}
+
+	while( fgets(*buffer + length, *size - length, stream) )
+	{
+		length += strlen(*buffer + length);
+		if(length > 0 && (*buffer)[length - 1] == '\n')
+			return *buffer;
+		if(length < *size - 1)
+			return *buffer; //last line without a newline
+		
+		*size *= 2;
+		*buffer = (char*) realloc(*buffer, *size);
+	}
+
+	return length > 0 ? *buffer : NULL;
+}
+
 int obj_parse_obj_file(obj_growable_scene_data *growable_data, const char *filename)
 {
 	FILE* obj_file_stream;
 	int current_material = -1; 
-	char *current_token = NULL;
-	char current_line[OBJ_LINE_SIZE];
+	char *current_line = NULL;
+	int line_size = 0;
 	int line_number = 0;
 	// open scene
+	strncpy(growable_data->scene_filename, filename, OBJ_FILENAME_LENGTH - 1);
 	obj_file_stream = fopen( filename, "r");
 	if(obj_file_stream == 0)
 	{
@@ -321,110 +512,13 @@ int obj_parse_obj_file(obj_growable_scene_data *growable_data, const char *filen
 
 
 	//parser loop
-	while( fgets(current_line, OBJ_LINE_SIZE, obj_file_stream) )
+	while( obj_read_line(obj_file_stream, &current_line, &line_size) )
 	{
-		current_token = strtok( current_line, " \t\n\r");
 		line_number++;
-		
-		//skip comments
-		if( current_token == NULL || current_token[0] == '#')
-			continue;
-
-		//parse objects
-		else if( strequal(current_token, "v") ) //process vertex
-		{
-			list_add_item(&growable_data->vertex_list,  obj_parse_vector(), NULL);
-		}
-		
-		else if( strequal(current_token, "vn") ) //process vertex normal
-		{
-			list_add_item(&growable_data->vertex_normal_list,  obj_parse_vector(), NULL);
-		}
-		
-		else if( strequal(current_token, "vt") ) //process vertex texture
-		{
-			list_add_item(&growable_data->vertex_texture_list,  obj_parse_vector(), NULL);
-		}
-		
-		else if( strequal(current_token, "f") ) //process face
-		{
-			obj_face *face = obj_parse_face(growable_data);
-			face->material_index = current_material;
-			list_add_item(&growable_data->face_list, face, NULL);
-		}
-		
-		else if( strequal(current_token, "sp") ) //process sphere
-		{
-			obj_sphere *sphr = obj_parse_sphere(growable_data);
-			sphr->material_index = current_material;
-			list_add_item(&growable_data->sphere_list, sphr, NULL);
-		}
-		
-		else if( strequal(current_token, "pl") ) //process plane
-		{
-			obj_plane *pl = obj_parse_plane(growable_data);
-			pl->material_index = current_material;
-			list_add_item(&growable_data->plane_list, pl, NULL);
-		}
-		
-		else if( strequal(current_token, "p") ) //process point
-		{
-			//make a small sphere to represent the point?
-		}
-		
-		else if( strequal(current_token, "lp") ) //light point source
-		{
-			obj_light_point *o = obj_parse_light_point(growable_data);
-			o->material_index = current_material;
-			list_add_item(&growable_data->light_point_list, o, NULL);
-		}
-		
-		else if( strequal(current_token, "ld") ) //process light disc
-		{
-			obj_light_disc *o = obj_parse_light_disc(growable_data);
-			o->material_index = current_material;
-			list_add_item(&growable_data->light_disc_list, o, NULL);
-		}
-		
-		else if( strequal(current_token, "lq") ) //process light quad
-		{
-			obj_light_quad *o = obj_parse_light_quad(growable_data);
-			o->material_index = current_material;
-			list_add_item(&growable_data->light_quad_list, o, NULL);
-		}
-		
-		else if( strequal(current_token, "c") ) //camera
-		{
-			growable_data->camera = (obj_camera*) malloc(sizeof(obj_camera));
-			obj_parse_camera(growable_data, growable_data->camera);
-		}
-		
-		else if( strequal(current_token, "usemtl") ) // usemtl
-		{
-			current_material = list_find(&growable_data->material_list, strtok(NULL, WHITESPACE));
-		}
-		
-		else if( strequal(current_token, "mtllib") ) // mtllib
-		{
-			strncpy(growable_data->material_filename, strtok(NULL, WHITESPACE), OBJ_FILENAME_LENGTH);
-			obj_parse_mtl_file(growable_data->material_filename, &growable_data->material_list);
-			continue;
-		}
-		
-		else if( strequal(current_token, "o") ) //object name
-		{ }
-		else if( strequal(current_token, "s") ) //smoothing
-		{ }
-		else if( strequal(current_token, "g") ) // group
-		{ }		
-
-		else
-		{
-			printf("Unknown command '%s' in scene code at line %i: \"%s\".\n",
-					current_token, line_number, current_line);
-		}
+		obj_parse_line(growable_data, current_line, line_number, &current_material);
 	}
 
+	free(current_line);
 	fclose(obj_file_stream);
 	
 	return 1;
@@ -448,15 +542,23 @@ void obj_init_temp_storage(obj_growable_scene_data *growable_data)
 	list_make(&growable_data->material_list, 10, 1);	
 	
 	growable_data->camera = NULL;
+	growable_data->scene_filename[0] = '\0';
+	growable_data->scene_filename[OBJ_FILENAME_LENGTH - 1] = '\0';
+
+	growable_data->vertex_count = 0;
+	growable_data->vertex_texture_count = 0;
+	growable_data->vertex_normal_count = 0;
+	memset(&growable_data->mesh, 0, sizeof(obj_mesh_arrays));
 }
 
 void obj_free_temp_storage(obj_growable_scene_data *growable_data)
 {
-	obj_free_half_list(&growable_data->vertex_list);
-	obj_free_half_list(&growable_data->vertex_normal_list);
-	obj_free_half_list(&growable_data->vertex_texture_list);
+	//geometry lists are converted to mesh arrays, see obj_build_mesh_arrays
+	list_free(&growable_data->vertex_list);
+	list_free(&growable_data->vertex_normal_list);
+	list_free(&growable_data->vertex_texture_list);
 	
-	obj_free_half_list(&growable_data->face_list);
+	list_free(&growable_data->face_list);
 	obj_free_half_list(&growable_data->sphere_list);
 	obj_free_half_list(&growable_data->plane_list);
 	
@@ -471,19 +573,8 @@ void delete_obj_data(obj_scene_data *data_out)
 {
 	int i;
 	
-	for(i=0; i<data_out->vertex_count; i++)
-		free(data_out->vertex_list[i]);
-	free(data_out->vertex_list);
-	for(i=0; i<data_out->vertex_normal_count; i++)
-		free(data_out->vertex_normal_list[i]);
-	free(data_out->vertex_normal_list);
-	for(i=0; i<data_out->vertex_texture_count; i++)
-		free(data_out->vertex_texture_list[i]);
-	free(data_out->vertex_texture_list);
-
-	for(i=0; i<data_out->face_count; i++)
-		free(data_out->face_list[i]);
-	free(data_out->face_list);
+	obj_mesh_arrays_free(&data_out->mesh);
+
 	for(i=0; i<data_out->sphere_count; i++)
 		free(data_out->sphere_list[i]);
 	free(data_out->sphere_list);
@@ -508,13 +599,105 @@ void delete_obj_data(obj_scene_data *data_out)
 	free(data_out->camera);
 }
 
+static size_t obj_align_size(size_t size)
+{
+	return (size + 15) & ~(size_t)15;
+}
+
+void obj_mesh_arrays_allocate(obj_mesh_arrays *mesh, int positions, int normals, int texcoords, int triangles)
+{
+	size_t positions_size = obj_align_size(sizeof(float) * 3 * positions);
+	size_t normals_size = obj_align_size(sizeof(float) * 3 * normals);
+	size_t texcoords_size = obj_align_size(sizeof(float) * 2 * texcoords);
+	size_t triangles_size = obj_align_size(sizeof(obj_index_triple) * 3 * triangles);
+	size_t materials_size = obj_align_size(sizeof(int) * triangles);
+	char *storage = (char*) malloc(positions_size + normals_size + texcoords_size + triangles_size + materials_size + 1);
+
+	mesh->storage = storage;
+	mesh->positions = (float*) storage;
+	storage += positions_size;
+	mesh->normals = (float*) storage;
+	storage += normals_size;
+	mesh->texcoords = (float*) storage;
+	storage += texcoords_size;
+	mesh->triangles = (obj_index_triple*) storage;
+	storage += triangles_size;
+	mesh->triangle_materials = (int*) storage;
+
+	mesh->position_count = positions;
+	mesh->normal_count = normals;
+	mesh->texcoord_count = texcoords;
+	mesh->triangle_count = triangles;
+}
+
+void obj_mesh_arrays_free(obj_mesh_arrays *mesh)
+{
+	free(mesh->storage);
+	memset(mesh, 0, sizeof(obj_mesh_arrays));
+}
+
+static void obj_copy_vectors(float *out, list *vectors, int components)
+{
+	for(int i=0; i<vectors->item_count; i++)
+		for(int c=0; c<components; c++)
+			*out++ = (float) ((obj_vector*) vectors->items[i])->e[c];
+}
+
+static void obj_free_list_items(list *listo)
+{
+	for(int i=0; i<listo->item_count; i++)
+		free(listo->items[i]);
+	list_delete_all(listo);
+}
+
+//Moves the v/vn/vt/f lists filled by the stdio parser to flat mesh arrays
+void obj_build_mesh_arrays(obj_growable_scene_data *growable_data)
+{
+	int triangles = 0;
+	int i, j;
+
+	for(i=0; i<growable_data->face_list.item_count; i++)
+	{
+		obj_face *face = (obj_face*) growable_data->face_list.items[i];
+		if(face->vertex_count >= 3)
+			triangles += face->vertex_count - 2;
+	}
+
+	obj_mesh_arrays *mesh = &growable_data->mesh;
+	obj_mesh_arrays_allocate(mesh, growable_data->vertex_list.item_count, growable_data->vertex_normal_list.item_count,
+		growable_data->vertex_texture_list.item_count, triangles);
+
+	obj_copy_vectors(mesh->positions, &growable_data->vertex_list, 3);
+	obj_copy_vectors(mesh->normals, &growable_data->vertex_normal_list, 3);
+	obj_copy_vectors(mesh->texcoords, &growable_data->vertex_texture_list, 2);
+
+	//faces with more than three corners are triangulated, see obj_triangulate
+	obj_triangulator triangulator;
+	obj_index_triple *corner = mesh->triangles;
+	int *material = mesh->triangle_materials;
+	obj_triangulator_init(&triangulator);
+	for(i=0; i<growable_data->face_list.item_count; i++)
+	{
+		obj_face *face = (obj_face*) growable_data->face_list.items[i];
+		if(face->vertex_count < 3)
+			continue;
+		obj_triangulate(&triangulator, mesh->positions, mesh->position_count, face->corners, face->vertex_count, corner);
+		corner += (face->vertex_count - 2) * 3;
+		for(j=0; j+2<face->vertex_count; j++)
+			*material++ = face->material_index;
+	}
+	obj_triangulator_free(&triangulator);
+
+	obj_free_list_items(&growable_data->vertex_list);
+	obj_free_list_items(&growable_data->vertex_normal_list);
+	obj_free_list_items(&growable_data->vertex_texture_list);
+	obj_free_list_items(&growable_data->face_list);
+}
+
 void obj_copy_to_out_storage(obj_scene_data *data_out, obj_growable_scene_data *growable_data)
 {
-	data_out->vertex_count = growable_data->vertex_list.item_count;
-	data_out->vertex_normal_count = growable_data->vertex_normal_list.item_count;
-	data_out->vertex_texture_count = growable_data->vertex_texture_list.item_count;
+	data_out->mesh = growable_data->mesh;
 
-	data_out->face_count = growable_data->face_list.item_count;
 	data_out->sphere_count = growable_data->sphere_list.item_count;
 	data_out->plane_count = growable_data->plane_list.item_count;
 
@@ -524,11 +707,6 @@ void obj_copy_to_out_storage(obj_scene_data *data_out, obj_growable_scene_data *
 
 	data_out->material_count = growable_data->material_list.item_count;
 	
-	data_out->vertex_list = (obj_vector**)growable_data->vertex_list.items;
-	data_out->vertex_normal_list = (obj_vector**)growable_data->vertex_normal_list.items;
-	data_out->vertex_texture_list = (obj_vector**)growable_data->vertex_texture_list.items;
-
-	data_out->face_list = (obj_face**)growable_data->face_list.items;
 	data_out->sphere_list = (obj_sphere**)growable_data->sphere_list.items;
 	data_out->plane_list = (obj_plane**)growable_data->plane_list.items;
 
@@ -545,9 +723,23 @@ int parse_obj_scene(obj_scene_data *data_out, const char *filename)
 {
 	obj_growable_scene_data growable_data;
 
+	obj_init_temp_storage(&growable_data);
+	if( obj_parse_mapped_obj_file(&growable_data, filename) == 0)
+		return 0;
+
+	obj_copy_to_out_storage(data_out, &growable_data);
+	obj_free_temp_storage(&growable_data);
+	return 1;
+}
+
+int parse_obj_scene_stdio(obj_scene_data *data_out, const char *filename)
+{
+	obj_growable_scene_data growable_data;
+
 	obj_init_temp_storage(&growable_data);
 	if( obj_parse_obj_file(&growable_data, filename) == 0)
 		return 0;
+	obj_build_mesh_arrays(&growable_data);
 	
 	//print_vector(NORMAL, "Max bounds are: ", &growable_data->extreme_dimensions[1]);
 	//print_vector(NORMAL, "Min bounds are: ", &growable_data->extreme_dimensions[0]);
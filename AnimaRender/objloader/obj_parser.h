@@ -6,16 +6,7 @@
 #define OBJ_FILENAME_LENGTH 500
 #define MATERIAL_NAME_SIZE 255
 #define OBJ_LINE_SIZE 500
-#define MAX_VERTEX_COUNT 4 //can only handle quads or triangles
-
-typedef struct obj_face
-{
-	int vertex_index[MAX_VERTEX_COUNT];
-	int normal_index[MAX_VERTEX_COUNT];
-	int texture_index[MAX_VERTEX_COUNT];
-	int vertex_count;
-	int material_index;
-};
+#define MAX_VERTEX_COUNT 4 //corners of spheres, planes and quad lights; faces have any number
 
 typedef struct obj_sphere
 {
@@ -40,6 +31,39 @@ typedef struct obj_vector
 	double e[3];
 };
 
+typedef struct obj_index_triple
+{
+	int vertex_index;
+	int texture_index;
+	int normal_index;
+};
+
+// A polygon of the stdio parser, allocated with room for vertex_count corners
+typedef struct obj_face
+{
+	int vertex_count;
+	int material_index;
+	obj_index_triple corners[1];
+};
+
+// Flat structure-of-arrays copy of the geometry, every array lives in one
+// block (storage) so there is a single allocation per mesh.
+typedef struct obj_mesh_arrays
+{
+	float *positions; // x y z for every v
+	float *normals; // x y z for every vn
+	float *texcoords; // u v for every vt
+	obj_index_triple *triangles; // three corners for every triangle
+	int *triangle_materials; // material_index of every triangle
+
+	int position_count;
+	int normal_count;
+	int texcoord_count;
+	int triangle_count;
+
+	void *storage;
+};
+
 typedef struct obj_material
 {
 	char name[MATERIAL_NAME_SIZE];
@@ -102,15 +126,19 @@ typedef struct obj_growable_scene_data
 	list material_list;
 	
 	obj_camera *camera;
+
+	// v/vt/vn read so far, relative indices are resolved against these
+	int vertex_count;
+	int vertex_texture_count;
+	int vertex_normal_count;
+
+	obj_mesh_arrays mesh;
 };
 
 typedef struct obj_scene_data
 {
-	obj_vector **vertex_list;
-	obj_vector **vertex_normal_list;
-	obj_vector **vertex_texture_list;
-	
-	obj_face **face_list;
+	obj_mesh_arrays mesh;
+
 	obj_sphere **sphere_list;
 	obj_plane **plane_list;
 	
@@ -120,11 +148,6 @@ typedef struct obj_scene_data
 	
 	obj_material **material_list;
 	
-	int vertex_count;
-	int vertex_normal_count;
-	int vertex_texture_count;
-
-	int face_count;
 	int sphere_count;
 	int plane_count;
 
@@ -138,6 +161,19 @@ typedef struct obj_scene_data
 };
 
 int parse_obj_scene(obj_scene_data *data_out, const char *filename);
+int parse_obj_scene_stdio(obj_scene_data *data_out, const char *filename);
 void delete_obj_data(obj_scene_data *data_out);
 
+// shared with the memory-mapped parser
+void obj_init_temp_storage(obj_growable_scene_data *growable_data);
+void obj_free_temp_storage(obj_growable_scene_data *growable_data);
+void obj_copy_to_out_storage(obj_scene_data *data_out, obj_growable_scene_data *growable_data);
+int obj_convert_to_list_index(int current_max, int index);
+void obj_mesh_arrays_allocate(obj_mesh_arrays *mesh, int positions, int normals, int texcoords, int triangles);
+void obj_mesh_arrays_free(obj_mesh_arrays *mesh);
+void obj_parse_line(obj_growable_scene_data *growable_data, char *current_line, int line_number, int *current_material);
+int obj_parse_mtl_file(const char *filename, list *material_list);
+// filename relative to the directory of base_filename, OBJ_FILENAME_LENGTH bytes at most
+void obj_resolve_path(char *out, const char *base_filename, const char *filename);
+
 #endif
@@ -0,0 +1,316 @@
+#include "obj_stream_reader.h"
+#include "obj_tokenizer.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <boost/filesystem.hpp>
+
+static void obj_stream_attribute_init(obj_stream_attribute *attribute, int components)
+{
+	attribute->components = components;
+	attribute->blocks.clear();
+	attribute->tail.clear();
+	attribute->spill = 1;
+}
+
+static std::string obj_stream_block_name(const obj_stream_reader *reader, const obj_stream_attribute *attribute, size_t block)
+{
+	const char *name = attribute == &reader->positions ? "v" : attribute == &reader->normals ? "vn" : "vt";
+	return reader->scratch_name + "." + name + "." + std::to_string((unsigned long long) block);
+}
+
+static void obj_stream_attribute_free(obj_stream_reader *reader, obj_stream_attribute *attribute)
+{
+	for (size_t b = 0; b < attribute->blocks.size(); b++)
+	{
+		unmap_file(&attribute->blocks[b]);
+		remove(obj_stream_block_name(reader, attribute, b).c_str());
+	}
+	std::vector<mapped_file>().swap(attribute->blocks);
+	std::vector<float>().swap(attribute->tail);
+}
+
+// Moves a full tail to the next scratch file and maps it back.
+static void obj_stream_spill(obj_stream_reader *reader, obj_stream_attribute *attribute)
+{
+	size_t length = (size_t) OBJ_STREAM_SPILL_ITEMS * attribute->components;
+	if (!attribute->spill || attribute->tail.size() < length)
+		return;
+
+	std::string block_name = obj_stream_block_name(reader, attribute, attribute->blocks.size());
+	FILE *f = fopen(block_name.c_str(), "wb");
+	int ok = f != NULL && fwrite(&attribute->tail[0], sizeof(float), length, f) == length;
+	if (f != NULL && fclose(f) != 0)
+		ok = 0;
+
+	mapped_file block;
+	int mapped = ok && map_file(&block, block_name.c_str());
+	if (mapped && block.size == length * sizeof(float))
+	{
+		attribute->blocks.push_back(block);
+		attribute->tail.clear();
+		return;
+	}
+	if (mapped)
+		unmap_file(&block);
+	remove(block_name.c_str());
+	fprintf(stderr, "%s: unable to write %s, the vertices stay in memory\n", reader->filename, block_name.c_str());
+	attribute->spill = 0;
+}
+
+int obj_stream_count(const obj_stream_attribute *attribute)
+{
+	return (int) (attribute->blocks.size() * OBJ_STREAM_SPILL_ITEMS + attribute->tail.size() / attribute->components);
+}
+
+const float *obj_stream_item(const obj_stream_attribute *attribute, int index)
+{
+	size_t block = (size_t) index / OBJ_STREAM_SPILL_ITEMS;
+	if (block < attribute->blocks.size())
+		return (const float *) attribute->blocks[block].data + (size_t) (index % OBJ_STREAM_SPILL_ITEMS) * attribute->components;
+	return &attribute->tail[((size_t) index - attribute->blocks.size() * OBJ_STREAM_SPILL_ITEMS) * attribute->components];
+}
+
+int obj_stream_open(obj_stream_reader *reader, const char *filename)
+{
+	reader->file = fopen(filename, "rb");
+	if (reader->file == NULL)
+	{
+		fprintf(stderr, "Error reading file: %s\n", filename);
+		return 0;
+	}
+
+	strncpy(reader->filename, filename, OBJ_FILENAME_LENGTH - 1);
+	reader->filename[OBJ_FILENAME_LENGTH - 1] = '\0';
+	reader->buffer_size = OBJ_STREAM_READ_SIZE;
+	reader->buffer = (char*) malloc(reader->buffer_size);
+	reader->begin = reader->end = 0;
+	reader->consumed = 0;
+	reader->eof = 0;
+	reader->current_material = -1;
+	boost::filesystem::path scratch = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("anima-%%%%-%%%%-%%%%");
+	reader->scratch_name = scratch.string();
+	obj_stream_attribute_init(&reader->positions, 3);
+	obj_stream_attribute_init(&reader->normals, 3);
+	obj_stream_attribute_init(&reader->texcoords, 2);
+	list_make(&reader->material_list, 10, 1);
+	obj_triangulator_init(&reader->triangulator);
+	return 1;
+}
+
+void obj_stream_close(obj_stream_reader *reader)
+{
+	int i;
+
+	if (reader->file != NULL)
+		fclose(reader->file);
+	reader->file = NULL;
+	free(reader->buffer);
+	reader->buffer = NULL;
+
+	for (i = 0; i < reader->material_list.item_count; i++)
+		free(reader->material_list.items[i]);
+	list_free(&reader->material_list);
+	obj_triangulator_free(&reader->triangulator);
+
+	obj_stream_attribute_free(reader, &reader->positions);
+	obj_stream_attribute_free(reader, &reader->normals);
+	obj_stream_attribute_free(reader, &reader->texcoords);
+}
+
+long long obj_stream_position(const obj_stream_reader *reader)
+{
+	return reader->consumed;
+}
+
+// Finds the next complete line, refilling (and if needed growing) the
+// buffer. The line is [*line, *eol); returns 0 at the end of the file.
+static int obj_stream_peek_line(obj_stream_reader *reader, const char **line, const char **eol)
+{
+	while (1)
+	{
+		const char *begin = reader->buffer + reader->begin;
+		const char *end = reader->buffer + reader->end;
+		const char *newline = obj_find_eol(begin, end);
+
+		if (newline < end || (reader->eof && begin < end))
+		{
+			*line = begin;
+			*eol = newline;
+			return 1;
+		}
+		if (reader->eof)
+			return 0;
+
+		// keep the partial line at the front and read behind it
+		size_t partial = reader->end - reader->begin;
+		memmove(reader->buffer, reader->buffer + reader->begin, partial);
+		reader->begin = 0;
+		reader->end = partial;
+		if (partial == reader->buffer_size)
+		{
+			reader->buffer_size *= 2;
+			reader->buffer = (char*) realloc(reader->buffer, reader->buffer_size);
+		}
+
+		size_t read = fread(reader->buffer + reader->end, 1, reader->buffer_size - reader->end, reader->file);
+		reader->end += read;
+		if (read == 0)
+			reader->eof = 1;
+	}
+}
+
+static void obj_stream_skip_line(obj_stream_reader *reader, const char *eol)
+{
+	size_t next = eol - reader->buffer;
+	if (next < reader->end)
+		next++;
+	reader->consumed += next - reader->begin;
+	reader->begin = next;
+}
+
+static void obj_stream_scan_floats(obj_stream_reader *reader, const char *p, const char *end, obj_stream_attribute *attribute)
+{
+	double value;
+
+	for (int i = 0; i < attribute->components; i++)
+	{
+		p = obj_skip_space(p, end);
+		if (p == end)
+			attribute->tail.push_back(0.0f);
+		else
+		{
+			p = obj_parse_double(p, end, &value);
+			attribute->tail.push_back((float) value);
+		}
+	}
+	obj_stream_spill(reader, attribute);
+}
+
+// Triangulates the polygon on the positions of its own corners, gathered from wherever they are stored.
+static void obj_stream_triangulate(obj_stream_reader *reader, obj_index_triple *triangles)
+{
+	int corner_count = (int) reader->polygon.size();
+	int position_count = obj_stream_count(&reader->positions);
+	if (corner_count == 3)
+	{
+		obj_triangulate(&reader->triangulator, NULL, 0, &reader->polygon[0], corner_count, triangles);
+		return;
+	}
+
+	//corners outside the positions read so far make the whole polygon a fan, as obj_triangulate does
+	bool valid = true;
+	reader->local_polygon.assign(reader->polygon.begin(), reader->polygon.end());
+	reader->polygon_positions.resize(corner_count * 3);
+	for (int i = 0; i < corner_count; i++)
+	{
+		int index = reader->polygon[i].vertex_index;
+		if (index < 0 || index >= position_count)
+			valid = false;
+		else
+			memcpy(&reader->polygon_positions[i * 3], obj_stream_item(&reader->positions, index), 3 * sizeof(float));
+		reader->local_polygon[i].vertex_index = i;
+	}
+
+	obj_triangulate(&reader->triangulator, &reader->polygon_positions[0], valid ? corner_count : 0,
+		&reader->local_polygon[0], corner_count, triangles);
+	for (int i = 0; i < (corner_count - 2) * 3; i++)
+		triangles[i].vertex_index = reader->polygon[triangles[i].vertex_index].vertex_index;
+}
+
+static void obj_stream_scan_face(obj_stream_reader *reader, const char *p, const char *end)
+{
+	int position_count = obj_stream_count(&reader->positions);
+	int texture_count = obj_stream_count(&reader->texcoords);
+	int normal_count = obj_stream_count(&reader->normals);
+
+	reader->polygon.clear();
+	while ((p = obj_skip_space(p, end)) < end)
+	{
+		obj_index_triple corner = { 0, 0, 0 };
+
+		p = obj_parse_int(p, end, &corner.vertex_index);
+		if (p < end && *p == '/')
+		{
+			p++;
+			if (p < end && *p != '/')
+				p = obj_parse_int(p, end, &corner.texture_index);
+			if (p < end && *p == '/')
+				p = obj_parse_int(p + 1, end, &corner.normal_index);
+		}
+		p = obj_skip_token(p, end);
+
+		corner.vertex_index = obj_convert_to_list_index(position_count, corner.vertex_index);
+		corner.texture_index = obj_convert_to_list_index(texture_count, corner.texture_index);
+		corner.normal_index = obj_convert_to_list_index(normal_count, corner.normal_index);
+		reader->polygon.push_back(corner);
+	}
+}
+
+int obj_stream_read(obj_stream_reader *reader, std::vector<obj_index_triple> &corners, int max_triangles, int *material)
+{
+	const char *line, *eol;
+	int triangles = 0;
+
+	*material = reader->current_material;
+
+	while (obj_stream_peek_line(reader, &line, &eol))
+	{
+		const char *token = obj_skip_space(line, eol);
+		const char *token_end = obj_skip_token(token, eol);
+		size_t token_length = token_end - token;
+
+		if (token_length == 1 && token[0] == 'v')
+			obj_stream_scan_floats(reader, token_end, eol, &reader->positions);
+		else if (token_length == 2 && token[0] == 'v' && token[1] == 'n')
+			obj_stream_scan_floats(reader, token_end, eol, &reader->normals);
+		else if (token_length == 2 && token[0] == 'v' && token[1] == 't')
+			obj_stream_scan_floats(reader, token_end, eol, &reader->texcoords);
+		else if (token_length == 1 && token[0] == 'f')
+		{
+			obj_stream_scan_face(reader, token_end, eol);
+			int corner_count = (int) reader->polygon.size();
+
+			//the face is left for the next batch: the line is read again
+			if (corner_count >= 3 && triangles > 0 && triangles + corner_count - 2 > max_triangles)
+				return triangles;
+
+			if (corner_count - 2 > max_triangles)
+				fprintf(stderr, "%s: face of %d corners dropped\n", reader->filename, corner_count);
+			else if (corner_count >= 3)
+			{
+				size_t first = corners.size();
+				corners.resize(first + (corner_count - 2) * 3);
+				obj_stream_triangulate(reader, &corners[first]);
+				triangles += corner_count - 2;
+			}
+		}
+		else if (token_length == 6 && strncmp(token, "usemtl", 6) == 0)
+		{
+			const char *name = obj_skip_space(token_end, eol);
+			std::string material_name(name, obj_skip_token(name, eol));
+			int next_material = list_find(&reader->material_list, (char*) material_name.c_str());
+
+			if (next_material != reader->current_material && triangles > 0)
+				return triangles;
+			reader->current_material = next_material;
+			*material = next_material;
+		}
+		else if (token_length == 6 && strncmp(token, "mtllib", 6) == 0)
+		{
+			char material_filename[OBJ_FILENAME_LENGTH];
+			const char *name = obj_skip_space(token_end, eol);
+			std::string relative(name, obj_skip_token(name, eol));
+
+			obj_resolve_path(material_filename, reader->filename, relative.c_str());
+			obj_parse_mtl_file(material_filename, &reader->material_list);
+		}
+
+		obj_stream_skip_line(reader, eol);
+		if (triangles >= max_triangles)
+			break;
+	}
+
+	return triangles;
+}
@@ -0,0 +1,83 @@
+#ifndef OBJ_STREAM_READER_H
+#define OBJ_STREAM_READER_H
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include "obj_parser.h"
+#include "obj_triangulate.h"
+#include "list.h"
+#include "../utils/mapped_file.h"
+
+#define OBJ_STREAM_READ_SIZE (4 << 20)
+// v, vt and vn lines are moved out of memory this many at a time (see obj_stream_attribute).
+#define OBJ_STREAM_SPILL_ITEMS (1 << 20)
+
+/*
+ * Sequential reader for OBJ files too big to be parsed in one go. The file
+ * is read OBJ_STREAM_READ_SIZE bytes at a time and its faces come out as
+ * batches of triangles, so neither the text nor the whole triangle list is
+ * ever resident. Faces may reference any v/vt/vn before them, so those are
+ * kept in binary form for the whole read, but only the last
+ * OBJ_STREAM_SPILL_ITEMS of each live on the heap: every full block is
+ * written to a scratch file in the temporary directory and mapped back. Its
+ * pages are backed by the file, so the system can drop the ones the faces
+ * no longer touch and the memory used stays bounded whatever the size of the
+ * file. If a scratch file cannot be written the attribute stays in memory.
+ * Only v, vt, vn, f, usemtl and mtllib are understood, everything else is
+ * skipped.
+ */
+
+// The items of a v, vt or vn array: full blocks in mapped scratch files, the rest in tail.
+typedef struct
+{
+	int components;
+	std::vector<mapped_file> blocks; // OBJ_STREAM_SPILL_ITEMS items each
+	std::vector<float> tail;
+	int spill; // 0 once writing a block failed
+} obj_stream_attribute;
+
+typedef struct
+{
+	FILE *file;
+	char filename[OBJ_FILENAME_LENGTH];
+	char *buffer;
+	size_t buffer_size;
+	size_t begin, end; // unread bytes in buffer
+	long long consumed;
+	int eof;
+
+	std::string scratch_name; // the scratch files are scratch_name.<attribute>.<block>
+	obj_stream_attribute positions;
+	obj_stream_attribute normals;
+	obj_stream_attribute texcoords;
+
+	list material_list; // obj_material, looked up by usemtl
+	int current_material;
+
+	std::vector<obj_index_triple> polygon;
+	std::vector<obj_index_triple> local_polygon;
+	std::vector<float> polygon_positions;
+	obj_triangulator triangulator;
+} obj_stream_reader;
+
+int obj_stream_open(obj_stream_reader *reader, const char *filename);
+void obj_stream_close(obj_stream_reader *reader);
+
+/*
+ * Appends to corners the next triangles of the file, three corners each,
+ * up to max_triangles; a batch also ends where the material changes, so
+ * all its triangles have *material. A face is never split across batches,
+ * faces bigger than a batch are dropped. Returns the number of triangles,
+ * 0 at the end of the file.
+ */
+int obj_stream_read(obj_stream_reader *reader, std::vector<obj_index_triple> &corners, int max_triangles, int *material);
+
+// Items read so far and the components of one of them; index must be below the count.
+int obj_stream_count(const obj_stream_attribute *attribute);
+const float *obj_stream_item(const obj_stream_attribute *attribute, int index);
+
+// Bytes consumed so far, for progress reports.
+long long obj_stream_position(const obj_stream_reader *reader);
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef OBJ_TOKENIZER_H
+#define OBJ_TOKENIZER_H
+
+/*
+ * Hand-written scanner primitives used by the memory-mapped OBJ parser.
+ * Every function works on a [p, end) range and never reads past end,
+ * so no terminating '\0' is needed.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define OBJ_TOKENIZER_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#define OBJ_MAX_FAST_MANTISSA 9007199254740992ULL // 2^53
+
+static inline int obj_is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline int obj_is_digit(char c)
+{
+	return (unsigned char)(c - '0') < 10;
+}
+
+#ifdef OBJ_TOKENIZER_SSE2
+static inline int obj_first_bit(int mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int) index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// Returns the position of the next '\n' in [p, end), or end.
+static inline const char *obj_find_eol(const char *p, const char *end)
+{
+#ifdef OBJ_TOKENIZER_SSE2
+	const __m128i newline = _mm_set1_epi8('\n');
+	while (end - p >= 16)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i *) p);
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+		if (mask != 0)
+			return p + obj_first_bit(mask);
+		p += 16;
+	}
+#endif
+	while (p < end && *p != '\n')
+		p++;
+	return p;
+}
+
+static inline const char *obj_skip_space(const char *p, const char *end)
+{
+	while (p < end && obj_is_space(*p))
+		p++;
+	return p;
+}
+
+static inline const char *obj_skip_token(const char *p, const char *end)
+{
+	while (p < end && !obj_is_space(*p))
+		p++;
+	return p;
+}
+
+// atoi() without the locale and the '\0' requirement.
+static inline const char *obj_parse_int(const char *p, const char *end, int *out)
+{
+	int negative = 0;
+	int value = 0;
+
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		p++;
+	}
+	while (p < end && obj_is_digit(*p))
+	{
+		value = value * 10 + (*p - '0');
+		p++;
+	}
+
+	*out = negative ? -value : value;
+	return p;
+}
+
+// Slow path for the float parser: copy the token and let the CRT handle it.
+static inline double obj_parse_double_fallback(const char *token, const char *end)
+{
+	char buffer[64];
+	size_t length = obj_skip_token(token, end) - token;
+
+	if (length >= sizeof(buffer))
+		length = sizeof(buffer) - 1;
+	memcpy(buffer, token, length);
+	buffer[length] = '\0';
+	return atof(buffer);
+}
+
+/*
+ * Locale-free decimal parser. Whenever the significand fits in 53 bits and the
+ * decimal exponent is within 10^22 (Clinger's fast path), a single IEEE
+ * multiply or divide gives the correctly rounded result, i.e. exactly what
+ * atof() returns. Anything else (very long mantissas, huge exponents, inf,
+ * nan, hex) goes through the fallback.
+ * Returns a pointer past the token.
+ */
+static inline const char *obj_parse_double(const char *p, const char *end, double *out)
+{
+	static const double powers_of_ten[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	const char *token = p;
+	unsigned long long mantissa = 0;
+	int significant_digits = 0;
+	int any_digit = 0;
+	int exponent = 0;
+	int negative = 0;
+	int truncated = 0;
+
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		p++;
+	}
+
+	while (p < end && obj_is_digit(*p))
+	{
+		any_digit = 1;
+		if (significant_digits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0)
+				significant_digits++;
+		}
+		else
+			truncated = 1;
+		p++;
+	}
+
+	if (p < end && *p == '.')
+	{
+		p++;
+		while (p < end && obj_is_digit(*p))
+		{
+			any_digit = 1;
+			if (significant_digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0)
+					significant_digits++;
+				exponent--;
+			}
+			else
+				truncated = 1;
+			p++;
+		}
+	}
+
+	if (!any_digit)
+	{
+		*out = obj_parse_double_fallback(token, end);
+		return obj_skip_token(p, end);
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		int exp_value;
+		const char *exp_start = p + 1;
+		if (exp_start < end && (obj_is_digit(*exp_start) ||
+			((*exp_start == '-' || *exp_start == '+') && exp_start + 1 < end && obj_is_digit(exp_start[1]))))
+		{
+			p = obj_parse_int(exp_start, end, &exp_value);
+			exponent += exp_value;
+		}
+	}
+
+	if (truncated || mantissa > OBJ_MAX_FAST_MANTISSA || exponent < -22 || exponent > 22)
+	{
+		*out = obj_parse_double_fallback(token, end);
+		return obj_skip_token(p, end);
+	}
+
+	double value = (double) mantissa;
+	if (exponent < 0)
+		value /= powers_of_ten[-exponent];
+	else
+		value *= powers_of_ten[exponent];
+
+	*out = negative ? -value : value;
+	return obj_skip_token(p, end);
+}
+
+#endif
@@ -0,0 +1,179 @@
+#include "obj_triangulate.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+void obj_triangulator_init(obj_triangulator *triangulator)
+{
+	triangulator->points = NULL;
+	triangulator->next = NULL;
+	triangulator->prev = NULL;
+	triangulator->capacity = 0;
+}
+
+void obj_triangulator_free(obj_triangulator *triangulator)
+{
+	free(triangulator->points);
+	free(triangulator->next);
+	free(triangulator->prev);
+	obj_triangulator_init(triangulator);
+}
+
+static int obj_triangulator_reserve(obj_triangulator *triangulator, int corner_count)
+{
+	int capacity = triangulator->capacity > 0 ? triangulator->capacity : 16;
+
+	if (corner_count <= triangulator->capacity)
+		return 1;
+	while (capacity < corner_count)
+		capacity *= 2;
+
+	float *points = (float*) realloc(triangulator->points, sizeof(float) * 2 * capacity);
+	if (points != NULL)
+		triangulator->points = points;
+	int *next = (int*) realloc(triangulator->next, sizeof(int) * capacity);
+	if (next != NULL)
+		triangulator->next = next;
+	int *prev = (int*) realloc(triangulator->prev, sizeof(int) * capacity);
+	if (prev != NULL)
+		triangulator->prev = prev;
+	if (points == NULL || next == NULL || prev == NULL)
+		return 0;
+
+	triangulator->capacity = capacity;
+	return 1;
+}
+
+static void obj_emit_triangle(obj_index_triple **out, const obj_index_triple *corners, int a, int b, int c)
+{
+	(*out)[0] = corners[a];
+	(*out)[1] = corners[b];
+	(*out)[2] = corners[c];
+	*out += 3;
+}
+
+static void obj_triangulate_fan(const obj_index_triple *corners, int corner_count, obj_index_triple *triangles)
+{
+	for (int i = 1; i + 1 < corner_count; i++)
+		obj_emit_triangle(&triangles, corners, 0, i, i + 1);
+}
+
+// twice the signed area of abc, positive when counterclockwise
+static float obj_cross(const float *points, int a, int b, int c)
+{
+	const float *pa = &points[a * 2], *pb = &points[b * 2], *pc = &points[c * 2];
+	return (pb[0] - pa[0]) * (pc[1] - pa[1]) - (pb[1] - pa[1]) * (pc[0] - pa[0]);
+}
+
+// no remaining corner lies inside the triangle prev, i, next (corners on the
+// edges count as inside, corners at the same place as the triangle's do not)
+static int obj_is_ear(const obj_triangulator *triangulator, int prev, int i, int next)
+{
+	const float *points = triangulator->points;
+
+	if (obj_cross(points, prev, i, next) <= 0.0f)
+		return 0;
+
+	for (int j = triangulator->next[next]; j != prev; j = triangulator->next[j])
+	{
+		const float *p = &points[j * 2];
+		if ((p[0] == points[prev * 2] && p[1] == points[prev * 2 + 1]) ||
+			(p[0] == points[i * 2] && p[1] == points[i * 2 + 1]) ||
+			(p[0] == points[next * 2] && p[1] == points[next * 2 + 1]))
+			continue;
+
+		if (obj_cross(points, prev, i, j) >= 0.0f && obj_cross(points, i, next, j) >= 0.0f &&
+			obj_cross(points, next, prev, j) >= 0.0f)
+			return 0;
+	}
+	return 1;
+}
+
+void obj_triangulate(obj_triangulator *triangulator, const float *positions, int position_count,
+	const obj_index_triple *corners, int corner_count, obj_index_triple *triangles)
+{
+	int i;
+
+	if (corner_count == 3 || !obj_triangulator_reserve(triangulator, corner_count))
+	{
+		obj_triangulate_fan(corners, corner_count, triangles);
+		return;
+	}
+	for (i = 0; i < corner_count; i++)
+	{
+		if (corners[i].vertex_index < 0 || corners[i].vertex_index >= position_count)
+		{
+			obj_triangulate_fan(corners, corner_count, triangles);
+			return;
+		}
+	}
+
+	// Newell normal; the polygon is projected dropping its largest axis
+	double normal[3] = { 0.0, 0.0, 0.0 };
+	for (i = 0; i < corner_count; i++)
+	{
+		const float *a = &positions[3 * corners[i].vertex_index];
+		const float *b = &positions[3 * corners[(i + 1) % corner_count].vertex_index];
+		normal[0] += (double) (a[1] - b[1]) * (a[2] + b[2]);
+		normal[1] += (double) (a[2] - b[2]) * (a[0] + b[0]);
+		normal[2] += (double) (a[0] - b[0]) * (a[1] + b[1]);
+	}
+	int axis = 2;
+	if (fabs(normal[0]) > fabs(normal[1]) && fabs(normal[0]) > fabs(normal[2]))
+		axis = 0;
+	else if (fabs(normal[1]) > fabs(normal[2]))
+		axis = 1;
+
+	// u, v chosen so that the projected polygon is counterclockwise
+	int u = (axis + 1) % 3, v = (axis + 2) % 3;
+	if (normal[axis] < 0.0)
+	{
+		int swap = u;
+		u = v;
+		v = swap;
+	}
+
+	float *points = triangulator->points;
+	for (i = 0; i < corner_count; i++)
+	{
+		const float *p = &positions[3 * corners[i].vertex_index];
+		points[i * 2] = p[u];
+		points[i * 2 + 1] = p[v];
+		triangulator->next[i] = (i + 1) % corner_count;
+		triangulator->prev[i] = (i + corner_count - 1) % corner_count;
+	}
+
+	int convex = 1;
+	for (i = 0; i < corner_count && convex; i++)
+		convex = obj_cross(points, triangulator->prev[i], i, triangulator->next[i]) >= 0.0f;
+	if (convex)
+	{
+		obj_triangulate_fan(corners, corner_count, triangles);
+		return;
+	}
+
+	int remaining = corner_count;
+	int attempts = 0;
+	i = 0;
+	while (remaining > 3)
+	{
+		int prev = triangulator->prev[i];
+		int next = triangulator->next[i];
+
+		// after a full turn without ears the polygon is degenerate: clip anyway
+		if (attempts < remaining && !obj_is_ear(triangulator, prev, i, next))
+		{
+			attempts++;
+			i = next;
+			continue;
+		}
+
+		obj_emit_triangle(&triangles, corners, prev, i, next);
+		triangulator->next[prev] = next;
+		triangulator->prev[next] = prev;
+		remaining--;
+		attempts = 0;
+		i = next;
+	}
+	obj_emit_triangle(&triangles, corners, triangulator->prev[i], i, triangulator->next[i]);
+}
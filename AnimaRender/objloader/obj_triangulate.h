@@ -0,0 +1,34 @@
+#ifndef OBJ_TRIANGULATE_H
+#define OBJ_TRIANGULATE_H
+
+#include "obj_parser.h"
+
+/*
+ * Triangulation of OBJ faces. A polygon of n corners always becomes n - 2
+ * triangles with the winding of the face: a fan from the first corner when
+ * the polygon is convex, ear clipping in the plane of the polygon (Newell
+ * normal) otherwise. Self-intersecting or degenerate polygons still get
+ * n - 2 triangles, the next corner is clipped when no ear is left.
+ *
+ * The working arrays live in an obj_triangulator that only grows, so a
+ * whole file is triangulated without an allocation per face.
+ */
+typedef struct
+{
+	float *points; // 2 per corner, projected on the polygon plane
+	int *next;
+	int *prev;
+	int capacity;
+} obj_triangulator;
+
+void obj_triangulator_init(obj_triangulator *triangulator);
+void obj_triangulator_free(obj_triangulator *triangulator);
+
+/*
+ * Writes (corner_count - 2) * 3 corners to triangles. Corners whose vertex
+ * index is outside [0, position_count) make the polygon fall back to a fan.
+ */
+void obj_triangulate(obj_triangulator *triangulator, const float *positions, int position_count,
+	const obj_index_triple *corners, int corner_count, obj_index_triple *triangles);
+
+#endif
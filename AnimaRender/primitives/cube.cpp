@@ -47,7 +47,7 @@ static const glm::vec2 box_st_buffer_data[] = {
 
 
 
-void make_cube(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &stCoordinates, std::vector<GLushort> &elements)
+void make_cube(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &stCoordinates, std::vector<GLuint> &elements)
 {
 	for (size_t i = 0; i < 8; i++)
 	{
@@ -4,4 +4,4 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
-void make_cube(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &stCoordinates, std::vector<GLushort> &elements);
\ No newline at end of file
+void make_cube(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &stCoordinates, std::vector<GLuint> &elements);
\ No newline at end of file
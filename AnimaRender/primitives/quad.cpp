@@ -20,7 +20,7 @@ glm::vec2 quad_st[] = {
 
 GLushort quad_elements[] = { 0, 1, 2, 0, 2, 3 };
 
-void make_quad(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &stCoordinates, std::vector<GLushort> &elements)
+void make_quad(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &stCoordinates, std::vector<GLuint> &elements)
 {
 	for (size_t i = 0; i < 4; i++)
 	{
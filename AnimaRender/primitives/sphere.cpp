@@ -3,7 +3,7 @@
 
 #include <boost\math\constants\constants.hpp>
 
-void make_sphere(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &stCoordinates, std::vector<GLushort> &elements, int rings, int sectors)
+void make_sphere(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &stCoordinates, std::vector<GLuint> &elements, int rings, int sectors)
 {
 	int radius = 1;
 
@@ -30,7 +30,7 @@ void make_sphere(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &norma
 	}
 
 	elements.resize(rings * sectors * 6);
-	std::vector<GLushort>::iterator i = elements.begin();
+	std::vector<GLuint>::iterator i = elements.begin();
 	for (r = 0; r < rings - 1; r++) for (s = 0; s < sectors - 1; s++) {
 		*i++ = r * sectors + s; //0		
 		*i++ = (r + 1) * sectors + (s + 1); //2
@@ -5,4 +5,4 @@
 
 #include <glm/glm.hpp>
 
-void make_sphere(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &stCoordinates, std::vector<GLushort> &elements, int rings, int sectors);
\ No newline at end of file
+void make_sphere(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &stCoordinates, std::vector<GLuint> &elements, int rings, int sectors);
\ No newline at end of file
@@ -1,7 +1,7 @@
 #include "tesselated_sphere.h"
 
 
-void addTriangle(std::vector<GLushort> &elements, GLuint i_v0, GLuint i_v1, GLuint i_v2)
+void addTriangle(std::vector<GLuint> &elements, GLuint i_v0, GLuint i_v1, GLuint i_v2)
 {
 	elements.push_back(i_v0);
 	elements.push_back(i_v1);
@@ -23,7 +23,7 @@ GLuint addMidPoint(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &nor
 	return (vertices.size() - 1);
 }
 
-void subdivide(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<GLushort> &elements, int i, GLuint i_v0, GLuint i_v1, GLuint i_v2)
+void subdivide(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<GLuint> &elements, int i, GLuint i_v0, GLuint i_v1, GLuint i_v2)
 {
 	//vertex 0
 	glm::vec3 v0 = vertices[i_v0];
@@ -67,7 +67,7 @@ static const GLuint g_element_buffer_data[] = {
 };
 
 //code taken from: https://bitbucket.org/rranon/grafica3d-interattiva/src/6e38e0cf314b9c95b36e74734ef130591b879abb/drawing-geometry/sphere.cpp?at=default
-void make_tesselated_sphere(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &stCoordinates, std::vector<GLushort> &elements, int tesselation_level)
+void make_tesselated_sphere(std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &stCoordinates, std::vector<GLuint> &elements, int tesselation_level)
 {
 	//populate initial icosahedron
 	for (int i = 0; i < 6; i++)
@@ -254,4 +254,29 @@ int Camera::make_resources()
 	if(textureUniformLocation == -1)
 		return 0;
 	return 1;
-}
\ No newline at end of file
+}
+//Legge la vista impostata da gluLookAt, la proiezione e il viewport una volta per frame:
+//gli oggetti compongono le loro matrici sulla cpu invece di chiederle al driver
+void Camera::beginFrame()
+{
+	glGetFloatv(GL_MODELVIEW_MATRIX, viewMatrix);
+	glGetFloatv(GL_PROJECTION_MATRIX, projectionMatrix);
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	viewportHeight = viewport[3];
+}
+
+const GLfloat *Camera::getViewMatrix()
+{
+	return viewMatrix;
+}
+
+const GLfloat *Camera::getProjectionMatrix()
+{
+	return projectionMatrix;
+}
+
+GLint Camera::getViewportHeight()
+{
+	return viewportHeight;
+}
@@ -38,6 +38,11 @@ private:
 
 	std::string screenEffect;
 
+	//Stato OpenGL del frame, letto una volta sola da beginFrame
+	GLfloat viewMatrix[16];
+	GLfloat projectionMatrix[16];
+	GLint viewportHeight;
+
 public:
 	GLShaderData postprocessData;
 	GLuint textureWidthUniformLocation;
@@ -46,6 +51,7 @@ public:
 	Camera()
 	{
 		screenEffect = "";
+		viewportHeight = 0;
 	}
 	void initCamera();
 	void setPosition(glm::vec3 pos);
@@ -87,4 +93,9 @@ public:
 	glm::vec3 vectorMatrixTransform(glm::vec3 v);
 
 	int make_resources();
+
+	void beginFrame();
+	const GLfloat *getViewMatrix();
+	const GLfloat *getProjectionMatrix();
+	GLint getViewportHeight();
 };
\ No newline at end of file
@@ -0,0 +1,1082 @@
+#include "Geometry.h"
+
+#include "../objloader/obj_parser.h"
+#include "../mesh/weld.h"
+#include "../mesh/vcache.h"
+#include "../mesh/normals.h"
+#include "../utils/timer.h"
+
+#include "../primitives/sphere.h"
+#include "../primitives/cube.h"
+#include "../primitives/tesselated_sphere.h"
+#include "../primitives/quad.h"
+
+#include <algorithm>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#include <boost/algorithm/string.hpp>
+
+unsigned long Geometry::glCalls = 0;
+unsigned long Geometry::renderCount = 0;
+unsigned long Geometry::culledMeshlets = 0;
+
+//I buffer vengono creati in makeResources; fino ad allora valgono zero
+Geometry::Geometry(string fileName, string primitiveKind, mesh_settings settings)
+{
+	geometryFileName = fileName;
+	this->primitiveKind = primitiveKind;
+	this->settings = settings;
+	elementType = GL_UNSIGNED_SHORT;
+	boundsCenter = glm::vec3(0.0f);
+	boundsRadius = 0.0f;
+	vertexBuffer = elementBuffer = 0;
+	vertex_layout_make(&settings.format, 0, 0, &layout);
+	normalType = GL_FLOAT;
+	unitTexcoords = false;
+	memset(&decode, 0, sizeof(decode));
+	memset(&quantizationError, 0, sizeof(quantizationError));
+	stream = NULL;
+	segmentVertices = segmentIndices = 0;
+	streamTriangles = 0;
+	streamStart = 0.0;
+}
+
+//Rilascia i buffer OpenGL quando l'ultimo oggetto che usa la geometria viene distrutto
+Geometry::~Geometry()
+{
+	GLuint buffers[2] = { vertexBuffer, elementBuffer };
+	if(vertexBuffer != 0 || elementBuffer != 0)
+		glDeleteBuffers(2, buffers);
+	if(!vertexArrays.empty())
+		glDeleteVertexArrays(vertexArrays.size(), &vertexArrays[0]);
+	if(stream != NULL)
+	{
+		mesh_stream_close(stream);
+		delete stream;
+	}
+	if(!segmentVertexBuffers.empty())
+	{
+		glDeleteBuffers(segmentVertexBuffers.size(), &segmentVertexBuffers[0]);
+		glDeleteBuffers(segmentElementBuffers.size(), &segmentElementBuffers[0]);
+	}
+}
+
+//Nome usato nei messaggi: il file obj o la descrizione della primitiva
+string Geometry::getName()
+{
+	return primitiveKind == "" ? geometryFileName : primitiveKind;
+}
+
+//Vero se la geometria ha coordinate texture
+bool Geometry::hasTexcoords()
+{
+	return layout.texcoord_offset >= 0;
+}
+
+//Vero se tutte le coordinate texture stanno nel quadrato [0, 1]: solo allora le texture possono
+//stare in un atlante, dove non si ripetono. Le geometrie caricate progressivamente non lo sanno in anticipo
+bool Geometry::hasUnitTexcoords()
+{
+	return unitTexcoords;
+}
+
+//Sceglie il livello di dettaglio dall'errore proiettato sullo schermo
+int Geometry::selectLod(Camera &camera, const GLfloat *modelview, float pixelError)
+{
+	if(lodLevels.size() < 2)
+		return 0;
+
+	float scale;
+	glm::vec3 eye = eyeCenter(modelview, scale);
+	float distance = glm::length(eye) - boundsRadius * scale;
+	if(distance <= 0.0f || scale <= 0.0f)
+		return 0;
+
+	//Come in reshape il campo visivo verticale  il doppio di FOVy
+	return select_lod(&lodLevels[0], lodLevels.size(), distance / scale, glm::radians(camera.getFovY() * 2.0f), camera.getViewportHeight(), pixelError);
+}
+
+//Centro della sfera che contiene la geometria in coordinate vista; scale  la scala pi grande della modelview
+glm::vec3 Geometry::eyeCenter(const GLfloat *modelview, float &scale)
+{
+	//La modelview contiene gi la camera: il centro in coordinate vista d la distanza
+	const GLfloat *m = modelview;
+	scale = glm::max(glm::length(glm::vec3(m[0], m[1], m[2])),
+		glm::max(glm::length(glm::vec3(m[4], m[5], m[6])), glm::length(glm::vec3(m[8], m[9], m[10]))));
+	return glm::vec3(
+		m[0] * boundsCenter.x + m[4] * boundsCenter.y + m[8] * boundsCenter.z + m[12],
+		m[1] * boundsCenter.x + m[5] * boundsCenter.y + m[9] * boundsCenter.z + m[13],
+		m[2] * boundsCenter.x + m[6] * boundsCenter.y + m[10] * boundsCenter.z + m[14]);
+}
+
+//Diametro in pixel della geometria sullo schermo, stimato dalla sfera che la contiene:
+//0 se  tutta dietro la camera, l'altezza della finestra se la camera  al suo interno
+float Geometry::projectedSize(Camera &camera, const GLfloat *modelview)
+{
+	float scale;
+	glm::vec3 eye = eyeCenter(modelview, scale);
+	float radius = boundsRadius * scale;
+	if(eye.z - radius > 0.0f)
+		return 0.0f;
+
+	float height = (float)camera.getViewportHeight();
+	float distance = glm::length(eye) - radius;
+	if(distance <= 0.0f)
+		return height;
+	float pixels = height * radius / (distance * tanf(glm::radians(camera.getFovY() * 2.0f) * 0.5f));
+	return glm::min(pixels, height);
+}
+
+//Riporta alle texture dei materiali quanti pixel occupa la geometria, per lo streaming
+void Geometry::touchMaterialTextures(float pixels)
+{
+	for(size_t m = 0; m < materialTextures.size(); m++)
+		if(materialTextures[m])
+			materialTextures[m]->touch(pixels);
+}
+
+//Imposta i puntatori degli attributi a partire dal primo vertice di una parte
+void Geometry::bindAttributes(GLuint firstVertex, bool textured)
+{
+	const char *base = (const char*)0 + firstVertex * layout.stride;
+
+	if(settings.format.compact)
+	{
+		//Attributi generici decodificati dalla libreria di vertex_decode_make_program
+		glVertexAttribPointer(VERTEX_POSITION_ATTRIBUTE, 4, GL_UNSIGNED_SHORT, GL_FALSE, layout.stride, base + layout.position_offset);
+		if(layout.normal_offset >= 0)
+			glVertexAttribPointer(VERTEX_NORMAL_ATTRIBUTE, 2, normalType, GL_FALSE, layout.stride, base + layout.normal_offset);
+		if(textured)
+			glVertexAttribPointer(VERTEX_TEXCOORD_ATTRIBUTE, 2, GL_UNSIGNED_SHORT, GL_FALSE, layout.stride, base + layout.texcoord_offset);
+		glCalls += 1 + (layout.normal_offset >= 0 ? 1 : 0) + (textured ? 1 : 0);
+		return;
+	}
+
+	glVertexPointer(3, GL_FLOAT, layout.stride, base + layout.position_offset);
+	if(layout.normal_offset >= 0)
+		glNormalPointer(GL_FLOAT, layout.stride, base + layout.normal_offset);
+	if(textured)
+		glTexCoordPointer(2, GL_FLOAT, layout.stride, base + layout.texcoord_offset);
+	glCalls += 1 + (layout.normal_offset >= 0 ? 1 : 0) + (textured ? 1 : 0);
+}
+
+//Attiva gli array di vertici del formato della geometria
+void Geometry::enableAttributes(bool textured)
+{
+	if(settings.format.compact)
+	{
+		glEnableVertexAttribArray(VERTEX_POSITION_ATTRIBUTE);
+		if(layout.normal_offset >= 0)
+			glEnableVertexAttribArray(VERTEX_NORMAL_ATTRIBUTE);
+		if(textured)
+			glEnableVertexAttribArray(VERTEX_TEXCOORD_ATTRIBUTE);
+	}
+	else
+	{
+		glEnableClientState(GL_VERTEX_ARRAY);
+		if(layout.normal_offset >= 0)
+			glEnableClientState(GL_NORMAL_ARRAY);
+		if(textured)
+			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	}
+	glCalls += 1 + (layout.normal_offset >= 0 ? 1 : 0) + (textured ? 1 : 0);
+}
+
+void Geometry::disableAttributes(bool textured)
+{
+	if(settings.format.compact)
+	{
+		glDisableVertexAttribArray(VERTEX_POSITION_ATTRIBUTE);
+		if(layout.normal_offset >= 0)
+			glDisableVertexAttribArray(VERTEX_NORMAL_ATTRIBUTE);
+		if(textured)
+			glDisableVertexAttribArray(VERTEX_TEXCOORD_ATTRIBUTE);
+	}
+	else
+	{
+		glDisableClientState(GL_VERTEX_ARRAY);
+		if(layout.normal_offset >= 0)
+			glDisableClientState(GL_NORMAL_ARRAY);
+		if(textured)
+			glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	}
+	glCalls += 1 + (layout.normal_offset >= 0 ? 1 : 0) + (textured ? 1 : 0);
+}
+
+//Registra una volta sola buffer e puntatori di ogni parte in un vertex array object.
+//Le parti che partono dallo stesso vertice (tutti i livelli senza divisione) condividono il vao
+void Geometry::makeVertexArrays()
+{
+	std::map<GLuint, GLuint> arrayByFirstVertex;
+	bool textured = layout.texcoord_offset >= 0;
+	unsigned long calls = glCalls;
+
+	partArrays.resize(parts.size());
+	for(size_t p = 0; p < parts.size(); p++)
+	{
+		std::map<GLuint, GLuint>::iterator it = arrayByFirstVertex.find(parts[p].first_vertex);
+		if(it != arrayByFirstVertex.end())
+		{
+			partArrays[p] = it->second;
+			continue;
+		}
+
+		GLuint vertexArray;
+		glGenVertexArrays(1, &vertexArray);
+		glBindVertexArray(vertexArray);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		enableAttributes(textured);
+		bindAttributes(parts[p].first_vertex, textured);
+
+		arrayByFirstVertex[parts[p].first_vertex] = vertexArray;
+		vertexArrays.push_back(vertexArray);
+		partArrays[p] = vertexArray;
+	}
+	glBindVertexArray(0);
+	glCalls = calls;
+}
+
+//Costanti di decodifica del formato compatto, NULL con il formato float
+const vertex_decode *Geometry::getDecode()
+{
+	return settings.format.compact ? &decode : NULL;
+}
+
+//Chiamate OpenGL e chiamate a render dall'ultimo azzeramento, per il benchmark di --benchmark-render
+unsigned long Geometry::getGlCalls()
+{
+	return glCalls;
+}
+
+unsigned long Geometry::getRenderCount()
+{
+	return renderCount;
+}
+
+unsigned long Geometry::getCulledMeshlets()
+{
+	return culledMeshlets;
+}
+
+void Geometry::resetGlCalls()
+{
+	glCalls = 0;
+	renderCount = 0;
+	culledMeshlets = 0;
+}
+
+//Disegna una parte: con i cluster solo gli intervalli visibili, uniti quando sono contigui,
+//con una sola glMultiDrawElements
+void Geometry::drawPart(const mesh_part &part, const meshlet_view *view)
+{
+	GLsizei elementSize = (elementType == GL_UNSIGNED_INT) ? sizeof(GLuint) : sizeof(GLushort);
+
+	if(view == NULL || part.meshlet_count == 0)
+	{
+		glDrawElements(
+			GL_TRIANGLES,
+			part.index_count,
+			elementType,
+			(void*)(part.first_index * elementSize)
+			);
+		glCalls++;
+		return;
+	}
+
+	drawCounts.clear();
+	drawOffsets.clear();
+	GLuint rangeEnd = 0;
+	for(GLuint m = part.first_meshlet; m < part.first_meshlet + part.meshlet_count; m++)
+	{
+		const meshlet &cluster = meshlets[m];
+		if(!meshlet_visible(&cluster, view))
+		{
+			culledMeshlets++;
+			continue;
+		}
+
+		if(!drawCounts.empty() && rangeEnd == cluster.first_index)
+			drawCounts.back() += cluster.index_count;
+		else
+		{
+			drawCounts.push_back(cluster.index_count);
+			drawOffsets.push_back((const GLvoid*)((const char*)0 + cluster.first_index * elementSize));
+		}
+		rangeEnd = cluster.first_index + cluster.index_count;
+	}
+
+	if(!drawCounts.empty())
+	{
+		glMultiDrawElements(GL_TRIANGLES, &drawCounts[0], elementType, &drawOffsets[0], drawCounts.size());
+		glCalls++;
+	}
+}
+
+//Imposta colori e texture di un materiale mtl, -1 torna al materiale di default
+void Geometry::bindMaterial(int material, bool textured, const material_uniforms *uniforms)
+{
+	if(material < 0)
+	{
+		material_reset(uniforms);
+		glCalls += 5;
+		return;
+	}
+
+	GLuint texture = textured && materialTextures[material] ? materialTextures[material]->getId() : 0;
+	material_bind(&materials[material], texture, uniforms);
+	glCalls += 5 + (texture != 0 ? 4 : 0);
+}
+
+//Disegna un livello di dettaglio; shader, uniform e texture sono gi impostati dall'oggetto.
+//Le parti di un livello sono ordinate per materiale: ogni materiale viene impostato una volta sola
+void Geometry::render(int lod, bool textured, const material_uniforms *materialUniforms, const GLfloat *modelview, const GLfloat *projection)
+{
+	textured = textured && layout.texcoord_offset >= 0;
+	renderCount++;
+
+	if(stream != NULL)
+		uploadStreamBatches();
+
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_BACK);
+	glCalls += 2;
+
+	const lod_level &level = lodLevels[lod];
+
+	//Frustum e posizione della camera in coordinate oggetto, solo se qualche parte ha dei cluster
+	meshlet_view view;
+	const meshlet_view *cullView = NULL;
+	if(!meshlets.empty() && mesh_cluster_culling_enabled())
+	{
+		meshlet_view_make(modelview, projection, &view);
+		cullView = &view;
+	}
+
+	int boundMaterial = -1;
+
+	//Con i vao ogni parte costa un bind (solo se cambia) e la chiamata di draw
+	if(mesh_vertex_arrays_enabled() && !partArrays.empty())
+	{
+		GLuint bound = 0;
+		for(GLuint p = level.first_part; p < level.first_part + level.part_count; p++)
+		{
+			if(parts[p].material != boundMaterial)
+			{
+				boundMaterial = parts[p].material;
+				bindMaterial(boundMaterial, textured, materialUniforms);
+			}
+			if(partArrays[p] != bound)
+			{
+				bound = partArrays[p];
+				glBindVertexArray(bound);
+				glCalls++;
+			}
+			drawPart(parts[p], cullView);
+		}
+		glBindVertexArray(0);
+		glCalls++;
+		if(boundMaterial >= 0)
+			bindMaterial(-1, textured, materialUniforms);
+		return;
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glCalls += 2;
+	enableAttributes(textured);
+
+	//Una chiamata di draw per ogni parte: gli indici di ogni parte partono dal suo primo vertice.
+	//Le mesh caricate progressivamente hanno una coppia di buffer per segmento
+	int boundSegment = -1;
+	for(GLuint p = level.first_part; p < level.first_part + level.part_count; p++)
+	{
+		if(parts[p].material != boundMaterial)
+		{
+			boundMaterial = parts[p].material;
+			bindMaterial(boundMaterial, textured, materialUniforms);
+		}
+		if(!partSegments.empty() && partSegments[p] != boundSegment)
+		{
+			boundSegment = partSegments[p];
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, segmentElementBuffers[boundSegment]);
+			glBindBuffer(GL_ARRAY_BUFFER, segmentVertexBuffers[boundSegment]);
+			glCalls += 2;
+		}
+		bindAttributes(parts[p].first_vertex, textured);
+		drawPart(parts[p], cullView);
+	}
+
+	disableAttributes(textured);
+	if(boundMaterial >= 0)
+		bindMaterial(-1, textured, materialUniforms);
+}
+
+//Sceglie indici a 16 o 32 bit a seconda del numero di vertici e crea le parti di ogni livello.
+//Se gli indici a 32 bit non sono disponibili divide ogni livello in parti da al pi 64K vertici.
+//Ogni intervallo di un materiale diventa almeno una parte
+void Geometry::prepareElements(const std::vector<material_range> &ranges)
+{
+	bool large = vertices.size() > MESH_MAX_SHORT_VERTICES;
+	bool split = large && !mesh_index32_supported();
+	std::vector<GLuint> remap;
+
+	parts.clear();
+	shortElements.clear();
+	lodLevels.clear();
+	elementType = (large && !split) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+
+	for(size_t r = 0; r < ranges.size(); r++)
+	{
+		if(lodLevels.empty() || ranges[r].level != (int)lodLevels.size() - 1)
+		{
+			lod_level level = { 0.0f, (GLuint)parts.size(), 0 };
+			lodLevels.push_back(level);
+		}
+		lod_level &level = lodLevels.back();
+		level.error = std::max(level.error, ranges[r].error);
+
+		if(split)
+		{
+			std::vector<GLuint> rangeElements(elements.begin() + ranges[r].first_index, elements.begin() + ranges[r].first_index + ranges[r].index_count);
+			std::vector<GLuint> rangeRemap;
+			std::vector<GLushort> rangeShortElements;
+			std::vector<mesh_part> rangeParts;
+			split_mesh(rangeElements, vertices.size(), MESH_MAX_SHORT_VERTICES, rangeRemap, rangeShortElements, rangeParts);
+
+			for(size_t p = 0; p < rangeParts.size(); p++)
+			{
+				rangeParts[p].first_vertex += remap.size();
+				rangeParts[p].first_index += shortElements.size();
+				rangeParts[p].material = ranges[r].material;
+				parts.push_back(rangeParts[p]);
+			}
+			remap.insert(remap.end(), rangeRemap.begin(), rangeRemap.end());
+			shortElements.insert(shortElements.end(), rangeShortElements.begin(), rangeShortElements.end());
+		}
+		else
+		{
+			mesh_part part = { 0, ranges[r].first_index, (GLsizei)ranges[r].index_count, 0, 0, ranges[r].material };
+			parts.push_back(part);
+		}
+
+		level.part_count = parts.size() - level.first_part;
+	}
+
+	if(split)
+	{
+		remap_vertices(vertices, remap);
+		remap_vertices(normals, remap);
+		remap_vertices(stCoordinates, remap);
+		printf("%s: %d vertici divisi in %d parti\n", geometryFileName.c_str(), (int)vertices.size(), (int)parts.size());
+	}
+	else if(elementType == GL_UNSIGNED_SHORT)
+		shortElements.assign(elements.begin(), elements.end());
+}
+
+//Copia i materiali mtl dell'obj nel formato della cache
+void Geometry::loadMaterials(objLoader *objectLoader)
+{
+	materials.resize(objectLoader->materialCount);
+	for(int m = 0; m < objectLoader->materialCount; m++)
+		material_from_obj(objectLoader->materialList[m], &materials[m]);
+}
+
+//Costruisce vertici e indici dall'obj o dalla primitiva
+void Geometry::buildGeometry(objLoader *objectLoader)
+{
+	std::vector<material_range> groups;
+
+	if (primitiveKind == "")
+	{
+
+		int cornerCount = objectLoader->triangleCount * 3;
+		const float *positions = objectLoader->positions;
+		const float *texcoords = objectLoader->texcoords;
+		const float *objNormals = objectLoader->normals;
+		bool hasNormals = objectLoader->normalCount > 0;
+
+		//Senza righe vn le normali vengono calcolate dalle facce
+		std::vector<glm::vec3> generatedNormals;
+		if (!hasNormals && cornerCount > 0)
+		{
+			double start = timer_seconds();
+			generate_normals(positions, objectLoader->vertexCount, objectLoader->triangles, cornerCount, settings.crease_angle, generatedNormals);
+			printf("%s: %d normali generate in %.3f s\n", geometryFileName.c_str(), (int)generatedNormals.size(), timer_seconds() - start);
+			objNormals = &generatedNormals[0].x;
+			hasNormals = true;
+		}
+
+		//Saldiamo i vertici: ogni terna (posizione, texture, normale) diventa un solo vertice indicizzato
+		std::vector<int> remap;
+		std::vector<obj_index_triple> unique;
+		int vertexCount = weld_corners(objectLoader->triangles, cornerCount, remap, unique);
+		printf("%s: %d vertici, %d dopo la saldatura\n", geometryFileName.c_str(), cornerCount, vertexCount);
+
+		vertices.reserve(vertexCount);
+		elements.reserve(cornerCount);
+		if (objectLoader->textureCount > 0)
+			stCoordinates.reserve(vertexCount);
+		if (hasNormals)
+			normals.reserve(vertexCount);
+
+		//Gli array dell'objLoader sono piatti: 3 float per posizione e normale, 2 per le coordinate texture
+		for (int vcount = 0; vcount < vertexCount; vcount++)
+		{
+			const obj_index_triple &corner = unique[vcount];
+
+			const float *v = &positions[3 * corner.vertex_index];
+			vertices.push_back(glm::vec3(v[0], v[1], v[2]));
+
+			if (objectLoader->textureCount > 0)
+			{
+				if (corner.texture_index >= 0)
+					stCoordinates.push_back(glm::vec2(texcoords[2 * corner.texture_index], texcoords[2 * corner.texture_index + 1]));
+				else
+					stCoordinates.push_back(glm::vec2(0.0f, 0.0f));
+			}
+
+			if (hasNormals)
+			{
+				if (corner.normal_index >= 0)
+				{
+					const float *n = &objNormals[3 * corner.normal_index];
+					normals.push_back(glm::vec3(n[0], n[1], n[2]));
+				}
+				else
+					normals.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
+			}
+		}
+
+		for (int ccount = 0; ccount < cornerCount; ccount++)
+			elements.push_back(remap[ccount]);
+
+		//Con un mtl i triangoli vengono raggruppati per materiale, nell'ordine dei materiali
+		if (objectLoader->materialCount > 0)
+		{
+			loadMaterials(objectLoader);
+			sort_by_material(elements, objectLoader->triangleMaterials, groups);
+			printf("%s: %d materiali, %d usati\n", geometryFileName.c_str(), (int)materials.size(), (int)groups.size());
+		}
+	}
+	else
+	{
+		if (primitiveKind.find("sphere") == 0)
+		{
+			std::vector<std::string> values;
+			boost::split(values, primitiveKind, boost::is_any_of(" "));
+
+			int rings = 10;
+			int sectors_or_tess_level = 10;
+			string kind = "geo";
+
+			if (values.size() > 1)
+			{
+				kind = values.at(1);
+			}
+
+			if (values.size() > 3)
+			{
+				rings = atoi(values.at(3).c_str());
+			}
+
+			if (values.size() > 2)
+			{
+				sectors_or_tess_level = atoi(values.at(2).c_str());
+			}
+
+			if (kind == "geo")
+				make_sphere(vertices, normals, stCoordinates, elements, rings, sectors_or_tess_level);
+			else if (kind == "tes")
+				make_tesselated_sphere(vertices, normals, stCoordinates, elements, sectors_or_tess_level);
+		}
+		else if (primitiveKind.compare("cube") == 0)
+		{
+			make_cube(vertices, normals, stCoordinates, elements);
+		}
+		else if (primitiveKind.compare("quad") == 0)
+		{
+			make_quad(vertices, normals, stCoordinates, elements);
+		}
+	}
+
+	//Sfera che contiene la mesh, per la scelta del livello di dettaglio
+	glm::vec3 minimum(0.0f), maximum(0.0f);
+	if(!vertices.empty())
+		minimum = maximum = vertices[0];
+	for(size_t v = 1; v < vertices.size(); v++)
+	{
+		minimum = glm::min(minimum, vertices[v]);
+		maximum = glm::max(maximum, vertices[v]);
+	}
+	boundsCenter = (minimum + maximum) * 0.5f;
+	boundsRadius = glm::length(maximum - minimum) * 0.5f;
+
+	//Senza materiali tutta la mesh  un solo gruppo
+	if(groups.empty())
+	{
+		material_range all = { 0, (GLuint)elements.size(), 0, -1, 0.0f };
+		groups.push_back(all);
+	}
+
+	//I livelli di dettaglio vengono accodati al livello 0 nello stesso element buffer e condividono i vertici
+	std::vector<material_range> ranges;
+	int levelCount = buildLods(groups, ranges);
+	if(levelCount > 1)
+	{
+		printf("%s: %d livelli di dettaglio,", geometryFileName.c_str(), levelCount);
+		for(int l = 0; l < levelCount; l++)
+		{
+			GLuint indexCount = 0;
+			for(size_t r = 0; r < ranges.size(); r++)
+				if(ranges[r].level == l)
+					indexCount += ranges[r].index_count;
+			printf(" %d", (int)indexCount / 3);
+		}
+		printf(" triangoli\n");
+	}
+
+	if(mesh_optimization_enabled())
+		optimizeGeometry(ranges);
+
+	//Va fatto prima di creare i buffer: la divisione in parti pu riordinare i vertici
+	prepareElements(ranges);
+
+	if(settings.meshlet_triangles > 0)
+		buildMeshlets();
+}
+
+//Ogni gruppo di materiale ha la sua catena di livelli: il bordo tra due materiali resta fermo
+//e un livello non mescola triangoli di materiali diversi. Gli indici vengono riscritti livello per livello
+//con i gruppi nell'ordine dei materiali; un gruppo che non si semplifica oltre ripete il suo ultimo livello
+int Geometry::buildLods(const std::vector<material_range> &groups, std::vector<material_range> &ranges)
+{
+	std::vector<std::vector<GLuint> > groupElements(groups.size());
+	std::vector<std::vector<lod_range> > groupLevels(groups.size());
+	size_t levelCount = 1;
+
+	for(size_t g = 0; g < groups.size(); g++)
+	{
+		std::vector<GLuint>::iterator begin = elements.begin() + groups[g].first_index;
+		groupElements[g].assign(begin, begin + groups[g].index_count);
+		build_lod_chain(groupElements[g], vertices, settings.lod, groupLevels[g]);
+		levelCount = std::max(levelCount, groupLevels[g].size());
+	}
+
+	elements.clear();
+	ranges.clear();
+	for(size_t l = 0; l < levelCount; l++)
+	{
+		for(size_t g = 0; g < groups.size(); g++)
+		{
+			const lod_range &level = groupLevels[g][std::min(l, groupLevels[g].size() - 1)];
+			material_range range = { (GLuint)elements.size(), level.index_count, (int)l, groups[g].material, level.error };
+			ranges.push_back(range);
+
+			std::vector<GLuint>::iterator begin = groupElements[g].begin() + level.first_index;
+			elements.insert(elements.end(), begin, begin + level.index_count);
+		}
+	}
+
+	return (int)levelCount;
+}
+
+//Divide le parti grandi in cluster di triangoli vicini, riordinando i loro indici,
+//per scartare ogni frame quelli fuori dal frustum o rivolti dalla parte opposta alla camera
+void Geometry::buildMeshlets()
+{
+	meshlets.clear();
+
+	for(size_t p = 0; p < parts.size(); p++)
+	{
+		mesh_part &part = parts[p];
+		part.first_meshlet = meshlets.size();
+		part.meshlet_count = 0;
+		if(part.index_count / 3 < MESHLET_MIN_CLUSTERS * settings.meshlet_triangles)
+			continue;
+
+		std::vector<GLuint> indices;
+		if(elementType == GL_UNSIGNED_INT)
+			indices.assign(elements.begin() + part.first_index, elements.begin() + part.first_index + part.index_count);
+		else
+			indices.assign(shortElements.begin() + part.first_index, shortElements.begin() + part.first_index + part.index_count);
+
+		build_meshlets(indices, vertices, part.first_vertex, part.first_index, settings.meshlet_triangles, meshlets);
+		part.meshlet_count = meshlets.size() - part.first_meshlet;
+
+		if(elementType == GL_UNSIGNED_INT)
+			std::copy(indices.begin(), indices.end(), elements.begin() + part.first_index);
+		else
+			std::copy(indices.begin(), indices.end(), shortElements.begin() + part.first_index);
+	}
+
+	if(!meshlets.empty())
+		printf("%s: %d cluster di al pi %d triangoli\n", getName().c_str(), (int)meshlets.size(), settings.meshlet_triangles);
+}
+
+//Riordina i triangoli per la cache dei vertici e per ridurre l'overdraw, poi i vertici nell'ordine d'uso
+void Geometry::optimizeGeometry(const std::vector<material_range> &ranges)
+{
+	//Le statistiche sono quelle del livello 0, i cui intervalli sono all'inizio
+	GLuint levelZeroEnd = 0;
+	for(size_t r = 0; r < ranges.size() && ranges[r].level == 0; r++)
+		levelZeroEnd = ranges[r].first_index + ranges[r].index_count;
+
+	std::vector<GLuint> levelZero(elements.begin(), elements.begin() + levelZeroEnd);
+	float acmrBefore = mesh_acmr(levelZero, vertices.size());
+	float atvrBefore = mesh_atvr(levelZero, vertices.size());
+
+	//Ogni livello di ogni materiale viene ottimizzato separatamente
+	for(size_t r = 0; r < ranges.size(); r++)
+	{
+		std::vector<GLuint>::iterator begin = elements.begin() + ranges[r].first_index;
+		std::vector<GLuint> level(begin, begin + ranges[r].index_count);
+
+		optimize_vertex_cache(level, vertices.size());
+		optimize_overdraw(level, vertices);
+		std::copy(level.begin(), level.end(), begin);
+	}
+
+	levelZero.assign(elements.begin(), elements.begin() + levelZeroEnd);
+	float acmrAfter = mesh_acmr(levelZero, vertices.size());
+	float atvrAfter = mesh_atvr(levelZero, vertices.size());
+
+	std::vector<GLuint> remap;
+	optimize_vertex_fetch(elements, vertices.size(), remap);
+	remap_vertices(vertices, remap);
+	remap_vertices(normals, remap);
+	remap_vertices(stCoordinates, remap);
+
+	printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", getName().c_str(),
+		acmrBefore, acmrAfter, atvrBefore, atvrAfter);
+}
+
+//Interlaccia i vertici costruiti da buildGeometry in un solo flusso, float o quantizzati a seconda
+//del formato:  quello che finisce nel buffer e nella cache, dove un caricamento lo trova gi pronto
+void Geometry::packVertices(std::vector<unsigned char> &interleaved)
+{
+	bool hasNormals = !normals.empty(), hasTexcoords = !stCoordinates.empty();
+	vertex_layout_make(&settings.format, hasNormals, hasTexcoords, &layout);
+
+	//un piccolo margine per gli errori di arrotondamento degli esportatori, coperto dal bordo dell'atlante
+	unitTexcoords = hasTexcoords;
+	for(size_t i = 0; unitTexcoords && i < stCoordinates.size(); i++)
+		unitTexcoords = stCoordinates[i].x >= -0.001f && stCoordinates[i].x <= 1.001f &&
+			stCoordinates[i].y >= -0.001f && stCoordinates[i].y <= 1.001f;
+
+	const float *positions = vertices.empty() ? NULL : &vertices[0].x;
+	const float *normalData = hasNormals ? &normals[0].x : NULL;
+	const float *texcoords = hasTexcoords ? &stCoordinates[0].x : NULL;
+	if(settings.format.compact)
+	{
+		compact_vertices compact;
+		quantize_vertices(&settings.format, positions, normalData, texcoords, vertices.size(), &compact);
+		decode = compact.decode;
+		normalType = compact.normal_type;
+		quantizationError = compact.error;
+		interleave_vertices(&layout, NULL, NULL, NULL, &compact, vertices.size(), interleaved);
+	}
+	else
+		interleave_vertices(&layout, positions, normalData, texcoords, NULL, vertices.size(), interleaved);
+}
+
+//Descrive la geometria costruita da buildGeometry, con i vertici interlacciati da packVertices, nel formato della cache .amesh
+amesh_data Geometry::geometryData(const std::vector<unsigned char> &interleaved)
+{
+	amesh_data mesh;
+	mesh.flags = amesh_current_flags();
+	mesh.vertex_count = vertices.size();
+	mesh.index_count = (elementType == GL_UNSIGNED_INT) ? elements.size() : shortElements.size();
+	mesh.index_type = elementType;
+	mesh.part_count = parts.size();
+	mesh.vertices = interleaved.empty() ? NULL : &interleaved[0];
+	mesh.layout = layout;
+	mesh.unit_texcoords = unitTexcoords;
+	mesh.normal_type = normalType;
+	mesh.decode = decode;
+	mesh.error = quantizationError;
+	if(elementType == GL_UNSIGNED_INT)
+		mesh.elements = elements.empty() ? NULL : (const void*)&elements[0];
+	else
+		mesh.elements = shortElements.empty() ? NULL : (const void*)&shortElements[0];
+	mesh.parts = parts.empty() ? NULL : &parts[0];
+	mesh.lod_count = lodLevels.size();
+	mesh.lods = lodLevels.empty() ? NULL : &lodLevels[0];
+	mesh.meshlet_count = meshlets.size();
+	mesh.meshlets = meshlets.empty() ? NULL : &meshlets[0];
+	mesh.material_count = materials.size();
+	mesh.materials = materials.empty() ? NULL : &materials[0];
+	mesh.center[0] = boundsCenter.x;
+	mesh.center[1] = boundsCenter.y;
+	mesh.center[2] = boundsCenter.z;
+	mesh.radius = boundsRadius;
+	return mesh;
+}
+
+//Crea i buffer OpenGL. I vertici sono gi interlacciati come li legge il disegno, quantizzati nel formato
+//compatto, e come gli indici possono venire direttamente dalla cache mappata in memoria
+void Geometry::uploadGeometry(const amesh_data &mesh)
+{
+	layout = mesh.layout;
+	unitTexcoords = mesh.unit_texcoords != 0;
+	if(settings.format.compact)
+	{
+		decode = mesh.decode;
+		normalType = mesh.normal_type;
+
+		vertex_format floatFormat;
+		vertex_format_default(&floatFormat);
+		printf("%s: formato compatto, %d -> %d byte per vertice, errore massimo posizioni %g (%.4f%% del raggio), normali %.3f gradi, uv %g\n",
+			getName().c_str(),
+			vertex_format_size(&floatFormat, layout.normal_offset >= 0, layout.texcoord_offset >= 0), layout.stride,
+			mesh.error.position, boundsRadius > 0.0f ? mesh.error.position / boundsRadius * 100.0f : 0.0f,
+			mesh.error.normal, mesh.error.texcoord);
+	}
+
+	vertexBuffer = make_buffer(
+		GL_ARRAY_BUFFER,
+		mesh.vertices,
+		mesh.vertex_count * layout.stride
+		);
+
+	elementBuffer = make_buffer(
+		GL_ELEMENT_ARRAY_BUFFER,
+		mesh.elements,
+		mesh.index_count * (mesh.index_type == GL_UNSIGNED_INT ? sizeof(GLuint) : sizeof(GLushort))
+		);
+
+	if(mesh_vertex_arrays_enabled())
+		makeVertexArrays();
+}
+
+//Le texture dei materiali passano dalla cache delle texture; senza coordinate texture non servono.
+//Una texture mancante lascia il materiale senza mappa. Con il caricamento progressivo i materiali
+//arrivano un po' alla volta: vengono caricate solo le texture di quelli nuovi
+void Geometry::makeMaterialTextures()
+{
+	size_t loaded = materialTextures.size();
+	materialTextures.resize(materials.size());
+	if(!hasTexcoords())
+		return;
+
+	//Le mappe dei materiali usano le mipmap di default
+	mipmap_settings mipmaps;
+	mipmap_default_settings(&mipmaps);
+	std::vector<std::pair<string, mipmap_settings> > requests;
+	for(size_t m = loaded; m < materials.size(); m++)
+		if(materials[m].texture_filename[0] != '\0')
+			requests.push_back(std::make_pair(string(materials[m].texture_filename), mipmaps));
+	TextureCache::preload(requests);
+
+	for(size_t m = loaded; m < materials.size(); m++)
+	{
+		if(materials[m].texture_filename[0] == '\0')
+			continue;
+		materialTextures[m] = TextureCache::get(materials[m].texture_filename, mipmaps);
+		if(!materialTextures[m])
+			printf("%s: texture %s del materiale %s non caricata\n", getName().c_str(), materials[m].texture_filename, materials[m].name);
+	}
+}
+
+//I dati su cpu non servono pi una volta creati i buffer
+void Geometry::releaseGeometry()
+{
+	std::vector<glm::vec3>().swap(vertices);
+	std::vector<GLuint>().swap(elements);
+	std::vector<glm::vec2>().swap(stCoordinates);
+	std::vector<glm::vec3>().swap(normals);
+	std::vector<GLushort>().swap(shortElements);
+}
+
+//Avvia la lettura progressiva dell'obj: i vertici sono sempre float con normali e coordinate texture
+//e non ci sono livelli di dettaglio n cluster; per quelli serve la cache (--bake-meshes)
+int Geometry::startStream()
+{
+	stream = new mesh_stream;
+	if(!mesh_stream_open(stream, geometryFileName.c_str(), settings.crease_angle))
+	{
+		delete stream;
+		stream = NULL;
+		return 0;
+	}
+
+	if(settings.format.compact)
+		printf("%s: formato compatto ignorato durante il caricamento progressivo\n", getName().c_str());
+	settings.format.compact = 0;
+	mesh_stream_layout(&layout);
+	normalType = GL_FLOAT;
+	elementType = mesh_index32_supported() ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+
+	lod_level level = { 0.0f, 0, 0 };
+	lodLevels.assign(1, level);
+	streamStart = timer_seconds();
+	printf("%s: caricamento progressivo\n", getName().c_str());
+	return 1;
+}
+
+//Carica nei buffer i blocchi gi pronti, per al pi MESH_STREAM_UPLOAD_SECONDS a frame,
+//cos il disegno non si blocca qualunque sia la dimensione del file
+void Geometry::uploadStreamBatches()
+{
+	double start = timer_seconds();
+	mesh_stream_batch *batch;
+
+	while(timer_seconds() - start < MESH_STREAM_UPLOAD_SECONDS && (batch = mesh_stream_pop(stream)) != NULL)
+	{
+		appendStreamBatch(*batch);
+		delete batch;
+	}
+
+	//I materiali di un blocco sono pubblicati prima del blocco stesso
+	mesh_stream_materials(stream, materials);
+	makeMaterialTextures();
+
+	if(mesh_stream_done(stream))
+	{
+		printf("%s: caricamento progressivo completato, %lu triangoli in %.2f s\n",
+			getName().c_str(), streamTriangles, timer_seconds() - streamStart);
+		mesh_stream_close(stream);
+		delete stream;
+		stream = NULL;
+	}
+}
+
+//Accoda un blocco all'ultimo segmento, creandone uno nuovo quando  pieno.
+//Con gli indici a 32 bit i blocchi consecutivi dello stesso materiale diventano una sola parte
+void Geometry::appendStreamBatch(const mesh_stream_batch &batch)
+{
+	GLuint indexCount = batch.elements.size();
+	bool absolute = elementType == GL_UNSIGNED_INT;
+
+	if(segmentVertexBuffers.empty() ||
+		segmentVertices + batch.vertex_count > MESH_STREAM_SEGMENT_VERTICES ||
+		segmentIndices + indexCount > MESH_STREAM_SEGMENT_INDICES)
+	{
+		GLsizei indexSize = absolute ? sizeof(GLuint) : sizeof(GLushort);
+		segmentVertexBuffers.push_back(make_buffer(GL_ARRAY_BUFFER, NULL, MESH_STREAM_SEGMENT_VERTICES * layout.stride));
+		segmentElementBuffers.push_back(make_buffer(GL_ELEMENT_ARRAY_BUFFER, NULL, MESH_STREAM_SEGMENT_INDICES * indexSize));
+		segmentVertices = segmentIndices = 0;
+		glCalls += 6;
+	}
+	int segment = segmentVertexBuffers.size() - 1;
+
+	glBindBuffer(GL_ARRAY_BUFFER, segmentVertexBuffers[segment]);
+	glBufferSubData(GL_ARRAY_BUFFER, segmentVertices * layout.stride, batch.vertices.size(), &batch.vertices[0]);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, segmentElementBuffers[segment]);
+	if(absolute)
+	{
+		//Indici riferiti all'inizio del segmento: una parte pu coprire pi blocchi
+		std::vector<GLuint> rebased(batch.elements);
+		for(size_t i = 0; i < rebased.size(); i++)
+			rebased[i] += segmentVertices;
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, segmentIndices * sizeof(GLuint), rebased.size() * sizeof(GLuint), &rebased[0]);
+	}
+	else
+	{
+		std::vector<GLushort> shortBatch(batch.elements.begin(), batch.elements.end());
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, segmentIndices * sizeof(GLushort), shortBatch.size() * sizeof(GLushort), &shortBatch[0]);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glCalls += 6;
+
+	mesh_part part = { absolute ? 0 : segmentVertices, segmentIndices, (GLsizei)indexCount, 0, 0, batch.material };
+	mesh_part *last = parts.empty() ? NULL : &parts.back();
+	if(absolute && last != NULL && partSegments.back() == segment && last->material == part.material &&
+		last->first_index + last->index_count == part.first_index)
+		last->index_count += indexCount;
+	else
+	{
+		parts.push_back(part);
+		partSegments.push_back(segment);
+	}
+	lodLevels[0].part_count = parts.size();
+
+	segmentVertices += batch.vertex_count;
+	segmentIndices += indexCount;
+	streamTriangles += indexCount / 3;
+}
+
+//Scrive la cache .amesh di un obj senza creare risorse OpenGL
+int Geometry::bake(string fileName, mesh_settings settings)
+{
+	Geometry geometry(fileName, "", settings);
+	amesh_file cache;
+	int result = 1;
+
+	if(amesh_open(&cache, fileName, settings))
+	{
+		amesh_close(&cache);
+		printf("%s: cache gi aggiornata\n", fileName.c_str());
+	}
+	else
+	{
+		objLoader loader;
+		result = loader.load(fileName.c_str());
+		if(result == 1)
+		{
+			geometry.buildGeometry(&loader);
+			std::vector<unsigned char> interleaved;
+			geometry.packVertices(interleaved);
+			amesh_data mesh = geometry.geometryData(interleaved);
+			result = amesh_write(fileName, &mesh, settings);
+		}
+	}
+
+	return result;
+}
+
+//Crea i buffer OpenGL dalla cache .amesh, dall'obj o dalla primitiva
+int Geometry::makeResources()
+{
+	amesh_file cache;
+
+	//Se esiste una cache .amesh aggiornata l'obj non viene nemmeno letto
+	if(primitiveKind == "" && amesh_open(&cache, geometryFileName, settings))
+	{
+		//Nessun parsing: i dati della cache vanno direttamente nei buffer
+		const amesh_data &mesh = cache.mesh;
+		elementType = mesh.index_type;
+		parts.assign(mesh.parts, mesh.parts + mesh.part_count);
+		lodLevels.assign(mesh.lods, mesh.lods + mesh.lod_count);
+		meshlets.assign(mesh.meshlets, mesh.meshlets + mesh.meshlet_count);
+		materials.assign(mesh.materials, mesh.materials + mesh.material_count);
+		boundsCenter = glm::vec3(mesh.center[0], mesh.center[1], mesh.center[2]);
+		boundsRadius = mesh.radius;
+		uploadGeometry(mesh);
+		amesh_close(&cache);
+	}
+	else if(primitiveKind == "" && settings.stream)
+	{
+		//Senza cache la mesh viene disegnata mentre arriva
+		return startStream();
+	}
+	else if(primitiveKind == "")
+	{
+		//L'objLoader serve solo durante la costruzione
+		objLoader loader;
+		if(loader.load(geometryFileName.c_str()) != 1)
+			return 0;
+
+		buildGeometry(&loader);
+		std::vector<unsigned char> interleaved;
+		packVertices(interleaved);
+		amesh_data mesh = geometryData(interleaved);
+		amesh_write(geometryFileName, &mesh, settings);
+		uploadGeometry(mesh);
+	}
+	else
+	{
+		buildGeometry(NULL);
+		std::vector<unsigned char> interleaved;
+		packVertices(interleaved);
+		amesh_data mesh = geometryData(interleaved);
+		uploadGeometry(mesh);
+	}
+
+	makeMaterialTextures();
+	releaseGeometry();
+	return 1;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "..\objloader\objLoader.h"
+#include "..\glfuncs.h"
+#include "..\mesh\index_buffer.h"
+#include "..\mesh\amesh.h"
+#include "..\mesh\lod.h"
+#include "..\mesh\vertex_format.h"
+#include "..\mesh\meshlet.h"
+#include "..\mesh\material.h"
+#include "..\mesh\mesh_stream.h"
+#include "Camera.h"
+#include "TextureCache.h"
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+using namespace std;
+
+//Vertici, indici e livelli di dettaglio di un obj o di una primitiva, gi caricati nei buffer OpenGL.
+//Una geometria viene condivisa da tutti gli oggetti che la usano attraverso GeometryCache.
+class Geometry
+{
+public:
+	Geometry(string fileName, string primitiveKind, mesh_settings settings);
+	~Geometry();
+
+	int makeResources();
+	static int bake(string fileName, mesh_settings settings);
+
+	int selectLod(Camera &camera, const GLfloat *modelview, float pixelError);
+	float projectedSize(Camera &camera, const GLfloat *modelview);
+	void touchMaterialTextures(float pixels);
+	void render(int lod, bool textured, const material_uniforms *materialUniforms, const GLfloat *modelview, const GLfloat *projection);
+	bool hasTexcoords();
+	bool hasUnitTexcoords();
+	const vertex_decode *getDecode();
+	static unsigned long getGlCalls();
+	static unsigned long getRenderCount();
+	static unsigned long getCulledMeshlets();
+	static void resetGlCalls();
+	string getName();
+private:
+	//I buffer OpenGL appartengono a una sola istanza
+	Geometry(const Geometry &other);
+	Geometry &operator=(const Geometry &other);
+
+	string geometryFileName;
+	string primitiveKind;
+	mesh_settings settings;
+
+	std::vector<glm::vec3> vertices;
+	std::vector<GLuint> elements;
+	std::vector<glm::vec2> stCoordinates;
+	std::vector<glm::vec3> normals;
+
+	void buildGeometry(objLoader *loader);
+	void loadMaterials(objLoader *loader);
+	int buildLods(const std::vector<material_range> &groups, std::vector<material_range> &ranges);
+	void optimizeGeometry(const std::vector<material_range> &ranges);
+	void prepareElements(const std::vector<material_range> &ranges);
+	void packVertices(std::vector<unsigned char> &interleaved);
+	amesh_data geometryData(const std::vector<unsigned char> &interleaved);
+	void uploadGeometry(const amesh_data &mesh);
+	void makeVertexArrays();
+	void buildMeshlets();
+	void makeMaterialTextures();
+	int startStream();
+	void uploadStreamBatches();
+	void appendStreamBatch(const mesh_stream_batch &batch);
+	void bindMaterial(int material, bool textured, const material_uniforms *uniforms);
+	void drawPart(const mesh_part &part, const meshlet_view *view);
+	void bindAttributes(GLuint firstVertex, bool textured);
+	void enableAttributes(bool textured);
+	void disableAttributes(bool textured);
+	void releaseGeometry();
+	glm::vec3 eyeCenter(const GLfloat *modelview, float &scale);
+
+	std::vector<GLushort> shortElements;
+	GLenum elementType;
+	std::vector<mesh_part> parts;
+
+	std::vector<mesh_material> materials;
+	std::vector<std::shared_ptr<Texture> > materialTextures;
+
+	std::vector<lod_level> lodLevels;
+	std::vector<meshlet> meshlets;
+	std::vector<GLsizei> drawCounts;
+	std::vector<const GLvoid*> drawOffsets;
+	glm::vec3 boundsCenter;
+	float boundsRadius;
+
+	GLuint vertexBuffer, elementBuffer;
+	vertex_layout layout;
+	GLenum normalType;
+	bool unitTexcoords;
+	std::vector<GLuint> vertexArrays;
+	std::vector<GLuint> partArrays;
+
+	//Caricamento progressivo: i blocchi vengono accodati a segmenti di dimensione fissa
+	mesh_stream *stream;
+	std::vector<GLuint> segmentVertexBuffers, segmentElementBuffers;
+	std::vector<int> partSegments;
+	GLuint segmentVertices, segmentIndices;
+	unsigned long streamTriangles;
+	double streamStart;
+
+	static unsigned long glCalls;
+	static unsigned long renderCount;
+	static unsigned long culledMeshlets;
+	vertex_decode decode;
+	vertex_error quantizationError;
+};
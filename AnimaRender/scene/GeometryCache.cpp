@@ -0,0 +1,63 @@
+#include "GeometryCache.h"
+
+#include <sstream>
+#include <stdio.h>
+
+std::map<string, std::weak_ptr<Geometry> > GeometryCache::entries;
+int GeometryCache::hits = 0;
+int GeometryCache::misses = 0;
+
+//Il percorso dell'obj  gi canonico; lod, angolo delle normali, cluster e formato dei vertici cambiano i buffer,
+//la soglia in pixel invece riguarda solo la scelta del livello e resta all'oggetto
+string GeometryCache::makeKey(string fileName, string primitiveKind, mesh_settings settings)
+{
+	ostringstream key;
+	if(primitiveKind == "")
+		key << "obj:" << fileName;
+	else
+		key << "primitive:" << primitiveKind;
+	key << "|" << settings.lod.levels << "|" << settings.lod.ratio << "|" << settings.crease_angle << "|" << settings.meshlet_triangles;
+	if(settings.format.compact)
+		key << "|compact " << settings.format.position_bits << " " << settings.format.normal_bits << " " << settings.format.texcoord_bits;
+	if(settings.stream)
+		key << "|stream";
+	return key.str();
+}
+
+//Ritorna la geometria condivisa, creandola se nessun oggetto la usa ancora. Null in caso di errore
+std::shared_ptr<Geometry> GeometryCache::get(string fileName, string primitiveKind, mesh_settings settings)
+{
+	string key = makeKey(fileName, primitiveKind, settings);
+
+	std::map<string, std::weak_ptr<Geometry> >::iterator it = entries.find(key);
+	if(it != entries.end())
+	{
+		std::shared_ptr<Geometry> geometry = it->second.lock();
+		if(geometry)
+		{
+			hits++;
+			printf("%s: geometria condivisa (%d oggetti)\n", geometry->getName().c_str(), (int)geometry.use_count());
+			return geometry;
+		}
+	}
+
+	std::shared_ptr<Geometry> geometry(new Geometry(fileName, primitiveKind, settings));
+	if(geometry->makeResources() != 1)
+		return std::shared_ptr<Geometry>();
+
+	misses++;
+	entries[key] = geometry;
+	return geometry;
+}
+
+//Oggetti che hanno riusato una geometria gi caricata
+int GeometryCache::getHits()
+{
+	return hits;
+}
+
+//Geometrie effettivamente caricate
+int GeometryCache::getMisses()
+{
+	return misses;
+}
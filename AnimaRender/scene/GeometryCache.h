@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Geometry.h"
+
+#include <string>
+#include <map>
+#include <memory>
+
+using namespace std;
+
+//Cache di processo delle geometrie: gli oggetti con lo stesso obj (o la stessa primitiva)
+//e le stesse impostazioni condividono un solo insieme di buffer OpenGL.
+//La cache tiene solo riferimenti deboli: la geometria viene liberata con l'ultimo oggetto che la usa.
+class GeometryCache
+{
+public:
+	static std::shared_ptr<Geometry> get(string fileName, string primitiveKind, mesh_settings settings);
+	static int getHits();
+	static int getMisses();
+private:
+	static string makeKey(string fileName, string primitiveKind, mesh_settings settings);
+
+	static std::map<string, std::weak_ptr<Geometry> > entries;
+	static int hits;
+	static int misses;
+};
@@ -1,16 +1,13 @@
 #include "Object.h"
 
 #include "../utils/util.h"
-#include "../objloader/obj_parser.h"
-
-#include "../primitives/sphere.h"
-#include "../primitives/cube.h"
-#include "../primitives/tesselated_sphere.h"
-#include "../primitives/quad.h"
 
 #include "Light.h"
+#include "GeometryCache.h"
 
 #include <list>
+#include <algorithm>
+#include <stdio.h>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
@@ -18,8 +15,6 @@
 //I parametri di default vengono inizializzati nel costruttore
 Object::Object()
 {
-	objectLoader = new objLoader();
-
 	for(int i = 0; i < 8; i++)
 	{
 		textureFileNames[i] = "";
@@ -27,19 +22,53 @@ Object::Object()
 	}
 	textured = false;
 	primitiveKind = "";
+	mesh_default_settings(&settings);
 }
 
-//Ritorna se il file specificato  un obj valido
+//Ritorna se il file specificato esiste. L'obj viene letto in makeResources,
+//quando sono note anche le impostazioni lod e si sa se la cache .amesh  valida
 int Object::loadGeometry(string filename)
 {
-	return objectLoader->load(filename.c_str());
+	geometryFileName = filename;
+	return boost::filesystem::exists(filename) ? 1 : 0;
+}
+
+//Numero di livelli di dettaglio da generare e soglia di errore in pixel per sceglierli
+void Object::setLod(lod_settings lod)
+{
+	settings.lod = lod;
+}
+
+//Angolo oltre il quale le normali generate non vengono mediate (spigoli vivi)
+void Object::setCreaseAngle(float degrees)
+{
+	settings.crease_angle = degrees;
+}
+
+//Triangoli per cluster usati per scartare le parti non visibili delle mesh grandi, 0 per disattivare
+void Object::setMeshletTriangles(int triangles)
+{
+	settings.meshlet_triangles = triangles;
+}
+
+//Senza cache .amesh l'obj viene disegnato mentre viene letto (vedi mesh_stream.h)
+void Object::setStreaming(bool streaming)
+{
+	settings.stream = streaming ? 1 : 0;
+}
+
+//Formato dei vertici nei buffer: float o quantizzato (vedi vertex_format.h)
+void Object::setVertexFormat(vertex_format format)
+{
+	settings.format = format;
 }
 
-//il nome del file da caricare con make_resources.
-void Object::setTexture(int id, string name, string filename)
+//il nome del file da caricare con make_resources e le sue mipmap.
+void Object::setTexture(int id, string name, string filename, mipmap_settings mipmaps)
 {
 	textureNames[id] = name;
 	textureFileNames[id] = filename;
+	textureMipmaps[id] = mipmaps;
 }
 
 //Imposta l'algoritmo di shading con cui effettuale il rendering dell'oggetto
@@ -59,7 +88,7 @@ void Object::addParameter(string key, glm::vec4 value)
 }
 
 //Effettivo rendering dell'oggetto
-void Object::render()
+void Object::render(Camera &camera, const GLfloat *modelview)
 {
 	glUseProgram(shaderData.program);
 
@@ -82,183 +111,67 @@ void Object::render()
 	glUniform1i(lightNumberLocation, Light::getNumberOfLights());
 
 	
-	//Uniform textures
+	//Uniform textures: le unit dei sampler sono fissate in makeResources, qui si lega solo la texture,
+	//se sulla sua unit non c' gi (oggetti che condividono texture o pagine di un atlante)
 	for(int i = 0; i < 8; i++)
 	{
-		if(data.textures[i] != -1)
-		{
-			glActiveTexture(GL_TEXTURE0+i);
-			GLint location = glGetUniformLocation(shaderData.program, textureNames[i].c_str());
-			glBindTexture(GL_TEXTURE_2D, data.textures[i]);
-			glUniform1i(location, i);
-		}
+		GLuint texture = atlas ? atlas->getTexture(i) : data.textures[i];
+		if(texture != -1)
+			texture_bind(i, texture);
 	}
-	glBindBuffer(GL_ARRAY_BUFFER, data.vertex_buffer);
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glVertexPointer(
-		3,
-		GL_FLOAT,
-		0,
-		(void*)0
-		);
-
-	glBindBuffer(GL_ARRAY_BUFFER, data.normal_buffer);
-	glEnableClientState(GL_NORMAL_ARRAY);
-	glNormalPointer(
-		GL_FLOAT,
-		0,
-		(void*)0
-		);
-
-	if(textured)
+	//Con lo streaming le texture scelgono i livelli da caricare in base allo spazio occupato sullo schermo
+	if(TextureStreamer::isEnabled())
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, data.st_buffer);
-		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-		//Texture coordinates
-		glTexCoordPointer(
-			2,
-			GL_FLOAT,
-			0,
-			(void*)0
-			);
+		float pixels = geometry->projectedSize(camera, modelview);
+		for(int i = 0; i < 8; i++)
+			if(textures[i])
+				textures[i]->touch(pixels);
+		if(atlas)
+			atlas->touch(pixels);
+		geometry->touchMaterialTextures(pixels);
 	}
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.element_buffer);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	glDrawElements(
-		GL_TRIANGLES,
-		elements.size(),
-		GL_UNSIGNED_SHORT,
-		(void*)0
-		);
-
-	glDisableClientState(GL_VERTEX_ARRAY);
-	glDisableClientState(GL_NORMAL_ARRAY);
-
-	if(textured)
-		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	vertex_decode_set_uniforms(&decodeUniforms, geometry->getDecode(), atlas ? atlas->getTransform() : NULL);
+	geometry->render(geometry->selectLod(camera, modelview, settings.lod.pixel_error), textured, &materialUniforms,
+		modelview, camera.getProjectionMatrix());
 }
 
 //Creiamo i buffer OpenGL e le texture leggendo i dati dell'obj
 int Object::makeResources()
 {
-	if (primitiveKind == "")
-	{
-
-		//Carichiamo 
-		int elementCounter = 0;
-		for (int fcount = 0; fcount < objectLoader->faceCount; fcount++)
-		{
-			obj_face *curFace = objectLoader->faceList[fcount];
-
-			for (int vcount = 0; vcount < 3; vcount++)
-			{
-				obj_vector *currentVertex = objectLoader->vertexList[curFace->vertex_index[vcount]];
-				vertices.push_back(glm::vec3(currentVertex->e[0], currentVertex->e[1], currentVertex->e[2]));
-				if (objectLoader->textureCount > 0)
-				{
-					obj_vector *currentTexture = objectLoader->textureList[curFace->texture_index[vcount]];
-					textured = true;
-					stCoordinates.push_back(glm::vec2(currentTexture->e[0], currentTexture->e[1]));
-				}
-
-				if (objectLoader->normalCount > 0)
-				{
-					obj_vector *currentNormal = objectLoader->normalList[curFace->normal_index[vcount]];
-					normals.push_back(glm::vec3(currentNormal->e[0], currentNormal->e[1], currentNormal->e[2]));
-				}
-
-				elements.push_back(elementCounter++); //Riempiamo l'element buffer con un ciclo per indicare che vogliamo caricare tutti i vertici
-			}
-		}
-	}
-	else
-	{
-		if (primitiveKind.find("sphere") == 0)
-		{
-			std::vector<std::string> values;
-			boost::split(values, primitiveKind, boost::is_any_of(" "));
-
-			int rings = 10;
-			int sectors_or_tess_level = 10;
-			string kind = "geo";
-
-			if (values.size() > 1)
-			{
-				kind = values.at(1);
-			}
-
-			if (values.size() > 3)
-			{
-				rings = atoi(values.at(3).c_str());
-			}
-
-			if (values.size() > 2)
-			{
-				sectors_or_tess_level = atoi(values.at(2).c_str());
-			}
-
-			if (kind == "geo")
-				make_sphere(vertices, normals, stCoordinates, elements, rings, sectors_or_tess_level);
-			else if (kind == "tes")
-				make_tesselated_sphere(vertices, normals, stCoordinates, elements, sectors_or_tess_level);
-		}
-		else if (primitiveKind.compare("cube") == 0)
-		{
-			make_cube(vertices, normals, stCoordinates, elements);
-		}
-		else if (primitiveKind.compare("quad") == 0)
+	//Gli oggetti con lo stesso obj o la stessa primitiva condividono i buffer
+	geometry = GeometryCache::get(geometryFileName, primitiveKind, settings);
+	if(!geometry)
+		return 0;
+	if(primitiveKind == "" && geometry->hasTexcoords())
+		textured = true;
+
+	//Con gli atlanti le texture di una geometria con coordinate in [0, 1] vengono impacchettate
+	//alla fine della scena (TextureAtlas::build); render le legge da atlas
+	bool packable = textured && TextureAtlas::isEnabled() && geometry->hasUnitTexcoords();
+	bool hasTextures = false;
+	for(int i = 0; i < 8 && packable; i++)
+		if(textureFileNames[i].compare("") != 0)
 		{
-			make_quad(vertices, normals, stCoordinates, elements);
+			packable = TextureAtlas::accepts(textureFileNames[i], textureMipmaps[i]);
+			hasTextures = true;
 		}
-	}
-	
-
-	data.vertex_buffer = make_buffer(
-		GL_ARRAY_BUFFER,
-		&vertices[0],
-		vertices.size() * sizeof(glm::vec3)
-		);
-
-	data.normal_buffer = make_buffer(
-		GL_ARRAY_BUFFER,
-		&normals[0],
-		normals.size() * sizeof(glm::vec3)
-		);
-
-
-	data.element_buffer = make_buffer(
-		GL_ELEMENT_ARRAY_BUFFER,
-		&elements[0],
-		elements.size() * sizeof(GLushort)
-		);
-
-	if(textured)
+	if(packable && hasTextures)
+		atlas = TextureAtlas::request(textureFileNames, textureMipmaps);
+	else if(textured)
 	{
-		data.st_buffer = make_buffer(
-			GL_ARRAY_BUFFER,
-			&stCoordinates[0],
-			stCoordinates.size() * sizeof(glm::vec2)
-			);
-
 		for(int i = 0; i < 8; i++)
 		{
 			if(textureFileNames[i].compare("") != 0)
 			{
-				data.textures[i] = make_texture(textureFileNames[i].c_str());
-				if(data.textures[i] == 0) //Zero in caso di errore
+				//Gli oggetti che nominano lo stesso file condividono la texture
+				textures[i] = TextureCache::get(textureFileNames[i], textureMipmaps[i]);
+				if(!textures[i])
 					return 0;
+				data.textures[i] = textures[i]->getId();
 			}
 		}
 	}
 
-	if (primitiveKind == "")
-	{
-		//Objectloader non serve pi in quanto abbiamo tutti i dati nei buffer dell'oggetto data.
-		delete objectLoader;
-	}
-
 	string vertexShaderFileName = boost::filesystem::canonical(material + ".vert").string();
 	string fragmentShaderFileName = boost::filesystem::canonical(material + ".frag").string();
 
@@ -272,12 +185,22 @@ int Object::makeResources()
 	if(shaderData.fragment_shader == 0)
 		return 0;
 
-	shaderData.program = make_program(shaderData.vertex_shader, shaderData.fragment_shader);
+	//Il programma include le funzioni animaVertex, animaNormal e animaMultiTexCoord0 del formato della geometria,
+	//che pu essere float anche se era stato chiesto quello compatto (caricamento progressivo)
+	shaderData.program = vertex_decode_make_program(shaderData.vertex_shader, shaderData.fragment_shader, geometry->getDecode() != NULL);
 
 	if(shaderData.program == 0)
 		return 0;
 
+	//Le unit dei sampler sono stato del programma e non cambiano: si impostano una volta sola
+	glUseProgram(shaderData.program);
+	for(int i = 0; i < 8; i++)
+		if(textureFileNames[i].compare("") != 0)
+			glUniform1i(glGetUniformLocation(shaderData.program, textureNames[i].c_str()), i);
+
 	lightNumberLocation = glGetUniformLocation(shaderData.program, "NUMBER_OF_LIGHTS");
+	vertex_decode_get_uniforms(shaderData.program, &decodeUniforms);
+	material_get_uniforms(shaderData.program, &materialUniforms);
 
 	for(std::map<std::string, float>::iterator it= floatParameters.begin(); it != floatParameters.end(); it++)
 	{
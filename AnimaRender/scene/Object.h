@@ -1,10 +1,17 @@
 #pragma once
 
-#include "..\objloader\objLoader.h"
 #include "..\glfuncs.h"
+#include "..\mesh\amesh.h"
+#include "..\mesh\lod.h"
+#include "Camera.h"
+#include "Geometry.h"
+#include "TextureCache.h"
+#include "TextureAtlas.h"
+#include "TextureStreamer.h"
 
 #include <string>
 #include <map>
+#include <memory>
 
 #include <vector>
 
@@ -19,25 +26,30 @@ class Object
 public:
 	Object();
 	int loadGeometry(string filename);
-	void setTexture(int id, string name, string filename);
+	void setTexture(int id, string name, string filename, mipmap_settings mipmaps);
 	void setMaterial(string filename);
 	void addParameter(string key, float value);
 	void addParameter(string key, glm::vec4 value);
+	void setLod(lod_settings lod);
+	void setCreaseAngle(float degrees);
+	void setVertexFormat(vertex_format format);
+	void setMeshletTriangles(int triangles);
+	void setStreaming(bool streaming);
 
-	void render();
+	void render(Camera &camera, const GLfloat *modelview);
 	int makeResources();
 	string primitiveKind;
 	bool textured;
 private:
-	objLoader* objectLoader;
-	std::vector<glm::vec3> vertices;
-	std::vector<GLushort> elements;
-	std::vector<glm::vec2> stCoordinates;
-	std::vector<glm::vec3> normals;
+	std::string geometryFileName;
+	std::shared_ptr<Geometry> geometry;
 
 	std::string material;
 	std::string textureNames[8];
 	std::string textureFileNames[8];
+	mipmap_settings textureMipmaps[8];
+	std::shared_ptr<Texture> textures[8];
+	std::shared_ptr<AtlasPlacement> atlas;
 
 	std::map<std::string, float> floatParameters;
 	std::map<std::string, glm::vec4> vectorParameters;
@@ -45,6 +57,10 @@ private:
 	std::map<std::string, GLint> uniformLocations;
 
 	GLint lightNumberLocation;
+	vertex_decode_uniforms decodeUniforms;
+	material_uniforms materialUniforms;
+
+	mesh_settings settings;
 
 	GlData data;
 	GLShaderData shaderData;
@@ -1,13 +1,22 @@
 #include "Scene.h"
 
 #include <fstream>
+#include <iostream>
 #include <string>
 #include <list>
 
 #include "scene_parser.h"
+#include "GeometryCache.h"
+#include "TextureCache.h"
+#include "TextureAtlas.h"
+#include "TextureStreamer.h"
+#include "../utils/timer.h"
 
 #include <GL\glew.h>
 #include <algorithm>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include <boost/filesystem.hpp>
 
@@ -19,6 +28,35 @@ std::string extractDirectory(const std::string& path )
 	return path.substr( 0, path.find_last_of( '\\' ) +1 );
 }
 
+//Raccoglie i file delle texture# di tutti gli oggetti, risolti come in parseObject,
+//cos che vengano decodificati in parallelo, con le loro mipmap, prima di creare gli oggetti
+static std::vector<std::pair<string, mipmap_settings> > sceneTextureFiles(string fileName, boost::filesystem::path scenePath)
+{
+	std::vector<std::pair<string, mipmap_settings> > fileNames;
+	ifstream fstream(fileName.c_str());
+
+	while(fstream.good() && !fstream.eof())
+	{
+		string key = getKeyword(fstream);
+		if(key.size() == 8 && key.compare(0, 7, "texture") == 0 && isdigit((unsigned char)key[7]))
+		{
+			string name;
+			fstream >> name;
+			boost::filesystem::path pathFile = scenePath / boost::filesystem::path(readString(fstream));
+			mipmap_settings mipmaps;
+			if(hasString(fstream))
+				mipmaps = readTextureOptions(readString(fstream));
+			else
+				mipmap_default_settings(&mipmaps);
+			if(boost::filesystem::exists(pathFile))
+				fileNames.push_back(std::make_pair(pathFile.string(), mipmaps));
+		}
+		else if(key.compare("#") == 0)
+			skipComment(fstream);
+	}
+	return fileNames;
+}
+
 //Caricamento della scena da file
 Scene* Scene::load(string fileName)
 {
@@ -31,6 +69,8 @@ Scene* Scene::load(string fileName)
 
 	if(fstream.good())
 	{
+		TextureCache::preload(sceneTextureFiles(fileName, scenePath));
+
 		while(!fstream.eof())
 		{
 			string key = getKeyword(fstream);
@@ -60,9 +100,103 @@ Scene* Scene::load(string fileName)
 	else
 		throw ParseException(CANT_OPEN_FILE);
 
+	if(TextureAtlas::build() != 1)
+		throw ParseException("Texture atlases cannot be created");
+	TextureCache::dropPreloaded();
+
+	if(GeometryCache::getHits() > 0)
+		cout << GeometryCache::getMisses() << " geometrie caricate, " << GeometryCache::getHits() << " oggetti le condividono" << endl;
+	if(TextureCache::getHits() > 0)
+		cout << TextureCache::getMisses() << " texture caricate, " << TextureCache::getHits() << " riusate, "
+			<< TextureCache::getBytesSaved() / 1024 << " KB risparmiati" << endl;
+
 	return scene;
 }
 
+//Scrive le cache .amesh di tutte le geometrie della scena senza creare il contesto OpenGL
+int Scene::bakeMeshCaches(string fileName)
+{
+	int result = 1;
+	boost::filesystem::path scenePath = boost::filesystem::current_path();
+	boost::filesystem::path filePath = scenePath / boost::filesystem::path(fileName);
+	ifstream fstream(filePath.string().c_str());
+
+	if(!fstream.good())
+		throw ParseException(CANT_OPEN_FILE);
+
+	//La geometria viene scritta alla fine del blocco Object, quando si conoscono le impostazioni lod
+	string geometry = "";
+	mesh_settings settings;
+	mesh_default_settings(&settings);
+
+	while(!fstream.eof())
+	{
+		string key = getKeyword(fstream);
+
+		if(key.compare("Object") == 0)
+		{
+			geometry = "";
+			mesh_default_settings(&settings);
+		}
+		else if(key.compare("geometry") == 0)
+			geometry = readString(fstream);
+		else if(key.compare("lod") == 0)
+			settings.lod = readLodSettings(readString(fstream));
+		else if(key.compare("crease") == 0)
+			settings.crease_angle = readFloat(fstream);
+		else if(key.compare("clusters") == 0)
+			settings.meshlet_triangles = (int)readFloat(fstream);
+		else if(key.compare("}") == 0 && geometry != "") //stessa risoluzione del percorso di parseObject
+		{
+			boost::filesystem::path pathFile = scenePath / boost::filesystem::path(geometry);
+			if(!boost::filesystem::exists(pathFile) || Geometry::bake(boost::filesystem::canonical(pathFile).string(), settings) != 1)
+			{
+				cout << FILE_MISSING << ": " << pathFile.string() << endl;
+				result = 0;
+			}
+			geometry = "";
+		}
+		else if(key.compare("#") == 0) //commento, va ignorato
+			skipComment(fstream);
+	}
+
+	return result;
+}
+
+//Scrive le copie compresse delle texture della scena, su tutti i core, senza creare il contesto OpenGL.
+//Le texture gi compresse (dds, ktx) o senza compressione vengono saltate
+int Scene::bakeTextureCaches(string fileName, int threads)
+{
+	boost::filesystem::path scenePath = boost::filesystem::current_path();
+	boost::filesystem::path filePath = scenePath / boost::filesystem::path(fileName);
+	if(!ifstream(filePath.string().c_str()).good())
+		throw ParseException(CANT_OPEN_FILE);
+
+	std::vector<std::pair<string, mipmap_settings> > textures = sceneTextureFiles(filePath.string(), scenePath);
+	int result = 1, baked = 0;
+	double start = timer_seconds();
+	for(size_t i = 0; i < textures.size(); i++)
+	{
+		string extension = boost::filesystem::extension(textures[i].first);
+		if(textures[i].second.compression == BCN_NONE || extension == ".dds" || extension == ".ktx")
+			continue;
+
+		texture_image image;
+		if(!decode_texture(textures[i].first.c_str(), &image, &textures[i].second, threads))
+		{
+			cout << FILE_MISSING << ": " << textures[i].first << endl;
+			result = 0;
+			continue;
+		}
+		cout << texture_compressed_cache_path(textures[i].first, &textures[i].second) << ": " << bcn_format_name(image.compression) << ", "
+			<< image.level_count << " livelli" << endl;
+		release_texture_pixels(&image);
+		baked++;
+	}
+	printf("%d texture compresse in %.3f s\n", baked, timer_seconds() - start);
+	return result;
+}
+
 Scene::Scene()
 {
 	cameras = std::vector<Camera>();
@@ -87,7 +221,13 @@ void Scene::render()
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 	glDepthMask(GL_TRUE);
-	rootTransform.render(false);
+	//Livelli delle texture in streaming chiesti nel frame precedente
+	TextureStreamer::update();
+	//Il passaggio di post-processing lega la sua texture tra un frame e l'altro
+	texture_forget_bindings();
+	Camera &camera = getActiveCamera();
+	camera.beginFrame();
+	rootTransform.render(false, camera, camera.getViewMatrix());
 }
 
 //Vai alla camera precedente
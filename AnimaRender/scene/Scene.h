@@ -9,6 +9,8 @@ public:
 	Camera& getActiveCamera();
 
 	static Scene* load(string fileName);
+	static int bakeMeshCaches(string fileName);
+	static int bakeTextureCaches(string fileName, int threads);
 	void addCamera(Camera camera);
 
 	void prevCamera();
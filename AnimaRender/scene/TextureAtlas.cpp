@@ -0,0 +1,288 @@
+#include "TextureAtlas.h"
+
+#include "../utils/parallel.h"
+#include "../utils/timer.h"
+
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+
+std::vector<std::shared_ptr<AtlasPlacement> > TextureAtlas::pending;
+bool TextureAtlas::enabled = false;
+atlas_settings TextureAtlas::settings = { 2048, 256, 4 };
+int TextureAtlas::pages = 0;
+int TextureAtlas::packedObjects = 0;
+
+AtlasPlacement::AtlasPlacement()
+{
+	packed = false;
+	transform.offset[0] = transform.offset[1] = 0.0f;
+	transform.scale[0] = transform.scale[1] = 1.0f;
+}
+
+//La texture da legare sull'unit dello slot, -1 se lo slot non ha texture
+GLuint AtlasPlacement::getTexture(int slot)
+{
+	return textures[slot] ? textures[slot]->getId() : -1;
+}
+
+//Posizione nelle pagine, NULL se le texture sono rimaste separate
+const texcoord_transform *AtlasPlacement::getTransform()
+{
+	return packed ? &transform : NULL;
+}
+
+//Le texture rimaste separate possono essere in streaming; le pagine vengono caricate intere
+void AtlasPlacement::touch(float pixels)
+{
+	if(packed)
+		return;
+	for(int i = 0; i < 8; i++)
+		if(textures[i])
+			textures[i]->touch(pixels);
+}
+
+void TextureAtlas::setEnabled(bool enabled)
+{
+	TextureAtlas::enabled = enabled;
+}
+
+void TextureAtlas::setSettings(const atlas_settings &settings)
+{
+	TextureAtlas::settings = settings;
+}
+
+bool TextureAtlas::isEnabled()
+{
+	return enabled;
+}
+
+//Solo le immagini che vengono caricate RGBA possono essere copiate in una pagina;
+//le dimensioni si conoscono solo dopo averle decodificate
+bool TextureAtlas::accepts(string fileName, const mipmap_settings &mipmaps)
+{
+	string extension = boost::filesystem::extension(fileName);
+	return mipmaps.compression == BCN_NONE && extension != ".dds" && extension != ".ktx";
+}
+
+//Registra le texture di un oggetto; le pagine vengono create da build
+std::shared_ptr<AtlasPlacement> TextureAtlas::request(const string fileNames[8], const mipmap_settings mipmaps[8])
+{
+	std::shared_ptr<AtlasPlacement> placement(new AtlasPlacement());
+	for(int i = 0; i < 8; i++)
+	{
+		placement->fileNames[i] = fileNames[i];
+		placement->mipmaps[i] = mipmaps[i];
+	}
+	pending.push_back(placement);
+	return placement;
+}
+
+//Un gruppo di oggetti che possono stare nelle stesse pagine: stessi slot con le stesse mipmap.
+//Ogni insieme di texture diverso occupa una posizione; gli oggetti con le stesse texture la condividono
+struct AtlasGroup
+{
+	int slots[8];
+	int slotCount;
+	mipmap_settings mipmaps[8];
+	std::vector<string> sets;
+	std::vector<atlas_entry> entries;
+	std::vector<std::vector<const texture_image *> > images;
+	std::vector<std::vector<std::shared_ptr<AtlasPlacement> > > placements;
+};
+
+//Impacchetta le texture chieste dagli oggetti della scena e carica le pagine.
+//Gli oggetti le cui texture sono troppo grandi, di dimensioni diverse tra gli slot o non leggibili
+//come RGBA ricevono le loro texture dalla cache. Ritorna 0 se una texture non si pu caricare
+int TextureAtlas::build()
+{
+	if(pending.empty())
+		return 1;
+	double start = timer_seconds();
+
+	//Le immagini decodificate da TextureCache::preload vengono prese dalla cache, le altre decodificate qui
+	std::vector<std::pair<string, mipmap_settings> > requests;
+	for(size_t p = 0; p < pending.size(); p++)
+		for(int i = 0; i < 8; i++)
+			if(pending[p]->fileNames[i] != "")
+				requests.push_back(std::make_pair(pending[p]->fileNames[i], pending[p]->mipmaps[i]));
+	TextureCache::preload(requests);
+
+	std::map<string, texture_image> images;
+	for(size_t r = 0; r < requests.size(); r++)
+	{
+		string key = requests[r].first + TextureCache::mipmapKey(requests[r].second);
+		if(images.find(key) != images.end())
+			continue;
+		texture_image image;
+		if(TextureCache::takePreloaded(requests[r].first, requests[r].second, image) ||
+			decode_texture(requests[r].first.c_str(), &image, &requests[r].second, 0))
+			images[key] = image;
+	}
+
+	std::map<string, AtlasGroup> groups;
+	std::vector<std::shared_ptr<AtlasPlacement> > fallback;
+	for(size_t p = 0; p < pending.size(); p++)
+	{
+		AtlasPlacement &placement = *pending[p];
+		AtlasGroup group;
+		group.slotCount = 0;
+		string signature, set;
+		std::vector<const texture_image *> setImages;
+		bool packable = true;
+		for(int i = 0; i < 8 && packable; i++)
+		{
+			if(placement.fileNames[i] == "")
+				continue;
+			string mipmapKey = TextureCache::mipmapKey(placement.mipmaps[i]);
+			std::map<string, texture_image>::iterator image = images.find(placement.fileNames[i] + mipmapKey);
+			packable = image != images.end() && image->second.compression == BCN_NONE && image->second.first_level == 0 &&
+				image->second.width <= settings.max_texture && image->second.height <= settings.max_texture &&
+				(setImages.empty() || (image->second.width == setImages[0]->width && image->second.height == setImages[0]->height));
+			if(!packable)
+				break;
+			group.slots[group.slotCount] = i;
+			group.mipmaps[group.slotCount++] = placement.mipmaps[i];
+			signature += (char)('0' + i) + mipmapKey + ";";
+			set += placement.fileNames[i] + mipmapKey + ";";
+			setImages.push_back(&image->second);
+		}
+		if(!packable || setImages.empty())
+		{
+			fallback.push_back(pending[p]);
+			continue;
+		}
+
+		std::map<string, AtlasGroup>::iterator found = groups.find(signature);
+		if(found == groups.end())
+			found = groups.insert(std::make_pair(signature, group)).first;
+		AtlasGroup &target = found->second;
+		size_t entry = std::find(target.sets.begin(), target.sets.end(), set) - target.sets.begin();
+		if(entry == target.sets.size())
+		{
+			atlas_entry placed;
+			placed.width = setImages[0]->width;
+			placed.height = setImages[0]->height;
+			target.sets.push_back(set);
+			target.entries.push_back(placed);
+			target.images.push_back(setImages);
+			target.placements.push_back(std::vector<std::shared_ptr<AtlasPlacement> >());
+		}
+		target.placements[entry].push_back(pending[p]);
+	}
+
+	//Una pagina per slot: tutte le pagine di un gruppo hanno le stesse posizioni
+	size_t bytes = 0;
+	int textures = 0;
+	for(std::map<string, AtlasGroup>::iterator it = groups.begin(); it != groups.end(); it++)
+	{
+		AtlasGroup &group = it->second;
+		int pageCount = atlas_pack(&group.entries[0], (int)group.entries.size(), &settings);
+		if(pageCount == 0) //texture pi grandi di una pagina
+			for(size_t e = 0; e < group.placements.size(); e++)
+				fallback.insert(fallback.end(), group.placements[e].begin(), group.placements[e].end());
+		for(int page = 0; page < pageCount; page++)
+		{
+			std::vector<int> onPage;
+			for(size_t e = 0; e < group.entries.size(); e++)
+				if(group.entries[e].page == page)
+					onPage.push_back((int)e);
+
+			for(int s = 0; s < group.slotCount; s++)
+			{
+				//senza mipmap la pagina ha un solo livello; le posizioni non cambiano
+				atlas_settings layer = settings;
+				if(group.mipmaps[s].filter == MIPMAP_NONE)
+					layer.levels = 1;
+
+				texture_image image;
+				image.pixels = calloc(atlas_page_bytes(&layer), 1);
+				image.width = image.height = layer.page_size;
+				image.format = GL_RGBA;
+				image.level_count = atlas_page_levels(&layer);
+				image.first_level = 0;
+				image.compression = BCN_NONE;
+				parallel_for((int)onPage.size(), 0, [&](int i) {
+					atlas_blit((unsigned char *)image.pixels, &group.entries[onPage[i]],
+						(const unsigned char *)group.images[onPage[i]][s]->pixels, &layer, &group.mipmaps[s]);
+				});
+
+				size_t pageBytes = 0;
+				GLuint id = upload_texture(&image, &pageBytes);
+				if(id == 0)
+					return 0;
+				std::shared_ptr<Texture> texture(new Texture(id, pageBytes));
+				bytes += pageBytes;
+				pages++;
+				for(size_t i = 0; i < onPage.size(); i++)
+					for(size_t p = 0; p < group.placements[onPage[i]].size(); p++)
+						group.placements[onPage[i]][p]->textures[group.slots[s]] = texture;
+			}
+
+			for(size_t i = 0; i < onPage.size(); i++)
+			{
+				texcoord_transform transform;
+				atlas_texcoord_transform(&group.entries[onPage[i]], &settings, transform.offset, transform.scale);
+				for(size_t p = 0; p < group.placements[onPage[i]].size(); p++)
+				{
+					group.placements[onPage[i]][p]->transform = transform;
+					group.placements[onPage[i]][p]->packed = true;
+					packedObjects++;
+				}
+			}
+			textures += (int)onPage.size() * group.slotCount;
+		}
+	}
+
+	//Le immagini che servono agli oggetti rimasti fuori tornano alla cache, che le caricher senza decodificarle di nuovo
+	for(size_t p = 0; p < fallback.size(); p++)
+		for(int i = 0; i < 8; i++)
+		{
+			if(fallback[p]->fileNames[i] == "")
+				continue;
+			string key = fallback[p]->fileNames[i] + TextureCache::mipmapKey(fallback[p]->mipmaps[i]);
+			std::map<string, texture_image>::iterator image = images.find(key);
+			if(image != images.end())
+			{
+				TextureCache::putPreloaded(fallback[p]->fileNames[i], fallback[p]->mipmaps[i], image->second);
+				images.erase(image);
+			}
+		}
+	for(std::map<string, texture_image>::iterator it = images.begin(); it != images.end(); it++)
+		release_texture_pixels(&it->second);
+
+	for(size_t p = 0; p < fallback.size(); p++)
+		for(int i = 0; i < 8; i++)
+			if(fallback[p]->fileNames[i] != "")
+			{
+				fallback[p]->textures[i] = TextureCache::get(fallback[p]->fileNames[i], fallback[p]->mipmaps[i]);
+				if(!fallback[p]->textures[i])
+					return 0;
+			}
+
+	printf("%d texture in %d pagine di atlante (%d KB) per %d oggetti, %d oggetti con texture proprie, %.3f s\n",
+		textures, pages, (int)(bytes / 1024), packedObjects, (int)fallback.size(), timer_seconds() - start);
+	pending.clear();
+	return 1;
+}
+
+//Pagine create, una per slot e gruppo
+int TextureAtlas::getPages()
+{
+	return pages;
+}
+
+//Un'immagine decodificata che build potrebbe copiare in una pagina: TextureCache::preload
+//non ne scarta i livelli grandi nemmeno con lo streaming
+bool TextureAtlas::mayPack(const texture_image &image)
+{
+	return enabled && image.compression == BCN_NONE && image.width <= settings.max_texture && image.height <= settings.max_texture;
+}
+
+//Oggetti disegnati da un atlante
+int TextureAtlas::getPackedObjects()
+{
+	return packedObjects;
+}
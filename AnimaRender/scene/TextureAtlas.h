@@ -0,0 +1,57 @@
+#pragma once
+
+#include "..\glfuncs.h"
+#include "..\mesh\vertex_format.h"
+#include "..\texture-formats\atlas.h"
+#include "TextureCache.h"
+
+#include <string>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+//Le texture di un oggetto: le pagine di un atlante e la posizione dell'oggetto in esse,
+//oppure le sue texture, se non  stato possibile impacchettarle. Viene riempita da TextureAtlas::build
+class AtlasPlacement
+{
+public:
+	AtlasPlacement();
+
+	GLuint getTexture(int slot);
+	const texcoord_transform *getTransform();
+	void touch(float pixels);
+private:
+	friend class TextureAtlas;
+
+	string fileNames[8];
+	mipmap_settings mipmaps[8];
+	std::shared_ptr<Texture> textures[8];
+	bool packed;
+	texcoord_transform transform;
+};
+
+//Atlanti delle texture piccole (--texture-atlas): gli oggetti con coordinate texture in [0, 1] chiedono
+//le loro texture con request e, finita la scena, build le copia una accanto all'altra in pagine grandi,
+//cos che oggetti diversi disegnino senza cambiare texture. Le texture dei diversi slot di un oggetto
+//finiscono nella stessa posizione di pagine parallele (una per slot), perch la trasformazione delle
+//coordinate  una sola. Il bordo e le mipmap delle pagine sono descritti in atlas.h
+class TextureAtlas
+{
+public:
+	static void setEnabled(bool enabled);
+	static void setSettings(const atlas_settings &settings);
+	static bool isEnabled();
+	static bool accepts(string fileName, const mipmap_settings &mipmaps);
+	static bool mayPack(const texture_image &image);
+	static std::shared_ptr<AtlasPlacement> request(const string fileNames[8], const mipmap_settings mipmaps[8]);
+	static int build();
+	static int getPages();
+	static int getPackedObjects();
+private:
+	static std::vector<std::shared_ptr<AtlasPlacement> > pending;
+	static bool enabled;
+	static atlas_settings settings;
+	static int pages;
+	static int packedObjects;
+};
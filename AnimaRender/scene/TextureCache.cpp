@@ -0,0 +1,281 @@
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "TextureAtlas.h"
+
+#include "../utils/mapped_file.h"
+#include "../utils/parallel.h"
+#include "../utils/timer.h"
+
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+
+std::map<string, std::weak_ptr<Texture> > TextureCache::entries;
+std::map<string, std::weak_ptr<Texture> > TextureCache::contents;
+std::map<string, texture_image> TextureCache::preloaded;
+bool TextureCache::contentHash = false;
+int TextureCache::decodeThreads = 0;
+int TextureCache::hits = 0;
+int TextureCache::misses = 0;
+size_t TextureCache::bytesSaved = 0;
+
+Texture::Texture(GLuint id, size_t bytes)
+{
+	this->id = id;
+	this->bytes = bytes;
+	streamId = 0;
+}
+
+Texture::~Texture()
+{
+	if(streamId != 0)
+		TextureStreamer::forget(streamId);
+	glDeleteTextures(1, &id);
+	texture_forget_bindings(); //l'id pu essere riusato da una texture nuova
+}
+
+GLuint Texture::getId()
+{
+	return id;
+}
+
+//Memoria occupata dalla texture, per le statistiche della cache
+size_t Texture::getBytes()
+{
+	return bytes;
+}
+
+//Con lo streaming riporta quanti pixel copre la texture sullo schermo, per scegliere i livelli da caricare
+void Texture::touch(float pixels)
+{
+	if(streamId != 0)
+		TextureStreamer::touch(streamId, pixels);
+}
+
+//Con il confronto dei contenuti ogni texture nuova viene letta anche per calcolarne l'hash
+void TextureCache::setContentHash(bool enabled)
+{
+	contentHash = enabled;
+}
+
+//Thread usati da preload, 0 per tutti i core
+void TextureCache::setDecodeThreads(int threads)
+{
+	decodeThreads = threads;
+}
+
+//Lo stesso file pu essere nominato con percorsi diversi (relativi, con .. o separatori diversi)
+string TextureCache::canonicalPath(string fileName)
+{
+	boost::system::error_code error;
+	boost::filesystem::path path = boost::filesystem::canonical(fileName, error);
+	return error ? fileName : path.string();
+}
+
+//Parte della chiave che distingue le versioni di uno stesso file con filtri diversi
+string TextureCache::mipmapKey(const mipmap_settings &mipmaps)
+{
+	ostringstream stream;
+	stream << "|mip" << mipmaps.filter;
+	if(mipmaps.filter != MIPMAP_NONE && mipmaps.gamma)
+		stream << "g";
+	if(mipmaps.premultiply)
+		stream << "|pm";
+	if(mipmaps.compression != BCN_NONE)
+		stream << "|" << bcn_format_name(mipmaps.compression);
+	return stream.str();
+}
+
+//Chiave del contenuto: dimensione e hash FNV-1a a 64 bit dei byte del file
+bool TextureCache::contentKey(string fileName, string &key)
+{
+	mapped_file file;
+	if(!map_file(&file, fileName.c_str()))
+		return false;
+
+	unsigned long long hash = 14695981039346656037ULL;
+	for(size_t i = 0; i < file.size; i++)
+	{
+		hash ^= (unsigned char)file.data[i];
+		hash *= 1099511628211ULL;
+	}
+
+	ostringstream stream;
+	stream << file.size << ":" << std::hex << hash;
+	key = stream.str();
+	unmap_file(&file);
+	return true;
+}
+
+std::shared_ptr<Texture> TextureCache::find(std::map<string, std::weak_ptr<Texture> > &cache, string key)
+{
+	std::map<string, std::weak_ptr<Texture> >::iterator it = cache.find(key);
+	if(it == cache.end())
+		return std::shared_ptr<Texture>();
+	return it->second.lock();
+}
+
+//Ritorna la texture condivisa, caricandola se nessuno la usa ancora. Null in caso di errore
+std::shared_ptr<Texture> TextureCache::get(string fileName, const mipmap_settings &mipmaps)
+{
+	string path = canonicalPath(fileName);
+	string key = path + mipmapKey(mipmaps);
+
+	std::shared_ptr<Texture> texture = find(entries, key);
+	if(texture)
+	{
+		hits++;
+		bytesSaved += texture->getBytes();
+		printf("%s: texture condivisa (%d utenti)\n", fileName.c_str(), (int)texture.use_count());
+		return texture;
+	}
+
+	//Una texture decodificata da preload viene solo caricata
+	texture_image image;
+	bool decoded = false;
+	std::map<string, texture_image>::iterator pending = preloaded.find(key);
+	if(pending != preloaded.end())
+	{
+		image = pending->second;
+		preloaded.erase(pending);
+		decoded = true;
+	}
+
+	string content;
+	if(contentHash && contentKey(path, content))
+	{
+		content += mipmapKey(mipmaps);
+		texture = find(contents, content);
+		if(texture)
+		{
+			if(decoded)
+				release_texture_pixels(&image);
+			hits++;
+			bytesSaved += texture->getBytes();
+			entries[key] = texture;
+			printf("%s: stesso contenuto di una texture gi caricata\n", fileName.c_str());
+			return texture;
+		}
+	}
+
+	//Una texture che non andr in streaming viene decodificata direttamente nel buffer da cui la legge il driver
+	if(!decoded && !(TextureStreamer::isEnabled() && mipmaps.filter != MIPMAP_NONE))
+	{
+		size_t bytes = 0;
+		GLuint id = make_texture(path.c_str(), &mipmaps, &bytes);
+		if(id == 0)
+			return texture;
+		texture.reset(new Texture(id, bytes));
+	}
+	else if(!decoded && !decode_texture(path.c_str(), &image, &mipmaps, 0))
+		return std::shared_ptr<Texture>();
+	//Con un budget di memoria video le texture con mipmap partono dai livelli piccoli
+	else if(TextureStreamer::accepts(image))
+	{
+		texture = TextureStreamer::create(path, mipmaps, image);
+		if(!texture)
+			return texture;
+	}
+	else
+	{
+		size_t bytes = 0;
+		GLuint id = upload_texture(&image, &bytes);
+		if(id == 0) //formato compresso non supportato dal driver
+			return texture;
+		texture.reset(new Texture(id, bytes));
+	}
+	misses++;
+	entries[key] = texture;
+	if(!content.empty())
+		contents[content] = texture;
+	return texture;
+}
+
+//Decodifica su pi thread i file non ancora in cache; get li trover gi pronti.
+//I file che non si possono leggere vengono lasciati a get, che riporter l'errore.
+//Ogni thread calcola da solo le mipmap delle sue texture
+void TextureCache::preload(const std::vector<std::pair<string, mipmap_settings> > &requests)
+{
+	std::vector<string> paths, keys;
+	std::vector<mipmap_settings> settings;
+	for(size_t i = 0; i < requests.size(); i++)
+	{
+		string path = canonicalPath(requests[i].first);
+		string key = path + mipmapKey(requests[i].second);
+		if(!find(entries, key) && preloaded.find(key) == preloaded.end() && std::find(keys.begin(), keys.end(), key) == keys.end())
+		{
+			paths.push_back(path);
+			keys.push_back(key);
+			settings.push_back(requests[i].second);
+		}
+	}
+	if(paths.empty())
+		return;
+
+	std::vector<texture_image> images(paths.size());
+	std::vector<int> decoded(paths.size(), 0);
+	double start = timer_seconds();
+	parallel_for((int)paths.size(), decodeThreads, [&](int i) {
+		decoded[i] = decode_texture(paths[i].c_str(), &images[i], &settings[i], 1);
+		//con lo streaming resta in memoria solo la coda, a meno che la texture non finisca in un atlante
+		if(decoded[i] && TextureStreamer::accepts(images[i]) && !TextureAtlas::mayPack(images[i]))
+			TextureStreamer::keepTail(images[i]);
+	});
+
+	int count = 0;
+	for(size_t i = 0; i < paths.size(); i++)
+		if(decoded[i])
+		{
+			preloaded[keys[i]] = images[i];
+			count++;
+		}
+
+	int threads = decodeThreads > 0 ? decodeThreads : hardware_threads();
+	printf("%d texture decodificate in %.3f s (%d thread)\n", count, timer_seconds() - start,
+		std::min(threads, (int)paths.size()));
+}
+
+//Libera le texture decodificate che nessuno ha chiesto (oggetti non caricati per un errore)
+void TextureCache::dropPreloaded()
+{
+	for(std::map<string, texture_image>::iterator it = preloaded.begin(); it != preloaded.end(); it++)
+		release_texture_pixels(&it->second);
+	preloaded.clear();
+}
+
+//Toglie dalla cache un'immagine decodificata da preload, che passa al chiamante (gli atlanti)
+bool TextureCache::takePreloaded(string fileName, const mipmap_settings &mipmaps, texture_image &image)
+{
+	std::map<string, texture_image>::iterator pending = preloaded.find(canonicalPath(fileName) + mipmapKey(mipmaps));
+	if(pending == preloaded.end())
+		return false;
+	image = pending->second;
+	preloaded.erase(pending);
+	return true;
+}
+
+//Restituisce un'immagine presa con takePreloaded e non usata: get la caricher senza decodificarla di nuovo
+void TextureCache::putPreloaded(string fileName, const mipmap_settings &mipmaps, const texture_image &image)
+{
+	preloaded[canonicalPath(fileName) + mipmapKey(mipmaps)] = image;
+}
+
+//Richieste servite da una texture gi caricata
+int TextureCache::getHits()
+{
+	return hits;
+}
+
+//Texture effettivamente decodificate e caricate
+int TextureCache::getMisses()
+{
+	return misses;
+}
+
+//Memoria video che le richieste servite dalla cache avrebbero occupato con una copia propria
+size_t TextureCache::getBytesSaved()
+{
+	return bytesSaved;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "..\glfuncs.h"
+
+#include <string>
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+//Una texture OpenGL letta da file; viene distrutta con l'ultimo oggetto o materiale che la usa
+class Texture
+{
+public:
+	Texture(GLuint id, size_t bytes);
+	~Texture();
+
+	GLuint getId();
+	size_t getBytes();
+	void touch(float pixels);
+private:
+	friend class TextureStreamer;
+	//La texture OpenGL appartiene a una sola istanza
+	Texture(const Texture &other);
+	Texture &operator=(const Texture &other);
+
+	GLuint id;
+	size_t bytes;
+	//Indice in TextureStreamer, 0 se la texture  stata caricata intera
+	int streamId;
+};
+
+//Cache di processo delle texture: ogni file viene decodificato e caricato una volta sola,
+//qualunque sia il numero di oggetti (texture#) o di materiali (map_Kd) che lo usano.
+//La chiave  il percorso canonico; con setContentHash anche file diversi con lo stesso contenuto
+//vengono riconosciuti. Come GeometryCache tiene solo riferimenti deboli.
+//preload decodifica in parallelo le texture che verranno chieste: a get resta solo glTexImage2D,
+//che deve girare sul thread OpenGL. Lo stesso file con mipmap diverse  una texture diversa.
+class TextureCache
+{
+public:
+	static std::shared_ptr<Texture> get(string fileName, const mipmap_settings &mipmaps);
+	static void preload(const std::vector<std::pair<string, mipmap_settings> > &requests);
+	static void dropPreloaded();
+	static bool takePreloaded(string fileName, const mipmap_settings &mipmaps, texture_image &image);
+	static void putPreloaded(string fileName, const mipmap_settings &mipmaps, const texture_image &image);
+	static void setContentHash(bool enabled);
+	static void setDecodeThreads(int threads);
+	static string mipmapKey(const mipmap_settings &mipmaps);
+	static int getHits();
+	static int getMisses();
+	static size_t getBytesSaved();
+private:
+	static string canonicalPath(string fileName);
+	static bool contentKey(string fileName, string &key);
+	static std::shared_ptr<Texture> find(std::map<string, std::weak_ptr<Texture> > &cache, string key);
+
+	static std::map<string, std::weak_ptr<Texture> > entries;
+	static std::map<string, std::weak_ptr<Texture> > contents;
+	//Per chiave (percorso e mipmap) le immagini gi decodificate
+	static std::map<string, texture_image> preloaded;
+	static bool contentHash;
+	static int decodeThreads;
+	static int hits;
+	static int misses;
+	static size_t bytesSaved;
+};
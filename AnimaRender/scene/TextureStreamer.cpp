@@ -0,0 +1,408 @@
+#include "TextureStreamer.h"
+
+#include "../utils/timer.h"
+
+#include <stdlib.h>
+#include <algorithm>
+
+std::map<int, TextureStreamer::StreamedTexture> TextureStreamer::textures;
+int TextureStreamer::nextId = 1;
+size_t TextureStreamer::budget = 0;
+int TextureStreamer::threads = 2;
+unsigned long TextureStreamer::frame = 1;
+
+std::vector<std::thread> TextureStreamer::workers;
+std::mutex TextureStreamer::mutex;
+std::condition_variable TextureStreamer::wake;
+std::deque<TextureStreamer::Request> TextureStreamer::requests;
+std::deque<TextureStreamer::Result> TextureStreamer::results;
+bool TextureStreamer::stop = false;
+
+size_t TextureStreamer::residentBytes = 0;
+size_t TextureStreamer::peakBytes = 0;
+int TextureStreamer::requestCount = 0;
+int TextureStreamer::levelsLoaded = 0;
+int TextureStreamer::levelsEvicted = 0;
+int TextureStreamer::latencyCount = 0;
+double TextureStreamer::latencySum = 0.0;
+double TextureStreamer::latencyMax = 0.0;
+
+//Il primo livello con il lato pi lungo entro TEXTURE_STREAM_TAIL_SIZE
+static int tail_level(int width, int height, int levelCount)
+{
+	int level = 0;
+	while(level < levelCount - 1 &&
+		std::max(mipmap_level_size(width, level), mipmap_level_size(height, level)) > TEXTURE_STREAM_TAIL_SIZE)
+		level++;
+	return level;
+}
+
+//Memoria video massima per le texture, 0 per caricarle intere
+void TextureStreamer::setBudget(size_t bytes)
+{
+	budget = bytes;
+}
+
+//Thread che decodificano i livelli chiesti
+void TextureStreamer::setThreads(int threads)
+{
+	TextureStreamer::threads = std::max(threads, 1);
+}
+
+bool TextureStreamer::isEnabled()
+{
+	return budget > 0;
+}
+
+//Solo le immagini con livelli pi grandi della coda vale la pena di caricarle a pezzi
+bool TextureStreamer::accepts(const texture_image &image)
+{
+	return isEnabled() && image.level_count > 1 && tail_level(image.width, image.height, image.level_count) > 0;
+}
+
+//Scarta i livelli pi grandi della coda di un'immagine appena decodificata, che create non caricherebbe.
+//Non usa OpenGL: TextureCache::preload la chiama dai suoi thread
+void TextureStreamer::keepTail(texture_image &image)
+{
+	drop_texture_levels(&image, tail_level(image.width, image.height, image.level_count));
+}
+
+//Crea la texture con i soli livelli della coda; l'immagine viene rilasciata come da upload_texture
+std::shared_ptr<Texture> TextureStreamer::create(string fileName, const mipmap_settings &mipmaps, texture_image &image)
+{
+	StreamedTexture streamed;
+	streamed.fileName = fileName;
+	streamed.mipmaps = mipmaps;
+	streamed.width = image.width;
+	streamed.height = image.height;
+	streamed.levelCount = image.level_count;
+	streamed.compression = image.compression;
+	streamed.tailLevel = tail_level(image.width, image.height, image.level_count);
+	streamed.baseLevel = streamed.wantedLevel = streamed.tailLevel;
+	streamed.lastUsed = 0;
+	streamed.pixels = 0.0f;
+	streamed.requested = false;
+	streamed.refused = false;
+	streamed.requestTime = 0.0;
+
+	size_t bytes = 0;
+	GLuint id = upload_texture_from_level(&image, streamed.tailLevel, &bytes);
+	if(id == 0)
+		return std::shared_ptr<Texture>();
+
+	std::shared_ptr<Texture> texture(new Texture(id, bytes));
+	texture->streamId = nextId;
+	streamed.texture = texture.get();
+	textures[nextId++] = streamed;
+	residentBytes += bytes;
+	peakBytes = std::max(peakBytes, residentBytes);
+	return texture;
+}
+
+//Un oggetto disegna la texture coprendo circa pixels pixel sullo schermo in questo frame
+void TextureStreamer::touch(int streamId, float pixels)
+{
+	std::map<int, StreamedTexture>::iterator it = textures.find(streamId);
+	if(it == textures.end())
+		return;
+	StreamedTexture &streamed = it->second;
+	if(streamed.lastUsed != frame)
+	{
+		streamed.lastUsed = frame;
+		streamed.pixels = 0.0f;
+	}
+	streamed.pixels = std::max(streamed.pixels, pixels);
+}
+
+//La texture  stata distrutta: la sua memoria torna libera e i livelli in arrivo vengono scartati
+void TextureStreamer::forget(int streamId)
+{
+	std::map<int, StreamedTexture>::iterator it = textures.find(streamId);
+	if(it == textures.end())
+		return;
+	residentBytes -= levelBytes(it->second, it->second.baseLevel, it->second.levelCount);
+	textures.erase(it);
+	clearRefused();
+}
+
+//Si  liberata memoria: le texture rimaste senza livelli li chiedono di nuovo
+void TextureStreamer::clearRefused()
+{
+	for(std::map<int, StreamedTexture>::iterator it = textures.begin(); it != textures.end(); it++)
+		it->second.refused = false;
+}
+
+//Da chiamare una volta per frame, prima di disegnare, sul thread OpenGL
+void TextureStreamer::update()
+{
+	if(budget == 0)
+		return;
+	double now = timer_seconds();
+
+	//Livelli voluti in base ai pixel del frame precedente: il pi piccolo che copre ancora quei pixel.
+	//Le texture non disegnate tornano alla coda
+	bool evictable = false;
+	for(std::map<int, StreamedTexture>::iterator it = textures.begin(); it != textures.end(); it++)
+	{
+		StreamedTexture &streamed = it->second;
+		int wanted = streamed.tailLevel;
+		if(streamed.lastUsed == frame && streamed.pixels > 0.0f)
+		{
+			wanted = 0;
+			while(wanted < streamed.tailLevel &&
+				std::max(mipmap_level_size(streamed.width, wanted + 1), mipmap_level_size(streamed.height, wanted + 1)) >= streamed.pixels)
+				wanted++;
+		}
+		if(wanted != streamed.wantedLevel)
+			streamed.refused = false;
+		//i livelli che non servono pi possono fare spazio alle texture rimaste senza
+		if(wanted > streamed.wantedLevel && streamed.baseLevel < wanted)
+			evictable = true;
+		streamed.wantedLevel = wanted;
+	}
+	if(evictable)
+		clearRefused();
+
+	bool queued = false;
+	for(std::map<int, StreamedTexture>::iterator it = textures.begin(); it != textures.end(); it++)
+	{
+		StreamedTexture &streamed = it->second;
+		if(streamed.wantedLevel < streamed.baseLevel && !streamed.requested && !streamed.refused)
+		{
+			Request request;
+			request.streamId = it->first;
+			request.fileName = streamed.fileName;
+			request.mipmaps = streamed.mipmaps;
+			request.pixels = streamed.pixels;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				requests.push_back(request);
+			}
+			streamed.requested = true;
+			streamed.requestTime = now;
+			requestCount++;
+			queued = true;
+		}
+	}
+	if(queued)
+	{
+		if(workers.empty())
+			startWorkers();
+		wake.notify_all();
+	}
+
+	//Immagini decodificate dai thread, entro il tempo concesso al frame
+	while(timer_seconds() - now < TEXTURE_STREAM_UPLOAD_SECONDS)
+	{
+		Result result;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(results.empty())
+				break;
+			result = results.front();
+			results.pop_front();
+		}
+		std::map<int, StreamedTexture>::iterator it = textures.find(result.streamId);
+		if(it != textures.end())
+		{
+			StreamedTexture &streamed = it->second;
+			streamed.requested = false;
+			//il file pu essere cambiato su disco nel frattempo
+			if(result.decoded && result.image.width == streamed.width && result.image.height == streamed.height &&
+				result.image.level_count == streamed.levelCount && result.image.compression == streamed.compression)
+				load(streamed, result.image);
+		}
+		if(result.decoded)
+			release_texture_pixels(&result.image);
+	}
+	frame++;
+}
+
+//Memoria video dei livelli [first, end) di una texture
+size_t TextureStreamer::levelBytes(const StreamedTexture &streamed, int first, int end)
+{
+	size_t bytes = 0;
+	for(int level = first; level < end; level++)
+		bytes += texture_level_memory(streamed.width, streamed.height, streamed.compression, level);
+	return bytes;
+}
+
+//Libera i livelli pi fini di end
+void TextureStreamer::unload(StreamedTexture &streamed, int end)
+{
+	if(end <= streamed.baseLevel)
+		return;
+	size_t bytes = levelBytes(streamed, streamed.baseLevel, end);
+	texture_unload_levels(streamed.texture->getId(), streamed.baseLevel, end);
+	residentBytes -= bytes;
+	streamed.texture->bytes -= bytes;
+	levelsEvicted += end - streamed.baseLevel;
+	streamed.baseLevel = end;
+	clearRefused();
+}
+
+//Memoria che si pu liberare dalle altre texture: i livelli pi fini di quelli che vogliono
+size_t TextureStreamer::evictableBytes(int keepId)
+{
+	size_t bytes = 0;
+	for(std::map<int, StreamedTexture>::iterator it = textures.begin(); it != textures.end(); it++)
+		if(it->first != keepId && it->second.baseLevel < it->second.wantedLevel)
+			bytes += levelBytes(it->second, it->second.baseLevel, it->second.wantedLevel);
+	return bytes;
+}
+
+//Fa spazio per bytes liberando i livelli che le altre texture non usano, dalle meno recenti,
+//finch non si rientra nel budget
+void TextureStreamer::makeRoom(size_t bytes, int keepId)
+{
+	if(residentBytes + bytes <= budget)
+		return;
+
+	std::vector<std::pair<unsigned long, int> > candidates;
+	for(std::map<int, StreamedTexture>::iterator it = textures.begin(); it != textures.end(); it++)
+		if(it->first != keepId && it->second.baseLevel < it->second.wantedLevel)
+			candidates.push_back(std::make_pair(it->second.lastUsed, it->first));
+	std::sort(candidates.begin(), candidates.end());
+
+	//un livello alla volta, dal pi fine
+	for(size_t c = 0; c < candidates.size() && residentBytes + bytes > budget; c++)
+	{
+		StreamedTexture &streamed = textures[candidates[c].second];
+		while(streamed.baseLevel < streamed.wantedLevel && residentBytes + bytes > budget)
+			unload(streamed, streamed.baseLevel + 1);
+	}
+}
+
+//Carica i livelli mancanti fino a quello voluto, o quanti ne stanno nel budget.
+//Prima si decide quanti livelli entrano, poi si libera solo la memoria che serve
+void TextureStreamer::load(StreamedTexture &streamed, const texture_image &image)
+{
+	int end = streamed.baseLevel;
+	int first = streamed.wantedLevel;
+	int keepId = streamed.texture->streamId;
+	size_t available = budget + evictableBytes(keepId);
+	size_t room = available > residentBytes ? available - residentBytes : 0;
+	while(first < end && levelBytes(streamed, first, end) > room)
+		first++;
+	if(first < end)
+		makeRoom(levelBytes(streamed, first, end), keepId);
+	//senza spazio non si chiede di nuovo finch non cambia il livello voluto o non si libera memoria
+	streamed.refused = first > streamed.wantedLevel;
+	if(first >= end)
+		return;
+
+	size_t bytes = texture_load_levels(streamed.texture->getId(), &image, first, end);
+	residentBytes += bytes;
+	peakBytes = std::max(peakBytes, residentBytes);
+	streamed.texture->bytes += bytes;
+	levelsLoaded += end - first;
+	streamed.baseLevel = first;
+
+	double latency = timer_seconds() - streamed.requestTime;
+	latencySum += latency;
+	latencyMax = std::max(latencyMax, latency);
+	latencyCount++;
+}
+
+void TextureStreamer::startWorkers()
+{
+	stop = false;
+	for(int i = 0; i < threads; i++)
+		workers.push_back(std::thread(run));
+	static bool registered = false;
+	if(!registered)
+	{
+		atexit(stopWorkers);
+		registered = true;
+	}
+}
+
+//Ferma i thread e libera le immagini decodificate e mai caricate
+void TextureStreamer::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	wake.notify_all();
+	for(size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+
+	requests.clear();
+	for(size_t i = 0; i < results.size(); i++)
+		if(results[i].decoded)
+			release_texture_pixels(&results[i].image);
+	results.clear();
+}
+
+//Thread di decodifica: prende sempre la richiesta della texture pi grande sullo schermo
+void TextureStreamer::run()
+{
+	for(;;)
+	{
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [] { return stop || !requests.empty(); });
+			if(stop)
+				return;
+			std::deque<Request>::iterator best = requests.begin();
+			for(std::deque<Request>::iterator it = requests.begin(); it != requests.end(); it++)
+				if(it->pixels > best->pixels)
+					best = it;
+			request = *best;
+			requests.erase(best);
+		}
+
+		Result result;
+		result.streamId = request.streamId;
+		result.decoded = decode_texture(request.fileName.c_str(), &result.image, &request.mipmaps, 1);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		results.push_back(result);
+	}
+}
+
+//Memoria video occupata dalle texture in streaming
+size_t TextureStreamer::getResidentBytes()
+{
+	return residentBytes;
+}
+
+size_t TextureStreamer::getPeakBytes()
+{
+	return peakBytes;
+}
+
+size_t TextureStreamer::getBudget()
+{
+	return budget;
+}
+
+//Decodifiche chieste ai thread
+int TextureStreamer::getRequests()
+{
+	return requestCount;
+}
+
+int TextureStreamer::getLevelsLoaded()
+{
+	return levelsLoaded;
+}
+
+int TextureStreamer::getLevelsEvicted()
+{
+	return levelsEvicted;
+}
+
+//Secondi tra la richiesta di livelli e il loro caricamento
+double TextureStreamer::getAverageLatency()
+{
+	return latencyCount > 0 ? latencySum / latencyCount : 0.0;
+}
+
+double TextureStreamer::getMaxLatency()
+{
+	return latencyMax;
+}
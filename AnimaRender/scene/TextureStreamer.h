@@ -0,0 +1,108 @@
+#pragma once
+
+#include "..\glfuncs.h"
+#include "TextureCache.h"
+
+#include <string>
+#include <map>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+//Le texture vengono create con i soli livelli fino a questo lato; gli altri arrivano quando servono
+#define TEXTURE_STREAM_TAIL_SIZE 64
+//Tempo massimo per frame speso a caricare i livelli decodificati, come per le mesh in streaming
+#define TEXTURE_STREAM_UPLOAD_SECONDS 0.004
+
+//Residenza delle texture con mipmap (--texture-budget). Al caricamento della scena ogni texture riceve
+//solo i livelli piccoli; durante il rendering gli oggetti riportano con touch quanti pixel occupano sullo
+//schermo e update, all'inizio di ogni frame, chiede ai thread di decodificare di nuovo i file di cui
+//servono livelli pi grandi. I livelli arrivati vengono caricati entro il budget di memoria video,
+//liberando quelli pi fini del necessario delle texture usate meno di recente.
+//Una texture non cambia mai id: si spostano solo il livello base e i livelli allocati
+class TextureStreamer
+{
+public:
+	static void setBudget(size_t bytes);
+	static void setThreads(int threads);
+	static bool isEnabled();
+	static bool accepts(const texture_image &image);
+	static void keepTail(texture_image &image);
+	static std::shared_ptr<Texture> create(string fileName, const mipmap_settings &mipmaps, texture_image &image);
+	static void touch(int streamId, float pixels);
+	static void forget(int streamId);
+	static void update();
+	static size_t getResidentBytes();
+	static size_t getPeakBytes();
+	static size_t getBudget();
+	static int getRequests();
+	static int getLevelsLoaded();
+	static int getLevelsEvicted();
+	static double getAverageLatency();
+	static double getMaxLatency();
+private:
+	//Stato di una texture in streaming: sono allocati i livelli da baseLevel in poi
+	struct StreamedTexture
+	{
+		Texture *texture;
+		string fileName;
+		mipmap_settings mipmaps;
+		int width, height, levelCount;
+		bcn_format compression;
+		int baseLevel, tailLevel, wantedLevel;
+		unsigned long lastUsed;
+		float pixels;
+		bool requested, refused;
+		double requestTime;
+	};
+	struct Request
+	{
+		int streamId;
+		string fileName;
+		mipmap_settings mipmaps;
+		float pixels;
+	};
+	struct Result
+	{
+		int streamId;
+		texture_image image;
+		int decoded;
+	};
+
+	static void startWorkers();
+	static void stopWorkers();
+	static void run();
+	static size_t levelBytes(const StreamedTexture &streamed, int first, int end);
+	static void unload(StreamedTexture &streamed, int end);
+	static size_t evictableBytes(int keepId);
+	static void makeRoom(size_t bytes, int keepId);
+	static void clearRefused();
+	static void load(StreamedTexture &streamed, const texture_image &image);
+
+	static std::map<int, StreamedTexture> textures;
+	static int nextId;
+	static size_t budget;
+	static int threads;
+	static unsigned long frame;
+
+	static std::vector<std::thread> workers;
+	static std::mutex mutex;
+	static std::condition_variable wake;
+	static std::deque<Request> requests;
+	static std::deque<Result> results;
+	static bool stop;
+
+	static size_t residentBytes;
+	static size_t peakBytes;
+	static int requestCount;
+	static int levelsLoaded;
+	static int levelsEvicted;
+	static int latencyCount;
+	static double latencySum;
+	static double latencyMax;
+};
@@ -1,6 +1,36 @@
 #include "Transform.h"
 
 #include <GL\glew.h>
+#include <math.h>
+
+//Copia sulla cpu di glTranslatef, glRotatef e glScalef applicate a parent (matrici per colonne)
+static void transform_matrix(const GLfloat *parent, glm::vec3 translation, float degrees, glm::vec3 axis, glm::vec3 scale, GLfloat *out)
+{
+	GLfloat local[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+	float length = glm::length(axis);
+	if(length > 0.0f)
+	{
+		float radians = degrees * 3.14159265f / 180.0f;
+		float c = cosf(radians), s = sinf(radians), x = axis.x / length, y = axis.y / length, z = axis.z / length;
+		local[0] = x * x * (1 - c) + c;     local[1] = y * x * (1 - c) + z * s; local[2] = x * z * (1 - c) - y * s;
+		local[4] = x * y * (1 - c) - z * s; local[5] = y * y * (1 - c) + c;     local[6] = y * z * (1 - c) + x * s;
+		local[8] = x * z * (1 - c) + y * s; local[9] = y * z * (1 - c) - x * s; local[10] = z * z * (1 - c) + c;
+	}
+	for(int r = 0; r < 3; r++)
+	{
+		local[r] *= scale.x;
+		local[4 + r] *= scale.y;
+		local[8 + r] *= scale.z;
+	}
+	local[12] = translation.x;
+	local[13] = translation.y;
+	local[14] = translation.z;
+
+	for(int c = 0; c < 4; c++)
+		for(int r = 0; r < 4; r++)
+			out[c * 4 + r] = parent[r] * local[c * 4] + parent[4 + r] * local[c * 4 + 1] +
+				parent[8 + r] * local[c * 4 + 2] + parent[12 + r] * local[c * 4 + 3];
+}
 
 
 Transform::Transform()
@@ -90,24 +120,27 @@ void Transform::previsitLights()
 	glPopMatrix();
 }
 
-void Transform::render(bool renderSemiTransparent)
+//parentModelview  la copia sulla cpu della modelview corrente, cos gli oggetti non la chiedono al driver
+void Transform::render(bool renderSemiTransparent, Camera &camera, const GLfloat *parentModelview)
 {
 	glPushMatrix();
 	glTranslatef(m_tanslation.x, m_tanslation.y, m_tanslation.z);
 	glRotatef(m_rotDeg, m_rotAxis.x, m_rotAxis.y, m_rotAxis.z);
 	glScalef(m_scale.x, m_scale.y, m_scale.z);
+	GLfloat modelview[16];
+	transform_matrix(parentModelview, m_tanslation, m_rotDeg, m_rotAxis, m_scale, modelview);
 
 	std::list<Transform>::iterator it;
 	//Esegui ricorsivamente il rendering delle trasformazioni figlie
 	for ( it=m_children.begin() ; it != m_children.end(); it++ )
 	{
-		it->render(renderSemiTransparent);
+		it->render(renderSemiTransparent, camera, modelview);
 	}
 	
 	std::list<Object>::iterator it2;
 	for ( it2=m_objects.begin() ; it2 != m_objects.end(); it2++ )
 	{
-			it2->render();
+			it2->render(camera, modelview);
 	}
 	glPopMatrix();
 }
\ No newline at end of file
@@ -38,5 +38,5 @@ public:
 	void addLight(Light light);
 
 	void previsitLights();
-	void render(bool renderSemiTransparent);
+	void render(bool renderSemiTransparent, Camera &camera, const GLfloat *parentModelview);
 };
\ No newline at end of file
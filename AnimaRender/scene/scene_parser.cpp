@@ -67,6 +67,16 @@ string readString(ifstream &fstream)
 	return str;
 }
 
+//Vero se sulla stessa riga segue un'altra stringa tra "", usato per i parametri opzionali
+bool hasString(ifstream &fstream)
+{
+	while(fstream.peek() == ' ' || fstream.peek() == '\t')
+		fstream.get();
+
+	int c = fstream.peek();
+	return c == '"' || c == (unsigned char)'\x93' || c == (unsigned char)'\x94';
+}
+
 //Parsa le sezioni camera del file
 Camera parseCamera(ifstream &fstream, boost::filesystem::path curPath)
 {
@@ -247,6 +257,147 @@ bool tryGetVector(glm::vec4 &vect, string value)
 	return false;
 }
 
+//Legge le impostazioni lod nella forma "levels=4;ratio=0.5;error=1"
+lod_settings readLodSettings(string value)
+{
+	lod_settings settings;
+	lod_default_settings(&settings);
+
+	std::vector<std::string> keyValuePairs;
+	boost::split(keyValuePairs, value, boost::is_any_of(";"));
+
+	for(unsigned int i=0; i<keyValuePairs.size(); ++i)
+	{
+		std::vector<std::string> currentKeyValuePair;
+		boost::split(currentKeyValuePair, keyValuePairs[i], boost::is_any_of("="));
+		if(currentKeyValuePair.size() != 2)
+			throw ParseException(WRONG_SYNTAX);
+
+		string key = boost::trim_copy(currentKeyValuePair[0]);
+		if(key.compare("levels") == 0)
+			settings.levels = atoi(currentKeyValuePair[1].c_str());
+		else if(key.compare("ratio") == 0)
+			settings.ratio = (float)atof(currentKeyValuePair[1].c_str());
+		else if(key.compare("error") == 0)
+			settings.pixel_error = (float)atof(currentKeyValuePair[1].c_str());
+		else
+			throw ParseException(WRONG_SYNTAX);
+	}
+
+	if(settings.levels < 1 || settings.ratio <= 0.0f || settings.ratio >= 1.0f || settings.pixel_error < 0.0f)
+		throw ParseException(WRONG_SYNTAX);
+
+	return settings;
+}
+
+//Legge il formato dei vertici: "float" oppure "compact" con i bit opzionali,
+//ad esempio "compact;positions=16;normals=8;texcoords=16"
+vertex_format readVertexFormat(string value)
+{
+	vertex_format format;
+	vertex_format_default(&format);
+
+	std::vector<std::string> keyValuePairs;
+	boost::split(keyValuePairs, value, boost::is_any_of(";"));
+
+	for(unsigned int i=0; i<keyValuePairs.size(); ++i)
+	{
+		string pair = boost::trim_copy(keyValuePairs[i]);
+		if(pair.compare("float") == 0)
+		{
+			format.compact = 0;
+			continue;
+		}
+		if(pair.compare("compact") == 0)
+		{
+			format.compact = 1;
+			continue;
+		}
+
+		std::vector<std::string> currentKeyValuePair;
+		boost::split(currentKeyValuePair, pair, boost::is_any_of("="));
+		if(currentKeyValuePair.size() != 2)
+			throw ParseException(WRONG_SYNTAX);
+
+		string key = boost::trim_copy(currentKeyValuePair[0]);
+		if(key.compare("positions") == 0)
+			format.position_bits = atoi(currentKeyValuePair[1].c_str());
+		else if(key.compare("normals") == 0)
+			format.normal_bits = atoi(currentKeyValuePair[1].c_str());
+		else if(key.compare("texcoords") == 0)
+			format.texcoord_bits = atoi(currentKeyValuePair[1].c_str());
+		else
+			throw ParseException(WRONG_SYNTAX);
+	}
+
+	if(format.position_bits < 1 || format.position_bits > 16 || format.texcoord_bits < 1 || format.texcoord_bits > 16 ||
+		(format.normal_bits != 8 && format.normal_bits != 16))
+		throw ParseException(WRONG_SYNTAX);
+
+	return format;
+}
+
+//Legge le mipmap di una texture, ad esempio "mipmaps=kaiser;gamma=true".
+//mipmaps pu essere off, box o kaiser; i valori non indicati restano quelli di default
+mipmap_settings readTextureOptions(string value)
+{
+	mipmap_settings settings;
+	mipmap_default_settings(&settings);
+
+	std::vector<std::string> keyValuePairs;
+	boost::split(keyValuePairs, value, boost::is_any_of(";"));
+
+	for(unsigned int i=0; i<keyValuePairs.size(); ++i)
+	{
+		std::vector<std::string> currentKeyValuePair;
+		boost::split(currentKeyValuePair, keyValuePairs[i], boost::is_any_of("="));
+		if(currentKeyValuePair.size() != 2)
+			throw ParseException(WRONG_SYNTAX);
+
+		string key = boost::trim_copy(currentKeyValuePair[0]);
+		string option = boost::trim_copy(currentKeyValuePair[1]);
+		if(key.compare("mipmaps") == 0)
+		{
+			if(option.compare("off") == 0)
+				settings.filter = MIPMAP_NONE;
+			else if(option.compare("box") == 0)
+				settings.filter = MIPMAP_BOX;
+			else if(option.compare("kaiser") == 0)
+				settings.filter = MIPMAP_KAISER;
+			else
+				throw ParseException(WRONG_SYNTAX);
+		}
+		else if(key.compare("gamma") == 0)
+		{
+			if(option.compare("true") == 0)
+				settings.gamma = 1;
+			else if(option.compare("false") == 0)
+				settings.gamma = 0;
+			else
+				throw ParseException(WRONG_SYNTAX);
+		}
+		else if(key.compare("premultiply") == 0)
+		{
+			if(option.compare("true") == 0)
+				settings.premultiply = 1;
+			else if(option.compare("false") == 0)
+				settings.premultiply = 0;
+			else
+				throw ParseException(WRONG_SYNTAX);
+		}
+		else if(key.compare("compress") == 0)
+		{
+			settings.compression = bcn_format_from_name(option.c_str());
+			if(settings.compression == BCN_NONE && option.compare("none") != 0)
+				throw ParseException(WRONG_SYNTAX);
+		}
+		else
+			throw ParseException(WRONG_SYNTAX);
+	}
+
+	return settings;
+}
+
 //Legge un oggetto e ne carica gli elementi
 Object parseObject(ifstream &fstream, boost::filesystem::path curPath)
 {
@@ -297,6 +448,30 @@ Object parseObject(ifstream &fstream, boost::filesystem::path curPath)
 			
 			object.setMaterial(filename);
 		}
+		else if (key.compare("lod") == 0)
+		{
+			object.setLod(readLodSettings(readString(fstream)));
+		}
+		else if (key.compare("crease") == 0)
+		{
+			object.setCreaseAngle(readFloat(fstream));
+		}
+		else if (key.compare("clusters") == 0)
+		{
+			float triangles = readFloat(fstream);
+			if(triangles < 0.0f)
+				throw ParseException(WRONG_SYNTAX);
+			object.setMeshletTriangles((int)triangles);
+		}
+		else if (key.compare("vertexformat") == 0)
+		{
+			object.setVertexFormat(readVertexFormat(readString(fstream)));
+		}
+		else if (key.compare("stream") == 0)
+		{
+			string value = readString(fstream);
+			object.setStreaming(value.compare("true") == 0);
+		}
 		else if (key.compare("textured") == 0)
 		{
 			string value = readString(fstream);
@@ -334,12 +509,17 @@ Object parseObject(ifstream &fstream, boost::filesystem::path curPath)
 			string filename = readString(fstream);
 			boost::filesystem::path pathFile = curPath / boost::filesystem::path(filename);
 			filename = boost::filesystem::canonical(pathFile).string();
+			mipmap_settings mipmaps;
+			if(hasString(fstream)) //opzioni facoltative: texture0 name "file" "mipmaps=off"
+				mipmaps = readTextureOptions(readString(fstream));
+			else
+				mipmap_default_settings(&mipmaps);
 			int id = atoi(key.substr(key.size() -1).c_str()); //TODO: migliorare come viene estratto il numero
 			if(id > 7)
 			{
 				throw ParseException(EXCEED_TEXTURE_LIMITS);
 			}
-			object.setTexture(id, name, filename); //Non viene ancora caricata in memoria
+			object.setTexture(id, name, filename, mipmaps); //Non viene ancora caricata in memoria
 		} 
 		else if(key.compare("#") == 0) //commento, va ignorato
 				skipComment(fstream);
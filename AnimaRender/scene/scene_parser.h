@@ -48,6 +48,16 @@ Light parseLight(ifstream &fstream);
 
 string getKeyword(ifstream &fstream);
 
+string readString(ifstream &fstream);
+
+float readFloat(ifstream &fstream);
+
+bool hasString(ifstream &fstream);
+
+lod_settings readLodSettings(string value);
+
+mipmap_settings readTextureOptions(string value);
+
 void skipComment(ifstream &fstream);
 
 void checkOpenBracket(ifstream &fstream);
@@ -0,0 +1,132 @@
+#include "atlas.h"
+
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+void atlas_default_settings(atlas_settings *settings)
+{
+	settings->page_size = 2048;
+	settings->max_texture = 256;
+	settings->levels = 4;
+}
+
+int atlas_page_levels(const atlas_settings *settings)
+{
+	int levels = mipmap_level_count(settings->page_size, settings->page_size);
+	return std::max(1, std::min(settings->levels, levels));
+}
+
+size_t atlas_page_bytes(const atlas_settings *settings)
+{
+	size_t bytes = 0;
+	for (int level = 0; level < atlas_page_levels(settings); level++)
+	{
+		size_t size = mipmap_level_size(settings->page_size, level);
+		bytes += size * size * 4;
+	}
+	return bytes;
+}
+
+int atlas_gutter(const atlas_settings *settings)
+{
+	return 1 << (atlas_page_levels(settings) - 1);
+}
+
+// Size of the cell of a texture side: the texture, a gutter on both sides, rounded up to the gutter.
+static int cell_size(int size, int gutter)
+{
+	return (size + 2 * gutter + gutter - 1) / gutter * gutter;
+}
+
+int atlas_pack(atlas_entry *entries, int count, const atlas_settings *settings)
+{
+	int gutter = atlas_gutter(settings), page_size = settings->page_size;
+	std::vector<int> order(count);
+	for (int i = 0; i < count; i++)
+	{
+		if (cell_size(entries[i].width, gutter) > page_size || cell_size(entries[i].height, gutter) > page_size)
+			return 0;
+		order[i] = i;
+	}
+	//tallest first, so every shelf wastes little height
+	std::stable_sort(order.begin(), order.end(), [entries](int a, int b) {
+		return entries[a].height != entries[b].height ? entries[a].height > entries[b].height : entries[a].width > entries[b].width;
+	});
+
+	int page = 0, x = 0, shelf_y = 0, shelf_height = 0;
+	for (int i = 0; i < count; i++)
+	{
+		atlas_entry &entry = entries[order[i]];
+		int width = cell_size(entry.width, gutter), height = cell_size(entry.height, gutter);
+		if (x + width > page_size)
+		{
+			shelf_y += shelf_height;
+			x = shelf_height = 0;
+		}
+		if (shelf_y + height > page_size)
+		{
+			page++;
+			x = shelf_y = shelf_height = 0;
+		}
+		entry.page = page;
+		entry.x = x + gutter;
+		entry.y = shelf_y + gutter;
+		x += width;
+		shelf_height = std::max(shelf_height, height);
+	}
+	return count > 0 ? page + 1 : 0;
+}
+
+void atlas_blit(unsigned char *chain, const atlas_entry *entry, const unsigned char *rgba, const atlas_settings *settings,
+	const mipmap_settings *mipmaps)
+{
+	int gutter = atlas_gutter(settings), page_size = settings->page_size;
+	int cell_width = cell_size(entry->width, gutter), cell_height = cell_size(entry->height, gutter);
+
+	//the cell with the edge texels repeated into the gutter; the gutter runs to the end of the cell,
+	//so the right and top ones can be wider than the others
+	std::vector<unsigned char> cell((size_t) cell_width * cell_height * 4);
+	for (int row = 0; row < cell_height; row++)
+	{
+		int source_row = std::max(0, std::min(entry->height - 1, row - gutter));
+		for (int column = 0; column < cell_width; column++)
+		{
+			int source_column = std::max(0, std::min(entry->width - 1, column - gutter));
+			memcpy(&cell[((size_t) row * cell_width + column) * 4], rgba + ((size_t) source_row * entry->width + source_column) * 4, 4);
+		}
+	}
+
+	//every level of the cell is filtered from the cell alone, so no filter reaches a neighbour;
+	//cell sizes are multiples of the gutter, so the cells tile every level of the page exactly
+	int levels = atlas_page_levels(settings), level_size = page_size;
+	int x = entry->x - gutter, y = entry->y - gutter;
+	unsigned char *level = chain;
+	std::vector<unsigned char> next;
+	for (int i = 0; i < levels; i++)
+	{
+		if (i > 0)
+		{
+			next.resize((size_t) (cell_width / 2) * (cell_height / 2) * 4);
+			mipmap_downsample(&cell[0], cell_width, cell_height, &next[0], mipmaps, 1);
+			cell.swap(next);
+			cell_width /= 2;
+			cell_height /= 2;
+			x /= 2;
+			y /= 2;
+			level += (size_t) level_size * level_size * 4;
+			level_size /= 2;
+		}
+		for (int row = 0; row < cell_height; row++)
+			memcpy(level + ((size_t) (y + row) * level_size + x) * 4, &cell[(size_t) row * cell_width * 4], (size_t) cell_width * 4);
+	}
+}
+
+void atlas_texcoord_transform(const atlas_entry *entry, const atlas_settings *settings, float offset[2], float scale[2])
+{
+	float page_size = (float) settings->page_size;
+	offset[0] = entry->x / page_size;
+	offset[1] = entry->y / page_size;
+	scale[0] = entry->width / page_size;
+	scale[1] = entry->height / page_size;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "mipmap.h"
+
+/*
+ * Atlas pages: small RGBA textures copied side by side into one square,
+ * power of two texture, so the objects that use them draw without
+ * rebinding. A texcoord t in [0, 1] of an entry becomes
+ *   offset + t * scale
+ * in the page, so only meshes whose texcoords stay inside the unit square
+ * can be drawn from an atlas (there is no wrapping inside a page).
+ *
+ * Entries are placed on shelves, tallest first. Every entry is surrounded
+ * by a gutter of copies of its edge texels, the same texels clamp to edge
+ * sampling would read, and its cell starts and ends on a multiple of the
+ * gutter. With a gutter of 2^(levels - 1) texels every level of the page
+ * keeps at least one gutter texel around every entry, so bilinear
+ * filtering never reads a neighbour; the page chain stops at `levels`.
+ * The levels of a cell are filtered from the cell alone, so wide filters
+ * like the Kaiser one do not bleed neighbours in either.
+ */
+
+typedef struct
+{
+	int page_size;   // width and height of a page, a power of two
+	int max_texture; // textures larger than this on either side keep their own texture
+	int levels;      // mip levels of a page, 1 for none
+} atlas_settings;
+
+typedef struct
+{
+	int width, height; // size of the texture, set by the caller
+	int page;          // page and texel of the first texture texel, set by atlas_pack
+	int x, y;
+} atlas_entry;
+
+void atlas_default_settings(atlas_settings *settings);
+
+// Levels of a page chain: settings->levels, at most the full chain.
+int atlas_page_levels(const atlas_settings *settings);
+// Bytes of a page chain, level 0 included.
+size_t atlas_page_bytes(const atlas_settings *settings);
+
+// Texels of gutter on every side of an entry.
+int atlas_gutter(const atlas_settings *settings);
+
+// Places the entries on as few pages as it manages, in order of height.
+// Returns the number of pages, 0 if an entry is too large for a page.
+int atlas_pack(atlas_entry *entries, int count, const atlas_settings *settings);
+
+// Copies the RGBA texture of an entry, with its gutter, into a page chain
+// laid out level after level, filtering the levels after the first with
+// mipmaps. Entries do not overlap, so they can be copied on different threads.
+void atlas_blit(unsigned char *chain, const atlas_entry *entry, const unsigned char *rgba, const atlas_settings *settings,
+	const mipmap_settings *mipmaps);
+
+// Texcoord transform from the unit square of an entry to its page.
+void atlas_texcoord_transform(const atlas_entry *entry, const atlas_settings *settings, float offset[2], float scale[2]);
@@ -0,0 +1,451 @@
+#include "bcn.h"
+#include "mipmap.h"
+#include "../utils/parallel.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Power iterations used to find the principal axis of a block.
+#define BCN_AXIS_ITERATIONS 8
+
+// Interpolation weights of the 4-bit BC7 indices, out of 64.
+static const int bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+int bcn_block_bytes(bcn_format format)
+{
+	return format == BCN_BC1 ? 8 : (format == BCN_NONE ? 0 : 16);
+}
+
+size_t bcn_level_bytes(bcn_format format, int width, int height)
+{
+	return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * bcn_block_bytes(format);
+}
+
+size_t bcn_image_bytes(bcn_format format, int width, int height, int level_count)
+{
+	size_t bytes = 0;
+	for (int level = 0; level < level_count; level++)
+		bytes += bcn_level_bytes(format, mipmap_level_size(width, level), mipmap_level_size(height, level));
+	return bytes;
+}
+
+const char *bcn_format_name(bcn_format format)
+{
+	switch (format)
+	{
+	case BCN_BC1: return "bc1";
+	case BCN_BC2: return "bc2";
+	case BCN_BC3: return "bc3";
+	case BCN_BC7: return "bc7";
+	default: return "none";
+	}
+}
+
+bcn_format bcn_format_from_name(const char *name)
+{
+	if (strcmp(name, "bc1") == 0)
+		return BCN_BC1;
+	if (strcmp(name, "bc3") == 0)
+		return BCN_BC3;
+	if (strcmp(name, "bc7") == 0)
+		return BCN_BC7;
+	return BCN_NONE;
+}
+
+// Endpoints of the block along the principal axis of its first `channels` channels.
+static void principal_endpoints(const float pixels[16][4], int channels, float *e0, float *e1)
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < channels; c++)
+			mean[c] += pixels[i][c] / 16.0f;
+
+	float covariance[4][4] = { { 0.0f } };
+	for (int i = 0; i < 16; i++)
+		for (int a = 0; a < channels; a++)
+			for (int b = 0; b < channels; b++)
+				covariance[a][b] += (pixels[i][a] - mean[a]) * (pixels[i][b] - mean[b]);
+
+	//the diagonal as a starting point never lies orthogonal to a one-channel spread
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < BCN_AXIS_ITERATIONS; iteration++)
+	{
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, length = 0.0f;
+		for (int a = 0; a < channels; a++)
+		{
+			for (int b = 0; b < channels; b++)
+				next[a] += covariance[a][b] * axis[b];
+			length = std::max(length, fabsf(next[a]));
+		}
+		if (length <= 0.0f)
+			break;
+		for (int c = 0; c < channels; c++)
+			axis[c] = next[c] / length;
+	}
+
+	float low = 0.0f, high = 0.0f, norm = 0.0f;
+	for (int c = 0; c < channels; c++)
+		norm += axis[c] * axis[c];
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (int c = 0; c < channels; c++)
+			t += (pixels[i][c] - mean[c]) * axis[c];
+		if (norm > 0.0f)
+			t /= norm;
+		low = std::min(low, t);
+		high = std::max(high, t);
+	}
+
+	for (int c = 0; c < channels; c++)
+	{
+		e0[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * low));
+		e1[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * high));
+	}
+}
+
+// Least squares endpoints for pixels interpolated with weights[i] from e0 (0) to e1 (1).
+// Returns 0, leaving the endpoints alone, when every pixel has the same weight.
+static int fit_endpoints(const float pixels[16][4], int channels, const float *weights, float *e0, float *e1)
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		float a = 1.0f - weights[i], b = weights[i];
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int c = 0; c < channels; c++)
+		{
+			ax[c] += a * pixels[i][c];
+			bx[c] += b * pixels[i][c];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+		return 0;
+	for (int c = 0; c < channels; c++)
+	{
+		e0[c] = std::min(255.0f, std::max(0.0f, (bb * ax[c] - ab * bx[c]) / determinant));
+		e1[c] = std::min(255.0f, std::max(0.0f, (aa * bx[c] - ab * ax[c]) / determinant));
+	}
+	return 1;
+}
+
+// Picks for every pixel the nearest of `count` palette entries; returns the total squared error.
+static float pick_indices(const float pixels[16][4], int channels, const float palette[][4], int count, int *indices)
+{
+	float total = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float best = 1e30f;
+		for (int p = 0; p < count; p++)
+		{
+			float error = 0.0f;
+			for (int c = 0; c < channels; c++)
+				error += (pixels[i][c] - palette[p][c]) * (pixels[i][c] - palette[p][c]);
+			if (error < best)
+			{
+				best = error;
+				indices[i] = p;
+			}
+		}
+		total += best;
+	}
+	return total;
+}
+
+static unsigned short pack_565(const float *color)
+{
+	int r = (int) (color[0] * 31.0f / 255.0f + 0.5f);
+	int g = (int) (color[1] * 63.0f / 255.0f + 0.5f);
+	int b = (int) (color[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short) ((r << 11) | (g << 5) | b);
+}
+
+// The color a decoder reads back from a 565 endpoint.
+static void unpack_565(unsigned short packed, float *color)
+{
+	int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (float) ((r << 3) | (r >> 2));
+	color[1] = (float) ((g << 2) | (g >> 4));
+	color[2] = (float) ((b << 3) | (b >> 2));
+	color[3] = 255.0f;
+}
+
+typedef struct
+{
+	unsigned short color0, color1;
+	int indices[16];
+	float error;
+} bc1_candidate;
+
+// Quantizes a pair of endpoints and chooses the indices of the four color mode,
+// which needs color0 > color1; equal endpoints get index 0 everywhere.
+static void bc1_try(const float pixels[16][4], const float *e0, const float *e1, bc1_candidate *candidate)
+{
+	unsigned short c0 = pack_565(e0), c1 = pack_565(e1);
+	if (c0 < c1)
+		std::swap(c0, c1);
+	candidate->color0 = c0;
+	candidate->color1 = c1;
+
+	float palette[4][4];
+	unpack_565(c0, palette[0]);
+	unpack_565(c1, palette[1]);
+	if (c0 == c1)
+	{
+		memset(candidate->indices, 0, sizeof(candidate->indices));
+		candidate->error = pick_indices(pixels, 3, palette, 1, candidate->indices);
+		return;
+	}
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+		palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+	}
+	candidate->error = pick_indices(pixels, 3, palette, 4, candidate->indices);
+}
+
+static void encode_bc1_color(const float pixels[16][4], unsigned char *block)
+{
+	//fraction of color1 in each of the four palette entries
+	static const float index_weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	float e0[4], e1[4];
+	bc1_candidate best, refined;
+
+	principal_endpoints(pixels, 3, e0, e1);
+	bc1_try(pixels, e0, e1, &best);
+
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = index_weights[best.indices[i]];
+	if (best.color0 != best.color1 && fit_endpoints(pixels, 3, weights, e0, e1))
+	{
+		bc1_try(pixels, e0, e1, &refined);
+		if (refined.error < best.error)
+			best = refined;
+	}
+
+	unsigned int bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= (unsigned int) best.indices[i] << (2 * i);
+	block[0] = (unsigned char) best.color0;
+	block[1] = (unsigned char) (best.color0 >> 8);
+	block[2] = (unsigned char) best.color1;
+	block[3] = (unsigned char) (best.color1 >> 8);
+	for (int b = 0; b < 4; b++)
+		block[4 + b] = (unsigned char) (bits >> (8 * b));
+}
+
+// The BC3 alpha block: min and max with eight interpolated values.
+static void encode_bc3_alpha(const float pixels[16][4], unsigned char *block)
+{
+	float low = 255.0f, high = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		low = std::min(low, pixels[i][3]);
+		high = std::max(high, pixels[i][3]);
+	}
+	int a0 = (int) (high + 0.5f), a1 = (int) (low + 0.5f);
+
+	unsigned long long bits = 0;
+	if (a0 > a1)
+	{
+		//palette order of the 8 value mode: a0, a1, then six steps from a0 to a1
+		float palette[8][4];
+		palette[0][0] = (float) a0;
+		palette[1][0] = (float) a1;
+		for (int p = 2; p < 8; p++)
+			palette[p][0] = (float) (((8 - p) * a0 + (p - 1) * a1) / 7);
+
+		float alpha[16][4];
+		int indices[16];
+		for (int i = 0; i < 16; i++)
+			alpha[i][0] = pixels[i][3];
+		pick_indices(alpha, 1, palette, 8, indices);
+		for (int i = 0; i < 16; i++)
+			bits |= (unsigned long long) indices[i] << (3 * i);
+	}
+
+	block[0] = (unsigned char) a0;
+	block[1] = (unsigned char) a1;
+	for (int b = 0; b < 6; b++)
+		block[2 + b] = (unsigned char) (bits >> (8 * b));
+}
+
+typedef struct
+{
+	int endpoint[2][4]; // 7-bit values
+	int pbit[2];
+	int indices[16];
+	float error;
+} bc7_candidate;
+
+// Quantizes an endpoint to 7 bits per channel plus the shared bit that fits it best.
+static void bc7_quantize(const float *endpoint, int *quantized, int *pbit)
+{
+	float best = 1e30f;
+	for (int p = 0; p < 2; p++)
+	{
+		int q[4];
+		float error = 0.0f;
+		for (int c = 0; c < 4; c++)
+		{
+			q[c] = std::min(127, std::max(0, (int) ((endpoint[c] - p) / 2.0f + 0.5f)));
+			float value = (float) (q[c] * 2 + p);
+			error += (value - endpoint[c]) * (value - endpoint[c]);
+		}
+		if (error < best)
+		{
+			best = error;
+			*pbit = p;
+			memcpy(quantized, q, sizeof(q));
+		}
+	}
+}
+
+static void bc7_try(const float pixels[16][4], const float *e0, const float *e1, bc7_candidate *candidate)
+{
+	bc7_quantize(e0, candidate->endpoint[0], &candidate->pbit[0]);
+	bc7_quantize(e1, candidate->endpoint[1], &candidate->pbit[1]);
+
+	float palette[16][4];
+	for (int p = 0; p < 16; p++)
+		for (int c = 0; c < 4; c++)
+		{
+			int v0 = candidate->endpoint[0][c] * 2 + candidate->pbit[0];
+			int v1 = candidate->endpoint[1][c] * 2 + candidate->pbit[1];
+			palette[p][c] = (float) (((64 - bc7_weights[p]) * v0 + bc7_weights[p] * v1 + 32) >> 6);
+		}
+	candidate->error = pick_indices(pixels, 4, palette, 16, candidate->indices);
+}
+
+// Appends `count` bits of value to a block, least significant first.
+static void put_bits(unsigned char *block, int *position, unsigned int value, int count)
+{
+	for (int b = 0; b < count; b++, (*position)++)
+		if (value & (1u << b))
+			block[*position >> 3] |= (unsigned char) (1 << (*position & 7));
+}
+
+static void encode_bc7(const float pixels[16][4], unsigned char *block)
+{
+	float e0[4], e1[4];
+	bc7_candidate best, refined;
+
+	principal_endpoints(pixels, 4, e0, e1);
+	bc7_try(pixels, e0, e1, &best);
+
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = bc7_weights[best.indices[i]] / 64.0f;
+	if (fit_endpoints(pixels, 4, weights, e0, e1))
+	{
+		bc7_try(pixels, e0, e1, &refined);
+		if (refined.error < best.error)
+			best = refined;
+	}
+
+	//the first index is stored with 3 bits, so its top bit must be 0
+	if (best.indices[0] & 8)
+	{
+		for (int c = 0; c < 4; c++)
+			std::swap(best.endpoint[0][c], best.endpoint[1][c]);
+		std::swap(best.pbit[0], best.pbit[1]);
+		for (int i = 0; i < 16; i++)
+			best.indices[i] = 15 - best.indices[i];
+	}
+
+	int position = 0;
+	memset(block, 0, 16);
+	put_bits(block, &position, 1 << 6, 7); // mode 6
+	for (int c = 0; c < 4; c++)
+	{
+		put_bits(block, &position, best.endpoint[0][c], 7);
+		put_bits(block, &position, best.endpoint[1][c], 7);
+	}
+	put_bits(block, &position, best.pbit[0], 1);
+	put_bits(block, &position, best.pbit[1], 1);
+	put_bits(block, &position, best.indices[0], 3);
+	for (int i = 1; i < 16; i++)
+		put_bits(block, &position, best.indices[i], 4);
+}
+
+void bcn_encode_block(const unsigned char *rgba, bcn_format format, unsigned char *block)
+{
+	float pixels[16][4];
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 4; c++)
+			pixels[i][c] = rgba[i * 4 + c];
+
+	switch (format)
+	{
+	case BCN_BC1:
+		encode_bc1_color(pixels, block);
+		break;
+	case BCN_BC3:
+		encode_bc3_alpha(pixels, block);
+		encode_bc1_color(pixels, block + 8);
+		break;
+	case BCN_BC7:
+		encode_bc7(pixels, block);
+		break;
+	default:
+		memset(block, 0, bcn_block_bytes(format));
+		break;
+	}
+}
+
+// Encodes one row of blocks of a level; blocks past the edge repeat its last pixels.
+static void encode_block_row(const unsigned char *rgba, int width, int height, int block_row, bcn_format format,
+	unsigned char *out)
+{
+	unsigned char pixels[64];
+	int blocks = (width + 3) / 4, block_bytes = bcn_block_bytes(format);
+
+	for (int bx = 0; bx < blocks; bx++)
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			const unsigned char *row = rgba + (size_t) std::min(block_row * 4 + y, height - 1) * width * 4;
+			for (int x = 0; x < 4; x++)
+				memcpy(pixels + (y * 4 + x) * 4, row + std::min(bx * 4 + x, width - 1) * 4, 4);
+		}
+		bcn_encode_block(pixels, format, out + (size_t) bx * block_bytes);
+	}
+}
+
+void bcn_encode_chain(const unsigned char *rgba, int width, int height, int level_count, bcn_format format,
+	unsigned char *out, int threads)
+{
+	//levels do not depend on each other here, so all their rows of blocks are spread together
+	std::vector<int> row_level, row_index;
+	std::vector<size_t> source_offsets(level_count), out_offsets(level_count);
+	size_t source_offset = 0, out_offset = 0;
+	for (int level = 0; level < level_count; level++)
+	{
+		int level_width = mipmap_level_size(width, level), level_height = mipmap_level_size(height, level);
+		source_offsets[level] = source_offset;
+		out_offsets[level] = out_offset;
+		source_offset += (size_t) level_width * level_height * 4;
+		out_offset += bcn_level_bytes(format, level_width, level_height);
+		for (int r = 0; r < (level_height + 3) / 4; r++)
+		{
+			row_level.push_back(level);
+			row_index.push_back(r);
+		}
+	}
+
+	parallel_for((int) row_level.size(), threads, [&](int i) {
+		int level = row_level[i];
+		int level_width = mipmap_level_size(width, level), level_height = mipmap_level_size(height, level);
+		size_t row_bytes = (size_t) ((level_width + 3) / 4) * bcn_block_bytes(format);
+		encode_block_row(rgba + source_offsets[level], level_width, level_height, row_index[i], format,
+			out + out_offsets[level] + row_index[i] * row_bytes);
+	});
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Block compressed textures (BCn / S3TC / BPTC): every 4x4 block of pixels
+ * is stored in a fixed number of bytes, so the GPU samples them without
+ * decompressing the whole image.
+ *   - BC1: RGB, 8 bytes per block, two 565 endpoints and 2-bit indices;
+ *     the encoder only uses the opaque four color mode;
+ *   - BC2: BC1 color plus explicit 4-bit alpha (loaded, not encoded);
+ *   - BC3: BC1 color plus an interpolated alpha block, 16 bytes;
+ *   - BC7: RGBA, 16 bytes. The encoder only emits mode 6 (one RGBA line,
+ *     7-bit endpoints with a shared bit, 4-bit indices), which is much
+ *     better than BC3 on smooth gradients and fast enough at load time.
+ * Images are kept level after level, each level padded to whole blocks.
+ * Endpoints come from the principal axis of the block colors and are then
+ * refined by least squares over the chosen indices.
+ */
+
+typedef enum
+{
+	BCN_NONE,
+	BCN_BC1,
+	BCN_BC2,
+	BCN_BC3,
+	BCN_BC7
+} bcn_format;
+
+// A compressed image with its mip chain.
+typedef struct
+{
+	bcn_format format;
+	int width, height;
+	int level_count;
+	unsigned char *data; // malloc'd, level after level
+} bcn_image;
+
+int bcn_block_bytes(bcn_format format);
+size_t bcn_level_bytes(bcn_format format, int width, int height);
+// Bytes of the first level_count levels, halving as mipmap_level_size does.
+size_t bcn_image_bytes(bcn_format format, int width, int height, int level_count);
+
+// Name used on the command line ("bc1", "bc3", "bc7"), and back; BCN_NONE for unknown names.
+const char *bcn_format_name(bcn_format format);
+bcn_format bcn_format_from_name(const char *name);
+
+// Compresses one RGBA block, pixels in rows of 4 (64 bytes).
+void bcn_encode_block(const unsigned char *rgba, bcn_format format, unsigned char *block);
+
+// Compresses a chain of level_count RGBA8 levels laid out level after level
+// into out (bcn_image_bytes big). Rows of blocks of every level are spread
+// over up to `threads` threads, <= 0 meaning all cores. BC2 cannot be encoded.
+void bcn_encode_chain(const unsigned char *rgba, int width, int height, int level_count, bcn_format format,
+	unsigned char *out, int threads);
@@ -1,51 +1,96 @@
 #include "bmpreader.h"
+#include "pixel_convert.h"
+#include "../utils/mapped_file.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+
+// Compression values of the info header.
+#define BMP_RGB 0
+#define BMP_BITFIELDS 3
+#define BMP_ALPHABITFIELDS 6
+
+static unsigned int le_int(const unsigned char *bytes)
+{
+	return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned int) bytes[3] << 24);
+}
 
-// Code taken from 
-// http://www.opengl-tutorial.org/beginners-tutorials/tutorial-5-a-textured-cube/
 void *read_bmp(const char *filename, int *width, int *height)
 {
-	unsigned char header[54]; // Each BMP file begins by a 54-bytes header
+	return read_bmp_to(filename, width, height, pixels_malloc, NULL);
+}
+
+// Header layout from
+// http://www.opengl-tutorial.org/beginners-tutorials/tutorial-5-a-textured-cube/
+// and the BITMAPINFOHEADER/BITMAPV5HEADER documentation.
+void *read_bmp_to(const char *filename, int *width, int *height, pixel_destination destination, void *context)
+{
+	const unsigned char *header; // 14 bytes of file header, then the info header
 	unsigned int dataPos;     // Position in the file where the actual data begins
-	unsigned int imageSize;   // = width*height*3
-	// Actual RGB data
-	unsigned char * data;
+	mapped_file file;
 
-	// Open the file
-	FILE * file = fopen(filename, "rb");
-	if (!file)                              { printf("Image could not be opened\n"); return 0; }
+	if (!map_file(&file, filename))         { printf("Image could not be opened\n"); return NULL; }
+	header = (const unsigned char *) file.data;
 
-	if (fread(header, 1, 54, file) != 54){ // If not 54 bytes read : problem
-		fprintf(stderr, "%s is not a correct BMP file\n");
+	if (file.size < 54 || header[0] != 'B' || header[1] != 'M'){
+		fprintf(stderr, "%s is not a correct BMP file\n", filename);
+		unmap_file(&file);
 		return NULL;
 	}
 
-	if (header[0] != 'B' || header[1] != 'M'){
-		fprintf(stderr, "%s is not a correct BMP file\n");
-		return 0;
-	}
-
 	// Read ints from the byte array
-	dataPos = *(int*) &(header[0x0A]);
-	imageSize = *(int*) &(header[0x22]);
-	*width = (int) (header[0x12]);
-	*height = (int) (header[0x16]);
-
-	// Some BMP files are misformatted, guess missing information
-	if (imageSize == 0)    
-		imageSize = *width*(*height) * 3; // 3 : one byte for each Red, Green and Blue component
-	if (dataPos == 0)      
+	dataPos = le_int(header + 0x0A);
+	unsigned int infoSize = le_int(header + 0x0E);
+	int fileWidth = (int) le_int(header + 0x12);
+	int fileHeight = (int) le_int(header + 0x16); // negative for rows stored top to bottom
+	int bits = header[0x1C] | (header[0x1D] << 8);
+	unsigned int compression = le_int(header + 0x1E);
+	if (dataPos == 0)
 		dataPos = 54; // The BMP header is done that way
 
-	// Create a buffer
-	data = new unsigned char[imageSize];
+	//32-bit pixels with bit fields are accepted in the usual BGRA layout only; alpha is kept
+	//when the header has an alpha mask, otherwise the fourth byte is padding
+	bool opaque = true;
+	if (bits == 32 && (compression == BMP_BITFIELDS || compression == BMP_ALPHABITFIELDS)) {
+		if (file.size < 0x42 || le_int(header + 0x36) != 0x00FF0000 || le_int(header + 0x3A) != 0x0000FF00 ||
+			le_int(header + 0x3E) != 0x000000FF) {
+			fprintf(stderr, "%s has unsupported bit fields\n", filename);
+			unmap_file(&file);
+			return NULL;
+		}
+		opaque = !((infoSize >= 56 || compression == BMP_ALPHABITFIELDS) && file.size >= 0x46 &&
+			le_int(header + 0x42) == 0xFF000000);
+	}
+	else if ((bits != 24 && bits != 32) || compression != BMP_RGB) {
+		fprintf(stderr, "%s is not a 24 or 32-bit uncompressed BMP file\n", filename);
+		unmap_file(&file);
+		return NULL;
+	}
 
-	// Read the actual data from the file into the buffer
-	fread(data, 1, imageSize, file);
+	*width = fileWidth;
+	*height = fileHeight < 0 ? -fileHeight : fileHeight;
+	size_t stride = ((size_t) *width * (bits / 8) + 3) & ~(size_t) 3; // rows are padded to 4 bytes
+	if (*width <= 0 || *height <= 0 || dataPos > file.size || (file.size - dataPos) / stride < (size_t) *height){
+		fprintf(stderr, "%s has incomplete image\n", filename);
+		unmap_file(&file);
+		return NULL;
+	}
 
-	//Everything is in memory now, the file can be closed
-	fclose(file);
+	// Convert every row straight from the mapping, bottom row first
+	unsigned char *pixels = (unsigned char *) destination(*width, *height, context);
+	if (pixels == NULL) {
+		unmap_file(&file);
+		return NULL;
+	}
+	for (int row = 0; row < *height; row++) {
+		const unsigned char *src = header + dataPos + row * stride;
+		unsigned char *dst = pixels + (size_t) (fileHeight < 0 ? *height - 1 - row : row) * *width * 4;
+		if (bits == 24)
+			pixels_bgr_to_rgba(src, dst, *width);
+		else
+			pixels_bgra_to_rgba(src, dst, *width, opaque);
+	}
 
-	return data;
-}
\ No newline at end of file
+	unmap_file(&file);
+	return pixels;
+}
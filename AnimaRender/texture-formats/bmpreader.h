@@ -1,3 +1,11 @@
 #pragma once
 
-void *read_bmp(const char *filename, int *width, int *height);
\ No newline at end of file
+#include "pixel_convert.h"
+
+// Reads a 24 or 32-bit uncompressed bmp file and returns its pixels as RGBA8
+// rows, bottom row first (malloc'd). NULL on failure.
+void *read_bmp(const char *filename, int *width, int *height);
+
+// Like read_bmp, but the pixels are written to the buffer destination returns;
+// returns that buffer, NULL on failure.
+void *read_bmp_to(const char *filename, int *width, int *height, pixel_destination destination, void *context);
@@ -0,0 +1,226 @@
+#include "ddsreader.h"
+#include "mipmap.h"
+#include "../utils/mapped_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sstream>
+#include <thread>
+
+#define DDS_MAGIC "DDS "
+// Tag of the stamp in the first reserved word: "ANIM".
+#define DDS_STAMP_TAG 0x4D494E41
+
+#define DDSD_CAPS 0x1
+#define DDSD_HEIGHT 0x2
+#define DDSD_WIDTH 0x4
+#define DDSD_PIXELFORMAT 0x1000
+#define DDSD_MIPMAPCOUNT 0x20000
+#define DDSD_LINEARSIZE 0x80000
+#define DDPF_FOURCC 0x4
+#define DDSCAPS_COMPLEX 0x8
+#define DDSCAPS_TEXTURE 0x1000
+#define DDSCAPS_MIPMAP 0x400000
+#define DDSCAPS2_CUBEMAP 0x200
+#define DDSCAPS2_VOLUME 0x200000
+
+#define DXGI_FORMAT_BC1_UNORM 71
+#define DXGI_FORMAT_BC1_UNORM_SRGB 72
+#define DXGI_FORMAT_BC2_UNORM 74
+#define DXGI_FORMAT_BC2_UNORM_SRGB 75
+#define DXGI_FORMAT_BC3_UNORM 77
+#define DXGI_FORMAT_BC3_UNORM_SRGB 78
+#define DXGI_FORMAT_BC7_UNORM 98
+#define DXGI_FORMAT_BC7_UNORM_SRGB 99
+#define D3D10_RESOURCE_DIMENSION_TEXTURE2D 3
+
+typedef struct
+{
+	unsigned int size;
+	unsigned int flags;
+	unsigned int four_cc;
+	unsigned int rgb_bit_count;
+	unsigned int masks[4];
+} dds_pixel_format;
+
+typedef struct
+{
+	unsigned int size;
+	unsigned int flags;
+	unsigned int height;
+	unsigned int width;
+	unsigned int linear_size;
+	unsigned int depth;
+	unsigned int mip_map_count;
+	unsigned int reserved1[11];
+	dds_pixel_format format;
+	unsigned int caps, caps2, caps3, caps4;
+	unsigned int reserved2;
+} dds_header;
+
+typedef struct
+{
+	unsigned int dxgi_format;
+	unsigned int resource_dimension;
+	unsigned int misc_flag;
+	unsigned int array_size;
+	unsigned int misc_flags2;
+} dds_header_dx10;
+
+static unsigned int four_cc(const char *code)
+{
+	return (unsigned int) code[0] | ((unsigned int) code[1] << 8) | ((unsigned int) code[2] << 16) | ((unsigned int) code[3] << 24);
+}
+
+static bcn_format dxgi_to_bcn(unsigned int dxgi_format)
+{
+	switch (dxgi_format)
+	{
+	case DXGI_FORMAT_BC1_UNORM: case DXGI_FORMAT_BC1_UNORM_SRGB: return BCN_BC1;
+	case DXGI_FORMAT_BC2_UNORM: case DXGI_FORMAT_BC2_UNORM_SRGB: return BCN_BC2;
+	case DXGI_FORMAT_BC3_UNORM: case DXGI_FORMAT_BC3_UNORM_SRGB: return BCN_BC3;
+	case DXGI_FORMAT_BC7_UNORM: case DXGI_FORMAT_BC7_UNORM_SRGB: return BCN_BC7;
+	default: return BCN_NONE;
+	}
+}
+
+int read_dds(const char *filename, bcn_image *image, dds_stamp *stamp)
+{
+	mapped_file file;
+	dds_header header;
+	size_t offset = 4 + sizeof(header);
+
+	if (!map_file(&file, filename))
+		return 0;
+	if (file.size < offset || memcmp(file.data, DDS_MAGIC, 4) != 0) {
+		fprintf(stderr, "%s is not a correct DDS file\n", filename);
+		unmap_file(&file);
+		return 0;
+	}
+	memcpy(&header, file.data + 4, sizeof(header));
+
+	image->format = BCN_NONE;
+	if (header.format.flags & DDPF_FOURCC) {
+		if (header.format.four_cc == four_cc("DXT1"))
+			image->format = BCN_BC1;
+		else if (header.format.four_cc == four_cc("DXT3"))
+			image->format = BCN_BC2;
+		else if (header.format.four_cc == four_cc("DXT5"))
+			image->format = BCN_BC3;
+		else if (header.format.four_cc == four_cc("DX10") && file.size >= offset + sizeof(dds_header_dx10)) {
+			dds_header_dx10 dx10;
+			memcpy(&dx10, file.data + offset, sizeof(dx10));
+			offset += sizeof(dx10);
+			if (dx10.resource_dimension == D3D10_RESOURCE_DIMENSION_TEXTURE2D && dx10.array_size <= 1)
+				image->format = dxgi_to_bcn(dx10.dxgi_format);
+		}
+	}
+	if (image->format == BCN_NONE || (header.caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) || header.width == 0 || header.height == 0) {
+		fprintf(stderr, "%s is not a BC1, BC2, BC3 or BC7 2D DDS texture\n", filename);
+		unmap_file(&file);
+		return 0;
+	}
+
+	image->width = (int) header.width;
+	image->height = (int) header.height;
+	image->level_count = (header.flags & DDSD_MIPMAPCOUNT) && header.mip_map_count > 0 ? (int) header.mip_map_count : 1;
+	if (image->level_count > mipmap_level_count(image->width, image->height))
+		image->level_count = mipmap_level_count(image->width, image->height);
+
+	size_t bytes = bcn_image_bytes(image->format, image->width, image->height, image->level_count);
+	if (file.size - offset < bytes) {
+		fprintf(stderr, "%s has incomplete image\n", filename);
+		unmap_file(&file);
+		return 0;
+	}
+	image->data = (unsigned char *) malloc(bytes);
+	memcpy(image->data, file.data + offset, bytes);
+
+	if (stamp != NULL) {
+		memset(stamp, 0, sizeof(*stamp));
+		if (header.reserved1[0] == DDS_STAMP_TAG) {
+			memcpy(&stamp->source_size, &header.reserved1[1], sizeof(stamp->source_size));
+			memcpy(&stamp->source_mtime, &header.reserved1[3], sizeof(stamp->source_mtime));
+			stamp->settings = header.reserved1[5];
+		}
+	}
+
+	unmap_file(&file);
+	return 1;
+}
+
+int write_dds(const char *filename, const bcn_image *image, const dds_stamp *stamp)
+{
+	dds_header header;
+	dds_header_dx10 dx10;
+
+	memset(&header, 0, sizeof(header));
+	header.size = sizeof(header);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+	header.height = image->height;
+	header.width = image->width;
+	header.linear_size = (unsigned int) bcn_level_bytes(image->format, image->width, image->height);
+	header.format.size = sizeof(header.format);
+	header.format.flags = DDPF_FOURCC;
+	header.caps = DDSCAPS_TEXTURE;
+	if (image->level_count > 1) {
+		header.flags |= DDSD_MIPMAPCOUNT;
+		header.mip_map_count = image->level_count;
+		header.caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+	}
+
+	switch (image->format)
+	{
+	case BCN_BC1: header.format.four_cc = four_cc("DXT1"); break;
+	case BCN_BC2: header.format.four_cc = four_cc("DXT3"); break;
+	case BCN_BC3: header.format.four_cc = four_cc("DXT5"); break;
+	case BCN_BC7: header.format.four_cc = four_cc("DX10"); break;
+	default: return 0;
+	}
+	memset(&dx10, 0, sizeof(dx10));
+	dx10.dxgi_format = DXGI_FORMAT_BC7_UNORM;
+	dx10.resource_dimension = D3D10_RESOURCE_DIMENSION_TEXTURE2D;
+	dx10.array_size = 1;
+
+	if (stamp != NULL) {
+		header.reserved1[0] = DDS_STAMP_TAG;
+		memcpy(&header.reserved1[1], &stamp->source_size, sizeof(stamp->source_size));
+		memcpy(&header.reserved1[3], &stamp->source_mtime, sizeof(stamp->source_mtime));
+		header.reserved1[5] = stamp->settings;
+	}
+
+	//Written to a temporary file of this thread and renamed, so decoders running in parallel on
+	//the same image never read or write a half-written file
+	std::ostringstream temp;
+	temp << filename << "." << std::this_thread::get_id() << ".tmp";
+	std::string temp_filename = temp.str();
+	FILE *f = fopen(temp_filename.c_str(), "wb");
+	if (!f) {
+		fprintf(stderr, "Unable to open %s for writing\n", temp_filename.c_str());
+		return 0;
+	}
+
+	size_t bytes = bcn_image_bytes(image->format, image->width, image->height, image->level_count);
+	int ok = fwrite(DDS_MAGIC, 1, 4, f) == 4 && fwrite(&header, sizeof(header), 1, f) == 1 &&
+		(image->format != BCN_BC7 || fwrite(&dx10, sizeof(dx10), 1, f) == 1) &&
+		fwrite(image->data, 1, bytes, f) == bytes;
+	if (fclose(f) != 0)
+		ok = 0;
+	if (ok) {
+		remove(filename);
+		//another thread may have renamed its identical copy in between
+		if (rename(temp_filename.c_str(), filename) != 0) {
+			FILE *existing = fopen(filename, "rb");
+			ok = existing != NULL;
+			if (existing)
+				fclose(existing);
+		}
+	}
+	if (!ok) {
+		fprintf(stderr, "Error writing %s\n", filename);
+		remove(temp_filename.c_str());
+	}
+	return ok;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "bcn.h"
+
+/*
+ * DDS files holding a BC1, BC2, BC3 (DXT1/3/5 FourCC) or BC7 (DX10 header)
+ * 2D texture with its mip chain. Cube maps, volumes and arrays are rejected.
+ * The images baked from a png/tga/bmp carry a stamp in the reserved words of
+ * the header (ignored by other tools) that tells whether they are stale.
+ */
+
+typedef struct
+{
+	long long source_size, source_mtime;
+	unsigned int settings; // mip filter, gamma and format the image was baked with
+} dds_stamp;
+
+// Reads the blocks into image->data (malloc'd). stamp, if not NULL, receives the
+// stamp of the file, all zero when it has none. Returns 0 on failure.
+int read_dds(const char *filename, bcn_image *image, dds_stamp *stamp);
+
+// Writes image, BC7 with a DX10 header; stamp may be NULL. The file is written under a
+// temporary name and renamed into place. Returns 0 on failure.
+int write_dds(const char *filename, const bcn_image *image, const dds_stamp *stamp);
@@ -0,0 +1,108 @@
+#include "ktxreader.h"
+#include "mipmap.h"
+#include "../utils/mapped_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KTX_ENDIANNESS 0x04030201
+
+// glInternalFormat values, from EXT_texture_compression_s3tc and ARB_texture_compression_bptc.
+#define KTX_RGB_S3TC_DXT1 0x83F0
+#define KTX_RGBA_S3TC_DXT1 0x83F1
+#define KTX_RGBA_S3TC_DXT3 0x83F2
+#define KTX_RGBA_S3TC_DXT5 0x83F3
+#define KTX_RGBA_BPTC_UNORM 0x8E8C
+#define KTX_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+
+static const unsigned char ktx_identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+typedef struct
+{
+	unsigned char identifier[12];
+	unsigned int endianness;
+	unsigned int gl_type;
+	unsigned int gl_type_size;
+	unsigned int gl_format;
+	unsigned int gl_internal_format;
+	unsigned int gl_base_internal_format;
+	unsigned int pixel_width;
+	unsigned int pixel_height;
+	unsigned int pixel_depth;
+	unsigned int array_elements;
+	unsigned int faces;
+	unsigned int mipmap_levels;
+	unsigned int key_value_bytes;
+} ktx_header;
+
+static bcn_format internal_format_to_bcn(unsigned int internal_format)
+{
+	switch (internal_format)
+	{
+	case KTX_RGB_S3TC_DXT1: case KTX_RGBA_S3TC_DXT1: return BCN_BC1;
+	case KTX_RGBA_S3TC_DXT3: return BCN_BC2;
+	case KTX_RGBA_S3TC_DXT5: return BCN_BC3;
+	case KTX_RGBA_BPTC_UNORM: case KTX_SRGB_ALPHA_BPTC_UNORM: return BCN_BC7;
+	default: return BCN_NONE;
+	}
+}
+
+int read_ktx(const char *filename, bcn_image *image)
+{
+	mapped_file file;
+	ktx_header header;
+
+	if (!map_file(&file, filename))
+		return 0;
+	if (file.size < sizeof(header) || memcmp(file.data, ktx_identifier, sizeof(ktx_identifier)) != 0) {
+		fprintf(stderr, "%s is not a correct KTX file\n", filename);
+		unmap_file(&file);
+		return 0;
+	}
+	memcpy(&header, file.data, sizeof(header));
+
+	image->format = internal_format_to_bcn(header.gl_internal_format);
+	if (header.endianness != KTX_ENDIANNESS || image->format == BCN_NONE || header.pixel_depth > 1 ||
+		header.array_elements > 1 || header.faces > 1 || header.pixel_width == 0 || header.pixel_height == 0) {
+		fprintf(stderr, "%s is not a little endian BC1, BC2, BC3 or BC7 2D KTX texture\n", filename);
+		unmap_file(&file);
+		return 0;
+	}
+
+	image->width = (int) header.pixel_width;
+	image->height = (int) header.pixel_height;
+	image->level_count = header.mipmap_levels > 0 ? (int) header.mipmap_levels : 1;
+	if (image->level_count > mipmap_level_count(image->width, image->height))
+		image->level_count = mipmap_level_count(image->width, image->height);
+
+	size_t bytes = bcn_image_bytes(image->format, image->width, image->height, image->level_count);
+	size_t offset = sizeof(header) + header.key_value_bytes;
+	image->data = (unsigned char *) malloc(bytes);
+
+	//every level is preceded by its size; compressed levels are whole blocks, so no padding follows them
+	unsigned char *level_data = image->data;
+	for (int level = 0; level < image->level_count; level++) {
+		size_t level_bytes = bcn_level_bytes(image->format, mipmap_level_size(image->width, level), mipmap_level_size(image->height, level));
+		unsigned int image_size;
+		if (offset > file.size || file.size - offset < 4 + level_bytes) {
+			fprintf(stderr, "%s has incomplete image\n", filename);
+			free(image->data);
+			unmap_file(&file);
+			return 0;
+		}
+		memcpy(&image_size, file.data + offset, 4);
+		if (image_size != level_bytes) {
+			fprintf(stderr, "%s has a mip level of unexpected size\n", filename);
+			free(image->data);
+			unmap_file(&file);
+			return 0;
+		}
+		memcpy(level_data, file.data + offset + 4, level_bytes);
+		level_data += level_bytes;
+		offset += 4 + level_bytes;
+	}
+
+	unmap_file(&file);
+	return 1;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "bcn.h"
+
+// Reads a KTX 1.1 file holding a BC1, BC2, BC3 or BC7 2D texture with its mip
+// chain into image->data (malloc'd). Returns 0 on failure.
+int read_ktx(const char *filename, bcn_image *image);
@@ -0,0 +1,308 @@
+#include "mipmap.h"
+#include "../utils/parallel.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define MIPMAP_SSE2
+#include <emmintrin.h>
+#endif
+
+// Output rows handed to a thread at a time.
+#define MIPMAP_BAND_ROWS 16
+#define MIPMAP_KAISER_RADIUS 4
+#define MIPMAP_KAISER_ALPHA 4.0
+// Entries of the linear to sRGB table, enough for every 8-bit output value.
+#define MIPMAP_LINEAR_STEPS 4096
+
+static mipmap_settings default_settings = { MIPMAP_BOX, 0, BCN_NONE, 0 };
+
+static float srgb_to_linear[256];
+static unsigned char linear_to_srgb[MIPMAP_LINEAR_STEPS];
+static std::once_flag gamma_tables_once;
+
+void mipmap_set_default_settings(const mipmap_settings *settings)
+{
+	default_settings = *settings;
+}
+
+void mipmap_default_settings(mipmap_settings *settings)
+{
+	*settings = default_settings;
+}
+
+int mipmap_level_count(int width, int height)
+{
+	int levels = 1;
+	while (width > 1 || height > 1)
+	{
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+		levels++;
+	}
+	return levels;
+}
+
+int mipmap_level_size(int size, int level)
+{
+	return std::max(1, size >> level);
+}
+
+size_t mipmap_chain_bytes(int width, int height)
+{
+	size_t bytes = 0;
+	int levels = mipmap_level_count(width, height);
+	for (int level = 0; level < levels; level++)
+		bytes += (size_t) mipmap_level_size(width, level) * mipmap_level_size(height, level) * 4;
+	return bytes;
+}
+
+static void build_gamma_tables()
+{
+	for (int i = 0; i < 256; i++)
+	{
+		double c = i / 255.0;
+		srgb_to_linear[i] = (float) (c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4));
+	}
+	for (int i = 0; i < MIPMAP_LINEAR_STEPS; i++)
+	{
+		double l = i / (double) (MIPMAP_LINEAR_STEPS - 1);
+		double c = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+		linear_to_srgb[i] = (unsigned char) (c * 255.0 + 0.5);
+	}
+}
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+static double bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 32; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+// Weights of the taps of one output pixel: tap k reads input 2x - radius + 1 + k.
+static int make_kernel(mipmap_filter filter, float *weights)
+{
+	if (filter != MIPMAP_KAISER)
+	{
+		weights[0] = weights[1] = 0.5f;
+		return 1;
+	}
+
+	int radius = MIPMAP_KAISER_RADIUS;
+	double sum = 0.0, w[2 * MIPMAP_KAISER_RADIUS];
+	for (int k = 0; k < 2 * radius; k++)
+	{
+		//distance from the center of the output pixel, in input pixels; the cutoff is half the input rate
+		double d = k - radius + 0.5;
+		double t = d / 2.0 * 3.14159265358979323846;
+		double sinc = sin(t) / t;
+		double r = d / radius;
+		w[k] = sinc * bessel_i0(MIPMAP_KAISER_ALPHA * sqrt(std::max(0.0, 1.0 - r * r))) / bessel_i0(MIPMAP_KAISER_ALPHA);
+		sum += w[k];
+	}
+	for (int k = 0; k < 2 * radius; k++)
+		weights[k] = (float) (w[k] / sum);
+	return radius;
+}
+
+// Box filter on 8-bit values, rows [first_row, last_row) of the output.
+static void box_rows(const unsigned char *src, int width, int height, unsigned char *dst, int first_row, int last_row)
+{
+	int out_width = mipmap_level_size(width, 1);
+
+	for (int y = first_row; y < last_row; y++)
+	{
+		const unsigned char *r0 = src + (size_t) std::min(2 * y, height - 1) * width * 4;
+		const unsigned char *r1 = src + (size_t) std::min(2 * y + 1, height - 1) * width * 4;
+		unsigned char *out = dst + (size_t) y * out_width * 4;
+		int x = 0;
+
+#ifdef MIPMAP_SSE2
+		//2x + 1 < width for every output pixel once the image is at least 2 wide
+		if (width >= 2)
+		{
+			const __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+			for (; x + 4 <= out_width; x += 4)
+			{
+				__m128i sums[2];
+				for (int half = 0; half < 2; half++)
+				{
+					__m128i a = _mm_loadu_si128((const __m128i *) (r0 + (2 * x + 4 * half) * 4));
+					__m128i b = _mm_loadu_si128((const __m128i *) (r1 + (2 * x + 4 * half) * 4));
+					//columns summed first: (p0, p1) and (p2, p3) of both rows
+					__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+					__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+					__m128i even = _mm_unpacklo_epi64(low, high), odd = _mm_unpackhi_epi64(low, high);
+					sums[half] = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(even, odd), two), 2);
+				}
+				_mm_storeu_si128((__m128i *) (out + x * 4), _mm_packus_epi16(sums[0], sums[1]));
+			}
+		}
+#endif
+		for (; x < out_width; x++)
+		{
+			int x0 = std::min(2 * x, width - 1) * 4, x1 = std::min(2 * x + 1, width - 1) * 4;
+			for (int c = 0; c < 4; c++)
+				out[x * 4 + c] = (unsigned char) ((r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c] + 2) >> 2);
+		}
+	}
+}
+
+// A row of pixels as 4 floats each in 0..1, linear when gamma is set.
+static void load_row(const unsigned char *row, int width, int gamma, float *out)
+{
+	if (gamma)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			out[x * 4] = srgb_to_linear[row[x * 4]];
+			out[x * 4 + 1] = srgb_to_linear[row[x * 4 + 1]];
+			out[x * 4 + 2] = srgb_to_linear[row[x * 4 + 2]];
+			out[x * 4 + 3] = row[x * 4 + 3] * (1.0f / 255.0f);
+		}
+		return;
+	}
+
+	int x = 0;
+#ifdef MIPMAP_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i *) (row + x * 4));
+		__m128i low = _mm_unpacklo_epi8(bytes, zero), high = _mm_unpackhi_epi8(bytes, zero);
+		__m128i words[4];
+		words[0] = _mm_unpacklo_epi16(low, zero);
+		words[1] = _mm_unpackhi_epi16(low, zero);
+		words[2] = _mm_unpacklo_epi16(high, zero);
+		words[3] = _mm_unpackhi_epi16(high, zero);
+		for (int k = 0; k < 4; k++)
+			_mm_storeu_ps(out + (x + k) * 4, _mm_mul_ps(_mm_cvtepi32_ps(words[k]), scale));
+	}
+#endif
+	//the vector loop counts pixels, the tail converts the remaining channels
+	for (x *= 4; x < width * 4; x++)
+		out[x] = row[x] * (1.0f / 255.0f);
+}
+
+static void store_pixel(const float *value, int gamma, unsigned char *out)
+{
+	for (int c = 0; c < 4; c++)
+	{
+		float v = std::min(1.0f, std::max(0.0f, value[c]));
+		if (gamma && c < 3)
+			out[c] = linear_to_srgb[(int) (v * (MIPMAP_LINEAR_STEPS - 1) + 0.5f)];
+		else
+			out[c] = (unsigned char) (v * 255.0f + 0.5f);
+	}
+}
+
+// Separable filter on floats for rows [first_row, last_row) of the output: the
+// horizontal pass of every input row the band needs, then the vertical pass.
+static void filter_rows(const unsigned char *src, int width, int height, unsigned char *dst, int first_row, int last_row,
+	const float *weights, int radius, int gamma)
+{
+	int out_width = mipmap_level_size(width, 1);
+	int taps = 2 * radius;
+	int first_input = 2 * first_row - radius + 1, last_input = 2 * (last_row - 1) + radius;
+	int input_rows = last_input - first_input + 1;
+
+	std::vector<float> row(width * 4), horizontal((size_t) input_rows * out_width * 4);
+
+	for (int r = 0; r < input_rows; r++)
+	{
+		int y = std::min(std::max(first_input + r, 0), height - 1);
+		load_row(src + (size_t) y * width * 4, width, gamma, &row[0]);
+
+		float *out = &horizontal[(size_t) r * out_width * 4];
+		for (int x = 0; x < out_width; x++)
+		{
+			int first = 2 * x - radius + 1;
+#ifdef MIPMAP_SSE2
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < taps; k++)
+			{
+				int i = std::min(std::max(first + k, 0), width - 1);
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&row[i * 4]), _mm_set1_ps(weights[k])));
+			}
+			_mm_storeu_ps(out + x * 4, sum);
+#else
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int k = 0; k < taps; k++)
+			{
+				int i = std::min(std::max(first + k, 0), width - 1);
+				for (int c = 0; c < 4; c++)
+					sum[c] += row[i * 4 + c] * weights[k];
+			}
+			memcpy(out + x * 4, sum, sizeof(sum));
+#endif
+		}
+	}
+
+	for (int y = first_row; y < last_row; y++)
+	{
+		int first = 2 * y - radius + 1 - first_input;
+		unsigned char *out = dst + (size_t) y * out_width * 4;
+		for (int x = 0; x < out_width; x++)
+		{
+			float value[4];
+#ifdef MIPMAP_SSE2
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < taps; k++)
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&horizontal[((size_t) (first + k) * out_width + x) * 4]), _mm_set1_ps(weights[k])));
+			_mm_storeu_ps(value, sum);
+#else
+			value[0] = value[1] = value[2] = value[3] = 0.0f;
+			for (int k = 0; k < taps; k++)
+				for (int c = 0; c < 4; c++)
+					value[c] += horizontal[((size_t) (first + k) * out_width + x) * 4 + c] * weights[k];
+#endif
+			store_pixel(value, gamma, out + x * 4);
+		}
+	}
+}
+
+void mipmap_downsample(const unsigned char *src, int width, int height, unsigned char *dst,
+	const mipmap_settings *settings, int threads)
+{
+	int out_height = mipmap_level_size(height, 1);
+	int bands = (out_height + MIPMAP_BAND_ROWS - 1) / MIPMAP_BAND_ROWS;
+	bool integer_box = settings->filter != MIPMAP_KAISER && !settings->gamma;
+
+	float weights[2 * MIPMAP_KAISER_RADIUS];
+	int radius = make_kernel(settings->filter, weights);
+	if (settings->gamma)
+		std::call_once(gamma_tables_once, build_gamma_tables);
+
+	parallel_for(bands, threads, [&](int band) {
+		int first_row = band * MIPMAP_BAND_ROWS;
+		int last_row = std::min(out_height, first_row + MIPMAP_BAND_ROWS);
+		if (integer_box)
+			box_rows(src, width, height, dst, first_row, last_row);
+		else
+			filter_rows(src, width, height, dst, first_row, last_row, weights, radius, settings->gamma);
+	});
+}
+
+void mipmap_build_chain(unsigned char *chain, int width, int height, const mipmap_settings *settings, int threads)
+{
+	int levels = mipmap_level_count(width, height);
+	unsigned char *level = chain;
+
+	for (int l = 1; l < levels; l++)
+	{
+		int level_width = mipmap_level_size(width, l - 1), level_height = mipmap_level_size(height, l - 1);
+		unsigned char *next = level + (size_t) level_width * level_height * 4;
+		mipmap_downsample(level, level_width, level_height, next, settings, threads);
+		level = next;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "bcn.h"
+
+/*
+ * Mip chains built on the CPU for 4 channel, 8 bit images (RGBA or BGRA,
+ * alpha last). Every level halves the previous one, sizes rounded down and
+ * never below 1, with
+ *   - a box filter: the 2x2 average;
+ *   - a Kaiser filter: a Kaiser-windowed sinc, 8 taps per axis, which keeps
+ *     the small levels sharper and aliases less than the box.
+ * With gamma the color channels are filtered in linear light: the 8-bit
+ * values are sRGB encoded, averaging them directly darkens high-contrast
+ * detail in the small levels. Alpha is always filtered as it is.
+ *
+ * The box filter without gamma works on 16-bit integers, eight channels at
+ * a time; the other cases on floats, one SSE2 register per pixel. Every
+ * level needs the previous one, so the work is split across threads by
+ * bands of rows inside each level.
+ */
+
+typedef enum
+{
+	MIPMAP_NONE,
+	MIPMAP_BOX,
+	MIPMAP_KAISER
+} mipmap_filter;
+
+typedef struct
+{
+	mipmap_filter filter;
+	int gamma;
+	bcn_format compression; // format the chain is compressed to on load, BCN_NONE to keep it RGBA8
+	int premultiply; // color multiplied by alpha before filtering, for premultiplied blending
+} mipmap_settings;
+
+// The settings of the textures that do not override them.
+void mipmap_set_default_settings(const mipmap_settings *settings);
+void mipmap_default_settings(mipmap_settings *settings);
+
+// Levels of a full chain down to 1x1, level 0 included.
+int mipmap_level_count(int width, int height);
+int mipmap_level_size(int size, int level);
+// Bytes of a full 4 channel chain, level 0 included.
+size_t mipmap_chain_bytes(int width, int height);
+
+// Writes the half size level of src into dst. threads <= 0 means all cores.
+void mipmap_downsample(const unsigned char *src, int width, int height, unsigned char *dst,
+	const mipmap_settings *settings, int threads);
+
+// Fills the levels after the first of a chain laid out level after level,
+// with level 0 already at its start.
+void mipmap_build_chain(unsigned char *chain, int width, int height, const mipmap_settings *settings, int threads);
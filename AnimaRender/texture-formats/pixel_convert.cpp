@@ -0,0 +1,174 @@
+#include "pixel_convert.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define PIXELS_SSE2
+#include <emmintrin.h>
+#endif
+
+void pixels_bgr_to_rgba(const unsigned char *src, unsigned char *dst, size_t count)
+{
+	size_t i = 0;
+
+#ifdef PIXELS_SSE2
+	//pixel k of a 12 byte group sits in lane k once the register is shifted left by k bytes
+	const __m128i lane0 = _mm_set_epi32(0, 0, 0, -1), lane1 = _mm_set_epi32(0, 0, -1, 0);
+	const __m128i lane2 = _mm_set_epi32(0, -1, 0, 0), lane3 = _mm_set_epi32(-1, 0, 0, 0);
+	const __m128i red_blue = _mm_set1_epi32(0x00FF00FF), green = _mm_set1_epi32(0x0000FF00);
+	const __m128i alpha = _mm_set1_epi32((int) 0xFF000000);
+	//every load reads 16 bytes for 4 pixels, so the last 2 pixels are left to the scalar loop
+	for (; i + 6 <= count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *) (src + i * 3));
+		__m128i bgrx = _mm_or_si128(
+			_mm_or_si128(_mm_and_si128(v, lane0), _mm_and_si128(_mm_slli_si128(v, 1), lane1)),
+			_mm_or_si128(_mm_and_si128(_mm_slli_si128(v, 2), lane2), _mm_and_si128(_mm_slli_si128(v, 3), lane3)));
+		__m128i rb = _mm_and_si128(bgrx, red_blue);
+		__m128i rgba = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16)),
+			_mm_or_si128(_mm_and_si128(bgrx, green), alpha));
+		_mm_storeu_si128((__m128i *) (dst + i * 4), rgba);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		dst[i * 4] = src[i * 3 + 2];
+		dst[i * 4 + 1] = src[i * 3 + 1];
+		dst[i * 4 + 2] = src[i * 3];
+		dst[i * 4 + 3] = 255;
+	}
+}
+
+void pixels_bgra_to_rgba(const unsigned char *src, unsigned char *dst, size_t count, int opaque)
+{
+	size_t i = 0;
+
+#ifdef PIXELS_SSE2
+	const __m128i red_blue = _mm_set1_epi32(0x00FF00FF), green_alpha = _mm_set1_epi32((int) 0xFF00FF00);
+	const __m128i alpha = _mm_set1_epi32(opaque ? (int) 0xFF000000 : 0);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i bgra = _mm_loadu_si128((const __m128i *) (src + i * 4));
+		__m128i rb = _mm_and_si128(bgra, red_blue);
+		__m128i rgba = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16)),
+			_mm_or_si128(_mm_and_si128(bgra, green_alpha), alpha));
+		_mm_storeu_si128((__m128i *) (dst + i * 4), rgba);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		unsigned char blue = src[i * 4];
+		dst[i * 4] = src[i * 4 + 2];
+		dst[i * 4 + 1] = src[i * 4 + 1];
+		dst[i * 4 + 2] = blue;
+		dst[i * 4 + 3] = opaque ? 255 : src[i * 4 + 3];
+	}
+}
+
+void pixels_gray_to_rgba(const unsigned char *src, unsigned char *dst, size_t count)
+{
+	size_t i = 0;
+
+#ifdef PIXELS_SSE2
+	const __m128i alpha = _mm_set1_epi32((int) 0xFF000000);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i gray = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i low = _mm_unpacklo_epi8(gray, gray), high = _mm_unpackhi_epi8(gray, gray);
+		_mm_storeu_si128((__m128i *) (dst + i * 4), _mm_or_si128(_mm_unpacklo_epi16(low, low), alpha));
+		_mm_storeu_si128((__m128i *) (dst + i * 4 + 16), _mm_or_si128(_mm_unpackhi_epi16(low, low), alpha));
+		_mm_storeu_si128((__m128i *) (dst + i * 4 + 32), _mm_or_si128(_mm_unpacklo_epi16(high, high), alpha));
+		_mm_storeu_si128((__m128i *) (dst + i * 4 + 48), _mm_or_si128(_mm_unpackhi_epi16(high, high), alpha));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		dst[i * 4] = dst[i * 4 + 1] = dst[i * 4 + 2] = src[i];
+		dst[i * 4 + 3] = 255;
+	}
+}
+
+void pixels_gray_alpha_to_rgba(const unsigned char *src, unsigned char *dst, size_t count)
+{
+	size_t i = 0;
+
+#ifdef PIXELS_SSE2
+	//a lane holds gray, alpha, gray, alpha: the second byte gets the gray value too
+	const __m128i keep = _mm_set1_epi32((int) 0xFFFF00FF), gray = _mm_set1_epi32(0xFF);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *) (src + i * 2));
+		__m128i low = _mm_unpacklo_epi16(v, v), high = _mm_unpackhi_epi16(v, v);
+		low = _mm_or_si128(_mm_and_si128(low, keep), _mm_slli_epi32(_mm_and_si128(low, gray), 8));
+		high = _mm_or_si128(_mm_and_si128(high, keep), _mm_slli_epi32(_mm_and_si128(high, gray), 8));
+		_mm_storeu_si128((__m128i *) (dst + i * 4), low);
+		_mm_storeu_si128((__m128i *) (dst + i * 4 + 16), high);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		dst[i * 4] = dst[i * 4 + 1] = dst[i * 4 + 2] = src[i * 2];
+		dst[i * 4 + 3] = src[i * 2 + 1];
+	}
+}
+
+void pixels_bgr555_to_rgba(const unsigned char *src, unsigned char *dst, size_t count, int alpha_bit)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned int pixel = src[i * 2] | (src[i * 2 + 1] << 8);
+		unsigned int r = (pixel >> 10) & 31, g = (pixel >> 5) & 31, b = pixel & 31;
+		dst[i * 4] = (unsigned char) ((r << 3) | (r >> 2));
+		dst[i * 4 + 1] = (unsigned char) ((g << 3) | (g >> 2));
+		dst[i * 4 + 2] = (unsigned char) ((b << 3) | (b >> 2));
+		dst[i * 4 + 3] = !alpha_bit || (pixel & 0x8000) ? 255 : 0;
+	}
+}
+
+void pixels_flip_rows(unsigned char *pixels, size_t row_bytes, int rows)
+{
+	std::vector<unsigned char> row(row_bytes);
+	for (int top = 0, bottom = rows - 1; top < bottom; top++, bottom--)
+	{
+		memcpy(&row[0], pixels + top * row_bytes, row_bytes);
+		memcpy(pixels + top * row_bytes, pixels + bottom * row_bytes, row_bytes);
+		memcpy(pixels + bottom * row_bytes, &row[0], row_bytes);
+	}
+}
+
+void pixels_premultiply(unsigned char *rgba, size_t count)
+{
+	size_t i = 0;
+
+#ifdef PIXELS_SSE2
+	const __m128i zero = _mm_setzero_si128(), half = _mm_set1_epi16(128);
+	const __m128i color = _mm_set1_epi32(0x00FFFFFF), alpha = _mm_set1_epi32((int) 0xFF000000);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *) (rgba + i * 4));
+		__m128i halves[2] = { _mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero) };
+		for (int h = 0; h < 2; h++)
+		{
+			__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(halves[h], _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			//(t + (t >> 8)) >> 8 with t = c * a + 128 is c * a / 255 rounded
+			__m128i t = _mm_add_epi16(_mm_mullo_epi16(halves[h], a), half);
+			halves[h] = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+		}
+		__m128i product = _mm_packus_epi16(halves[0], halves[1]);
+		_mm_storeu_si128((__m128i *) (rgba + i * 4), _mm_or_si128(_mm_and_si128(product, color), _mm_and_si128(v, alpha)));
+	}
+#endif
+	for (; i < count; i++)
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int t = rgba[i * 4 + c] * rgba[i * 4 + 3] + 128;
+			rgba[i * 4 + c] = (unsigned char) ((t + (t >> 8)) >> 8);
+		}
+}
+
+void *pixels_malloc(int width, int height, void *context)
+{
+	return malloc((size_t) width * height * 4);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Conversions of the pixel layouts found in image files to RGBA8, the
+ * layout every uncompressed texture is uploaded in, so the driver never
+ * has to swizzle. Counts are in pixels. Apart from pixels_bgra_to_rgba,
+ * src and dst must not overlap.
+ *
+ * The 8 and 24/32-bit conversions work on SSE2 registers, 4 to 16 pixels
+ * at a time: BGR pixels are spread to 32-bit lanes with byte shifts and
+ * masks, red and blue are swapped with 32-bit shifts. Premultiplication
+ * computes c * a / 255 exactly on 16-bit lanes.
+ */
+
+// 3 bytes per pixel, blue first; alpha becomes 255.
+void pixels_bgr_to_rgba(const unsigned char *src, unsigned char *dst, size_t count);
+
+// 4 bytes per pixel, blue first. With opaque the fourth byte is ignored and
+// alpha becomes 255. src and dst may be the same buffer.
+void pixels_bgra_to_rgba(const unsigned char *src, unsigned char *dst, size_t count, int opaque);
+
+// 1 byte per pixel, or 2 with alpha after the gray value.
+void pixels_gray_to_rgba(const unsigned char *src, unsigned char *dst, size_t count);
+void pixels_gray_alpha_to_rgba(const unsigned char *src, unsigned char *dst, size_t count);
+
+// 16-bit little endian pixels, 5 bits per channel with blue lowest and the top bit
+// as alpha when alpha_bit is set (opaque otherwise).
+void pixels_bgr555_to_rgba(const unsigned char *src, unsigned char *dst, size_t count, int alpha_bit);
+
+// Reverses the order of the rows in place.
+void pixels_flip_rows(unsigned char *pixels, size_t row_bytes, int rows);
+
+// Multiplies the color channels of RGBA pixels by their alpha, in place.
+void pixels_premultiply(unsigned char *rgba, size_t count);
+
+// Where a reader writes the RGBA8 pixels of an image: called once the file is
+// known to decode, with its size, it returns a buffer of at least
+// width * height * 4 bytes, or NULL to give up. The rows are written from the
+// start of the buffer; the callers building a mip chain ask for more room after it.
+typedef void *(*pixel_destination)(int width, int height, void *context);
+
+// The destination of the readers returning malloc'd pixels; context is unused.
+void *pixels_malloc(int width, int height, void *context);
@@ -1,19 +1,37 @@
 #include "pngreader.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <lodepng.h>
 
 //Loads a PNG image, must be sized as a power of two.
 void *read_png(const char *filename, unsigned int *width, unsigned int *height)
 {
-	std::vector<unsigned char> *image = new std::vector<unsigned char>();
-	unsigned error = lodepng::decode(*image, *width, *height, filename);
+	//the C interface hands over its malloc'd buffer instead of keeping it in a vector
+	unsigned char *image = NULL;
+	unsigned error = lodepng_decode32_file(&image, width, height, filename);
 
 	// If there's an error, display it.
 	if (error != 0)
 	{
 		fprintf(stderr, "Error decoding %s\n", filename);
+		free(image);
 		return NULL;
 	}
 
-	return &(*image)[0];
-}
\ No newline at end of file
+	return image;
+}
+
+void *read_png_to(const char *filename, unsigned int *width, unsigned int *height, pixel_destination destination, void *context)
+{
+	unsigned char *image = (unsigned char *) read_png(filename, width, height);
+	if (image == NULL)
+		return NULL;
+
+	void *pixels = destination((int) *width, (int) *height, context);
+	if (pixels != NULL)
+		memcpy(pixels, image, (size_t) *width * *height * 4);
+	free(image);
+	return pixels;
+}
@@ -1,3 +1,11 @@
 #pragma once
 
-void *read_png(const char *filename, unsigned int *width, unsigned int *height);
\ No newline at end of file
+#include "pixel_convert.h"
+
+// Decodes a png file to RGBA; the pixels are malloc'd and must be freed with free().
+void *read_png(const char *filename, unsigned int *width, unsigned int *height);
+
+// Like read_png, but the pixels are written to the buffer destination returns;
+// returns that buffer, NULL on failure. lodepng decodes into memory of its own,
+// which is copied into the destination and freed.
+void *read_png_to(const char *filename, unsigned int *width, unsigned int *height, pixel_destination destination, void *context);
@@ -1,14 +1,85 @@
 #include "tgareader.h"
+#include "pixel_convert.h"
+#include "../utils/mapped_file.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <vector>
 
-static short le_short(unsigned char *bytes)
+// Image types; the RLE compressed variants add 8.
+#define TGA_COLOR_MAPPED 1
+#define TGA_TRUE_COLOR 2
+#define TGA_GRAY 3
+#define TGA_RLE 8
+// Image descriptor bit set when the first row is the top one.
+#define TGA_TOP_ORIGIN 0x20
+
+static short le_short(const unsigned char *bytes)
 {
 	return bytes[0] | ((char) bytes[1] << 8);
 }
 
+// Expands the RLE packets of `count` pixels of `pixel_bytes` each; returns the bytes
+// read from data, 0 if the packets run past its end.
+static size_t decode_rle(const unsigned char *data, size_t size, size_t count, int pixel_bytes, unsigned char *out)
+{
+	size_t read = 0, written = 0;
+	while (written < count)
+	{
+		if (read >= size)
+			return 0;
+		unsigned char packet = data[read++];
+		size_t run = (packet & 0x7F) + 1;
+		if (run > count - written)
+			run = count - written;
+		if (packet & 0x80)
+		{
+			if (size - read < (size_t) pixel_bytes)
+				return 0;
+			for (size_t i = 0; i < run; i++)
+				memcpy(out + (written + i) * pixel_bytes, data + read, pixel_bytes);
+			read += pixel_bytes;
+		}
+		else
+		{
+			if (size - read < run * pixel_bytes)
+				return 0;
+			memcpy(out + written * pixel_bytes, data + read, run * pixel_bytes);
+			read += run * pixel_bytes;
+		}
+		written += run;
+	}
+	return read;
+}
+
+// Whether convert_pixels handles a tga layout.
+static bool supported_pixels(int bits, bool gray)
+{
+	return gray ? (bits == 8 || bits == 16) : (bits == 15 || bits == 16 || bits == 24 || bits == 32);
+}
+
+// Converts count pixels of a supported tga layout to RGBA.
+static void convert_pixels(const unsigned char *src, unsigned char *dst, size_t count, int bits, bool gray, int alpha_bits)
+{
+	if (gray && bits == 8)
+		pixels_gray_to_rgba(src, dst, count);
+	else if (gray)
+		pixels_gray_alpha_to_rgba(src, dst, count);
+	else if (bits == 15 || bits == 16)
+		pixels_bgr555_to_rgba(src, dst, count, alpha_bits > 0);
+	else if (bits == 24)
+		pixels_bgr_to_rgba(src, dst, count);
+	else
+		pixels_bgra_to_rgba(src, dst, count, 0);
+}
+
 void *read_tga(const char *filename, int *width, int *height)
+{
+	return read_tga_to(filename, width, height, pixels_malloc, NULL);
+}
+
+void *read_tga_to(const char *filename, int *width, int *height, pixel_destination destination, void *context)
 {
 	struct tga_header {
 		char  id_length;
@@ -24,57 +95,102 @@ void *read_tga(const char *filename, int *width, int *height)
 		char  bits_per_pixel;
 		char  image_descriptor;
 	} header;
-	int i, color_map_size, pixels_size;
-	FILE *f;
-	size_t read;
-	void *pixels;
+	mapped_file file;
 
-	f = fopen(filename, "rb");
-
-	if (!f) {
-		fprintf(stderr, "Unable to open %s for reading\n", filename);
+	if (!map_file(&file, filename))
 		return NULL;
-	}
 
-	read = fread(&header, 1, sizeof(header), f);
-
-	if (read != sizeof(header)) {
+	if (file.size < sizeof(header)) {
 		fprintf(stderr, "%s has incomplete tga header\n", filename);
-		fclose(f);
+		unmap_file(&file);
 		return NULL;
 	}
-	if (header.data_type_code != 2) {
-		fprintf(stderr, "%s is not an uncompressed RGB tga file\n", filename);
-		fclose(f);
+	memcpy(&header, file.data, sizeof(header));
+
+	int type = header.data_type_code & ~TGA_RLE;
+	int bits = (unsigned char) header.bits_per_pixel, map_bits = (unsigned char) header.color_map_depth;
+	if ((type != TGA_COLOR_MAPPED && type != TGA_TRUE_COLOR && type != TGA_GRAY) ||
+		(type == TGA_COLOR_MAPPED && (header.color_map_type != 1 || bits != 8))) {
+		fprintf(stderr, "%s is not a true color, gray or 8-bit color mapped tga file\n", filename);
+		unmap_file(&file);
 		return NULL;
 	}
-	for (i = 0; i < header.id_length; ++i)
-	if (getc(f) == EOF) {
-		fprintf(stderr, "%s has incomplete id string\n", filename);
-		fclose(f);
+
+	//the id string and the color map come before the pixels
+	int map_first = le_short(header.color_map_origin), map_length = le_short(header.color_map_length);
+	int map_entry_bytes = (map_bits + 7) / 8;
+	size_t map_offset = sizeof(header) + (unsigned char) header.id_length;
+	size_t pixels_offset = map_offset + (header.color_map_type == 1 ? (size_t) map_length * map_entry_bytes : 0);
+
+	*width = le_short(header.width); *height = le_short(header.height);
+	size_t count = (size_t) *width * *height;
+	int pixel_bytes = (bits + 7) / 8;
+	if (*width <= 0 || *height <= 0 || pixels_offset > file.size) {
+		fprintf(stderr, "%s has incomplete image\n", filename);
+		unmap_file(&file);
 		return NULL;
 	}
 
-	color_map_size = le_short(header.color_map_length) * (header.color_map_depth / 8);
-	for (i = 0; i < color_map_size; ++i)
-	if (getc(f) == EOF) {
-		fprintf(stderr, "%s has incomplete color map\n", filename);
-		fclose(f);
+	const unsigned char *data = (const unsigned char *) file.data + pixels_offset;
+	size_t size = file.size - pixels_offset;
+	std::vector<unsigned char> expanded;
+	if (header.data_type_code & TGA_RLE) {
+		expanded.resize(count * pixel_bytes);
+		if (decode_rle(data, size, count, pixel_bytes, &expanded[0]) == 0) {
+			fprintf(stderr, "%s has incomplete image\n", filename);
+			unmap_file(&file);
+			return NULL;
+		}
+		data = &expanded[0];
+	}
+	else if (size < count * pixel_bytes) {
+		fprintf(stderr, "%s has incomplete image\n", filename);
+		unmap_file(&file);
 		return NULL;
 	}
 
-	*width = le_short(header.width); *height = le_short(header.height);
-	pixels_size = *width * *height * (header.bits_per_pixel / 8);
-	pixels = malloc(pixels_size);
+	//color mapped pixels are looked up first, then converted like true color ones
+	std::vector<unsigned char> mapped;
+	if (type == TGA_COLOR_MAPPED) {
+		const unsigned char *map = (const unsigned char *) file.data + map_offset;
+		mapped.resize(count * map_entry_bytes);
+		for (size_t i = 0; i < count; i++) {
+			int entry = data[i] - map_first;
+			if (entry < 0 || entry >= map_length) {
+				fprintf(stderr, "%s has a pixel outside its color map\n", filename);
+				unmap_file(&file);
+				return NULL;
+			}
+			memcpy(&mapped[i * map_entry_bytes], map + entry * map_entry_bytes, map_entry_bytes);
+		}
+		data = &mapped[0];
+		bits = map_bits;
+	}
 
-	read = fread(pixels, 1, pixels_size, f);
+	bool gray = type == TGA_GRAY;
+	int alpha_bits = header.image_descriptor & 0x0F;
+	if (!supported_pixels(bits, gray)) {
+		fprintf(stderr, "%s has an unsupported pixel depth\n", filename);
+		unmap_file(&file);
+		return NULL;
+	}
 
-	if (read != pixels_size) {
-		fprintf(stderr, "%s has incomplete image\n", filename);
-		fclose(f);
-		free(pixels);
+	unsigned char *pixels = (unsigned char *) destination(*width, *height, context);
+	if (pixels == NULL) {
+		unmap_file(&file);
 		return NULL;
 	}
 
+	//bottom row first, as in the default tga orientation: top to bottom rows are converted
+	//one by one into their place, so the destination is only written, never read back
+	if (header.image_descriptor & TGA_TOP_ORIGIN) {
+		size_t src_row = (size_t) *width * ((bits + 7) / 8), dst_row = (size_t) *width * 4;
+		for (int row = 0; row < *height; row++)
+			convert_pixels(data + row * src_row, pixels + (*height - 1 - row) * dst_row, *width, bits, gray, alpha_bits);
+	}
+	else
+		convert_pixels(data, pixels, count, bits, gray, alpha_bits);
+
+	unmap_file(&file);
 	return pixels;
-}
\ No newline at end of file
+}
@@ -1,3 +1,11 @@
 #pragma once
 
-void *read_tga(const char *filename, int *width, int *height);
\ No newline at end of file
+#include "pixel_convert.h"
+
+// Reads a true color, gray or color mapped tga file, plain or RLE compressed,
+// and returns its pixels as RGBA8 rows, bottom row first (malloc'd). NULL on failure.
+void *read_tga(const char *filename, int *width, int *height);
+
+// Like read_tga, but the pixels are written to the buffer destination returns;
+// returns that buffer, NULL on failure.
+void *read_tga_to(const char *filename, int *width, int *height, pixel_destination destination, void *context);
@@ -0,0 +1,377 @@
+#include "benchmark.h"
+#include "timer.h"
+#include "mapped_file.h"
+
+#include "../objloader/obj_parser.h"
+#include "../mesh/index_buffer.h"
+#include "../mesh/weld.h"
+#include "../mesh/vcache.h"
+#include "../mesh/mesh_codec.h"
+#include "../texture-formats/pixel_convert.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+static double file_megabytes(const char *filename)
+{
+	long long size;
+	if (!file_stat(filename, &size, NULL))
+		return 0.0;
+	return size / (1024.0 * 1024.0);
+}
+
+static double time_obj_parse(int (*parse)(obj_scene_data *, const char *), const char *filename, int iterations, obj_scene_data *last)
+{
+	double best = 1e30;
+
+	for (int i = 0; i < iterations; i++)
+	{
+		obj_scene_data data;
+		double start = timer_seconds();
+		if (!parse(&data, filename))
+			return -1.0;
+		double elapsed = timer_seconds() - start;
+		if (elapsed < best)
+			best = elapsed;
+
+		if (i == iterations - 1)
+			*last = data;
+		else
+			delete_obj_data(&data);
+	}
+	return best;
+}
+
+static int count_mismatches(const void *a, const void *b, int count, size_t element_size)
+{
+	int mismatches = 0;
+	for (int i = 0; i < count; i++)
+		if (memcmp((const char *) a + i * element_size, (const char *) b + i * element_size, element_size) != 0)
+			mismatches++;
+	return mismatches;
+}
+
+//Compares the stdio parser with the memory-mapped one on the same file
+int benchmark_obj_parser(const char *filename, int iterations)
+{
+	obj_scene_data stdio_data, mapped_data;
+	double size = file_megabytes(filename);
+
+	if (iterations < 1)
+		iterations = 1;
+
+	double stdio_time = time_obj_parse(parse_obj_scene_stdio, filename, iterations, &stdio_data);
+	double mapped_time = time_obj_parse(parse_obj_scene, filename, iterations, &mapped_data);
+	if (stdio_time < 0.0 || mapped_time < 0.0)
+	{
+		fprintf(stderr, "Error parsing %s\n", filename);
+		return 0;
+	}
+
+	const obj_mesh_arrays &stdio_mesh = stdio_data.mesh;
+	const obj_mesh_arrays &mapped_mesh = mapped_data.mesh;
+
+	printf("%s: %.1f MB, %d v, %d vn, %d vt, %d triangles (best of %d)\n", filename, size,
+		mapped_mesh.position_count, mapped_mesh.normal_count, mapped_mesh.texcoord_count,
+		mapped_mesh.triangle_count, iterations);
+	printf("  stdio parser:  %8.3f s  %8.1f MB/s\n", stdio_time, size / stdio_time);
+	printf("  mapped parser: %8.3f s  %8.1f MB/s  (%.2fx)\n", mapped_time, size / mapped_time, stdio_time / mapped_time);
+
+	if (stdio_mesh.position_count != mapped_mesh.position_count ||
+		stdio_mesh.normal_count != mapped_mesh.normal_count ||
+		stdio_mesh.texcoord_count != mapped_mesh.texcoord_count ||
+		stdio_mesh.triangle_count != mapped_mesh.triangle_count)
+	{
+		printf("  WARNING: the two parsers produced different element counts\n");
+	}
+	else
+	{
+		int mismatches = count_mismatches(stdio_mesh.positions, mapped_mesh.positions, mapped_mesh.position_count, sizeof(float) * 3)
+			+ count_mismatches(stdio_mesh.normals, mapped_mesh.normals, mapped_mesh.normal_count, sizeof(float) * 3)
+			+ count_mismatches(stdio_mesh.texcoords, mapped_mesh.texcoords, mapped_mesh.texcoord_count, sizeof(float) * 2)
+			+ count_mismatches(stdio_mesh.triangles, mapped_mesh.triangles, mapped_mesh.triangle_count, sizeof(obj_index_triple) * 3)
+			+ count_mismatches(stdio_mesh.triangle_materials, mapped_mesh.triangle_materials, mapped_mesh.triangle_count, sizeof(int));
+		if (mismatches != 0)
+			printf("  WARNING: %d elements differ between the two parsers\n", mismatches);
+	}
+
+	delete_obj_data(&stdio_data);
+	delete_obj_data(&mapped_data);
+	return 1;
+}
+
+typedef struct
+{
+	const char *name;
+	const void *data;
+	size_t count;
+	int components;
+	int word_size;
+} codec_stream;
+
+//Welds the OBJ like Geometry::buildGeometry and puts it in the order an optimized cache has
+static int codec_streams(const obj_mesh_arrays &mesh, std::vector<float> &positions, std::vector<float> &normals,
+	std::vector<float> &texcoords, std::vector<GLuint> &elements)
+{
+	std::vector<int> remap;
+	std::vector<obj_index_triple> unique;
+	int vertex_count = weld_corners(mesh.triangles, mesh.triangle_count * 3, remap, unique);
+
+	std::vector<GLuint> order;
+	elements.assign(remap.begin(), remap.end());
+	optimize_vertex_cache(elements, vertex_count);
+	optimize_vertex_fetch(elements, vertex_count, order);
+
+	positions.resize(vertex_count * 3);
+	normals.resize(mesh.normal_count > 0 ? vertex_count * 3 : 0, 0.0f);
+	texcoords.resize(mesh.texcoord_count > 0 ? vertex_count * 2 : 0, 0.0f);
+	for (int v = 0; v < vertex_count; v++)
+	{
+		const obj_index_triple &corner = unique[order[v]];
+		memcpy(&positions[v * 3], &mesh.positions[corner.vertex_index * 3], 3 * sizeof(float));
+		if (!normals.empty() && corner.normal_index >= 0)
+			memcpy(&normals[v * 3], &mesh.normals[corner.normal_index * 3], 3 * sizeof(float));
+		if (!texcoords.empty() && corner.texture_index >= 0)
+			memcpy(&texcoords[v * 2], &mesh.texcoords[corner.texture_index * 2], 2 * sizeof(float));
+	}
+	return vertex_count;
+}
+
+//Compresses the welded mesh of an OBJ and compares the load paths: parsing the text,
+//copying the raw arrays (a mapped .amesh) and decoding the codec streams
+int benchmark_mesh_codec(const char *filename, int iterations)
+{
+	obj_scene_data data;
+
+	if (iterations < 1)
+		iterations = 1;
+
+	double obj_size = file_megabytes(filename);
+	double parse_time = time_obj_parse(parse_obj_scene, filename, iterations, &data);
+	if (parse_time < 0.0)
+	{
+		fprintf(stderr, "Error parsing %s\n", filename);
+		return 0;
+	}
+
+	std::vector<float> positions, normals, texcoords;
+	std::vector<GLuint> elements;
+	int vertex_count = codec_streams(data.mesh, positions, normals, texcoords, elements);
+	delete_obj_data(&data);
+
+	std::vector<GLushort> short_elements;
+	bool short_indices = vertex_count <= MESH_MAX_SHORT_VERTICES;
+	if (short_indices)
+		short_elements.assign(elements.begin(), elements.end());
+
+	codec_stream streams[4] = {
+		{ "positions", positions.empty() ? NULL : &positions[0], (size_t) vertex_count, 3, 4 },
+		{ "normals", normals.empty() ? NULL : &normals[0], (size_t) vertex_count, 3, 4 },
+		{ "texcoords", texcoords.empty() ? NULL : &texcoords[0], (size_t) vertex_count, 2, 4 },
+		{ "indices", NULL, elements.size(), 1, short_indices ? 2 : 4 }
+	};
+	if (!elements.empty())
+		streams[3].data = short_indices ? (const void *) &short_elements[0] : (const void *) &elements[0];
+
+	printf("%s: %.1f MB, %d vertices, %d triangles, %d-bit indices (best of %d)\n", filename, obj_size,
+		vertex_count, (int) elements.size() / 3, short_indices ? 16 : 32, iterations);
+
+	double raw_total = 0.0, encoded_total = 0.0, copy_time = 0.0, decode_time = 0.0;
+	for (int s = 0; s < 4; s++)
+	{
+		const codec_stream &stream = streams[s];
+		if (stream.data == NULL)
+			continue;
+
+		size_t raw_size = stream.count * stream.components * stream.word_size;
+		std::vector<unsigned char> encoded, decoded(raw_size), copy(raw_size);
+
+		double start = timer_seconds();
+		codec_encode_words(stream.data, stream.count, stream.components, stream.word_size, encoded);
+		double encode_time = timer_seconds() - start;
+
+		double best_decode = 1e30, best_copy = 1e30;
+		for (int i = 0; i < iterations; i++)
+		{
+			start = timer_seconds();
+			if (!codec_decode_words(&encoded[0], encoded.size(), stream.count, stream.components, stream.word_size, &decoded[0]))
+			{
+				printf("  WARNING: %s could not be decoded\n", stream.name);
+				return 0;
+			}
+			best_decode = std::min(best_decode, timer_seconds() - start);
+
+			start = timer_seconds();
+			memcpy(&copy[0], stream.data, raw_size);
+			best_copy = std::min(best_copy, timer_seconds() - start);
+		}
+		if (memcmp(&decoded[0], stream.data, raw_size) != 0)
+			printf("  WARNING: %s does not decode to the original data\n", stream.name);
+
+		double raw_mb = raw_size / (1024.0 * 1024.0), encoded_mb = encoded.size() / (1024.0 * 1024.0);
+		printf("  %-10s %8.2f MB -> %8.2f MB  %5.2fx  encode %7.1f MB/s  decode %6.2f GB/s\n", stream.name,
+			raw_mb, encoded_mb, raw_mb / encoded_mb, raw_mb / encode_time, raw_mb / 1024.0 / best_decode);
+
+		raw_total += raw_mb;
+		encoded_total += encoded_mb;
+		copy_time += best_copy;
+		decode_time += best_decode;
+	}
+
+	printf("  OBJ text:   %8.2f MB  parse  %8.3f s  %8.1f MB/s\n", obj_size, parse_time, obj_size / parse_time);
+	printf("  raw binary: %8.2f MB  copy   %8.3f s  %8.2f GB/s  (%.1fx smaller than OBJ)\n",
+		raw_total, copy_time, raw_total / 1024.0 / copy_time, obj_size / raw_total);
+	printf("  mesh codec: %8.2f MB  decode %8.3f s  %8.2f GB/s  (%.1fx smaller than OBJ, %.2fx than raw)\n",
+		encoded_total, decode_time, raw_total / 1024.0 / decode_time, obj_size / encoded_total, raw_total / encoded_total);
+	printf("  a disk must read faster than %.1f MB/s for the raw binary to load faster than the codec\n",
+		(raw_total - encoded_total) / decode_time);
+	return 1;
+}
+
+//Plain loops the pixel conversions are compared with
+static void reference_bgr_to_rgba(const unsigned char *src, unsigned char *dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		dst[i * 4] = src[i * 3 + 2];
+		dst[i * 4 + 1] = src[i * 3 + 1];
+		dst[i * 4 + 2] = src[i * 3];
+		dst[i * 4 + 3] = 255;
+	}
+}
+
+static void reference_bgra_to_rgba(const unsigned char *src, unsigned char *dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		dst[i * 4] = src[i * 4 + 2];
+		dst[i * 4 + 1] = src[i * 4 + 1];
+		dst[i * 4 + 2] = src[i * 4];
+		dst[i * 4 + 3] = src[i * 4 + 3];
+	}
+}
+
+static void reference_gray_to_rgba(const unsigned char *src, unsigned char *dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		dst[i * 4] = dst[i * 4 + 1] = dst[i * 4 + 2] = src[i];
+		dst[i * 4 + 3] = 255;
+	}
+}
+
+static void reference_gray_alpha_to_rgba(const unsigned char *src, unsigned char *dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		dst[i * 4] = dst[i * 4 + 1] = dst[i * 4 + 2] = src[i * 2];
+		dst[i * 4 + 3] = src[i * 2 + 1];
+	}
+}
+
+static void reference_premultiply(const unsigned char *src, unsigned char *dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int c = 0; c < 3; c++)
+			dst[i * 4 + c] = (unsigned char) ((src[i * 4 + c] * src[i * 4 + 3] + 127) / 255);
+		dst[i * 4 + 3] = src[i * 4 + 3];
+	}
+}
+
+static void library_bgra_to_rgba(const unsigned char *src, unsigned char *dst, size_t count)
+{
+	pixels_bgra_to_rgba(src, dst, count, 0);
+}
+
+static void library_premultiply(const unsigned char *src, unsigned char *dst, size_t count)
+{
+	memcpy(dst, src, count * 4);
+	pixels_premultiply(dst, count);
+}
+
+//Like the readers: the rows arrive in the destination, then are flipped there
+static void library_flip(const unsigned char *src, unsigned char *dst, size_t count)
+{
+	memcpy(dst, src, count * 4);
+	pixels_flip_rows(dst, 4096 * 4, (int) (count / 4096));
+}
+
+static void reference_flip(const unsigned char *src, unsigned char *dst, size_t count)
+{
+	size_t row = 4096 * 4, rows = count / 4096;
+	for (size_t r = 0; r < rows; r++)
+		memcpy(dst + r * row, src + (rows - 1 - r) * row, row);
+}
+
+static double time_conversion(void (*convert)(const unsigned char *, unsigned char *, size_t),
+	const unsigned char *src, unsigned char *dst, size_t count, int iterations)
+{
+	double best = 1e30;
+	for (int i = 0; i < iterations; i++)
+	{
+		double start = timer_seconds();
+		convert(src, dst, count);
+		best = std::min(best, timer_seconds() - start);
+	}
+	return best;
+}
+
+//Times every conversion of pixel_convert on random pixels and checks it against the plain loop
+int benchmark_pixel_conversion(int megapixels, int iterations)
+{
+	typedef struct
+	{
+		const char *name;
+		int source_bytes;
+		void (*convert)(const unsigned char *, unsigned char *, size_t);
+		void (*reference)(const unsigned char *, unsigned char *, size_t);
+	} conversion;
+
+	const conversion conversions[] = {
+		{ "bgr -> rgba", 3, pixels_bgr_to_rgba, reference_bgr_to_rgba },
+		{ "bgra -> rgba", 4, library_bgra_to_rgba, reference_bgra_to_rgba },
+		{ "gray -> rgba", 1, pixels_gray_to_rgba, reference_gray_to_rgba },
+		{ "gray+a -> rgba", 2, pixels_gray_alpha_to_rgba, reference_gray_alpha_to_rgba },
+		{ "premultiply", 4, library_premultiply, reference_premultiply },
+		{ "vertical flip", 4, library_flip, reference_flip }
+	};
+
+	if (iterations < 1)
+		iterations = 1;
+	if (megapixels < 1)
+		megapixels = 1;
+
+	//rows of 4096 pixels, so the flip works on a realistic texture width
+	size_t count = (size_t) megapixels * 1024 * 1024;
+	std::vector<unsigned char> src(count * 4), dst(count * 4), expected(count * 4);
+	unsigned int seed = 12345;
+	for (size_t i = 0; i < src.size(); i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+		src[i] = (unsigned char) (seed >> 16);
+	}
+
+	printf("pixel conversions on %d Mpixel (best of %d), MB/s of source pixels\n", megapixels, iterations);
+	for (size_t c = 0; c < sizeof(conversions) / sizeof(conversions[0]); c++)
+	{
+		const conversion &conv = conversions[c];
+		double megabytes = count * conv.source_bytes / (1024.0 * 1024.0);
+		double time = time_conversion(conv.convert, &src[0], &dst[0], count, iterations);
+		if (conv.reference == NULL)
+		{
+			printf("  %-15s %9.1f MB/s\n", conv.name, megabytes / time);
+			continue;
+		}
+
+		double reference_time = time_conversion(conv.reference, &src[0], &expected[0], count, iterations);
+		conv.convert(&src[0], &dst[0], count);
+		printf("  %-15s %9.1f MB/s  plain loop %9.1f MB/s  (%.2fx)\n", conv.name, megabytes / time,
+			megabytes / reference_time, reference_time / time);
+		if (memcmp(&dst[0], &expected[0], count * 4) != 0)
+			printf("  WARNING: %s does not match the plain loop\n", conv.name);
+	}
+	return 1;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+/*
+ * Micro benchmarks that can be run from the command line (see main.cpp).
+ * They print their results on stdout and don't need an OpenGL context.
+ */
+
+int benchmark_obj_parser(const char *filename, int iterations);
+
+// Sizes and decode speed of the mesh_codec streams of an OBJ, against the OBJ text and the raw binary arrays.
+int benchmark_mesh_codec(const char *filename, int iterations);
+
+// Throughput of the texture-formats pixel conversions on a synthetic image of `megapixels`,
+// against plain per-pixel loops.
+int benchmark_pixel_conversion(int megapixels, int iterations);
@@ -0,0 +1,123 @@
+#include "mapped_file.h"
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Maps filename read-only. An empty file is mapped as data == NULL, size == 0.
+ * Returns 0 on failure.
+ */
+int map_file(mapped_file *mf, const char *filename)
+{
+	mf->data = NULL;
+	mf->size = 0;
+
+#ifdef _WIN32
+	mf->mapping_handle = NULL;
+	mf->file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (mf->file_handle == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "Unable to open %s for reading\n", filename);
+		return 0;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mf->file_handle, &size)) {
+		CloseHandle(mf->file_handle);
+		return 0;
+	}
+	mf->size = (size_t) size.QuadPart;
+	if (mf->size == 0)
+		return 1;
+
+	mf->mapping_handle = CreateFileMappingA(mf->file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mf->mapping_handle == NULL) {
+		fprintf(stderr, "Unable to map %s\n", filename);
+		CloseHandle(mf->file_handle);
+		return 0;
+	}
+
+	mf->data = (const char *) MapViewOfFile(mf->mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if (mf->data == NULL) {
+		fprintf(stderr, "Unable to map %s\n", filename);
+		CloseHandle(mf->mapping_handle);
+		CloseHandle(mf->file_handle);
+		return 0;
+	}
+#else
+	struct stat st;
+
+	mf->fd = open(filename, O_RDONLY);
+	if (mf->fd < 0) {
+		fprintf(stderr, "Unable to open %s for reading\n", filename);
+		return 0;
+	}
+
+	if (fstat(mf->fd, &st) != 0) {
+		close(mf->fd);
+		return 0;
+	}
+	mf->size = (size_t) st.st_size;
+	if (mf->size == 0)
+		return 1;
+
+	void *data = mmap(NULL, mf->size, PROT_READ, MAP_PRIVATE, mf->fd, 0);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "Unable to map %s\n", filename);
+		close(mf->fd);
+		return 0;
+	}
+	madvise(data, mf->size, MADV_SEQUENTIAL);
+	mf->data = (const char *) data;
+#endif
+
+	return 1;
+}
+
+void unmap_file(mapped_file *mf)
+{
+#ifdef _WIN32
+	if (mf->data)
+		UnmapViewOfFile(mf->data);
+	if (mf->mapping_handle)
+		CloseHandle(mf->mapping_handle);
+	CloseHandle(mf->file_handle);
+#else
+	if (mf->data)
+		munmap((void *) mf->data, mf->size);
+	close(mf->fd);
+#endif
+	mf->data = NULL;
+	mf->size = 0;
+}
+
+int file_stat(const char *filename, long long *size, long long *mtime)
+{
+#ifdef _WIN32
+	//stat has a 32-bit st_size with the Microsoft CRT
+	struct _stat64 st;
+	if (_stat64(filename, &st) != 0)
+		return 0;
+#else
+	struct stat st;
+	if (stat(filename, &st) != 0)
+		return 0;
+#endif
+	if (size != NULL)
+		*size = (long long) st.st_size;
+	if (mtime != NULL)
+		*mtime = (long long) st.st_mtime;
+	return 1;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Read-only memory mapping of a whole file.
+ */
+typedef struct
+{
+	const char *data;
+	size_t size;
+#ifdef _WIN32
+	void *file_handle;
+	void *mapping_handle;
+#else
+	int fd;
+#endif
+} mapped_file;
+
+int map_file(mapped_file *mf, const char *filename);
+void unmap_file(mapped_file *mf);
+
+// Size and modification time of a file, 64-bit on every platform (files over
+// 2 GB included). Either pointer may be NULL. Returns 0 if it does not exist.
+int file_stat(const char *filename, long long *size, long long *mtime);
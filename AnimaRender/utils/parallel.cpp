@@ -0,0 +1,45 @@
+#include "parallel.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+int hardware_threads()
+{
+	unsigned int threads = std::thread::hardware_concurrency();
+	return threads > 0 ? (int) threads : 1;
+}
+
+void parallel_for(int count, int threads, const std::function<void (int)> &body)
+{
+	if (threads <= 0)
+		threads = hardware_threads();
+	if (threads > count)
+		threads = count;
+
+	if (threads <= 1)
+	{
+		for (int i = 0; i < count; i++)
+			body(i);
+		return;
+	}
+
+	std::atomic<int> next(0);
+	std::vector<std::thread> workers;
+
+	for (int t = 1; t < threads; t++)
+	{
+		workers.push_back(std::thread([&]() {
+			int i;
+			while ((i = next++) < count)
+				body(i);
+		}));
+	}
+
+	int i;
+	while ((i = next++) < count)
+		body(i);
+
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <functional>
+
+// Number of worker threads to use when the caller asks for 0 ("automatic").
+int hardware_threads();
+
+/*
+ * Runs body(0) ... body(count - 1) on up to `threads` threads, the calling
+ * thread included. Iterations are handed out dynamically, so uneven work
+ * is balanced. threads <= 0 means hardware_threads().
+ */
+void parallel_for(int count, int threads, const std::function<void (int)> &body);
@@ -0,0 +1,4 @@
+#pragma once
+
+// Monotonic wall clock in seconds, for load-time statistics and benchmarks.
+double timer_seconds();